@@ -0,0 +1,99 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Heap allocation accounting for the real-time mode
+ * @author Stylianos Piperakis
+ * @details counts the heap allocations of the calling thread by interposing malloc and friends
+ * (src/AllocationCounter.cpp, only linked with -DSEROW_ALLOCATION_TRACKING=ON), a ScopedAllocationCheck
+ * then reports the allocations done inside an estimator cycle
+ */
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+#include <iostream>
+#include <cstdlib>
+
+namespace serow
+{
+#ifdef SEROW_ALLOCATION_TRACKING
+    /** @fn unsigned long allocationCount()
+     *  @brief number of heap allocations the calling thread has done so far
+    */
+    unsigned long allocationCount();
+
+    /** @fn bool allocationTrackingAvailable()
+     *  @brief true when the malloc hooks are linked in
+    */
+    inline bool allocationTrackingAvailable()
+    {
+        return true;
+    }
+#else
+    inline unsigned long allocationCount()
+    {
+        return 0;
+    }
+    inline bool allocationTrackingAvailable()
+    {
+        return false;
+    }
+#endif
+
+    /**
+     * @brief counts the allocations of the calling thread between construction and destruction,
+     * reports them on std::cerr and aborts if asked to
+     */
+    class ScopedAllocationCheck
+    {
+    private:
+        const char *label;
+        unsigned long start;
+        bool armed, abortOnAllocation;
+
+    public:
+        ScopedAllocationCheck(bool armed_, bool abortOnAllocation_, const char *label_ = "estimator cycle")
+            : label(label_), start(0), armed(armed_ && allocationTrackingAvailable()), abortOnAllocation(abortOnAllocation_)
+        {
+            if (armed)
+                start = allocationCount();
+        }
+        ~ScopedAllocationCheck()
+        {
+            if (!armed)
+                return;
+            unsigned long n = allocationCount() - start;
+            if (n == 0)
+                return;
+            std::cerr << "[serow] rt_mode: " << n << " heap allocation(s) in the " << label << std::endl;
+            if (abortOnAllocation)
+                std::abort();
+        }
+    };
+} // namespace serow
+#endif
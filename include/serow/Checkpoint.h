@@ -0,0 +1,348 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Binary checkpoint of the estimator state for warm restarts
+ * @author Stylianos Piperakis
+ * @details a Checkpoint is a list of named blocks of doubles (biases, states, covariances, ...), filled in the
+ * same order every time so that refilling it does not allocate. save() writes a temporary file and renames it
+ * over the checkpoint, so a crash while saving leaves the previous checkpoint intact. CheckpointWriter saves
+ * from a background thread, the estimator hands it checkpoints through a triple buffer without blocking.
+ *
+ * File layout, host byte order: CheckpointFileHeader, then per block a CheckpointBlockHeader and count doubles.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+#include <eigen3/Eigen/Dense>
+#include "serow/TripleBuffer.h"
+
+namespace serow
+{
+    struct CheckpointFileHeader
+    {
+        char magic[8]; //"SEROWCKP"
+        uint32_t version, blocks;
+        ///Wall clock time of the checkpoint, nanoseconds since the epoch
+        int64_t stamp_ns;
+    };
+
+    struct CheckpointBlockHeader
+    {
+        static const int NameSize = 24;
+        char name[NameSize];
+        uint32_t count, reserved;
+    };
+
+    class Checkpoint
+    {
+    private:
+        struct Block
+        {
+            char name[CheckpointBlockHeader::NameSize];
+            uint32_t offset, count;
+        };
+        std::vector<Block> blocks;
+        std::vector<double> values;
+
+        const Block *find(const char *name) const
+        {
+            for (std::size_t i = 0; i < blocks.size(); i++)
+                if (std::strncmp(blocks[i].name, name, CheckpointBlockHeader::NameSize) == 0)
+                    return &blocks[i];
+            return NULL;
+        }
+
+    public:
+        static const uint32_t Version = 1;
+        ///Wall clock time of the state, nanoseconds since the epoch
+        int64_t stamp_ns;
+
+        Checkpoint() : stamp_ns(0) {}
+
+        /** @fn void clear()
+         *  @brief removes the blocks but keeps the storage for the next fill
+        */
+        void clear()
+        {
+            blocks.clear();
+            values.clear();
+            stamp_ns = 0;
+        }
+
+        bool empty() const
+        {
+            return blocks.empty();
+        }
+
+        /** @fn void put(const char *name, const double *v, uint32_t count)
+         *  @brief appends block name with count values, names are truncated to 23 characters
+        */
+        void put(const char *name, const double *v, uint32_t count)
+        {
+            Block b;
+            std::memset(b.name, 0, sizeof(b.name));
+            std::strncpy(b.name, name, sizeof(b.name) - 1);
+            b.offset = values.size();
+            b.count = count;
+            blocks.push_back(b);
+            values.insert(values.end(), v, v + count);
+        }
+
+        template <typename Derived>
+        void put(const char *name, const Eigen::PlainObjectBase<Derived> &m)
+        {
+            put(name, m.data(), m.size());
+        }
+
+        /** @fn bool get(const char *name, double *v, uint32_t count) const
+         *  @brief copies block name to v, false if it is missing or does not have count values
+        */
+        bool get(const char *name, double *v, uint32_t count) const
+        {
+            const Block *b = find(name);
+            if (!b || b->count != count)
+                return false;
+            std::memcpy(v, &values[b->offset], count * sizeof(double));
+            return true;
+        }
+
+        template <typename Derived>
+        bool get(const char *name, Eigen::PlainObjectBase<Derived> &m) const
+        {
+            return get(name, m.data(), m.size());
+        }
+
+        /** @fn bool take(const char *name, Eigen::PlainObjectBase<Derived> &m)
+         *  @brief get() that also removes the block, for state that must be restored only once
+        */
+        template <typename Derived>
+        bool take(const char *name, Eigen::PlainObjectBase<Derived> &m)
+        {
+            const Block *b = find(name);
+            if (!b || !get(name, m))
+                return false;
+            blocks.erase(blocks.begin() + (b - &blocks[0]));
+            return true;
+        }
+
+        bool has(const char *name) const
+        {
+            return find(name) != NULL;
+        }
+
+        /** @fn bool save(const std::string &path) const
+         *  @brief writes path.tmp and renames it to path
+        */
+        bool save(const std::string &path) const
+        {
+            const std::string tmp = path + ".tmp";
+            FILE *f = std::fopen(tmp.c_str(), "wb");
+            if (!f)
+                return false;
+            CheckpointFileHeader h;
+            std::memcpy(h.magic, "SEROWCKP", 8);
+            h.version = Version;
+            h.blocks = blocks.size();
+            h.stamp_ns = stamp_ns;
+            bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+            for (std::size_t i = 0; ok && i < blocks.size(); i++)
+            {
+                CheckpointBlockHeader bh;
+                std::memcpy(bh.name, blocks[i].name, sizeof(bh.name));
+                bh.count = blocks[i].count;
+                bh.reserved = 0;
+                ok = std::fwrite(&bh, sizeof(bh), 1, f) == 1 &&
+                     std::fwrite(&values[blocks[i].offset], sizeof(double), bh.count, f) == bh.count;
+            }
+            ok = std::fclose(f) == 0 && ok;
+            if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+            {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        /** @fn bool load(const std::string &path)
+         *  @brief reads a checkpoint written by save(), false if it is missing, truncated or of another version
+        */
+        bool load(const std::string &path)
+        {
+            clear();
+            FILE *f = std::fopen(path.c_str(), "rb");
+            if (!f)
+                return false;
+            CheckpointFileHeader h;
+            bool ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(h.magic, "SEROWCKP", 8) == 0 && h.version == Version;
+            for (uint32_t i = 0; ok && i < h.blocks; i++)
+            {
+                CheckpointBlockHeader bh;
+                ok = std::fread(&bh, sizeof(bh), 1, f) == 1 && bh.count < (1u << 20);
+                if (!ok)
+                    break;
+                bh.name[sizeof(bh.name) - 1] = 0;
+                Block b;
+                std::memcpy(b.name, bh.name, sizeof(b.name));
+                b.offset = values.size();
+                b.count = bh.count;
+                values.resize(values.size() + bh.count);
+                ok = std::fread(&values[b.offset], sizeof(double), bh.count, f) == bh.count;
+                blocks.push_back(b);
+            }
+            std::fclose(f);
+            if (!ok)
+            {
+                clear();
+                return false;
+            }
+            stamp_ns = h.stamp_ns;
+            return true;
+        }
+    };
+
+    /**
+     * @brief Saves checkpoints handed over by the estimator thread from a background thread
+     * @details the estimator fills write() and publish()es it through a triple buffer, the writer thread polls
+     * the buffer and saves the latest checkpoint from its own slot, so neither side copies, locks or allocates
+     * once the slots are sized by open()
+     */
+    class CheckpointWriter
+    {
+    private:
+        std::string path;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread writer;
+        TripleBuffer<Checkpoint> buffer;
+        bool running;
+        double pollPeriod;
+        std::atomic<long> saved, failed;
+
+        void save()
+        {
+            if (!buffer.update())
+                return;
+            if (buffer.read().save(path))
+                saved++;
+            else
+                failed++;
+        }
+
+        void writerLoop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (running)
+            {
+                cv.wait_for(lock, std::chrono::duration<double>(pollPeriod), [this] { return !running; });
+                lock.unlock();
+                save();
+                lock.lock();
+            }
+        }
+
+    public:
+        CheckpointWriter() : running(false), pollPeriod(0.1), saved(0), failed(0) {}
+        ~CheckpointWriter()
+        {
+            close();
+        }
+
+        /** @fn void open(const std::string &path_, const Checkpoint &layout)
+         *  @brief sizes the three slots after layout and starts the writer thread, checkpoints are saved to path_
+         *  @details later checkpoints with the same blocks are filled in place without allocating
+        */
+        void open(const std::string &path_, const Checkpoint &layout)
+        {
+            close();
+            path = path_;
+            for (int i = 0; i < 3; i++)
+                buffer.slot(i) = layout;
+            running = true;
+            writer = std::thread(&CheckpointWriter::writerLoop, this);
+        }
+
+        bool isOpen() const
+        {
+            return writer.joinable();
+        }
+
+        /** @fn Checkpoint &write()
+         *  @brief the slot owned by the estimator, filled before publish()
+        */
+        Checkpoint &write()
+        {
+            return buffer.write();
+        }
+
+        /** @fn void publish()
+         *  @brief hands the filled slot to the writer thread, a checkpoint not yet saved is replaced
+        */
+        void publish()
+        {
+            buffer.publish();
+        }
+
+        /** @fn void close()
+         *  @brief saves the last published checkpoint and stops the writer thread
+        */
+        void close()
+        {
+            if (!writer.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running = false;
+            }
+            cv.notify_one();
+            writer.join();
+            save();
+        }
+
+        long savedCount() const
+        {
+            return saved.load();
+        }
+
+        long failedCount() const
+        {
+            return failed.load();
+        }
+    };
+} // namespace serow
+#endif
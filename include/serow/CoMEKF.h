@@ -125,6 +125,20 @@ public:
 		x(7) = force(1);
 		x(8) = force(2);
 	}
+	/** @fn const Matrix<double, 9, 9> &covariance() const
+     *   @brief error covariance of the CoM state
+     */
+	const Matrix<double, 9, 9> &covariance() const
+	{
+		return P;
+	}
+	/** @fn void setCovariance(const Matrix<double, 9, 9> &P_)
+     *   @brief initializes the error covariance, e.g. from a checkpoint
+     */
+	void setCovariance(const Matrix<double, 9, 9> &P_)
+	{
+		P = P_;
+	}
 	/** @fn void predict(Vector3d COP_, Vector3d fN_, Vector3d L_);
      *   @brief realizes the predict step of the EKF
      *   @param COP_ 3D COP position
@@ -272,6 +272,23 @@ public:
     lmdf = MediatorNew(medianWindow);
     cout<<"Gait-Phase Estimation Module with Schmitt-Trigger Initialized"<<endl;
   }
+  /** @fn void setThresholds(double LegHighThres_, double LegLowThres_, double StrikingContact_, double VelocityThres_)
+   *  @brief updates the Schmitt-Trigger and foot velocity thresholds, the contact state is kept
+   */
+  void setThresholds(double LegHighThres_, double LegLowThres_, double StrikingContact_, double VelocityThres_)
+  {
+    LegHighThres = LegHighThres_;
+    LegLowThres = LegLowThres_;
+    StrikingContact = StrikingContact_;
+    VelocityThres = VelocityThres_;
+  }
+  /** @fn void setProbabilityThreshold(double prob_TH_)
+   *  @brief updates the contact probability threshold, same scale as the one of the probabilistic init()
+   */
+  void setProbabilityThreshold(double prob_TH_)
+  {
+    prob_TH = prob_TH_/2.0;
+  }
   /** @fn getDiffForce()
    *  @brief returns the absolute vertical force difference between the two legs
    */
@@ -362,24 +379,24 @@ public:
   {
     return contactRFilt;
   }
-  /** @fn   std::string getSupportFrame()
+  /** @fn   const std::string &getSupportFrame()
    *  @brief  returns the support foot frame
    */
-  std::string getSupportFrame()
+  const std::string &getSupportFrame()
   {
     return support_foot_frame;
   }
-  /** @fn   std::string getSupportLeg()
+  /** @fn   const std::string &getSupportLeg()
    *  @brief  returns the support leg
    */
-  std::string getSupportLeg()
+  const std::string &getSupportLeg()
   {
     return support_leg;
   }
-  /** @fn   std::string getSupportPhase()
+  /** @fn   const std::string &getSupportPhase()
    *  @brief  returns the gait phase
   */
-  std::string getSupportPhase()
+  const std::string &getSupportPhase()
   {
     return phase;
   }
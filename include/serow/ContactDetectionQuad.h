@@ -356,6 +356,23 @@ public:
     RHmdf = MediatorNew(medianWindow);
     cout<<"Gait-Phase Estimation Module Initialized"<<endl;
   }
+  /** @fn void setThresholds(double LegHighThres_, double LegLowThres_, double StrikingContact_, double VelocityThres_)
+   *  @brief updates the Schmitt-Trigger and foot velocity thresholds, the contact state is kept
+   */
+  void setThresholds(double LegHighThres_, double LegLowThres_, double StrikingContact_, double VelocityThres_)
+  {
+    LegHighThres = LegHighThres_;
+    LegLowThres = LegLowThres_;
+    StrikingContact = StrikingContact_;
+    VelocityThres = VelocityThres_;
+  }
+  /** @fn void setProbabilityThreshold(double prob_TH_)
+   *  @brief updates the contact probability threshold
+   */
+  void setProbabilityThreshold(double prob_TH_)
+  {
+    prob_TH = prob_TH_;
+  }
   double getLFDiffForce()
   {
     return fabs(deltaLFfz);
@@ -479,16 +496,16 @@ public:
     return contactRHFilt;
   }
 
-  std::string getSupportFrame()
+  const std::string &getSupportFrame()
   {
     return support_foot_frame;
   }
 
-  std::string getSupportPhase()
+  const std::string &getSupportPhase()
   {
     return phase;
   }
-  std::string getSupportLeg()
+  const std::string &getSupportLeg()
   {
     return support_leg;
   }
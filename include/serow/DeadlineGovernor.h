@@ -0,0 +1,221 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Deadline monitor and degraded mode governor of the estimation loop
+ * @author Stylianos Piperakis
+ * @details measures the period and the compute time of every estimator cycle against the IMU period, when
+ * overruns persist over a window the governor steps down one level at a time and steps back up once the
+ * cycles have had enough headroom for a number of windows
+ */
+
+#ifndef DEADLINEGOVERNOR_H
+#define DEADLINEGOVERNOR_H
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <stdint.h>
+#include "serow/StageProfiler.h"
+
+namespace serow
+{
+    class DeadlineGovernor
+    {
+    public:
+        /// Degradation levels, every level includes the ones before it
+        enum Level
+        {
+            Nominal,
+            DecimatePublishing, ///< non core topic groups are published at a lower rate
+            SlowCoM,            ///< the CoM estimator runs at a lower rate
+            SkipOptional,       ///< ground-truth and comparison odometry are not processed
+            MinimalBase,        ///< only the base estimator runs, in its cheapest configuration
+            NumLevels
+        };
+
+    private:
+        bool enabled;
+        uint64_t period_ns, budget_ns, restore_ns;
+        int window, restore_windows, max_level;
+        double degrade_ratio;
+        std::atomic<int> lvl;
+        //current window
+        uint64_t cycle_start, last_start;
+        int cycles, window_overruns, quiet_windows;
+        //totals for the report
+        uint64_t total_cycles, total_overruns, max_compute, max_period, level_changes;
+        double jitter_sum;
+
+    public:
+        DeadlineGovernor() : enabled(false), period_ns(0), budget_ns(0), restore_ns(0), window(100), restore_windows(5),
+                             max_level(NumLevels - 1), degrade_ratio(0.05), lvl(Nominal), cycle_start(0), last_start(0), cycles(0),
+                             window_overruns(0), quiet_windows(0), total_cycles(0), total_overruns(0), max_compute(0),
+                             max_period(0), level_changes(0), jitter_sum(0) {}
+
+        /** @fn void init(double freq, double budget, int window_, double degrade_ratio_, double restore_budget, int restore_windows_, int max_level_)
+         *  @brief enables the monitor for an estimation rate of freq Hz
+         *  @param budget fraction of the period a cycle may compute before it counts as an overrun
+         *  @param window_ cycles per decision window
+         *  @param degrade_ratio_ fraction of overrunning cycles in a window that steps the level down
+         *  @param restore_budget fraction of the period the slowest cycle of a window must stay under to count as headroom
+         *  @param restore_windows_ consecutive windows with headroom that step the level back up
+         *  @param max_level_ deepest level the governor may reach, 0 only monitors
+        */
+        void init(double freq, double budget, int window_, double degrade_ratio_, double restore_budget, int restore_windows_, int max_level_)
+        {
+            enabled = freq > 0;
+            period_ns = enabled ? (uint64_t)(1.0e9 / freq) : 0;
+            budget_ns = (uint64_t)(period_ns * budget);
+            restore_ns = (uint64_t)(period_ns * restore_budget);
+            window = window_ > 0 ? window_ : 1;
+            degrade_ratio = degrade_ratio_;
+            restore_windows = restore_windows_ > 0 ? restore_windows_ : 1;
+            max_level = max_level_ < 0 ? 0 : (max_level_ >= NumLevels ? NumLevels - 1 : max_level_);
+            lvl = Nominal;
+        }
+
+        /** @fn void start()
+         *  @brief marks the beginning of an estimator cycle
+        */
+        void start()
+        {
+            if (!enabled)
+                return;
+            cycle_start = monotonicNs();
+            if (last_start)
+            {
+                uint64_t period = cycle_start - last_start;
+                if (period > max_period)
+                    max_period = period;
+                jitter_sum += period > period_ns ? period - period_ns : period_ns - period;
+            }
+            last_start = cycle_start;
+        }
+
+        /** @fn bool stop()
+         *  @brief marks the end of an estimator cycle, returns true when the cycle changed the level
+        */
+        bool stop()
+        {
+            if (!enabled || !cycle_start)
+                return false;
+            uint64_t compute = monotonicNs() - cycle_start;
+            cycle_start = 0;
+            total_cycles++;
+            if (compute > max_compute)
+                max_compute = compute;
+            if (compute > budget_ns)
+            {
+                window_overruns++;
+                total_overruns++;
+            }
+            //the window maximum decides on restoring, a single slow cycle keeps the level
+            if (compute > restore_ns)
+                quiet_windows = -1;
+            if (++cycles < window)
+                return false;
+
+            int l = lvl, next = l;
+            if (window_overruns > degrade_ratio * window)
+            {
+                if (l < max_level)
+                    next = l + 1;
+                quiet_windows = 0;
+            }
+            else if (quiet_windows < 0)
+                quiet_windows = 0;
+            else if (l > Nominal && ++quiet_windows >= restore_windows)
+            {
+                next = l - 1;
+                quiet_windows = 0;
+            }
+            cycles = 0;
+            window_overruns = 0;
+            if (next == l)
+                return false;
+            lvl = next;
+            level_changes++;
+            return true;
+        }
+
+        /** @fn int level() const
+         *  @brief current degradation level, safe to read from any thread
+        */
+        int level() const
+        {
+            return lvl;
+        }
+
+        /** @fn bool atLeast(Level l) const
+         *  @brief true when the governor has stepped down to l or further
+        */
+        bool atLeast(Level l) const
+        {
+            return lvl >= l;
+        }
+
+        static const char *levelName(int l)
+        {
+            switch (l)
+            {
+            case Nominal:
+                return "nominal";
+            case DecimatePublishing:
+                return "decimated publishing";
+            case SlowCoM:
+                return "reduced CoM rate";
+            case SkipOptional:
+                return "no ground-truth/comparison";
+            case MinimalBase:
+                return "minimal base estimator";
+            default:
+                return "unknown";
+            }
+        }
+
+        /** @fn std::string report() const
+         *  @brief overrun, period and compute time summary of the run
+        */
+        std::string report() const
+        {
+            std::ostringstream os;
+            os << std::fixed << std::setprecision(3);
+            os << "deadline " << period_ns * 1e-6 << " ms, budget " << budget_ns * 1e-6 << " ms, cycles " << total_cycles
+               << ", overruns " << total_overruns;
+            if (total_cycles)
+                os << " (" << 100.0 * total_overruns / total_cycles << "%)";
+            os << ", max compute " << max_compute * 1e-6 << " ms, max period " << max_period * 1e-6 << " ms";
+            if (total_cycles > 1)
+                os << ", mean jitter " << jitter_sum / (total_cycles - 1) * 1e-6 << " ms";
+            os << ", level changes " << level_changes << ", final level " << levelName(lvl);
+            return os.str();
+        }
+    };
+} // namespace serow
+#endif
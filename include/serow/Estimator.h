@@ -0,0 +1,180 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Compile-time composition of the estimation pipeline
+ * @author Stylianos Piperakis
+ * @details the attitude filter, base filter, contact detector and CoM estimator are chosen with policy
+ * classes and stored by value in one Estimator object, the stage dispatch of the estimation cycle is
+ * resolved at compile time for every configuration the node instantiates
+ */
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+#include <cstddef>
+#include <eigen3/Eigen/Dense>
+#include "serow/Madgwick.h"
+#include "serow/Mahony.h"
+
+namespace serow
+{
+    /// Gains of the attitude filters, only the ones of the selected filter are used
+    struct AttitudeParams
+    {
+        double freq;
+        double beta;
+        double Kp;
+        double Ki;
+    };
+
+    /// Attitude estimation with the Madgwick filter
+    struct MadgwickAttitude
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Madgwick filter;
+        explicit MadgwickAttitude(const AttitudeParams &p) : filter(p.freq, p.beta) {}
+    };
+
+    /// Attitude estimation with the Mahony filter
+    struct MahonyAttitude
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        Mahony filter;
+        explicit MahonyAttitude(const AttitudeParams &p) : filter(p.freq, p.Kp, p.Ki) {}
+    };
+
+    /// Base estimation with a rigid body EKF that is updated with the leg odometry twist
+    template <class Filter>
+    struct RigidBodyBase
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        static const bool ContactAided = false;
+        Filter filter;
+        RigidBodyBase() { filter.init(); }
+    };
+
+    /// Base estimation with a contact aided invariant EKF that keeps the feet in its state
+    template <class Filter>
+    struct ContactAidedBase
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        static const bool ContactAided = true;
+        Filter filter;
+        ContactAidedBase() { filter.init(); }
+    };
+
+    /// Contact detection with a Schmitt trigger on the vertical leg forces
+    template <class Detector>
+    struct ThresholdContact
+    {
+        static const bool Probabilistic = false;
+        Detector detector;
+    };
+
+    /// Contact detection with the Gait-phase Estimation Module (force, COP and kinematics probabilities)
+    template <class Detector>
+    struct ProbabilisticContact
+    {
+        static const bool Probabilistic = true;
+        Detector detector;
+    };
+
+    /// CoM estimation with the nonlinear CoM EKF
+    template <class Filter>
+    struct CoMEstimation
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        static const bool Enabled = true;
+        Filter filter;
+        CoMEstimation() { filter.init(); }
+    };
+
+    /// No CoM estimation, the empty placeholder keeps the layout of the pipeline uniform
+    struct NoCoMEstimation
+    {
+        struct None
+        {
+        };
+        static const bool Enabled = false;
+        None filter;
+    };
+
+    /// Resolves componentOf() for a component of type U
+    template <class T, class U>
+    struct ComponentOf
+    {
+        static T *get(U &) { return NULL; }
+    };
+
+    template <class T>
+    struct ComponentOf<T, T>
+    {
+        static T *get(T &c) { return &c; }
+    };
+
+    /** @fn T *componentOf(U &c)
+     *  @brief returns the address of c when it is a T and NULL otherwise
+     *  @details lets the node alias its component pointers to whatever the selected policies hold
+    */
+    template <class T, class U>
+    inline T *componentOf(U &c)
+    {
+        return ComponentOf<T, U>::get(c);
+    }
+
+    /// Common base so that the node can own any composed pipeline through one pointer
+    class EstimatorPipeline
+    {
+    public:
+        virtual ~EstimatorPipeline() {}
+    };
+
+    /**
+     * @brief Estimation pipeline composed from one policy per stage
+     * @details all components are members, so a configuration is a single allocation made at start-up and
+     * the policy constants (ContactAided, Probabilistic, Enabled) fold the stage selection away in the cycle
+     */
+    template <class AttitudePolicy, class BaseFilterPolicy, class ContactPolicy, class CoMPolicy>
+    class Estimator : public EstimatorPipeline
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        typedef AttitudePolicy Attitude;
+        typedef BaseFilterPolicy BaseFilter;
+        typedef ContactPolicy Contact;
+        typedef CoMPolicy CoM;
+
+        Attitude attitude;
+        BaseFilter base;
+        Contact contact;
+        CoM com;
+
+        explicit Estimator(const AttitudeParams &p) : attitude(p) {}
+    };
+} // namespace serow
+#endif
@@ -0,0 +1,71 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Table exported by a generated kinematics library
+ * @author Stylianos Piperakis
+ * @details scripts/serow_kinematics_codegen.py turns a URDF and the configured foot frames into
+ * straight-line C++ that fills this table, robotDyn loads the resulting shared library with dlopen and
+ * uses it instead of the Pinocchio algorithms. All quantities are expressed in the root link of the URDF.
+ */
+
+#ifndef GENERATEDKINEMATICS_H
+#define GENERATEDKINEMATICS_H
+
+///Bumped whenever the layout of GeneratedKinematics or of its buffers changes
+#define SEROW_GENERATED_KINEMATICS_VERSION 1
+///Symbol every generated library exports
+#define SEROW_GENERATED_KINEMATICS_ENTRY "serow_generated_kinematics"
+
+namespace serow
+{
+    /**
+     * @brief Generated kinematics of one robot, plain data only
+     * @details q holds num_joints values in the order of joint_names. For frame f, frames() writes the
+     * position to pos[3f], the rotation column-major to rot[9f], and the 6 x num_joints Jacobian
+     * column-major to jac[6 num_joints f], linear rows first, both with respect to the root link
+     * and expressed in it.
+     */
+    struct GeneratedKinematics
+    {
+        int version;
+        const char *robot;
+        const char *base_frame;
+        int num_joints;
+        const char *const *joint_names;
+        int num_frames;
+        const char *const *frame_names;
+        ///Total mass of the model
+        double mass;
+        void (*frames)(const double *q, double *pos, double *rot, double *jac);
+        void (*com)(const double *q, double *com);
+    };
+
+    typedef const GeneratedKinematics *(*GeneratedKinematicsEntry)();
+}
+#endif
@@ -0,0 +1,289 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Offline replay of the humanoid base estimation
+ * @author Stylianos Piperakis
+ * @details runs the Mahony attitude, the kinematics, the Schmitt-Trigger contact detection, the leg odometry and
+ * IMUEKF over recorded sensor arrays in the order humanoid_ekf does for every IMU sample, without ROS. The rows
+ * of all arrays are synchronized samples at freq, force/torque already in the foot frames, IMU in the base frame.
+ * Not replayed: the IMU bias calibration (the biases are given), the no motion check and the external odometry.
+ */
+
+#ifndef HUMANOIDREPLAY_H
+#define HUMANOIDREPLAY_H
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <serow/robotDyn.h>
+#include <serow/Mahony.h>
+#include <serow/mediator.h>
+#include <serow/ContactDetection.h>
+#include <serow/deadReckoning.h>
+#include <serow/IMUEKF.h>
+#include <serow/NoiseParameters.h>
+
+namespace serow
+{
+    /// Parameters of the replay, the defaults are those of humanoid_ekf
+    struct HumanoidReplayParams
+    {
+        std::string modelname, lfoot_frame, rfoot_frame, model_cache_dir;
+        /// Column names of the joint arrays
+        std::vector<std::string> joint_names;
+        double freq, joint_noise_density, mass, gravity, Tau0, Tau1;
+        double Mahony_Kp, Mahony_Ki;
+        double LegHighThres, LegLowThres, StrikingContact, VelocityThres, LosingContact;
+        int medianWindow;
+        bool useLegOdom;
+        /// FT sensor position w.r.t the foot frames
+        Eigen::Vector3d p_FT_LL, p_FT_RL;
+        Eigen::Vector3d bias_a, bias_g;
+        ImuNoiseParams noise;
+
+        HumanoidReplayParams()
+        {
+            freq = 100.0;
+            joint_noise_density = 0.03;
+            mass = 5.14;
+            gravity = 9.81;
+            Tau0 = 0.5;
+            Tau1 = 0.01;
+            Mahony_Kp = 0.25;
+            Mahony_Ki = 0.0;
+            LegHighThres = 20.0;
+            LegLowThres = 15.0;
+            StrikingContact = 5.0;
+            VelocityThres = 0.5;
+            LosingContact = 5.0;
+            medianWindow = 10;
+            useLegOdom = false;
+            p_FT_LL.setZero();
+            p_FT_RL.setZero();
+            bias_a.setZero();
+            bias_g.setZero();
+            for (int j = 0; j < 3; j++)
+            {
+                noise.acc_q[j] = 0.02;
+                noise.gyr_q[j] = 0.002;
+                noise.accb_q[j] = 0.001;
+                noise.gyrb_q[j] = 0.0001;
+                noise.foot_contact[j] = 0.1;
+                noise.odom_p[j] = 0.01;
+                noise.odom_a[j] = 0.01;
+                noise.leg_odom_p[j] = 0.001;
+                noise.leg_odom_a[j] = 0.001;
+                noise.vel_p[j] = 0.1;
+            }
+            noise.mahalanobis_TH = -1;
+        }
+    };
+
+    class HumanoidReplay
+    {
+    public:
+        /// Row-major arrays, as NumPy lays them out
+        typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Rows;
+        /// Columns of an output row, the quaternion is w, x, y, z
+        enum Column
+        {
+            BasePosition = 0,
+            BaseVelocity = 3,
+            BaseOrientation = 6,
+            GyroBias = 10,
+            AccBias = 13,
+            LegOdometry = 16,
+            Contact = 19,
+            Columns = 21
+        };
+
+    private:
+        HumanoidReplayParams p;
+        robotDyn *rd;
+        Mahony attitude;
+        ContactDetection cd;
+        Mediator *lmdf, *rmdf;
+        deadReckoning *dr;
+        IMUEKF imuEKF;
+        Eigen::VectorXd q, dq;
+        Eigen::Affine3d Twb, Twb_;
+        Eigen::Quaterniond qwb, qwb_, q_update;
+        Eigen::Vector3d pos_update;
+        bool firstUpdate;
+
+        HumanoidReplay(const HumanoidReplay &);
+        HumanoidReplay &operator=(const HumanoidReplay &);
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        HumanoidReplay(const HumanoidReplayParams &params) : p(params), attitude(params.freq, params.Mahony_Kp, params.Mahony_Ki)
+        {
+            rd = new robotDyn(p.modelname, false, false, p.model_cache_dir);
+            rd->mapJointNames(p.joint_names);
+            q.setZero(p.joint_names.size());
+            dq.setZero(p.joint_names.size());
+            lmdf = MediatorNew(p.medianWindow);
+            rmdf = MediatorNew(p.medianWindow);
+            dr = NULL;
+            cd.init(p.lfoot_frame, p.rfoot_frame, p.LegHighThres, p.LegLowThres, p.StrikingContact, p.VelocityThres, 0.9, p.medianWindow);
+            imuEKF.init();
+            applyImuNoise(imuEKF, p.noise);
+            imuEKF.mahalanobis_TH = p.noise.mahalanobis_TH;
+            imuEKF.ghat = p.gravity;
+            Twb = Eigen::Affine3d::Identity();
+            Twb_ = Twb;
+            qwb = Eigen::Quaterniond::Identity();
+            qwb_ = qwb;
+            q_update = qwb;
+            pos_update.setZero();
+            firstUpdate = true;
+        }
+
+        ~HumanoidReplay()
+        {
+            delete dr;
+            delete rd;
+            free(lmdf);
+            free(rmdf);
+        }
+
+        /** @fn void step(const Eigen::Vector3d& gyro, const Eigen::Vector3d& acc, const Eigen::Ref<const Eigen::VectorXd>& qj,
+         *  const Eigen::Ref<const Eigen::VectorXd>& dqj, const Eigen::Matrix<double, 6, 1>& lft, const Eigen::Matrix<double, 6, 1>& rft, double* out)
+         *  @brief one estimation cycle, lft/rft are force then torque in the foot frame, out receives Columns values
+        */
+        void step(const Eigen::Vector3d &gyro, const Eigen::Vector3d &acc, const Eigen::Ref<const Eigen::VectorXd> &qj,
+                  const Eigen::Ref<const Eigen::VectorXd> &dqj, const Eigen::Matrix<double, 6, 1> &lft, const Eigen::Matrix<double, 6, 1> &rft, double *out)
+        {
+            attitude.updateIMU(gyro, acc);
+
+            //Kinematics
+            q = qj;
+            dq = dqj;
+            rd->updateJointConfig(q, dq, p.joint_noise_density);
+            Eigen::Affine3d Tbl = Eigen::Affine3d::Identity(), Tbr = Eigen::Affine3d::Identity();
+            Tbl.translation() = rd->linkPosition(p.lfoot_frame);
+            Tbl.linear() = rd->linkOrientation(p.lfoot_frame).toRotationMatrix();
+            Tbr.translation() = rd->linkPosition(p.rfoot_frame);
+            Tbr.linear() = rd->linkOrientation(p.rfoot_frame).toRotationMatrix();
+            if (!dr)
+                dr = new deadReckoning(Eigen::Vector3d(Tbl.translation()(0), Tbl.translation()(1), 0.0), Eigen::Vector3d(Tbr.translation()(0), Tbr.translation()(1), 0.0),
+                                       Tbl.linear(), Tbr.linear(), p.mass, p.Tau0, p.Tau1, p.freq, p.gravity, p.p_FT_LL, p.p_FT_RL);
+
+            qwb_ = qwb;
+            qwb = Eigen::Quaterniond(attitude.getR());
+            const Eigen::Matrix3d Rwb = qwb.toRotationMatrix();
+            const Eigen::Vector3d omegawb = attitude.getGyro();
+
+            //GRF in the world frame, the vertical force for the contact detection is median filtered
+            Eigen::Vector3d LLegGRF = lft.head<3>(), LLegGRT = lft.tail<3>(), RLegGRF = rft.head<3>(), RLegGRT = rft.tail<3>();
+            MediatorInsert(lmdf, LLegGRF(2));
+            MediatorInsert(rmdf, RLegGRF(2));
+            Eigen::Vector3d LLegForceFilt(LLegGRF(0), LLegGRF(1), MediatorMedian(lmdf));
+            Eigen::Vector3d RLegForceFilt(RLegGRF(0), RLegGRF(1), MediatorMedian(rmdf));
+            if (LLegGRF(2) < p.LosingContact)
+            {
+                LLegGRF.setZero();
+                LLegGRT.setZero();
+            }
+            if (RLegGRF(2) < p.LosingContact)
+            {
+                RLegGRF.setZero();
+                RLegGRT.setZero();
+            }
+            LLegForceFilt = Rwb * Tbl.linear() * LLegForceFilt;
+            RLegForceFilt = Rwb * Tbr.linear() * RLegForceFilt;
+            LLegGRF = Rwb * Tbl.linear() * LLegGRF;
+            RLegGRF = Rwb * Tbr.linear() * RLegGRF;
+            LLegGRT = Rwb * Tbl.linear() * LLegGRT;
+            RLegGRT = Rwb * Tbr.linear() * RLegGRT;
+            cd.computeForceWeights(LLegForceFilt(2), RLegForceFilt(2));
+            cd.SchmittTrigger(LLegForceFilt(2), RLegForceFilt(2));
+
+            //Leg odometry
+            dr->computeDeadReckoning(Rwb, Tbl.linear(), Tbr.linear(), omegawb, gyro, Tbl.translation(), Tbr.translation(),
+                                     rd->getLinearVelocity(p.lfoot_frame), rd->getLinearVelocity(p.rfoot_frame),
+                                     rd->getAngularVelocity(p.lfoot_frame), rd->getAngularVelocity(p.rfoot_frame),
+                                     LLegForceFilt(2), RLegForceFilt(2), LLegGRF, RLegGRF, LLegGRT, RLegGRT);
+            Twb_ = Twb;
+            Twb.linear() = Rwb;
+            Twb.translation() = dr->getOdom();
+
+            //Base EKF
+            if (imuEKF.firstrun)
+            {
+                imuEKF.setdt(1.0 / p.freq);
+                imuEKF.setBodyPos(Twb.translation());
+                imuEKF.setBodyOrientation(Rwb);
+                imuEKF.setAccBias(p.bias_a);
+                imuEKF.setGyroBias(p.bias_g);
+                imuEKF.firstrun = false;
+            }
+            imuEKF.predict(gyro, acc);
+            if (firstUpdate)
+            {
+                pos_update = Twb.translation();
+                q_update = qwb;
+                firstUpdate = false;
+                imuEKF.updateWithLegOdom(pos_update, q_update);
+            }
+            else if (p.useLegOdom)
+            {
+                pos_update += Twb.translation() - Twb_.translation();
+                q_update *= qwb * qwb_.inverse();
+                imuEKF.updateWithLegOdom(pos_update, q_update);
+            }
+            else
+                imuEKF.updateWithTwist(dr->getLinearVel());
+
+            Eigen::Map<Eigen::Matrix<double, Columns, 1> > o(out);
+            o.segment<3>(BasePosition) = imuEKF.x.segment<3>(6);
+            o.segment<3>(BaseVelocity) = imuEKF.Rib * imuEKF.x.segment<3>(0);
+            o.segment<4>(BaseOrientation) << imuEKF.qib.w(), imuEKF.qib.x(), imuEKF.qib.y(), imuEKF.qib.z();
+            o.segment<3>(GyroBias) = imuEKF.x.segment<3>(9);
+            o.segment<3>(AccBias) = imuEKF.x.segment<3>(12);
+            o.segment<3>(LegOdometry) = Twb.translation();
+            o(Contact) = cd.isLLegContact();
+            o(Contact + 1) = cd.isRLegContact();
+        }
+
+        /** @fn void run(const Eigen::Ref<const Rows>& gyro, const Eigen::Ref<const Rows>& acc, const Eigen::Ref<const Rows>& qj,
+         *  const Eigen::Ref<const Rows>& dqj, const Eigen::Ref<const Rows>& lft, const Eigen::Ref<const Rows>& rft, Eigen::Ref<Rows> out)
+         *  @brief step() over every row, gyro/acc are T x 3, qj/dqj T x joints, lft/rft T x 6 and out T x Columns
+        */
+        void run(const Eigen::Ref<const Rows> &gyro, const Eigen::Ref<const Rows> &acc, const Eigen::Ref<const Rows> &qj,
+                 const Eigen::Ref<const Rows> &dqj, const Eigen::Ref<const Rows> &lft, const Eigen::Ref<const Rows> &rft, Eigen::Ref<Rows> out)
+        {
+            for (Eigen::Index t = 0; t < gyro.rows(); t++)
+                step(gyro.row(t).transpose(), acc.row(t).transpose(), qj.row(t).transpose(), dqj.row(t).transpose(),
+                     lft.row(t).transpose(), rft.row(t).transpose(), out.row(t).data());
+        }
+    };
+} // namespace serow
+#endif
@@ -44,6 +44,7 @@
 #include <iostream>
 #include <eigen3/Eigen/Dense>
 #include <cmath>       /* isnan, sqrt */
+#include "serow/lie.h"
  
 
  
@@ -95,17 +96,17 @@ private:
 	 *  @brief computes the state transition matrix for linearized error state dynamics
      *  
 	*/
-	Matrix<double,15,15> computeTrans(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_);
+	Matrix<double,15,15> computeTrans(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_);
 	/**
 	 *  @brief performs euler (first-order) discretization to the nonlinear state-space dynamics
      *  
 	*/
-	void euler(Vector3d omega_, Vector3d f_);
+	void euler(const Vector3d &omega_, const Vector3d &f_);
 	/**
 	 *  @brief updates the parameters for the outlier detection on odometry measurements
      *  
 	*/
-	void updateOutlierDetectionParams(Eigen::Matrix<double, 3,3> B);
+	void updateOutlierDetectionParams(const Eigen::Matrix<double, 3,3> &B);
 	/**
 	 *  @brief computes the digamma Function Approximation
      *  
@@ -115,12 +116,12 @@ private:
 	 *  @brief computes the discrete-time nonlinear state-space dynamics
      *  
 	*/
-    Matrix<double,15,1> computeDiscreteDyn(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_);
+    Matrix<double,15,1> computeDiscreteDyn(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_);
 	/**
 	 *  @brief computes the continuous-time nonlinear state-space dynamics
      *  
 	*/
-	Matrix<double,15,1> computeContinuousDyn(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_);
+	Matrix<double,15,1> computeContinuousDyn(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_);
 
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -172,11 +173,11 @@ public:
 	void setdt(double dtt) {
 		dt = dtt;
 	}
-	/** @fn void setGyroBias(Vector3d bgyr_)
+	/** @fn void setGyroBias(const Vector3d &bgyr_)
 	 *  @brief initializes the angular velocity bias state of the Error State Kalman Filter (ESKF)
 	 *  @param bgyr_ angular velocity bias in the base coordinates
 	 */
-	void setGyroBias(Vector3d bgyr_)
+	void setGyroBias(const Vector3d &bgyr_)
 	{
 		bgyr = bgyr_;
 		x(9) = bgyr_(0);
@@ -186,11 +187,11 @@ public:
 		bias_gy = bgyr_(1);
 		bias_gz = bgyr_(2);
 	}
-	/** @fn void setAccBias(Vector3d bacc_)
+	/** @fn void setAccBias(const Vector3d &bacc_)
 	 *  @brief initializes the acceleration bias state of the Error State Kalman Filter (ESKF)
 	 *  @param bacc_ acceleration bias in the base coordinates
 	 */
-	void setAccBias(Vector3d bacc_)
+	void setAccBias(const Vector3d &bacc_)
 	{
 		bacc = bacc_;
 		x(12) = bacc_(0);
@@ -200,61 +201,89 @@ public:
 		bias_ay = bacc_(1);
 		bias_az = bacc_(2);
 	}
-	/** @fn void setBodyPos(Vector3d bp)
+	/** @fn void setBodyPos(const Vector3d &bp)
 	 *  @brief initializes the base position state of the Error State Kalman Filter (ESKF)
 	 *  @param bp Position of the base in the world frame
 	 */
-	void setBodyPos(Vector3d bp) {
+	void setBodyPos(const Vector3d &bp) {
 		x(6) = bp(0);
 		x(7) = bp(1);
 		x(8) = bp(2);
 	}
-	/** @fn void setBodyOrientation(Matrix3d Rot_)
+	/** @fn void setBodyOrientation(const Matrix3d &Rot_)
 	 *  @brief initializes the base rotation state of the Error State Kalman Filter (ESKF)
 	 *  @param Rot_ Rotation of the base in the world frame
 	 */
-	void setBodyOrientation(Matrix3d Rot_){
+	void setBodyOrientation(const Matrix3d &Rot_){
 		Rib = Rot_;
 	}
-	/** @fn void setBodyVel(Vector3d bv)
+	/** @fn void setBodyVel(const Vector3d &bv)
 	 *  @brief initializes the base velocity state of the Error State Kalman Filter (ESKF)
 	 *  @param bv linear velocity of the base in the base frame
 	 */
-    void setBodyVel(Vector3d bv)
+    void setBodyVel(const Vector3d &bv)
     {
         x.segment<3>(0).noalias() =  bv;
     }
-	/** @fn void predict(Vector3d omega_, Vector3d f_);
+	/** @fn const Matrix<double, 15, 15> &covariance() const
+	 *  @brief error state covariance of the Error State Kalman Filter (ESKF)
+	 */
+	const Matrix<double, 15, 15> &covariance() const
+	{
+		return P;
+	}
+	/** @fn void setCovariance(const Matrix<double, 15, 15> &P_)
+	 *  @brief initializes the error state covariance, e.g. from a checkpoint
+	 */
+	void setCovariance(const Matrix<double, 15, 15> &P_)
+	{
+		P = P_;
+	}
+	/** @fn void predict(const Vector3d &omega_, const Vector3d &f_);
 	 *  @brief realises the predict step of the Error State Kalman Filter (ESKF)
 	 *  @param omega_ angular velocity of the base in the base frame
 	 *  @param f_ linear acceleration of the base in the base frame
 	 */
-	void predict(Vector3d omega_, Vector3d f_);
-	/** @fn void updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection);
+	void predict(const Vector3d &omega_, const Vector3d &f_);
+	/** @fn void updateWithOdom(const Vector3d &y, const Quaterniond &qy, bool useOutlierDetection);
 	 *  @brief realises the pose update step of the Error State Kalman Filter (ESKF)
 	 *  @param y 3D base position measurement in the world frame
 	 *  @param qy orientation of the base w.r.t the world frame in quaternion
 	 *  @param useOutlierDetection check if the measurement is an outlier
 	 */
-	bool updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection);
-	/** @fn void updateWithLegOdom(Vector3d y, Quaterniond qy);
+	bool updateWithOdom(const Vector3d &y, const Quaterniond &qy, bool useOutlierDetection);
+	/** @fn void updateWithLegOdom(const Vector3d &y, const Quaterniond &qy);
 	 *  @brief realises the pose update step of the Error State Kalman Filter (ESKF) with Leg Odometry
 	 *  @param y 3D base position measurement in the world frame
 	 *  @param qy orientation of the base w.r.t the world frame in quaternion
 	 *  @note Leg odometry is accurate when accurate contact states are detected
 	 */
-	void updateWithLegOdom(Vector3d y, Quaterniond qy);
-	/** @fn void updateWithTwist(Vector3d y);
+	void updateWithLegOdom(const Vector3d &y, const Quaterniond &qy);
+	/** @fn void updateWithGyroBias(const Vector3d &y, const Matrix3d &Ry)
+	 *  @brief realises the update step of the Error State Kalman Filter (ESKF) with a gyro bias pseudo-measurement
+	 *  @param y angular velocity bias measured while the base stands still, in the base coordinates
+	 *  @param Ry covariance of y
+	 */
+	void updateWithGyroBias(const Vector3d &y, const Matrix3d &Ry);
+	/** @fn void updateWithTwist(const Vector3d &y);
 	 *  @brief realises the  update step of the Error State Kalman Filter (ESKF) with a base linear velocity measurement
 	 *  @param y 3D base velociy measurement in the world frame
 	 */
-	void updateWithTwist(Vector3d y);
-	/** @fn void updateWithTwistRotation(Vector3d y,Quaterniond qy);
+	void updateWithTwist(const Vector3d &y);
+	/** @fn void updateWithTwistRotation(const Vector3d &y,const Quaterniond &qy);
 	 *  @brief realises the  update step of the Error State Kalman Filter (ESKF) with a base linear velocity measurement and orientation measurement
 	 *  @param y 3D base velociy measurement in the world frame
 	 * 	@param qy orientation of the base w.r.t the world frame in quaternion
 	 */
-	void updateWithTwistRotation(Vector3d y,Quaterniond qy);
+	void updateWithTwistRotation(const Vector3d &y,const Quaterniond &qy);
+	/** @fn Matrix<double, 6, 6> poseCovariance() const
+	 *  @brief covariance of the base position and orientation in the world frame, ordered x, y, z, roll, pitch, yaw as in nav_msgs
+	 */
+	Matrix<double, 6, 6> poseCovariance() const;
+	/** @fn Matrix<double, 6, 6> twistCovariance() const
+	 *  @brief covariance of the base linear and bias-corrected angular velocity in the world frame
+	 */
+	Matrix<double, 6, 6> twistCovariance() const;
 	/**
 	 *  @fn void init()
 	 *  @brief Initializes the Base Estimator
@@ -262,118 +291,12 @@ public:
      *   Initializes:  State-Error Covariance  P, State x, Linearization Matrices for process and measurement models Acf, Lcf, Hf and rest class variables
 	*/
 	void init();
-	/** @fn Matrix3d wedge(Vector3d v)
-	 * 	@brief Computes the skew symmetric matrix of a 3-D vector
-	 *  @param v  3D Twist vector 
-	 *  @return   3x3 skew symmetric representation
-	 */
-	Matrix3d wedge(
-			Vector3d v) {
-
-		Matrix3d skew;
-
-		skew = Matrix3d::Zero();
-		skew(0, 1) = -v(2);
-		skew(0, 2) = v(1);
-		skew(1, 2) = -v(0);
-		skew(1, 0) = v(2);
-		skew(2, 0) = -v(1);
-		skew(2, 1) = v(0);
-
-		return skew;
-
-	}
-	/** @fn Vector3d vec(Matrix3d M)
-	 *  @brief Computes the vector represation of a skew symmetric matrix
-	 *  @param M  3x3 skew symmetric matrix
-	 *  @return   3D Twist vector
-	 */
-	Vector3d vec(Matrix3d M)
-	{
-		Vector3d v = Vector3d::Zero();
-		v(0) = M(2,1);
-		v(1) = M(0,2);
-		v(2) = M(1,0);
-		return v;
-	}
-
-	/** @brief Computes the exponential map according to the Rodriquez Formula for component in so(3)
-	 *  @param omega 3D twist in so(3) algebra
-	 *  @return   3x3 Rotation in  SO(3) group
-	 */
-	inline Matrix<double, 3, 3> expMap(
-			Vector3d omega) {
-
-		Matrix<double, 3, 3> res;
-		double omeganorm;
-
-		omeganorm = omega.norm();
-		res =  Matrix<double, 3, 3>::Identity();
-
-		if(omeganorm !=0.0)
-		{
-			Matrix<double, 3, 3>  omega_skew;
-			omega_skew = Matrix<double, 3, 3>::Zero();
-
-			omega_skew = wedge(omega);
-			res += omega_skew * (sin(omeganorm) / omeganorm);
-			res += (omega_skew * omega_skew) * (
-					(1.000 - cos(omeganorm)) / (omeganorm * omeganorm));
-		}
-
-		return res;
-	}
-	/** @brief Computes the logarithmic map for a component in SO(3) group
-	 *  @param Rt 3x3 Rotation in SO(3) group
-	 *  @return   3D twist in so(3) algebra
-	 */
-	inline Vector3d logMap(
-			Matrix<double, 3, 3> Rt) {
-
-		Vector3d res = Vector3d::Zero();
-		double costheta = (Rt.trace()-1.0)/2.0;
-		double theta = acos(costheta);
-
-		if (theta != 0.000) {
-			Matrix<double, 3, 3> lnR = Matrix<double, 3, 3>::Zero();
-			lnR.noalias() =  Rt - Rt.transpose();
-			lnR *= theta /(2.0*sin(theta));
-			res = vec(lnR); 			
-		}
-
-		return res;
-	}
-	/** @brief Computes the logarithmic map for a component in SO(3) group
-	 *  @param q Quaternion in SO(3) group
-	 *  @return   3D twist in so(3) algebra
-	 */
-	inline Vector3d logMap(
-			Quaterniond q) {
-
-		Vector3d omega;
-		omega = Vector3d::Zero();
-
-		double temp = q.norm();
-
-		Vector3d tempV = Vector3d(q.x(), q.y(), q.z());
-
-		double temp_ = tempV.norm();
-		tempV *= (1.000 / temp_);
-
-
-		omega = tempV * (2.0 * acos(q.w() / temp));
-		//omega = tempV * (2.0 * atan2(temp_,q.w()));
-		if(std::isnan(omega(0) + omega(1) + omega(2)))
-			omega = Vector3d::Zero();
-
-		return omega;
-	}
 	/** @brief Computes Euler Angles from a Rotation Matrix
 	 *  @param Rt 3x3 Rotation in SO(3) group
 	 *  @return   3D Vector with Roll-Pitch-Yaw
 	 */
 	inline Vector3d getEulerAngles(
-			Matrix3d Rt) {
+			const Matrix3d &Rt) {
 		Vector3d res;
 		res = Vector3d::Zero();
 
@@ -387,7 +310,7 @@ public:
 	 *  @return  3x3 Rotation in SO(3) group
 	 */
 	inline Matrix3d getRotationMatrix(
-			Vector3d angles_) {
+			const Vector3d &angles_) {
 		Matrix3d res, Rz, Ry, Rx;
 		Rz = Matrix3d::Zero();
 
@@ -0,0 +1,524 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Base Estimator of IMUEKF for N robots at once
+ * @author Stylianos Piperakis
+ * @details same state, process model and updates as IMUEKF, for N independent instances (e.g. the robots of a
+ * simulation farm). Every scalar of the filter is stored as an Eigen::Array with one coefficient per instance,
+ * so the propagation and the Kalman updates are coefficient-wise expressions that run the instances in the
+ * SIMD lanes. Only the SO(3) exponential and logarithm are evaluated instance by instance.
+ * The covariance propagation uses the fixed sparsity of the linearized transition and noise models.
+ * Throughput is highest while the batch (about 700 N doubles) stays in cache, a few tens of instances per batch.
+ */
+
+#ifndef IMUEKFBATCH_H
+#define IMUEKFBATCH_H
+#include <eigen3/Eigen/Dense>
+#include <cmath>
+#include "serow/lie.h"
+#include "serow/NoiseParameters.h"
+
+namespace serow
+{
+    template <int N>
+    class IMUEKFBatch
+    {
+    public:
+        /// One coefficient per instance
+        typedef Eigen::Array<double, N, 1> Lanes;
+
+    private:
+        /// Linearized state transition Af = I + Acf dt, only the entries of transitionPattern() are used
+        Lanes A[15][15];
+        /// Af * P work buffer
+        Lanes T[15][15];
+        /// P H^T, Kalman gain, innovation covariance (its Cholesky factor after correct()), measurement model, innovation and noise
+        Lanes PHt[15][6], K[15][6], S[6][6], Hc[6][6], z[6], Rn[6], Sinv[6];
+        /// bias removed gyro rate and acceleration, velocity, R^T g, velocity derivative
+        Lanes w[3], fb[3], v[3], Rtg[3], a[3];
+
+        /** @fn int transitionPattern(int i, const int*& cols)
+         *  @brief columns of the non-zero entries of row i of Af
+        */
+        static int transitionPattern(int i, const int *&cols)
+        {
+            static const int velocity[12] = {0, 1, 2, 3, 4, 5, 9, 10, 11, 12, 13, 14};
+            static const int rotation[6] = {3, 4, 5, 9, 10, 11};
+            static const int position[3][7] = {{0, 1, 2, 3, 4, 5, 6}, {0, 1, 2, 3, 4, 5, 7}, {0, 1, 2, 3, 4, 5, 8}};
+            static const int bias[15] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 9, 10, 11, 12, 13, 14};
+            if (i < 3)
+            {
+                cols = velocity;
+                return 12;
+            }
+            if (i < 6)
+            {
+                cols = rotation;
+                return 6;
+            }
+            if (i < 9)
+            {
+                cols = position[i - 6];
+                return 7;
+            }
+            cols = &bias[i];
+            return 1;
+        }
+
+        /** @fn void setSkewBlock(int r, int c, const Lanes u[3], double s, double d)
+         *  @brief A block (r, c) = s * skew(u) + d * I
+        */
+        void setSkewBlock(int r, int c, const Lanes u[3], double s, double d)
+        {
+            A[r][c].setConstant(d);
+            A[r + 1][c + 1].setConstant(d);
+            A[r + 2][c + 2].setConstant(d);
+            A[r][c + 1] = -s * u[2];
+            A[r][c + 2] = s * u[1];
+            A[r + 1][c] = s * u[2];
+            A[r + 1][c + 2] = -s * u[0];
+            A[r + 2][c] = -s * u[1];
+            A[r + 2][c + 1] = s * u[0];
+        }
+
+        /** @fn void rotate(const Lanes R[9], const Lanes u[3], int i)
+         *  @brief (R * u)(i) of every instance, as an expression
+        */
+        static auto rotate(const Lanes R[9], const Lanes u[3], int i) -> decltype(R[0] * u[0] + R[0] * u[0] + R[0] * u[0])
+        {
+            return R[i] * u[0] + R[i + 3] * u[1] + R[i + 6] * u[2];
+        }
+
+        /** @fn Eigen::Matrix3d laneRotation(const Lanes R[9], int l)
+         *  @brief rotation of instance l
+        */
+        static Eigen::Matrix3d laneRotation(const Lanes R[9], int l)
+        {
+            Eigen::Matrix3d M;
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    M(r, c) = R[r + 3 * c](l);
+            return M;
+        }
+
+        /** @fn void retract(const Lanes dphi[3])
+         *  @brief Rib = Rib * exp(dphi) for the instances with a non-zero rotation on every axis, as IMUEKF does
+        */
+        void retract(const Lanes dphi[3])
+        {
+            for (int l = 0; l < N; l++)
+            {
+                if (dphi[0](l) != 0 && dphi[1](l) != 0 && dphi[2](l) != 0)
+                {
+                    const Eigen::Matrix3d R = laneRotation(Rib, l) * lie::expSO3(Eigen::Vector3d(dphi[0](l), dphi[1](l), dphi[2](l)));
+                    for (int c = 0; c < 3; c++)
+                        for (int r = 0; r < 3; r++)
+                            Rib[r + 3 * c](l) = R(r, c);
+                }
+            }
+        }
+
+        /** @fn void correct(int m)
+         *  @brief Kalman update with PHt = P H^T and the lower triangle of S = H P H^T set, Rn the measurement noise variances and z the innovation
+         *  @details S + R is factored with Cholesky, then K = P H^T (S + R)^-1, x += K z and P -= K H P, keeping P symmetric
+        */
+        void correct(int m)
+        {
+            for (int j = 0; j < m; j++)
+            {
+                S[j][j] += Rn[j];
+                for (int k = 0; k < j; k++)
+                    S[j][j] -= S[j][k] * S[j][k];
+                S[j][j] = S[j][j].sqrt();
+                Sinv[j] = S[j][j].inverse();
+                for (int i = j + 1; i < m; i++)
+                {
+                    for (int k = 0; k < j; k++)
+                        S[i][j] -= S[i][k] * S[j][k];
+                    S[i][j] *= Sinv[j];
+                }
+            }
+            for (int i = 0; i < 15; i++)
+            {
+                //L L^T K_i^T = PHt_i^T
+                for (int j = 0; j < m; j++)
+                {
+                    K[i][j] = PHt[i][j];
+                    for (int k = 0; k < j; k++)
+                        K[i][j] -= S[j][k] * K[i][k];
+                    K[i][j] *= Sinv[j];
+                }
+                for (int j = m - 1; j >= 0; j--)
+                {
+                    for (int k = j + 1; k < m; k++)
+                        K[i][j] -= S[k][j] * K[i][k];
+                    K[i][j] *= Sinv[j];
+                }
+            }
+            for (int i = 0; i < 15; i++)
+            {
+                for (int j = 0; j < m; j++)
+                    x[i] += K[i][j] * z[j];
+                for (int k = i; k < 15; k++)
+                {
+                    for (int j = 0; j < m; j++)
+                        P[i][k] -= K[i][j] * PHt[k][j];
+                    P[k][i] = P[i][k];
+                }
+            }
+            retract(x + 3);
+            for (int i = 3; i < 6; i++)
+                x[i].setZero();
+        }
+
+        /** @fn void updatePose(const Lanes y[3], const Lanes Ry[9], const Lanes p[3], const Lanes ang[3])
+         *  @brief position and orientation update with noise stds p and ang
+        */
+        void updatePose(const Lanes y[3], const Lanes Ry[9], const Lanes p[3], const Lanes ang[3])
+        {
+            //H picks the position (6) and the rotation error (3)
+            static const int cols[6] = {6, 7, 8, 3, 4, 5};
+            for (int j = 0; j < 3; j++)
+            {
+                Rn[j] = p[j] * p[j];
+                Rn[j + 3] = ang[j] * ang[j];
+                z[j] = y[j] - x[6 + j];
+            }
+            for (int l = 0; l < N; l++)
+            {
+                const Eigen::Vector3d phi = lie::logSO3(laneRotation(Rib, l).transpose() * laneRotation(Ry, l));
+                for (int j = 0; j < 3; j++)
+                    z[3 + j](l) = phi(j);
+            }
+            for (int i = 0; i < 15; i++)
+                for (int j = 0; j < 6; j++)
+                    PHt[i][j] = P[i][cols[j]];
+            for (int j = 0; j < 6; j++)
+                for (int k = 0; k <= j; k++)
+                    S[j][k] = P[cols[j]][cols[k]];
+            correct(6);
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        /// State of every instance: velocity in the base frame (0), rotation error (3, zero between updates),
+        /// position in the world frame (6), gyro bias (9) and acc bias (12)
+        Lanes x[15];
+        /// Rotation from the base to the world frame, Rib[r + 3 * c] holds the (r, c) entry
+        Lanes Rib[9];
+        /// Error covariance
+        Lanes P[15][15];
+        /// Noise stds of every instance, as in IMUEKF
+        Lanes acc_q[3], gyr_q[3], accb_q[3], gyrb_q[3], odom_p[3], odom_a[3], leg_odom_p[3], leg_odom_a[3], vel_p[3];
+        /// Gravity vector
+        Eigen::Vector3d g;
+        /// Sampling time = 1.0/Sampling Frequency
+        double dt;
+
+        /**
+         *  @brief Constructor of the batched Base Estimator, the instances are left uninitialized until init()
+         *  @note with thousands of instances the object takes megabytes, allocate it with new
+        */
+        IMUEKFBatch()
+        {
+            g = Eigen::Vector3d(0, 0, -9.80);
+            dt = 0;
+        }
+
+        /** @fn void init()
+         *  @brief initializes every instance as IMUEKF::init() does: zero state, identity rotation, default covariance
+        */
+        void init()
+        {
+            for (int i = 0; i < 15; i++)
+            {
+                x[i].setZero();
+                for (int j = 0; j < 15; j++)
+                {
+                    P[i][j].setZero();
+                    A[i][j].setZero();
+                }
+            }
+            for (int i = 0; i < 15; i++)
+                P[i][i].setConstant(i < 6 || i >= 9 ? 1e-3 : 1e-5);
+            for (int i = 0; i < 9; i++)
+                Rib[i].setConstant(i % 4 == 0 ? 1.0 : 0.0);
+            //Constant part of Af
+            for (int i = 6; i < 15; i++)
+                A[i][i].setOnes();
+        }
+
+        /** @fn void setdt(double dtt)
+         *  @brief sets the discretization of every instance
+        */
+        void setdt(double dtt)
+        {
+            dt = dtt;
+        }
+
+        /** @fn void setNoise(int l, const ImuNoiseParams& p)
+         *  @brief noise stds of instance l
+        */
+        void setNoise(int l, const ImuNoiseParams &p)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                acc_q[j](l) = p.acc_q[j];
+                gyr_q[j](l) = p.gyr_q[j];
+                accb_q[j](l) = p.accb_q[j];
+                gyrb_q[j](l) = p.gyrb_q[j];
+                odom_p[j](l) = p.odom_p[j];
+                odom_a[j](l) = p.odom_a[j];
+                leg_odom_p[j](l) = p.leg_odom_p[j];
+                leg_odom_a[j](l) = p.leg_odom_a[j];
+                vel_p[j](l) = p.vel_p[j];
+            }
+        }
+
+        /** @fn void setNoise(const ImuNoiseParams& p)
+         *  @brief noise stds of every instance
+        */
+        void setNoise(const ImuNoiseParams &p)
+        {
+            for (int l = 0; l < N; l++)
+                setNoise(l, p);
+        }
+
+        void setBodyVel(int l, const Eigen::Vector3d &bv)
+        {
+            for (int j = 0; j < 3; j++)
+                x[j](l) = bv(j);
+        }
+
+        void setBodyPos(int l, const Eigen::Vector3d &bp)
+        {
+            for (int j = 0; j < 3; j++)
+                x[6 + j](l) = bp(j);
+        }
+
+        void setBodyOrientation(int l, const Eigen::Matrix3d &Rot_)
+        {
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    Rib[r + 3 * c](l) = Rot_(r, c);
+        }
+
+        void setGyroBias(int l, const Eigen::Vector3d &bgyr_)
+        {
+            for (int j = 0; j < 3; j++)
+                x[9 + j](l) = bgyr_(j);
+        }
+
+        void setAccBias(int l, const Eigen::Vector3d &bacc_)
+        {
+            for (int j = 0; j < 3; j++)
+                x[12 + j](l) = bacc_(j);
+        }
+
+        /// Base velocity in the base frame of instance l
+        Eigen::Vector3d bodyVel(int l) const { return Eigen::Vector3d(x[0](l), x[1](l), x[2](l)); }
+        /// Base position in the world frame of instance l
+        Eigen::Vector3d bodyPos(int l) const { return Eigen::Vector3d(x[6](l), x[7](l), x[8](l)); }
+        /// Base to world rotation of instance l
+        Eigen::Matrix3d bodyOrientation(int l) const { return laneRotation(Rib, l); }
+        Eigen::Vector3d gyroBias(int l) const { return Eigen::Vector3d(x[9](l), x[10](l), x[11](l)); }
+        Eigen::Vector3d accBias(int l) const { return Eigen::Vector3d(x[12](l), x[13](l), x[14](l)); }
+        /// Error covariance of instance l
+        Eigen::Matrix<double, 15, 15> covariance(int l) const
+        {
+            Eigen::Matrix<double, 15, 15> C;
+            for (int i = 0; i < 15; i++)
+                for (int j = 0; j < 15; j++)
+                    C(i, j) = P[i][j](l);
+            return C;
+        }
+
+        /** @fn void predict(const Lanes omega_[3], const Lanes f_[3])
+         *  @brief predict step of every instance
+         *  @param omega_ angular velocity of the base in the base frame
+         *  @param f_ linear acceleration of the base in the base frame
+         */
+        void predict(const Lanes omega_[3], const Lanes f_[3])
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                w[j] = omega_[j] - x[9 + j];
+                fb[j] = f_[j] - x[12 + j];
+                v[j] = x[j];
+                //R^T g
+                Rtg[j] = Rib[3 * j] * g(0) + Rib[3 * j + 1] * g(1) + Rib[3 * j + 2] * g(2);
+            }
+            //\dot{v}_b = v x omega + R^T g + f
+            a[0] = v[1] * w[2] - v[2] * w[1] + Rtg[0] + fb[0];
+            a[1] = v[2] * w[0] - v[0] * w[2] + Rtg[1] + fb[1];
+            a[2] = v[0] * w[1] - v[1] * w[0] + Rtg[2] + fb[2];
+
+            //Af = I + Acf dt, linearized around the state before the propagation
+            setSkewBlock(0, 0, w, -dt, 1.0);
+            setSkewBlock(0, 3, Rtg, dt, 0.0);
+            setSkewBlock(0, 9, v, -dt, 0.0);
+            setSkewBlock(3, 3, w, -dt, 1.0);
+            for (int i = 0; i < 3; i++)
+            {
+                A[i][12 + i].setConstant(-dt);
+                A[3 + i][9 + i].setConstant(-dt);
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                A[6 + i][0] = Rib[i] * dt;
+                A[6 + i][1] = Rib[i + 3] * dt;
+                A[6 + i][2] = Rib[i + 6] * dt;
+                //-R skew(v), row i is -(r_i x v)
+                A[6 + i][3] = (Rib[i + 6] * v[1] - Rib[i + 3] * v[2]) * dt;
+                A[6 + i][4] = (Rib[i] * v[2] - Rib[i + 6] * v[0]) * dt;
+                A[6 + i][5] = (Rib[i + 3] * v[0] - Rib[i] * v[1]) * dt;
+            }
+
+            //Discrete dynamics
+            for (int j = 0; j < 3; j++)
+            {
+                x[6 + j] += rotate(Rib, a, j) * (dt * dt / 2.0) + rotate(Rib, v, j) * dt;
+                x[j] += a[j] * dt;
+            }
+
+            //P + Lcf Qf Lcf^T dt, with Lcf = [-skew(v) -I 0 0; -I 0 0 0; 0 0 0 0; 0 0 I 0; 0 0 0 I]
+            const Lanes qg0 = gyr_q[0] * gyr_q[0] * dt, qg1 = gyr_q[1] * gyr_q[1] * dt, qg2 = gyr_q[2] * gyr_q[2] * dt;
+            P[0][0] += v[2] * v[2] * qg1 + v[1] * v[1] * qg2 + acc_q[0] * acc_q[0] * dt;
+            P[1][1] += v[2] * v[2] * qg0 + v[0] * v[0] * qg2 + acc_q[1] * acc_q[1] * dt;
+            P[2][2] += v[1] * v[1] * qg0 + v[0] * v[0] * qg1 + acc_q[2] * acc_q[2] * dt;
+            P[0][1] -= v[0] * v[1] * qg2;
+            P[0][2] -= v[0] * v[2] * qg1;
+            P[1][2] -= v[1] * v[2] * qg0;
+            //skew(v) Qg
+            P[0][4] -= v[2] * qg1;
+            P[0][5] += v[1] * qg2;
+            P[1][3] += v[2] * qg0;
+            P[1][5] -= v[0] * qg2;
+            P[2][3] -= v[1] * qg0;
+            P[2][4] += v[0] * qg1;
+            P[3][3] += qg0;
+            P[4][4] += qg1;
+            P[5][5] += qg2;
+            for (int j = 0; j < 3; j++)
+            {
+                P[9 + j][9 + j] += gyrb_q[j] * gyrb_q[j] * dt;
+                P[12 + j][12 + j] += accb_q[j] * accb_q[j] * dt;
+            }
+            for (int i = 0; i < 6; i++)
+                for (int j = i + 1; j < 6; j++)
+                    P[j][i] = P[i][j];
+
+            //P = Af P Af^T
+            const int *cols;
+            for (int i = 0; i < 15; i++)
+            {
+                int n = transitionPattern(i, cols);
+                for (int j = 0; j < 15; j++)
+                {
+                    T[i][j] = A[i][cols[0]] * P[cols[0]][j];
+                    for (int k = 1; k < n; k++)
+                        T[i][j] += A[i][cols[k]] * P[cols[k]][j];
+                }
+            }
+            for (int j = 0; j < 15; j++)
+            {
+                int n = transitionPattern(j, cols);
+                for (int i = 0; i <= j; i++)
+                {
+                    P[i][j] = T[i][cols[0]] * A[j][cols[0]];
+                    for (int k = 1; k < n; k++)
+                        P[i][j] += T[i][cols[k]] * A[j][cols[k]];
+                    P[j][i] = P[i][j];
+                }
+            }
+
+            for (int j = 0; j < 3; j++)
+                w[j] *= dt;
+            retract(w);
+        }
+
+        /** @fn void updateWithLegOdom(const Lanes y[3], const Lanes Ry[9])
+         *  @brief pose update with Leg Odometry
+         *  @param y base position in the world frame
+         *  @param Ry base to world rotation, Ry[r + 3 * c] holds the (r, c) entry
+         */
+        void updateWithLegOdom(const Lanes y[3], const Lanes Ry[9])
+        {
+            updatePose(y, Ry, leg_odom_p, leg_odom_a);
+        }
+
+        /** @fn void updateWithOdom(const Lanes y[3], const Lanes Ry[9])
+         *  @brief pose update with external odometry, as IMUEKF::updateWithOdom() without outlier detection and mahalanobis_TH <= 0
+         */
+        void updateWithOdom(const Lanes y[3], const Lanes Ry[9])
+        {
+            updatePose(y, Ry, odom_p, odom_a);
+        }
+
+        /** @fn void updateWithTwist(const Lanes y[3])
+         *  @brief update with a base linear velocity measurement in the world frame
+         */
+        void updateWithTwist(const Lanes y[3])
+        {
+            //H = [Rib -Rib skew(v) 0]
+            for (int j = 0; j < 3; j++)
+            {
+                v[j] = x[j];
+                Rn[j] = vel_p[j] * vel_p[j];
+            }
+            for (int r = 0; r < 3; r++)
+            {
+                z[r] = y[r] - rotate(Rib, v, r);
+                Hc[r][0] = Rib[r];
+                Hc[r][1] = Rib[r + 3];
+                Hc[r][2] = Rib[r + 6];
+                Hc[r][3] = Rib[r + 6] * v[1] - Rib[r + 3] * v[2];
+                Hc[r][4] = Rib[r] * v[2] - Rib[r + 6] * v[0];
+                Hc[r][5] = Rib[r + 3] * v[0] - Rib[r] * v[1];
+            }
+            for (int i = 0; i < 15; i++)
+                for (int j = 0; j < 3; j++)
+                {
+                    PHt[i][j] = P[i][0] * Hc[j][0];
+                    for (int c = 1; c < 6; c++)
+                        PHt[i][j] += P[i][c] * Hc[j][c];
+                }
+            for (int j = 0; j < 3; j++)
+                for (int k = 0; k <= j; k++)
+                {
+                    S[j][k] = Hc[j][0] * PHt[0][k];
+                    for (int c = 1; c < 6; c++)
+                        S[j][k] += Hc[j][c] * PHt[c][k];
+                }
+            correct(3);
+        }
+    };
+} // namespace serow
+#endif
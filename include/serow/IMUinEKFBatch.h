@@ -0,0 +1,490 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Base Estimator of IMUinEKF for N robots at once, with both feet in contact
+ * @author Stylianos Piperakis
+ * @details same right invariant state, process model and contact update as IMUinEKF while contactR = contactL = 1,
+ * for N independent instances (e.g. the robots of a simulation farm standing or in double support). As in
+ * IMUEKFBatch every scalar is an Eigen::Array with one coefficient per instance and only the SO(3)/SE_K(3)
+ * exponentials are evaluated instance by instance. A fixed contact set keeps one measurement model for all
+ * lanes; batches with swing legs go through one IMUinEKF per instance.
+ * The covariance propagation uses the fixed sparsity of the linearized transition.
+ */
+
+#ifndef IMUINEKFBATCH_H
+#define IMUINEKFBATCH_H
+#include <eigen3/Eigen/Dense>
+#include <cmath>
+#include "serow/lie.h"
+#include "serow/NoiseParameters.h"
+
+namespace serow
+{
+    template <int N>
+    class IMUinEKFBatch
+    {
+    public:
+        /// One coefficient per instance
+        typedef Eigen::Array<double, N, 1> Lanes;
+
+    private:
+        /// Linearized state transition Phi = I + Af dt, only the entries of transitionPattern() are used
+        Lanes A[21][21];
+        /// Phi * P work buffer
+        Lanes T[21][21];
+        /// P H^T, Kalman gain, innovation covariance (its Cholesky factor after correct()), innovation, correction
+        Lanes PHt[21][6], K[21][6], S[6][6], z[6], Sinv[6], delta[21];
+        /// Rows of the SE_K(3) adjoint under the rotation: F[0] = Rwb, F[1..4] = skew(x) Rwb for x = v, p, dR, dL
+        Lanes F[5][9];
+        /// bias removed gyro rate and acceleration, world frame acceleration, 3x3 work buffer
+        Lanes w[3], fb[3], acc[3], M[9];
+
+        /** @fn int transitionPattern(int i, const int*& cols)
+         *  @brief columns of the non-zero entries of row i of Phi
+        */
+        static int transitionPattern(int i, const int *&cols)
+        {
+            static const int rows[21][11] = {
+                {4, 0, 15, 16, 17}, {4, 1, 15, 16, 17}, {4, 2, 15, 16, 17},
+                {10, 0, 1, 2, 3, 15, 16, 17, 18, 19, 20}, {10, 0, 1, 2, 4, 15, 16, 17, 18, 19, 20}, {10, 0, 1, 2, 5, 15, 16, 17, 18, 19, 20},
+                {5, 3, 6, 15, 16, 17}, {5, 4, 7, 15, 16, 17}, {5, 5, 8, 15, 16, 17},
+                {4, 9, 15, 16, 17}, {4, 10, 15, 16, 17}, {4, 11, 15, 16, 17},
+                {4, 12, 15, 16, 17}, {4, 13, 15, 16, 17}, {4, 14, 15, 16, 17},
+                {1, 15}, {1, 16}, {1, 17}, {1, 18}, {1, 19}, {1, 20}};
+            cols = rows[i] + 1;
+            return rows[i][0];
+        }
+
+        /** @fn void rotate(const Lanes R[9], const Lanes u[3], int i)
+         *  @brief (R * u)(i) of every instance, as an expression
+        */
+        static auto rotate(const Lanes R[9], const Lanes u[3], int i) -> decltype(R[0] * u[0] + R[0] * u[0] + R[0] * u[0])
+        {
+            return R[i] * u[0] + R[i + 3] * u[1] + R[i + 6] * u[2];
+        }
+
+        /** @fn void multiply(const Lanes X[9], const Lanes Y[9], Lanes Z[9])
+         *  @brief Z = X * Y of every instance, 3x3 matrices stored as Rwb
+        */
+        static void multiply(const Lanes X[9], const Lanes Y[9], Lanes Z[9])
+        {
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    Z[r + 3 * c] = X[r] * Y[3 * c] + X[r + 3] * Y[1 + 3 * c] + X[r + 6] * Y[2 + 3 * c];
+        }
+
+        /** @fn void skewMultiply(const Lanes u[3], const Lanes Y[9], Lanes Z[9])
+         *  @brief Z = skew(u) * Y of every instance
+        */
+        static void skewMultiply(const Lanes u[3], const Lanes Y[9], Lanes Z[9])
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                Z[3 * c] = u[1] * Y[2 + 3 * c] - u[2] * Y[1 + 3 * c];
+                Z[1 + 3 * c] = u[2] * Y[3 * c] - u[0] * Y[2 + 3 * c];
+                Z[2 + 3 * c] = u[0] * Y[1 + 3 * c] - u[1] * Y[3 * c];
+            }
+        }
+
+        /** @fn Eigen::Matrix3d laneRotation(const Lanes R[9], int l)
+         *  @brief rotation of instance l
+        */
+        static Eigen::Matrix3d laneRotation(const Lanes R[9], int l)
+        {
+            Eigen::Matrix3d Rl;
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    Rl(r, c) = R[r + 3 * c](l);
+            return Rl;
+        }
+
+        static Eigen::Vector3d laneVector(const Lanes u[3], int l)
+        {
+            return Eigen::Vector3d(u[0](l), u[1](l), u[2](l));
+        }
+
+        static void setLaneVector(Lanes u[3], int l, const Eigen::Vector3d &x)
+        {
+            for (int j = 0; j < 3; j++)
+                u[j](l) = x(j);
+        }
+
+        /** @fn void addNoise(int a, int b, const Lanes X[9], const Lanes Y[9], const Lanes q[3])
+         *  @brief P block (a, b) += X diag(q) Y^T and block (b, a) its transpose
+        */
+        void addNoise(int a, int b, const Lanes X[9], const Lanes Y[9], const Lanes q[3])
+        {
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++)
+                {
+                    P[3 * a + r][3 * b + c] += X[r] * q[0] * Y[c] + X[r + 3] * q[1] * Y[c + 3] + X[r + 6] * q[2] * Y[c + 6];
+                    if (a != b)
+                        P[3 * b + c][3 * a + r] = P[3 * a + r][3 * b + c];
+                }
+        }
+
+        /** @fn void correct(int m)
+         *  @brief Kalman update with PHt = P H^T and the lower triangle of S = H P H^T + N set and z the innovation
+         *  @details S is factored with Cholesky, then K = P H^T S^-1, delta = K z and P -= K H P, keeping P symmetric
+        */
+        void correct(int m)
+        {
+            for (int j = 0; j < m; j++)
+            {
+                for (int k = 0; k < j; k++)
+                    S[j][j] -= S[j][k] * S[j][k];
+                S[j][j] = S[j][j].sqrt();
+                Sinv[j] = S[j][j].inverse();
+                for (int i = j + 1; i < m; i++)
+                {
+                    for (int k = 0; k < j; k++)
+                        S[i][j] -= S[i][k] * S[j][k];
+                    S[i][j] *= Sinv[j];
+                }
+            }
+            for (int i = 0; i < 21; i++)
+            {
+                //L L^T K_i^T = PHt_i^T
+                for (int j = 0; j < m; j++)
+                {
+                    K[i][j] = PHt[i][j];
+                    for (int k = 0; k < j; k++)
+                        K[i][j] -= S[j][k] * K[i][k];
+                    K[i][j] *= Sinv[j];
+                }
+                for (int j = m - 1; j >= 0; j--)
+                {
+                    for (int k = j + 1; k < m; k++)
+                        K[i][j] -= S[k][j] * K[i][k];
+                    K[i][j] *= Sinv[j];
+                }
+            }
+            for (int i = 0; i < 21; i++)
+            {
+                delta[i] = K[i][0] * z[0];
+                for (int j = 1; j < m; j++)
+                    delta[i] += K[i][j] * z[j];
+                for (int k = i; k < 21; k++)
+                {
+                    for (int j = 0; j < m; j++)
+                        P[i][k] -= K[i][j] * PHt[k][j];
+                    P[k][i] = P[i][k];
+                }
+            }
+            //X = exp(delta) X, theta += delta
+            for (int l = 0; l < N; l++)
+            {
+                Eigen::Matrix<double, 15, 1> xi;
+                for (int i = 0; i < 15; i++)
+                    xi(i) = delta[i](l);
+                const Eigen::Matrix<double, 7, 7> dX = lie::expSEK3(xi);
+                const Eigen::Matrix3d R = dX.topLeftCorner<3, 3>() * laneRotation(Rwb, l);
+                for (int c = 0; c < 3; c++)
+                    for (int r = 0; r < 3; r++)
+                        Rwb[r + 3 * c](l) = R(r, c);
+                setLaneVector(vwb, l, dX.topLeftCorner<3, 3>() * laneVector(vwb, l) + dX.block<3, 1>(0, 3));
+                setLaneVector(pwb, l, dX.topLeftCorner<3, 3>() * laneVector(pwb, l) + dX.block<3, 1>(0, 4));
+                setLaneVector(dR, l, dX.topLeftCorner<3, 3>() * laneVector(dR, l) + dX.block<3, 1>(0, 5));
+                setLaneVector(dL, l, dX.topLeftCorner<3, 3>() * laneVector(dL, l) + dX.block<3, 1>(0, 6));
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                bgyr[j] += delta[15 + j];
+                bacc[j] += delta[18 + j];
+            }
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        /// Rotation from the base to the world frame, Rwb[r + 3 * c] holds the (r, c) entry
+        Lanes Rwb[9];
+        /// Base velocity and position, right and left foot contact positions in the world frame, gyro and acc bias
+        Lanes vwb[3], pwb[3], dR[3], dL[3], bgyr[3], bacc[3];
+        /// Right invariant error covariance, ordered as in IMUinEKF
+        Lanes P[21][21];
+        /// Noise stds of every instance, as in IMUinEKF
+        Lanes acc_q[3], gyr_q[3], accb_q[3], gyrb_q[3], foot_contact[3], leg_odom_p[3];
+        /// Gravity vector
+        Eigen::Vector3d g;
+        /// Sampling time = 1.0/Sampling Frequency
+        double dt;
+
+        /**
+         *  @brief Constructor of the batched Base Estimator, the instances are left uninitialized until init()
+         *  @note with hundreds of instances the object takes megabytes, allocate it with new
+        */
+        IMUinEKFBatch()
+        {
+            g = Eigen::Vector3d(0, 0, -9.80);
+            dt = 0;
+        }
+
+        /** @fn void init()
+         *  @brief initializes every instance as IMUinEKF::init() does: zero state, identity rotation, default covariance
+        */
+        void init()
+        {
+            static const double P0[7] = {1e-2, 1e-2, 1e-3, 1e-3, 1e-3, 1e-2, 1e-1};
+            for (int i = 0; i < 21; i++)
+            {
+                for (int j = 0; j < 21; j++)
+                {
+                    P[i][j].setZero();
+                    A[i][j].setZero();
+                }
+                P[i][i].setConstant(P0[i / 3]);
+                A[i][i].setOnes();
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                vwb[j].setZero();
+                pwb[j].setZero();
+                dR[j].setZero();
+                dL[j].setZero();
+                bgyr[j].setZero();
+                bacc[j].setZero();
+            }
+            for (int i = 0; i < 9; i++)
+                Rwb[i].setConstant(i % 4 == 0 ? 1.0 : 0.0);
+        }
+
+        /** @fn void setdt(double dtt)
+         *  @brief sets the discretization of every instance
+        */
+        void setdt(double dtt)
+        {
+            dt = dtt;
+        }
+
+        /** @fn void setNoise(int l, const ImuNoiseParams& p)
+         *  @brief noise stds of instance l
+        */
+        void setNoise(int l, const ImuNoiseParams &p)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                acc_q[j](l) = p.acc_q[j];
+                gyr_q[j](l) = p.gyr_q[j];
+                accb_q[j](l) = p.accb_q[j];
+                gyrb_q[j](l) = p.gyrb_q[j];
+                foot_contact[j](l) = p.foot_contact[j];
+                leg_odom_p[j](l) = p.leg_odom_p[j];
+            }
+        }
+
+        /** @fn void setNoise(const ImuNoiseParams& p)
+         *  @brief noise stds of every instance
+        */
+        void setNoise(const ImuNoiseParams &p)
+        {
+            for (int l = 0; l < N; l++)
+                setNoise(l, p);
+        }
+
+        void setBodyPos(int l, const Eigen::Vector3d &bp) { setLaneVector(pwb, l, bp); }
+        void setBodyVel(int l, const Eigen::Vector3d &bv) { setLaneVector(vwb, l, bv); }
+        void setRightContact(int l, const Eigen::Vector3d &br) { setLaneVector(dR, l, br); }
+        void setLeftContact(int l, const Eigen::Vector3d &bl) { setLaneVector(dL, l, bl); }
+        void setGyroBias(int l, const Eigen::Vector3d &bgyr_) { setLaneVector(bgyr, l, bgyr_); }
+        void setAccBias(int l, const Eigen::Vector3d &bacc_) { setLaneVector(bacc, l, bacc_); }
+
+        void setBodyOrientation(int l, const Eigen::Matrix3d &bR)
+        {
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    Rwb[r + 3 * c](l) = bR(r, c);
+        }
+
+        void setCovariance(int l, const Eigen::Matrix<double, 21, 21> &P_)
+        {
+            for (int i = 0; i < 21; i++)
+                for (int j = 0; j < 21; j++)
+                    P[i][j](l) = P_(i, j);
+        }
+
+        Eigen::Vector3d bodyPos(int l) const { return laneVector(pwb, l); }
+        Eigen::Vector3d bodyVel(int l) const { return laneVector(vwb, l); }
+        Eigen::Matrix3d bodyOrientation(int l) const { return laneRotation(Rwb, l); }
+        Eigen::Vector3d rightContact(int l) const { return laneVector(dR, l); }
+        Eigen::Vector3d leftContact(int l) const { return laneVector(dL, l); }
+        Eigen::Vector3d gyroBias(int l) const { return laneVector(bgyr, l); }
+        Eigen::Vector3d accBias(int l) const { return laneVector(bacc, l); }
+        /// Right invariant error covariance of instance l
+        Eigen::Matrix<double, 21, 21> covariance(int l) const
+        {
+            Eigen::Matrix<double, 21, 21> C;
+            for (int i = 0; i < 21; i++)
+                for (int j = 0; j < 21; j++)
+                    C(i, j) = P[i][j](l);
+            return C;
+        }
+
+        /** @fn void predict(const Lanes angular_velocity[3], const Lanes linear_acceleration[3], const Lanes hR_R[9], const Lanes hR_L[9])
+         *  @brief predict step of every instance, IMUinEKF::predict() with contactR = contactL = 1
+         *  @param angular_velocity angular velocity of the base in the base frame
+         *  @param linear_acceleration linear acceleration of the base in the base frame
+         *  @param hR_R, hR_L orientation of the right and left foot in the base frame, they rotate the contact noise
+         */
+        void predict(const Lanes angular_velocity[3], const Lanes linear_acceleration[3], const Lanes hR_R[9], const Lanes hR_L[9])
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                w[j] = angular_velocity[j] - bgyr[j];
+                fb[j] = linear_acceleration[j] - bacc[j];
+            }
+            for (int i = 0; i < 9; i++)
+                F[0][i] = Rwb[i];
+            skewMultiply(vwb, Rwb, F[1]);
+            skewMultiply(pwb, Rwb, F[2]);
+            skewMultiply(dR, Rwb, F[3]);
+            skewMultiply(dL, Rwb, F[4]);
+
+            //P + Adj Qf Adj^T dt, Adj has F[a] in block (a, 0) and Rwb in block (a, a)
+            Lanes q[3];
+            for (int j = 0; j < 3; j++)
+                q[j] = gyr_q[j] * gyr_q[j] * dt;
+            for (int a = 0; a < 5; a++)
+                for (int b = a; b < 5; b++)
+                    addNoise(a, b, F[a], F[b], q);
+            for (int j = 0; j < 3; j++)
+                q[j] = acc_q[j] * acc_q[j] * dt;
+            addNoise(1, 1, Rwb, Rwb, q);
+            for (int j = 0; j < 3; j++)
+                q[j] = foot_contact[j] * foot_contact[j] * dt;
+            multiply(Rwb, hR_R, M);
+            addNoise(3, 3, M, M, q);
+            multiply(Rwb, hR_L, M);
+            addNoise(4, 4, M, M, q);
+            for (int j = 0; j < 3; j++)
+            {
+                P[15 + j][15 + j] += gyrb_q[j] * gyrb_q[j] * dt;
+                P[18 + j][18 + j] += accb_q[j] * accb_q[j] * dt;
+            }
+
+            //Phi = I + Af dt, linearized around the state before the propagation
+            for (int a = 0; a < 5; a++)
+                for (int r = 0; r < 3; r++)
+                    for (int c = 0; c < 3; c++)
+                        A[3 * a + r][15 + c] = -F[a][r + 3 * c] * dt;
+            for (int r = 0; r < 3; r++)
+            {
+                for (int c = 0; c < 3; c++)
+                    A[3 + r][18 + c] = -Rwb[r + 3 * c] * dt;
+                A[6 + r][3 + r].setConstant(dt);
+            }
+            //skew(g) dt
+            A[3][1].setConstant(-g(2) * dt);
+            A[3][2].setConstant(g(1) * dt);
+            A[4][0].setConstant(g(2) * dt);
+            A[4][2].setConstant(-g(0) * dt);
+            A[5][0].setConstant(-g(1) * dt);
+            A[5][1].setConstant(g(0) * dt);
+
+            //P = Phi P Phi^T
+            const int *cols;
+            for (int i = 0; i < 21; i++)
+            {
+                int n = transitionPattern(i, cols);
+                for (int j = 0; j < 21; j++)
+                {
+                    T[i][j] = A[i][cols[0]] * P[cols[0]][j];
+                    for (int k = 1; k < n; k++)
+                        T[i][j] += A[i][cols[k]] * P[cols[k]][j];
+                }
+            }
+            for (int j = 0; j < 21; j++)
+            {
+                int n = transitionPattern(j, cols);
+                for (int i = 0; i <= j; i++)
+                {
+                    P[i][j] = T[i][cols[0]] * A[j][cols[0]];
+                    for (int k = 1; k < n; k++)
+                        P[i][j] += T[i][cols[k]] * A[j][cols[k]];
+                    P[j][i] = P[i][j];
+                }
+            }
+
+            //Discrete dynamics, the feet stay in place
+            for (int j = 0; j < 3; j++)
+                acc[j] = rotate(Rwb, fb, j) + g(j);
+            for (int j = 0; j < 3; j++)
+            {
+                pwb[j] += vwb[j] * dt + acc[j] * (0.5 * dt * dt);
+                vwb[j] += acc[j] * dt;
+            }
+            for (int l = 0; l < N; l++)
+            {
+                const Eigen::Matrix3d R = laneRotation(Rwb, l) * lie::expSO3(laneVector(w, l) * dt);
+                for (int c = 0; c < 3; c++)
+                    for (int r = 0; r < 3; r++)
+                        Rwb[r + 3 * c](l) = R(r, c);
+            }
+        }
+
+        /** @fn void updateWithContacts(const Lanes s_pR[3], const Lanes s_pL[3], const Lanes JRQeJR[9], const Lanes JLQeJL[9], const Lanes &weightR, const Lanes &weightL)
+         *  @brief contact update of every instance, IMUinEKF::updateWithContacts() with contactR = contactL = 1
+         *  @param s_pR, s_pL right and left foot position in the base frame
+         *  @param JRQeJR, JLQeJL their covariance in the base frame from the joint encoder noise
+         *  @param weightR, weightL innovation weights
+         */
+        void updateWithContacts(const Lanes s_pR[3], const Lanes s_pL[3], const Lanes JRQeJR[9], const Lanes JLQeJL[9],
+                                const Lanes &weightR, const Lanes &weightL)
+        {
+            //H = [0 0 -I I 0 0 0; 0 0 -I 0 I 0 0], z = R s_p + p - d
+            for (int r = 0; r < 3; r++)
+            {
+                z[r] = weightR * (rotate(Rwb, s_pR, r) + pwb[r] - dR[r]);
+                z[3 + r] = weightL * (rotate(Rwb, s_pL, r) + pwb[r] - dL[r]);
+            }
+            for (int i = 0; i < 21; i++)
+                for (int j = 0; j < 3; j++)
+                {
+                    PHt[i][j] = P[i][9 + j] - P[i][6 + j];
+                    PHt[i][3 + j] = P[i][12 + j] - P[i][6 + j];
+                }
+            for (int j = 0; j < 6; j++)
+                for (int k = 0; k <= j; k++)
+                    S[j][k] = PHt[9 + j][k] - PHt[6 + j % 3][k];
+            //N = Rwb J Rwb^T + diag(leg_odom_p^2) on the diagonal blocks
+            for (int foot = 0; foot < 2; foot++)
+            {
+                multiply(Rwb, foot == 0 ? JRQeJR : JLQeJL, M);
+                for (int r = 0; r < 3; r++)
+                {
+                    for (int c = 0; c <= r; c++)
+                        S[3 * foot + r][3 * foot + c] += M[r] * Rwb[c] + M[r + 3] * Rwb[c + 3] + M[r + 6] * Rwb[c + 6];
+                    S[3 * foot + r][3 * foot + r] += leg_odom_p[r] * leg_odom_p[r];
+                }
+            }
+            correct(6);
+        }
+    };
+} // namespace serow
+#endif
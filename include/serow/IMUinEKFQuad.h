@@ -4,6 +4,7 @@
 #include <iostream>
 #include <eigen3/Eigen/Dense>
 #include <cmath>
+#include "serow/lie.h"
 
 using namespace Eigen;
 
@@ -63,12 +64,12 @@ class IMUinEKFQuad
 
 	void constructState(Matrix<double, 9, 9> &X_, Matrix<double, 6, 1> &theta_, Matrix3d R_, Vector3d v_, Vector3d p_, Vector3d dRF_, Vector3d dRH_, Vector3d dLF_, Vector3d dLH_, Vector3d bg_, Vector3d ba_);
 	void seperateState(Matrix<double, 9, 9> X_, Matrix<double, 6, 1> theta_, Matrix3d &R_, Vector3d &v_, Vector3d &p_, Vector3d &dRF_, Vector3d &dRH_, Vector3d &dLF_, Vector3d &dLH_, Vector3d &bg_, Vector3d &ba_);
-	Matrix<double, 9, 9> exp_SE3(Matrix<double, 21, 1> v);
-	Matrix3d exp_SO3(Vector3d v);
 	Matrix<double, 27, 27> Adjoint(Matrix<double, 9, 9> X_);
 
 	void updateWithTwist(Vector3d vy, Matrix3d Rvy);
 	void updateWithOrient(Quaterniond qy);
+	//Gyro bias pseudo-measurement, e.g. from a still window of the IMU bias calibration
+	void updateWithGyroBias(const Vector3d &bg_, const Matrix3d &Rbg);
 
 	void updateVars();
 
@@ -139,23 +140,15 @@ class IMUinEKFQuad
 	}
 
 
-	inline Vector3d logMap(
-		Matrix<double, 3, 3> Rt)
-	{
-
-		Vector3d res = Vector3d::Zero();
-		double costheta = (Rt.trace() - 1.0) / 2.0;
-		double theta = acos(costheta);
-
-		if (theta != 0.000)
-		{
-			Matrix<double, 3, 3> lnR = Matrix<double, 3, 3>::Zero();
-			lnR.noalias() = Rt - Rt.transpose();
-			lnR *= theta / (2.0 * sin(theta));
-			res = vec(lnR);
-		}
 
-		return res;
+	//Right invariant error covariance, restored from a checkpoint with setCovariance()
+	const Matrix<double, 27, 27> &covariance() const
+	{
+		return P;
+	}
+	void setCovariance(const Matrix<double, 27, 27> &P_)
+	{
+		P = P_;
 	}
 
 	void predict(Vector3d angular_velocity, Vector3d linear_acceleration, Vector3d pbRF, Vector3d pbRH, Vector3d pbLF, Vector3d pbLH, Matrix3d hR_RF, Matrix3d hR_RH,  Matrix3d hR_LF, Matrix3d hR_LH, int contactRF, int contactRH, int contactLF, int contactLH);
@@ -165,28 +158,15 @@ class IMUinEKFQuad
 	void updateWithTwistOrient(Vector3d vy, Quaterniond qy);
 	// Initializing Variables
 	void init();
+	/** @fn Matrix<double, 6, 6> poseCovariance() const
+	 *  @brief covariance of the base position and orientation in the world frame, ordered x, y, z, roll, pitch, yaw as in nav_msgs
+	 */
+	Matrix<double, 6, 6> poseCovariance() const;
+	/** @fn Matrix<double, 6, 6> twistCovariance() const
+	 *  @brief covariance of the base linear and bias-corrected angular velocity in the world frame
+	 */
+	Matrix<double, 6, 6> twistCovariance() const;
 
-	//Computes the skew symmetric matrix of a 3-D vector
-	Matrix3d skew(Vector3d v)
-	{
-		Matrix3d res;
-		res = Matrix3d::Zero();
-		res(0, 1) = -v(2);
-		res(0, 2) = v(1);
-		res(1, 2) = -v(0);
-		res(1, 0) = v(2);
-		res(2, 0) = -v(1);
-		res(2, 1) = v(0);
-		return res;
-	}
-	Vector3d vec(Matrix3d M)
-	{
-		Vector3d v = Vector3d::Zero();
-		v(0) = M(2, 1);
-		v(1) = M(0, 2);
-		v(2) = M(1, 0);
-		return v;
-	}
 
 	//Get the Euler Angles from a Rotation Matrix
 	inline Vector3d getEulerAngles(
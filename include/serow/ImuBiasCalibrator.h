@@ -0,0 +1,224 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Streaming IMU bias calibration with stillness detection
+ * @author Stylianos Piperakis
+ * @details the gyro rate and the gravity compensated specific force are accumulated with Welford running
+ * statistics while the IMU is still. Every window samples of uninterrupted stillness the window means refine
+ * the bias priors, so the calibration runs alongside the estimation and tracks slow bias drift whenever the
+ * robot stands still. A sample is still if the rate and the specific force stay within the thresholds of the
+ * current priors and of the window means.
+ */
+
+#ifndef IMUBIASCALIBRATOR_H
+#define IMUBIASCALIBRATOR_H
+#include <eigen3/Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+
+namespace serow
+{
+    /**
+     * @brief Welford running mean and variance of a 3-vector
+     */
+    struct RunningStats3
+    {
+        long n;
+        Eigen::Vector3d mean, m2;
+
+        RunningStats3()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            n = 0;
+            mean.setZero();
+            m2.setZero();
+        }
+
+        void add(const Eigen::Vector3d &x)
+        {
+            n++;
+            const Eigen::Vector3d d = x - mean;
+            mean += d / n;
+            m2 += d.cwiseProduct(x - mean);
+        }
+
+        Eigen::Vector3d variance() const
+        {
+            return n > 1 ? Eigen::Vector3d(m2 / (n - 1)) : Eigen::Vector3d::Zero();
+        }
+    };
+
+    class ImuBiasCalibrator
+    {
+    private:
+        RunningStats3 gyroStats, accStats;
+        Eigen::Vector3d bg, ba;
+        ///Mean and per sample variance of the last window that refined the priors
+        Eigen::Vector3d windowGyro, windowGyroVar, windowAccVar;
+        long windowN;
+        ///Samples the priors stand for, capped at memory
+        double weight;
+        double g, gyroThreshold, accThreshold;
+        long window, memory, windows;
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        ImuBiasCalibrator()
+        {
+            bg.setZero();
+            ba.setZero();
+            windowGyro.setZero();
+            windowGyroVar.setZero();
+            windowAccVar.setZero();
+            windowN = 0;
+            weight = 0;
+            windows = 0;
+            setParams(9.80665, 0.05, 0.3, 500, 500);
+        }
+
+        /** @fn void setParams(double g_, double gyroThreshold_, double accThreshold_, long window_, long memory_)
+         *  @param g_ gravity constant
+         *  @param gyroThreshold_ largest rate deviation of a still sample in rad/s
+         *  @param accThreshold_ largest specific force deviation of a still sample in m/s^2
+         *  @param window_ still samples averaged before the priors are refined
+         *  @param memory_ still samples the priors average at most, older windows are forgotten beyond it
+        */
+        void setParams(double g_, double gyroThreshold_, double accThreshold_, long window_, long memory_)
+        {
+            g = g_;
+            gyroThreshold = gyroThreshold_;
+            accThreshold = accThreshold_;
+            window = std::max(window_, 1L);
+            memory = std::max(memory_, window);
+        }
+
+        /** @fn void setPrior(const Eigen::Vector3d &ba_, const Eigen::Vector3d &bg_, double weight_)
+         *  @brief sets the bias priors, weight_ is the number of still samples they count for, 0 lets the
+         *  first window replace them
+        */
+        void setPrior(const Eigen::Vector3d &ba_, const Eigen::Vector3d &bg_, double weight_)
+        {
+            ba = ba_;
+            bg = bg_;
+            weight = std::min(weight_, (double)memory);
+            gyroStats.reset();
+            accStats.reset();
+        }
+
+        /** @fn bool add(const Eigen::Vector3d &gyro, const Eigen::Vector3d &acc, const Eigen::Matrix3d &Rwb)
+         *  @brief adds one IMU sample in the base frame with the current base orientation
+         *  @return true if the sample completed a still window and the priors were refined
+        */
+        bool add(const Eigen::Vector3d &gyro, const Eigen::Vector3d &acc, const Eigen::Matrix3d &Rwb)
+        {
+            const Eigen::Vector3d f = acc - Rwb.transpose() * Eigen::Vector3d(0, 0, g);
+            bool still = (gyro - bg).norm() < gyroThreshold && std::fabs((acc - ba).norm() - g) < accThreshold;
+            if (still && gyroStats.n > 0)
+                still = (gyro - gyroStats.mean).norm() < gyroThreshold && (f - accStats.mean).norm() < accThreshold;
+            if (!still)
+            {
+                gyroStats.reset();
+                accStats.reset();
+                return false;
+            }
+            gyroStats.add(gyro);
+            accStats.add(f);
+            if (gyroStats.n < window)
+                return false;
+
+            const double n = gyroStats.n;
+            windowGyro = gyroStats.mean;
+            windowGyroVar = gyroStats.variance();
+            windowAccVar = accStats.variance();
+            windowN = gyroStats.n;
+            bg = (weight * bg + n * gyroStats.mean) / (weight + n);
+            ba = (weight * ba + n * accStats.mean) / (weight + n);
+            weight = std::min(weight + n, (double)memory);
+            windows++;
+            gyroStats.reset();
+            accStats.reset();
+            return true;
+        }
+
+        bool isStill() const
+        {
+            return gyroStats.n > 0;
+        }
+
+        ///Still samples in the current window
+        long stillSamples() const
+        {
+            return gyroStats.n;
+        }
+
+        ///Windows that refined the priors so far
+        long refinedWindows() const
+        {
+            return windows;
+        }
+
+        Eigen::Vector3d gyroBias() const
+        {
+            return bg;
+        }
+
+        Eigen::Vector3d accBias() const
+        {
+            return ba;
+        }
+
+        ///Gyro bias averaged over the last refining window alone
+        Eigen::Vector3d windowGyroBias() const
+        {
+            return windowGyro;
+        }
+
+        long windowSamples() const
+        {
+            return windowN;
+        }
+
+        ///Variance of the rate in the last refining window, the gyro noise while standing still
+        Eigen::Vector3d gyroVariance() const
+        {
+            return windowGyroVar;
+        }
+
+        Eigen::Vector3d accVariance() const
+        {
+            return windowAccVar;
+        }
+    };
+} // namespace serow
+#endif
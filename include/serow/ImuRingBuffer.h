@@ -0,0 +1,126 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Fixed-capacity ring buffer of raw IMU samples
+ * @author Stylianos Piperakis
+ * @details lets the attitude filters consume every IMU sample at the sensor's native rate,
+ * independently of the rate at which the estimator loop runs
+ */
+
+#ifndef IMURINGBUFFER_H
+#define IMURINGBUFFER_H
+#include <eigen3/Eigen/Dense>
+#include <atomic>
+#include <cstddef>
+
+namespace serow
+{
+    struct ImuSample
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        /// sensor timestamp in seconds
+        double t;
+        Eigen::Vector3d gyro, acc;
+    };
+
+    /**
+     *  @brief Single-producer/single-consumer ring of IMU samples with storage fixed at compile time.
+     *  The producer is the IMU callback, the consumer the estimator loop. When the ring is full the
+     *  newest sample is dropped and counted, so push() and pop() never allocate or block.
+     */
+    template <std::size_t N>
+    class ImuRingBuffer
+    {
+    private:
+        ImuSample buffer[N];
+        std::atomic<std::size_t> head, tail;
+        std::atomic<unsigned long> dropped;
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        ImuRingBuffer() : head(0), tail(0), dropped(0) {}
+
+        /** @fn bool push(double t, const Eigen::Vector3d& gyro, const Eigen::Vector3d& acc)
+         *  @brief stores a sample, returns false if the ring was full and the sample was dropped
+        */
+        bool push(double t, const Eigen::Vector3d &gyro, const Eigen::Vector3d &acc)
+        {
+            const std::size_t h = head.load(std::memory_order_relaxed);
+            const std::size_t next = (h + 1) % N;
+            if (next == tail.load(std::memory_order_acquire))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            buffer[h].t = t;
+            buffer[h].gyro = gyro;
+            buffer[h].acc = acc;
+            head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        /** @fn bool pop(ImuSample& s)
+         *  @brief retrieves the oldest sample, returns false if the ring is empty
+        */
+        bool pop(ImuSample &s)
+        {
+            const std::size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire))
+                return false;
+            s = buffer[t];
+            tail.store((t + 1) % N, std::memory_order_release);
+            return true;
+        }
+
+        std::size_t size() const
+        {
+            const std::size_t h = head.load(std::memory_order_acquire);
+            const std::size_t t = tail.load(std::memory_order_acquire);
+            return (h + N - t) % N;
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        /// number of usable slots
+        static constexpr std::size_t capacity()
+        {
+            return N - 1;
+        }
+
+        unsigned long droppedSamples() const
+        {
+            return dropped.load(std::memory_order_relaxed);
+        }
+    };
+} // namespace serow
+#endif
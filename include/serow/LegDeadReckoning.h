@@ -0,0 +1,391 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Leg odometry kernel shared by the biped and the quadruped dead reckoning
+ * @author Stylianos Piperakis
+ * @details the kinematic body velocity, the IMVP and the weighted leg odometry are computed for all legs in
+ * lockstep; every per-leg quantity is stored structure-of-arrays (one row per leg, one column per component)
+ * so each step is a short coefficient-wise loop over the legs that the compiler vectorizes
+ */
+
+#ifndef LEGDEADRECKONING_H
+#define LEGDEADRECKONING_H
+#include <eigen3/Eigen/Dense>
+
+namespace serow
+{
+    template <int Legs>
+    class LegDeadReckoning
+    {
+    public:
+        /// One row per leg, columns x, y, z
+        typedef Eigen::Array<double, Legs, 3> LegVectors;
+        /// One row per leg, column r + 3 * c holds the (r, c) entry of the leg rotation
+        typedef Eigen::Array<double, Legs, 9> LegRotations;
+        typedef Eigen::Array<double, Legs, 1> LegScalars;
+
+        /// Measurements of one cycle, kinematics in the base frame and force/torque in the foot frame
+        struct Input
+        {
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+            LegRotations Rb;
+            LegVectors pb, vb, omegab;
+            LegVectors f, t;
+            /// vertical GRF, or contact probability for the GEM variant
+            LegScalars contact;
+        };
+
+    protected:
+        double Tm2, Tm3, ef, mass, g, freq, alpha1, alpha3;
+        bool firstrun;
+        Input in;
+        /// normalized leg weights of the odometry
+        LegScalars w;
+        /// FT sensor position w.r.t the foot frame
+        LegVectors pf;
+        /// leg pose w.r.t the world frame, current and previous cycle
+        LegVectors pw, pw_;
+        LegRotations Rw, Rw_;
+        /// leg velocities w.r.t the world frame, body velocity implied by each leg, IMVP in the foot frame
+        LegVectors vw, omegaw, vwb_leg, pm;
+        /// Rwb * pb and Rwb * vb, shared by the velocity and the odometry steps
+        LegVectors Rp, Rv, wxRp;
+        Eigen::Vector3d pwb, pwb_, vwb;
+        Eigen::Matrix3d vwb_cov;
+
+        /** @fn void rotate(const Eigen::Matrix3d& R, const LegVectors& v, LegVectors& out)
+         *  @brief out = R * v for every leg, out must not alias v
+        */
+        static void rotate(const Eigen::Matrix3d &R, const LegVectors &v, LegVectors &out)
+        {
+            for (int r = 0; r < 3; r++)
+                out.col(r) = R(r, 0) * v.col(0) + R(r, 1) * v.col(1) + R(r, 2) * v.col(2);
+        }
+
+        /** @fn void rotate(const LegRotations& R, const LegVectors& v, LegVectors& out)
+         *  @brief out = R_i * v_i for every leg i, out must not alias v
+        */
+        static void rotate(const LegRotations &R, const LegVectors &v, LegVectors &out)
+        {
+            for (int r = 0; r < 3; r++)
+                out.col(r) = R.col(r) * v.col(0) + R.col(r + 3) * v.col(1) + R.col(r + 6) * v.col(2);
+        }
+
+        /** @fn void rotateTransposed(const LegRotations& R, const LegVectors& v, LegVectors& out)
+         *  @brief out = R_i^T * v_i for every leg i, out must not alias v
+        */
+        static void rotateTransposed(const LegRotations &R, const LegVectors &v, LegVectors &out)
+        {
+            for (int r = 0; r < 3; r++)
+                out.col(r) = R.col(3 * r) * v.col(0) + R.col(3 * r + 1) * v.col(1) + R.col(3 * r + 2) * v.col(2);
+        }
+
+        /** @fn void compose(const Eigen::Matrix3d& A, const LegRotations& B, LegRotations& out)
+         *  @brief out = A * B_i for every leg i
+        */
+        static void compose(const Eigen::Matrix3d &A, const LegRotations &B, LegRotations &out)
+        {
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    out.col(r + 3 * c) = A(r, 0) * B.col(3 * c) + A(r, 1) * B.col(3 * c + 1) + A(r, 2) * B.col(3 * c + 2);
+        }
+
+        /** @fn void cross(const LegVectors& a, const LegVectors& b, LegVectors& out)
+         *  @brief out = a_i x b_i for every leg i, out must not alias a or b
+        */
+        static void cross(const LegVectors &a, const LegVectors &b, LegVectors &out)
+        {
+            out.col(0) = a.col(1) * b.col(2) - a.col(2) * b.col(1);
+            out.col(1) = a.col(2) * b.col(0) - a.col(0) * b.col(2);
+            out.col(2) = a.col(0) * b.col(1) - a.col(1) * b.col(0);
+        }
+
+        /** @fn void cross(const Eigen::Vector3d& a, const LegVectors& b, LegVectors& out)
+         *  @brief out = a x b_i for every leg i, out must not alias b
+        */
+        static void cross(const Eigen::Vector3d &a, const LegVectors &b, LegVectors &out)
+        {
+            out.col(0) = a(1) * b.col(2) - a(2) * b.col(1);
+            out.col(1) = a(2) * b.col(0) - a(0) * b.col(2);
+            out.col(2) = a(0) * b.col(1) - a(1) * b.col(0);
+        }
+
+        /** @fn Eigen::Vector3d weightedSum(const LegVectors& v) const
+         *  @brief sum of the leg vectors weighted with the normalized leg weights
+        */
+        Eigen::Vector3d weightedSum(const LegVectors &v) const
+        {
+            return (v.colwise() * w).colwise().sum().transpose().matrix();
+        }
+
+        /** @fn void computeBodyVelKCFS(const Eigen::Matrix3d& Rwb, const Eigen::Vector3d& omegawb)
+         *  @brief body velocity implied by the kinematics of every leg and their weighted average
+        */
+        void computeBodyVelKCFS(const Eigen::Matrix3d &Rwb, const Eigen::Vector3d &omegawb)
+        {
+            rotate(Rwb, in.pb, Rp);
+            rotate(Rwb, in.vb, Rv);
+            cross(omegawb, Rp, wxRp);
+            vwb_leg = -wxRp - Rv;
+            vwb = weightedSum(vwb_leg);
+        }
+
+        /** @fn void computeLegKCFS(const Eigen::Matrix3d& Rwb, const Eigen::Vector3d& omegawb)
+         *  @brief orientation, linear and angular velocity of every foot w.r.t the world frame
+        */
+        void computeLegKCFS(const Eigen::Matrix3d &Rwb, const Eigen::Vector3d &omegawb)
+        {
+            compose(Rwb, in.Rb, Rw);
+            rotate(Rwb, in.omegab, omegaw);
+            omegaw.rowwise() += omegawb.transpose().array();
+            vw = wxRp + Rv;
+            vw.rowwise() += vwb.transpose().array();
+        }
+
+        /** @fn void computeIMVP()
+         *  @brief instantaneous moment of velocity point of every foot from the foot kinematics
+        */
+        void computeIMVP()
+        {
+            LegVectors om, vl, wxv;
+            rotateTransposed(Rw, omegaw, om);
+            rotateTransposed(Rw, vw, vl);
+            cross(om, vl, wxv);
+            LegScalars temp = Tm2 / (om.square().rowwise().sum() * Tm2 + 1.0);
+            LegScalars ompm = (om * pm).rowwise().sum();
+            for (int r = 0; r < 3; r++)
+                pm.col(r) = temp * (om.col(r) * ompm + pm.col(r) / Tm2 + wxv.col(r));
+        }
+
+        /** @fn void computeIMVPFT()
+         *  @brief instantaneous moment of velocity point of every foot from the foot kinematics and force/torque
+         *  @details solves (I/Tm2 - alpha1 [w]^2 - alpha3/Tm3 [f]^2) pm = b per leg with the adjugate of the
+         *  symmetric system matrix
+        */
+        void computeIMVPFT()
+        {
+            const LegVectors &f = in.f;
+            LegVectors om, vl, wxv, fxt;
+            rotateTransposed(Rw, omegaw, om);
+            rotateTransposed(Rw, vw, vl);
+            cross(om, vl, wxv);
+            cross(f, in.t, fxt);
+
+            const double c = alpha3 / Tm3;
+            LegScalars f2 = f.square().rowwise().sum();
+            LegScalars s = 1.0 / Tm2 + alpha1 * om.square().rowwise().sum() + c * f2;
+            LegScalars a00 = s - alpha1 * om.col(0).square() - c * f.col(0).square();
+            LegScalars a11 = s - alpha1 * om.col(1).square() - c * f.col(1).square();
+            LegScalars a22 = s - alpha1 * om.col(2).square() - c * f.col(2).square();
+            LegScalars a01 = -alpha1 * om.col(0) * om.col(1) - c * f.col(0) * f.col(1);
+            LegScalars a02 = -alpha1 * om.col(0) * om.col(2) - c * f.col(0) * f.col(2);
+            LegScalars a12 = -alpha1 * om.col(1) * om.col(2) - c * f.col(1) * f.col(2);
+
+            //b = pm/Tm2 + alpha1 [w] v + alpha3/Tm3 ([f] t - [f]^2 pf), [f]^2 pf = f (f.pf) - |f|^2 pf
+            LegScalars fpf = (f * pf).rowwise().sum();
+            LegVectors b;
+            for (int r = 0; r < 3; r++)
+                b.col(r) = pm.col(r) / Tm2 + alpha1 * wxv.col(r) + c * (fxt.col(r) - f.col(r) * fpf + f2 * pf.col(r));
+
+            LegScalars c00 = a11 * a22 - a12 * a12;
+            LegScalars c01 = a02 * a12 - a01 * a22;
+            LegScalars c02 = a01 * a12 - a02 * a11;
+            LegScalars c11 = a00 * a22 - a02 * a02;
+            LegScalars c12 = a01 * a02 - a00 * a12;
+            LegScalars c22 = a00 * a11 - a01 * a01;
+            LegScalars idet = 1.0 / (a00 * c00 + a01 * c01 + a02 * c02);
+            pm.col(0) = (c00 * b.col(0) + c01 * b.col(1) + c02 * b.col(2)) * idet;
+            pm.col(1) = (c01 * b.col(0) + c11 * b.col(1) + c12 * b.col(2)) * idet;
+            pm.col(2) = (c02 * b.col(0) + c12 * b.col(1) + c22 * b.col(2)) * idet;
+        }
+
+        /** @fn void computeOdometry(const Eigen::Matrix3d& Rwb, const Eigen::Vector3d& omegawb)
+         *  @brief one full cycle once the leg weights are set
+        */
+        void computeOdometry(const Eigen::Matrix3d &Rwb, const Eigen::Vector3d &omegawb)
+        {
+            computeBodyVelKCFS(Rwb, omegawb);
+            computeLegKCFS(Rwb, omegawb);
+            if (alpha3 > 0)
+                computeIMVPFT();
+            else
+                computeIMVP();
+
+            //Temp estimate of the leg positions w.r.t the inertial frame, the IMVP stays fixed
+            LegVectors a, b;
+            rotate(Rw, pm, a);
+            rotate(Rw_, pm, b);
+            pw = pw_ - a + b;
+
+            //Base position implied by each leg and their weighted average
+            LegVectors pbw = pw - Rp;
+            pwb_ = pwb;
+            pwb = weightedSum(pbw);
+            pw -= pbw;
+            pw.rowwise() += pwb.transpose().array();
+
+            //Needed in the next iteration
+            Rw_ = Rw;
+            pw_ = pw;
+            if (!firstrun)
+                vwb = (pwb - pwb_) * freq;
+            else
+                firstrun = false;
+
+            LegVectors e = vwb_leg;
+            e.rowwise() -= vwb.transpose().array();
+            vwb_cov.noalias() = (e.colwise() * w).matrix().transpose() * e.matrix();
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        /** @fn LegDeadReckoning(const LegVectors& pw0, const LegRotations& Rw0, double mass_, double alpha1_, double alpha3_, double freq_, double g_, const LegVectors& pf_)
+         *  @brief initializes the leg odometry with the initial foot poses and the FT sensor positions
+        */
+        LegDeadReckoning(const LegVectors &pw0, const LegRotations &Rw0, double mass_, double alpha1_, double alpha3_,
+                         double freq_, double g_, const LegVectors &pf_)
+        {
+            firstrun = true;
+            mass = mass_;
+            g = g_;
+            freq = freq_;
+            Tm2 = 1.0 / (freq * freq);
+            Tm3 = (mass * mass * g * g) * Tm2;
+            ef = 0.1;
+            alpha1 = alpha1_;
+            alpha3 = alpha3_;
+            pw = pw0;
+            pw_ = pw0;
+            Rw = Rw0;
+            Rw_ = Rw0;
+            pf = pf_;
+            pm = pf_;
+            in.Rb = Rw0;
+            in.pb.setZero();
+            in.vb.setZero();
+            in.omegab.setZero();
+            in.f.setZero();
+            in.t.setZero();
+            in.contact.setZero();
+            w.setConstant(1.0 / Legs);
+            vw.setZero();
+            omegaw.setZero();
+            vwb_leg.setZero();
+            Rp.setZero();
+            Rv.setZero();
+            wxRp.setZero();
+            pwb.setZero();
+            pwb_.setZero();
+            vwb.setZero();
+            vwb_cov.setZero();
+        }
+
+        /** @fn Input& input()
+         *  @brief measurements of the next cycle, filled in place by the caller
+        */
+        Input &input()
+        {
+            return in;
+        }
+
+        /** @fn void computeDeadReckoning(const Eigen::Matrix3d& Rwb, const Eigen::Vector3d& omegawb)
+         *  @brief leg odometry with the legs weighted by their cropped vertical GRF (input().contact)
+        */
+        void computeDeadReckoning(const Eigen::Matrix3d &Rwb, const Eigen::Vector3d &omegawb)
+        {
+            LegScalars fz = in.contact.min(mass * g).max(0.0);
+            w = (fz + ef) / (fz.sum() + Legs * ef);
+            computeOdometry(Rwb, omegawb);
+        }
+
+        /** @fn void computeDeadReckoningGEM(const Eigen::Matrix3d& Rwb, const Eigen::Vector3d& omegawb)
+         *  @brief leg odometry with the legs weighted by their contact probability (input().contact)
+        */
+        void computeDeadReckoningGEM(const Eigen::Matrix3d &Rwb, const Eigen::Vector3d &omegawb)
+        {
+            w = (in.contact + ef) / (in.contact.sum() + Legs * ef);
+            computeOdometry(Rwb, omegawb);
+        }
+
+        Eigen::Vector3d getOdom() const
+        {
+            return pwb;
+        }
+        Eigen::Vector3d getLinearVel() const
+        {
+            return vwb;
+        }
+        Eigen::Matrix3d getVelocityCovariance() const
+        {
+            return vwb_cov;
+        }
+        Eigen::Vector3d getFootLinearVel(int leg) const
+        {
+            return vector(vw, leg);
+        }
+        Eigen::Vector3d getFootAngularVel(int leg) const
+        {
+            return vector(omegaw, leg);
+        }
+        /** @fn Eigen::Vector3d getFootIMVPPosition(int leg) const
+         *  @brief contact point w.r.t the base frame, currently the foot frame origin
+        */
+        Eigen::Vector3d getFootIMVPPosition(int leg) const
+        {
+            return vector(in.pb, leg);
+        }
+        Eigen::Matrix3d getFootIMVPOrientation(int leg) const
+        {
+            return rotation(in.Rb, leg);
+        }
+
+        static Eigen::Vector3d vector(const LegVectors &v, int leg)
+        {
+            return v.row(leg).transpose().matrix();
+        }
+        static Eigen::Matrix3d rotation(const LegRotations &R, int leg)
+        {
+            Eigen::Matrix3d m;
+            for (int k = 0; k < 9; k++)
+                m(k % 3, k / 3) = R(leg, k);
+            return m;
+        }
+        static void setLeg(LegVectors &v, int leg, const Eigen::Vector3d &x)
+        {
+            v.row(leg) = x.transpose().array();
+        }
+        static void setLeg(LegRotations &R, int leg, const Eigen::Matrix3d &m)
+        {
+            for (int k = 0; k < 9; k++)
+                R(leg, k) = m(k % 3, k / 3);
+        }
+    };
+} // namespace serow
+#endif
@@ -48,57 +48,12 @@ namespace serow{
         double beta;				// algorithm gain
         double freq;
         double q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
-        
-    public:
-        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-        
-        Madgwick(double freq_, double beta_)
-        {
-            R.Identity();
-            acc.Zero();
-            gyro.Zero();
-            freq = freq_;
-            beta = beta_;  //2 * proportional gain (Kp)
-            q.Identity();
-            q0 = 1.0f;
-            q1 = 0.0f;
-            q2 = 0.0f;
-            q3 = 0.0f;
-        }
-        
-        Eigen::Quaterniond getQ()
-        {
-            return q;
-        }
-        
-        Eigen::Vector3d getAcc()
-        {
-            return acc;
-        }
-        Eigen::Vector3d getGyro()
-        {
-            return gyro;
-        }
-        Eigen::Matrix3d getR()
-        {
-            return R;
-        }
-        Eigen::Vector3d getEuler()
-        {
-            return q.toRotationMatrix().eulerAngles(0, 1, 2);
-        }
-        void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_)
+
+        /** @fn void step(double gx, double gy, double gz, double ax, double ay, double az, double dt)
+         *  @brief single gradient descent/integration step of the quaternion over dt
+        */
+        void step(double gx, double gy, double gz, double ax, double ay, double az, double dt)
         {
-            
-            
-            double gx = gyro_(0);
-            double gy = gyro_(1);
-            double gz = gyro_(2);
-            
-            double ax = acc_(0);
-            double ay = acc_(1);
-            double az = acc_(2);
-            
             double recipNorm;
             double s0, s1, s2, s3;
             double qDot1, qDot2, qDot3, qDot4;
@@ -153,10 +108,10 @@ namespace serow{
             }
             
             // Integrate rate of change of quaternion to yield quaternion
-            q0 += qDot1 * (1.0f / freq);
-            q1 += qDot2 * (1.0f / freq);
-            q2 += qDot3 * (1.0f / freq);
-            q3 += qDot4 * (1.0f / freq);
+            q0 += qDot1 * dt;
+            q1 += qDot2 * dt;
+            q2 += qDot3 * dt;
+            q3 += qDot4 * dt;
             
             // Normalise quaternion
             recipNorm = 1.0/sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
@@ -164,7 +119,81 @@ namespace serow{
             q1 *= recipNorm;
             q2 *= recipNorm;
             q3 *= recipNorm;
-            
+        }
+        
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        
+        Madgwick(double freq_, double beta_)
+        {
+            R.Identity();
+            acc.Zero();
+            gyro.Zero();
+            freq = freq_;
+            beta = beta_;  //2 * proportional gain (Kp)
+            q.Identity();
+            q0 = 1.0f;
+            q1 = 0.0f;
+            q2 = 0.0f;
+            q3 = 0.0f;
+        }
+        
+        Eigen::Quaterniond getQ()
+        {
+            return q;
+        }
+        
+        Eigen::Vector3d getAcc()
+        {
+            return acc;
+        }
+        Eigen::Vector3d getGyro()
+        {
+            return gyro;
+        }
+        Eigen::Matrix3d getR()
+        {
+            return R;
+        }
+        Eigen::Vector3d getEuler()
+        {
+            return q.toRotationMatrix().eulerAngles(0, 1, 2);
+        }
+        /** @fn void setQ(const Eigen::Quaterniond &q_)
+         *  @brief resumes from a saved orientation, e.g. from a checkpoint
+        */
+        void setQ(const Eigen::Quaterniond &q_)
+        {
+            q = q_.normalized();
+            q0 = q.w();
+            q1 = q.x();
+            q2 = q.y();
+            q3 = q.z();
+            R = q.toRotationMatrix();
+        }
+
+        /** @fn void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_)
+         *  @brief updates the orientation with one IMU sample taken at the nominal filter rate
+        */
+        void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_)
+        {
+            updateIMU(gyro_, acc_, 1.0 / freq);
+        }
+
+        /** @fn void updateIMU(const Eigen::Vector3d& gyro_, const Eigen::Vector3d& acc_, double dt)
+         *  @brief updates the orientation with one IMU sample held for dt seconds
+         *  @details if dt spans more than one nominal period the sample is integrated in equal sub-steps
+         *  no longer than 1/freq (zero-order hold), so bursts and gaps do not degrade the integration
+        */
+        void updateIMU(const Eigen::Vector3d &gyro_, const Eigen::Vector3d &acc_, double dt)
+        {
+            int substeps = 1;
+            if (dt * freq > 1.0)
+                substeps = (int)ceil(dt * freq - 1e-6);
+            const double h = dt / substeps;
+            for (int i = 0; i < substeps; i++)
+                step(gyro_(0), gyro_(1), gyro_(2), acc_(0), acc_(1), acc_(2), h);
+
             q.x() = q1;
             q.y() = q2;
             q.z() = q3;
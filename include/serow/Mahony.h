@@ -50,62 +50,17 @@ namespace serow{
         double q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
         double integralFBx,  integralFBy, integralFBz;
         double sampleFreq;
-    public:
-        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-        
-        Mahony( double sampleFreq_, double Kp, double Ki = 0.0f)
-        {
-            R.Identity();
-            acc.Zero();
-            gyro.Zero();
-            sampleFreq = sampleFreq_;
-            q.Identity();
-            q0 = 1.0f;
-            q1 = 0.0f;
-            q2 = 0.0f;
-            q3 = 0.0f;
-            twoKp = 2.0 * Kp;
-            twoKi = 2.0 * Ki;
-            integralFBx = 0.0;
-            integralFBy = 0.0;
-            integralFBz = 0.0;
-        }
-        
-        Eigen::Quaterniond getQ()
-        {
-            return q;
-        }
-        
-        Eigen::Vector3d getAcc()
-        {
-            return acc;
-        }
-        Eigen::Vector3d getGyro()
-        {
-            return gyro;
-        }
-        Eigen::Matrix3d getR()
-        {
-            return R;
-        }
-        Eigen::Vector3d getEuler()
+
+        /** @fn void step(double gx, double gy, double gz, double ax, double ay, double az, double dt)
+         *  @brief single feedback/integration step of the quaternion over dt
+        */
+        void step(double gx, double gy, double gz, double ax, double ay, double az, double dt)
         {
-            return q.toRotationMatrix().eulerAngles(0, 1, 2);
-        }
-        
-        void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_) {
             double recipNorm;
             double halfvx, halfvy, halfvz;
             double halfex, halfey, halfez;
             double qa, qb, qc;
-            double ax,ay,az,gx,gy,gz;
-	    
-            gx = gyro_(0);
-            gy = gyro_(1);
-            gz = gyro_(2);
-            ax = acc_(0);
-            ay = acc_(1);
-            az = acc_(2);
+
             // Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
             if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
                 
@@ -127,9 +82,9 @@ namespace serow{
                 
                 // Compute and apply integral feedback if enabled
                 if(twoKi > 0.0f) {
-                    integralFBx += twoKi * halfex * (1.0f / sampleFreq);    // integral error scaled by Ki
-                    integralFBy += twoKi * halfey * (1.0f / sampleFreq);
-                    integralFBz += twoKi * halfez * (1.0f / sampleFreq);
+                    integralFBx += twoKi * halfex * dt;    // integral error scaled by Ki
+                    integralFBy += twoKi * halfey * dt;
+                    integralFBz += twoKi * halfez * dt;
                     gx += integralFBx;    // apply integral feedback
                     gy += integralFBy;
                     gz += integralFBz;
@@ -147,9 +102,9 @@ namespace serow{
             }
             
             // Integrate rate of change of quaternion
-            gx *= (0.5f * (1.0f / sampleFreq));        // pre-multiply common factors
-            gy *= (0.5f * (1.0f / sampleFreq));
-            gz *= (0.5f * (1.0f / sampleFreq));
+            gx *= (0.5f * dt);        // pre-multiply common factors
+            gy *= (0.5f * dt);
+            gz *= (0.5f * dt);
             qa = q0;
             qb = q1;
             qc = q2;
@@ -164,6 +119,93 @@ namespace serow{
             q1 *= recipNorm;
             q2 *= recipNorm;
             q3 *= recipNorm;
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        
+        Mahony( double sampleFreq_, double Kp, double Ki = 0.0f)
+        {
+            R.Identity();
+            acc.Zero();
+            gyro.Zero();
+            sampleFreq = sampleFreq_;
+            q.Identity();
+            q0 = 1.0f;
+            q1 = 0.0f;
+            q2 = 0.0f;
+            q3 = 0.0f;
+            twoKp = 2.0 * Kp;
+            twoKi = 2.0 * Ki;
+            integralFBx = 0.0;
+            integralFBy = 0.0;
+            integralFBz = 0.0;
+        }
+        
+        Eigen::Quaterniond getQ()
+        {
+            return q;
+        }
+        
+        Eigen::Vector3d getAcc()
+        {
+            return acc;
+        }
+        Eigen::Vector3d getGyro()
+        {
+            return gyro;
+        }
+        Eigen::Matrix3d getR()
+        {
+            return R;
+        }
+        Eigen::Vector3d getEuler()
+        {
+            return q.toRotationMatrix().eulerAngles(0, 1, 2);
+        }
+
+        Eigen::Vector3d getIntegralFeedback() const
+        {
+            return Eigen::Vector3d(integralFBx, integralFBy, integralFBz);
+        }
+
+        /** @fn void setState(const Eigen::Quaterniond &q_, const Eigen::Vector3d &integralFB)
+         *  @brief resumes from a saved orientation and integral feedback, e.g. from a checkpoint
+        */
+        void setState(const Eigen::Quaterniond &q_, const Eigen::Vector3d &integralFB)
+        {
+            q = q_.normalized();
+            q0 = q.w();
+            q1 = q.x();
+            q2 = q.y();
+            q3 = q.z();
+            R = q.toRotationMatrix();
+            integralFBx = integralFB(0);
+            integralFBy = integralFB(1);
+            integralFBz = integralFB(2);
+        }
+        
+        /** @fn void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_)
+         *  @brief updates the orientation with one IMU sample taken at the nominal filter rate
+        */
+        void updateIMU(Eigen::Vector3d gyro_, Eigen::Vector3d acc_)
+        {
+            updateIMU(gyro_, acc_, 1.0 / sampleFreq);
+        }
+
+        /** @fn void updateIMU(const Eigen::Vector3d& gyro_, const Eigen::Vector3d& acc_, double dt)
+         *  @brief updates the orientation with one IMU sample held for dt seconds
+         *  @details intervals longer than 1/sampleFreq are integrated in equal sub-steps (zero-order hold)
+        */
+        void updateIMU(const Eigen::Vector3d &gyro_, const Eigen::Vector3d &acc_, double dt)
+        {
+            int substeps = 1;
+            if (dt * sampleFreq > 1.0)
+                substeps = (int)ceil(dt * sampleFreq - 1e-6);
+            const double h = dt / substeps;
+            for (int i = 0; i < substeps; i++)
+                step(gyro_(0), gyro_(1), gyro_(2), acc_(0), acc_(1), acc_(2), h);
+
             q.x() = q1;
             q.y() = q2;
             q.z() = q3;
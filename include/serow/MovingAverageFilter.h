@@ -35,7 +35,7 @@
 #ifndef  __MOVINGAVERAGEFILTER_H__
 #define  __MOVINGAVERAGEFILTER_H__
 
-#include <queue>
+#include <vector>
 #include <iostream>
 
 
@@ -45,16 +45,22 @@ class MovingAverageFilter
 private:
     int windowSize;
     unsigned currentstep;
-    std::queue<float> windowBuffer;
+    /// fixed ring of the last windowSize samples, head points at the oldest one
+    std::vector<float> windowBuffer;
+    int head;
 public:
     float x;
 
     /** @fn setParams(int windowSize_)
      *  @brief sets the buffer size of the moving average filter
+     *  @details the ring buffer is sized here so that filter() never allocates
     */
     void setParams(int windowSize_)
     {
         windowSize=windowSize_;
+        windowBuffer.assign(windowSize, 0.0f);
+        head = 0;
+        currentstep = 0;
     }
 
     /** @fn void filter(float y)
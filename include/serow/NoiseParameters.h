@@ -0,0 +1,269 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Versioned noise and threshold parameter sets for runtime reconfiguration
+ * @author Stylianos Piperakis
+ * @details the reconfigure thread publishes a complete parameter set through a TripleBuffer and the
+ * estimator thread picks up the latest version at a cycle boundary, neither side ever blocks and the
+ * filters never see a half updated set
+ */
+
+#ifndef NOISEPARAMETERS_H
+#define NOISEPARAMETERS_H
+#include "serow/TripleBuffer.h"
+
+namespace serow
+{
+    /// Process and measurement noise of the base filters (IMUEKF, IMUinEKF, IMUinEKFQuad)
+    struct ImuNoiseParams
+    {
+        double acc_q[3], gyr_q[3], accb_q[3], gyrb_q[3];
+        double foot_contact[3];
+        double odom_p[3], odom_a[3];
+        double leg_odom_p[3], leg_odom_a[3];
+        double vel_p[3];
+        double mahalanobis_TH;
+    };
+
+    /// Process and measurement noise of the CoM estimator
+    struct CoMNoiseParams
+    {
+        double com_q, comd_q, fd_q, com_r, comdd_r;
+    };
+
+    /// Thresholds of the contact detectors
+    struct ContactThresholds
+    {
+        double LegHighThres, LegLowThres, StrikingContact, VelocityThres, prob_TH;
+    };
+
+    /// One complete parameter set, published and applied as a whole
+    struct EstimatorParams
+    {
+        ImuNoiseParams imu;
+        CoMNoiseParams com;
+        ContactThresholds contact;
+    };
+
+    /** @fn void readImuNoise(const Filter& f, ImuNoiseParams& p)
+     *  @brief copies the noise parameters shared by all base filters out of a filter
+    */
+    template <class Filter>
+    void readImuNoise(const Filter &f, ImuNoiseParams &p)
+    {
+        p.acc_q[0] = f.acc_qx; p.acc_q[1] = f.acc_qy; p.acc_q[2] = f.acc_qz;
+        p.gyr_q[0] = f.gyr_qx; p.gyr_q[1] = f.gyr_qy; p.gyr_q[2] = f.gyr_qz;
+        p.accb_q[0] = f.accb_qx; p.accb_q[1] = f.accb_qy; p.accb_q[2] = f.accb_qz;
+        p.gyrb_q[0] = f.gyrb_qx; p.gyrb_q[1] = f.gyrb_qy; p.gyrb_q[2] = f.gyrb_qz;
+        p.odom_p[0] = f.odom_px; p.odom_p[1] = f.odom_py; p.odom_p[2] = f.odom_pz;
+        p.odom_a[0] = f.odom_ax; p.odom_a[1] = f.odom_ay; p.odom_a[2] = f.odom_az;
+        p.leg_odom_p[0] = f.leg_odom_px; p.leg_odom_p[1] = f.leg_odom_py; p.leg_odom_p[2] = f.leg_odom_pz;
+        p.leg_odom_a[0] = f.leg_odom_ax; p.leg_odom_a[1] = f.leg_odom_ay; p.leg_odom_a[2] = f.leg_odom_az;
+        p.vel_p[0] = f.vel_px; p.vel_p[1] = f.vel_py; p.vel_p[2] = f.vel_pz;
+    }
+
+    /** @fn void applyImuNoise(Filter& f, const ImuNoiseParams& p)
+     *  @brief writes the noise parameters shared by all base filters, they are read at every predict/update
+    */
+    template <class Filter>
+    void applyImuNoise(Filter &f, const ImuNoiseParams &p)
+    {
+        f.acc_qx = p.acc_q[0]; f.acc_qy = p.acc_q[1]; f.acc_qz = p.acc_q[2];
+        f.gyr_qx = p.gyr_q[0]; f.gyr_qy = p.gyr_q[1]; f.gyr_qz = p.gyr_q[2];
+        f.accb_qx = p.accb_q[0]; f.accb_qy = p.accb_q[1]; f.accb_qz = p.accb_q[2];
+        f.gyrb_qx = p.gyrb_q[0]; f.gyrb_qy = p.gyrb_q[1]; f.gyrb_qz = p.gyrb_q[2];
+        f.odom_px = p.odom_p[0]; f.odom_py = p.odom_p[1]; f.odom_pz = p.odom_p[2];
+        f.odom_ax = p.odom_a[0]; f.odom_ay = p.odom_a[1]; f.odom_az = p.odom_a[2];
+        f.leg_odom_px = p.leg_odom_p[0]; f.leg_odom_py = p.leg_odom_p[1]; f.leg_odom_pz = p.leg_odom_p[2];
+        f.leg_odom_ax = p.leg_odom_a[0]; f.leg_odom_ay = p.leg_odom_a[1]; f.leg_odom_az = p.leg_odom_a[2];
+        f.vel_px = p.vel_p[0]; f.vel_py = p.vel_p[1]; f.vel_pz = p.vel_p[2];
+    }
+
+    /** @fn void readContactNoise(const Filter& f, ImuNoiseParams& p)
+     *  @brief copies the contact random walk of the contact aided filters (IMUinEKF, IMUinEKFQuad)
+    */
+    template <class Filter>
+    void readContactNoise(const Filter &f, ImuNoiseParams &p)
+    {
+        p.foot_contact[0] = f.foot_contactx; p.foot_contact[1] = f.foot_contacty; p.foot_contact[2] = f.foot_contactz;
+    }
+
+    /** @fn void applyContactNoise(Filter& f, const ImuNoiseParams& p)
+     *  @brief writes the contact random walk of the contact aided filters (IMUinEKF, IMUinEKFQuad)
+    */
+    template <class Filter>
+    void applyContactNoise(Filter &f, const ImuNoiseParams &p)
+    {
+        f.foot_contactx = p.foot_contact[0]; f.foot_contacty = p.foot_contact[1]; f.foot_contactz = p.foot_contact[2];
+    }
+
+    /** @fn void readCoMNoise(const Filter& f, CoMNoiseParams& p)
+     *  @brief copies the noise parameters out of the CoM estimator
+    */
+    template <class Filter>
+    void readCoMNoise(const Filter &f, CoMNoiseParams &p)
+    {
+        p.com_q = f.com_q;
+        p.comd_q = f.comd_q;
+        p.fd_q = f.fd_q;
+        p.com_r = f.com_r;
+        p.comdd_r = f.comdd_r;
+    }
+
+    /** @fn void applyCoMNoise(Filter& f, const CoMNoiseParams& p)
+     *  @brief writes the noise parameters of the CoM estimator, they are read at every predict/update
+    */
+    template <class Filter>
+    void applyCoMNoise(Filter &f, const CoMNoiseParams &p)
+    {
+        f.com_q = p.com_q;
+        f.comd_q = p.comd_q;
+        f.fd_q = p.fd_q;
+        f.com_r = p.com_r;
+        f.comdd_r = p.comdd_r;
+    }
+
+    /** @fn void paramsFromConfig(const Config& c, EstimatorParams& p)
+     *  @brief converts a dynamic reconfigure config (VarianceControlConfig) to a parameter set
+    */
+    template <class Config>
+    void paramsFromConfig(const Config &c, EstimatorParams &p)
+    {
+        p.imu.acc_q[0] = c.acc_qx; p.imu.acc_q[1] = c.acc_qy; p.imu.acc_q[2] = c.acc_qz;
+        p.imu.gyr_q[0] = c.gyr_qx; p.imu.gyr_q[1] = c.gyr_qy; p.imu.gyr_q[2] = c.gyr_qz;
+        p.imu.accb_q[0] = c.accb_qx; p.imu.accb_q[1] = c.accb_qy; p.imu.accb_q[2] = c.accb_qz;
+        p.imu.gyrb_q[0] = c.gyrb_qx; p.imu.gyrb_q[1] = c.gyrb_qy; p.imu.gyrb_q[2] = c.gyrb_qz;
+        p.imu.foot_contact[0] = c.foot_contactx; p.imu.foot_contact[1] = c.foot_contacty; p.imu.foot_contact[2] = c.foot_contactz;
+        p.imu.odom_p[0] = c.odom_px; p.imu.odom_p[1] = c.odom_py; p.imu.odom_p[2] = c.odom_pz;
+        p.imu.odom_a[0] = c.odom_ax; p.imu.odom_a[1] = c.odom_ay; p.imu.odom_a[2] = c.odom_az;
+        p.imu.leg_odom_p[0] = c.leg_odom_px; p.imu.leg_odom_p[1] = c.leg_odom_py; p.imu.leg_odom_p[2] = c.leg_odom_pz;
+        p.imu.leg_odom_a[0] = c.leg_odom_ax; p.imu.leg_odom_a[1] = c.leg_odom_ay; p.imu.leg_odom_a[2] = c.leg_odom_az;
+        p.imu.vel_p[0] = c.vel_px; p.imu.vel_p[1] = c.vel_py; p.imu.vel_p[2] = c.vel_pz;
+        p.imu.mahalanobis_TH = c.mahalanobis_TH;
+        p.com.com_q = c.com_q;
+        p.com.comd_q = c.comd_q;
+        p.com.fd_q = c.fd_q;
+        p.com.com_r = c.com_r;
+        p.com.comdd_r = c.comdd_r;
+        p.contact.LegHighThres = c.LegUpThres;
+        p.contact.LegLowThres = c.LegLowThres;
+        p.contact.StrikingContact = c.StrikingContact;
+        p.contact.VelocityThres = c.VelocityThres;
+        p.contact.prob_TH = c.probabilisticContactThreshold;
+    }
+
+    /** @fn void configFromParams(const EstimatorParams& p, Config& c)
+     *  @brief converts a parameter set to a dynamic reconfigure config (VarianceControlConfig)
+    */
+    template <class Config>
+    void configFromParams(const EstimatorParams &p, Config &c)
+    {
+        c.acc_qx = p.imu.acc_q[0]; c.acc_qy = p.imu.acc_q[1]; c.acc_qz = p.imu.acc_q[2];
+        c.gyr_qx = p.imu.gyr_q[0]; c.gyr_qy = p.imu.gyr_q[1]; c.gyr_qz = p.imu.gyr_q[2];
+        c.accb_qx = p.imu.accb_q[0]; c.accb_qy = p.imu.accb_q[1]; c.accb_qz = p.imu.accb_q[2];
+        c.gyrb_qx = p.imu.gyrb_q[0]; c.gyrb_qy = p.imu.gyrb_q[1]; c.gyrb_qz = p.imu.gyrb_q[2];
+        c.foot_contactx = p.imu.foot_contact[0]; c.foot_contacty = p.imu.foot_contact[1]; c.foot_contactz = p.imu.foot_contact[2];
+        c.odom_px = p.imu.odom_p[0]; c.odom_py = p.imu.odom_p[1]; c.odom_pz = p.imu.odom_p[2];
+        c.odom_ax = p.imu.odom_a[0]; c.odom_ay = p.imu.odom_a[1]; c.odom_az = p.imu.odom_a[2];
+        c.leg_odom_px = p.imu.leg_odom_p[0]; c.leg_odom_py = p.imu.leg_odom_p[1]; c.leg_odom_pz = p.imu.leg_odom_p[2];
+        c.leg_odom_ax = p.imu.leg_odom_a[0]; c.leg_odom_ay = p.imu.leg_odom_a[1]; c.leg_odom_az = p.imu.leg_odom_a[2];
+        c.vel_px = p.imu.vel_p[0]; c.vel_py = p.imu.vel_p[1]; c.vel_pz = p.imu.vel_p[2];
+        c.mahalanobis_TH = p.imu.mahalanobis_TH;
+        c.com_q = p.com.com_q;
+        c.comd_q = p.com.comd_q;
+        c.fd_q = p.com.fd_q;
+        c.com_r = p.com.com_r;
+        c.comdd_r = p.com.comdd_r;
+        c.LegUpThres = p.contact.LegHighThres;
+        c.LegLowThres = p.contact.LegLowThres;
+        c.StrikingContact = p.contact.StrikingContact;
+        c.VelocityThres = p.contact.VelocityThres;
+        c.probabilisticContactThreshold = p.contact.prob_TH;
+    }
+
+    /// Lock-free handoff of complete parameter sets, publish() from the reconfigure thread and fetch()
+    /// from the estimator thread at the start of a cycle, versions published in between are skipped
+    template <typename T>
+    class VersionedParams
+    {
+    private:
+        struct Slot
+        {
+            T values;
+            unsigned long version;
+        };
+        TripleBuffer<Slot> buffer;
+        /// last version handed out, only touched by the writer
+        unsigned long published;
+
+    public:
+        VersionedParams() : published(0)
+        {
+            for (int i = 0; i < 3; i++)
+                buffer.slot(i).version = 0;
+        }
+
+        /** @fn unsigned long publish(const T& values)
+         *  @brief hands a complete parameter set to the reader, returns its version
+        */
+        unsigned long publish(const T &values)
+        {
+            Slot &s = buffer.write();
+            s.values = values;
+            s.version = ++published;
+            buffer.publish();
+            return published;
+        }
+
+        /** @fn bool fetch()
+         *  @brief takes the latest published set, returns false if there is nothing newer than current()
+        */
+        bool fetch()
+        {
+            return buffer.update();
+        }
+
+        /** @fn const T& current() const
+         *  @brief the set taken by the last successful fetch()
+        */
+        const T &current() const
+        {
+            return buffer.read().values;
+        }
+
+        /** @fn unsigned long version() const
+         *  @brief version of current(), 0 before the first fetch()
+        */
+        unsigned long version() const
+        {
+            return buffer.read().version;
+        }
+    };
+} // namespace serow
+#endif
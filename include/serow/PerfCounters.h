@@ -0,0 +1,310 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Hardware performance counters per estimator stage
+ * @author Stylianos Piperakis
+ * @details counts cycles, instructions, L1 data and last level cache misses and branch misses of the calling
+ * thread with perf_event_open, accumulated per stage; counters the kernel or the CPU do not provide are skipped
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <stdint.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace serow
+{
+    class PerfCounters
+    {
+    public:
+        enum Counter
+        {
+            Cycles,
+            Instructions,
+            L1DMisses,
+            LLCMisses,
+            BranchMisses,
+            NumCounters
+        };
+        static const int MaxStages = 16;
+
+    private:
+        ///file descriptors in group order, -1 if the counter could not be opened
+        int fd[NumCounters];
+        ///position of each counter in the group read, -1 if not in the group
+        int slot[NumCounters];
+        int numOpen;
+        std::atomic<uint64_t> sums[MaxStages][NumCounters];
+        std::atomic<uint64_t> calls[MaxStages];
+        std::string names[MaxStages];
+        int numStages;
+
+        struct GroupRead
+        {
+            uint64_t nr;
+            uint64_t values[NumCounters];
+        };
+
+#ifdef __linux__
+        static int openCounter(uint32_t type, uint64_t config, int group)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = group == -1 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+        }
+#endif
+
+    public:
+        PerfCounters() : numOpen(0), numStages(0)
+        {
+            for (int c = 0; c < NumCounters; c++)
+            {
+                fd[c] = -1;
+                slot[c] = -1;
+            }
+            reset();
+        }
+
+        ~PerfCounters()
+        {
+            close();
+        }
+
+        /** @fn bool open()
+         *  @brief opens the counters for the calling thread, only that thread may call read() afterwards
+         *  @return false if no counter is available (no PMU access, perf_event_paranoid, containers)
+        */
+        bool open()
+        {
+#ifdef __linux__
+            close();
+            const uint32_t types[NumCounters] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+            const uint64_t configs[NumCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            int leader = -1;
+            for (int c = 0; c < NumCounters; c++)
+            {
+                fd[c] = openCounter(types[c], configs[c], leader);
+                if (fd[c] < 0)
+                {
+                    fd[c] = -1;
+                    continue;
+                }
+                if (leader == -1)
+                    leader = fd[c];
+                slot[c] = numOpen++;
+            }
+            if (leader == -1)
+                return false;
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void close()
+        {
+#ifdef __linux__
+            for (int c = 0; c < NumCounters; c++)
+            {
+                if (fd[c] >= 0)
+                    ::close(fd[c]);
+                fd[c] = -1;
+                slot[c] = -1;
+            }
+#endif
+            numOpen = 0;
+        }
+
+        bool available() const
+        {
+            return numOpen > 0;
+        }
+
+        bool available(Counter c) const
+        {
+            return slot[c] >= 0;
+        }
+
+        /** @fn bool read(uint64_t *values)
+         *  @brief reads all open counters with one syscall, values of unavailable counters are left at 0
+        */
+        bool read(uint64_t *values)
+        {
+            for (int c = 0; c < NumCounters; c++)
+                values[c] = 0;
+#ifdef __linux__
+            if (!numOpen)
+                return false;
+            GroupRead g;
+            int leader = -1;
+            for (int c = 0; c < NumCounters && leader == -1; c++)
+                leader = fd[c];
+            if (::read(leader, &g, sizeof(uint64_t) * (1 + numOpen)) <= 0)
+                return false;
+            for (int c = 0; c < NumCounters; c++)
+                if (slot[c] >= 0)
+                    values[c] = g.values[slot[c]];
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void setStageName(int stage, const std::string &name)
+        {
+            if (stage < 0 || stage >= MaxStages)
+                return;
+            names[stage] = name;
+            if (stage >= numStages)
+                numStages = stage + 1;
+        }
+
+        void accumulate(int stage, const uint64_t *start, const uint64_t *end)
+        {
+            for (int c = 0; c < NumCounters; c++)
+                sums[stage][c].fetch_add(end[c] - start[c], std::memory_order_relaxed);
+            calls[stage].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t stageCalls(int stage) const
+        {
+            return calls[stage].load(std::memory_order_relaxed);
+        }
+
+        /** @fn double perCall(int stage, Counter c) const
+         *  @brief mean count of counter c per call of the stage
+        */
+        double perCall(int stage, Counter c) const
+        {
+            uint64_t n = stageCalls(stage);
+            return n ? (double)sums[stage][c].load(std::memory_order_relaxed) / n : 0.0;
+        }
+
+        /** @fn double ipc(int stage) const
+         *  @brief instructions per cycle of the stage, 0 if either counter is unavailable
+        */
+        double ipc(int stage) const
+        {
+            double cycles = perCall(stage, Cycles);
+            return cycles > 0 ? perCall(stage, Instructions) / cycles : 0.0;
+        }
+
+        void reset()
+        {
+            for (int s = 0; s < MaxStages; s++)
+            {
+                calls[s].store(0, std::memory_order_relaxed);
+                for (int c = 0; c < NumCounters; c++)
+                    sums[s][c].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /** @fn std::string report() const
+         *  @brief per call means of every stage, n/a for counters that are not available
+        */
+        std::string report() const
+        {
+            const char *counterNames[NumCounters] = {"cycles", "instr", "L1D miss", "LLC miss", "br miss"};
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1);
+            out << std::setw(14) << std::left << "stage" << std::right << std::setw(10) << "calls";
+            for (int c = 0; c < NumCounters; c++)
+                out << std::setw(12) << counterNames[c];
+            out << std::setw(8) << "IPC" << " [per call]" << std::endl;
+            for (int s = 0; s < numStages; s++)
+            {
+                if (names[s].empty() || !stageCalls(s))
+                    continue;
+                out << std::setw(14) << std::left << names[s] << std::right << std::setw(10) << stageCalls(s);
+                for (int c = 0; c < NumCounters; c++)
+                {
+                    if (available((Counter)c))
+                        out << std::setw(12) << perCall(s, (Counter)c);
+                    else
+                        out << std::setw(12) << "n/a";
+                }
+                out << std::setw(8) << std::setprecision(2) << ipc(s) << std::setprecision(1) << std::endl;
+            }
+            return out.str();
+        }
+    };
+
+    /**
+     * @brief Accumulates the counter deltas of the enclosing scope into a stage, does nothing if no counter is open
+     */
+    class ScopedPerfCounters
+    {
+    private:
+        PerfCounters &counters;
+        int stage;
+        bool active;
+        uint64_t start[PerfCounters::NumCounters];
+
+    public:
+        ScopedPerfCounters(PerfCounters &counters_, int stage_) : counters(counters_), stage(stage_), active(counters_.available())
+        {
+            if (active)
+                active = counters.read(start);
+        }
+        ~ScopedPerfCounters()
+        {
+            uint64_t end[PerfCounters::NumCounters];
+            if (active && counters.read(end))
+                counters.accumulate(stage, start, end);
+        }
+    };
+} // namespace serow
+
+#ifdef SEROW_PROFILING
+#define SEROW_PERF_SCOPE(counters, stage) serow::ScopedPerfCounters SEROW_PROFILE_CONCAT(serow_perf_scope_, __LINE__)(counters, stage)
+#else
+#define SEROW_PERF_SCOPE(counters, stage) ((void)0)
+#endif
+#endif
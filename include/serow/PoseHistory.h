@@ -0,0 +1,342 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Time-indexed history of the base estimates with interpolated lookups
+ * @author Stylianos Piperakis
+ * @details the estimator pushes one PoseSample per cycle into a fixed-capacity ring, lookup() finds the two
+ * samples around a stamp by binary search and interpolates the pose on SE(3). The ring is written wait-free
+ * and read under a sequence lock, as SharedEstimate, and can be placed in a POSIX shared memory object so
+ * that readers on the same host query it without messaging (link with -lrt).
+ */
+
+#ifndef POSEHISTORY_H
+#define POSEHISTORY_H
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <eigen3/Eigen/Dense>
+#include "serow/lie.h"
+
+namespace serow
+{
+    /**
+     * @brief One estimate of the history
+     * @details plain data only, the base is in the world frame, the quaternion is w, x, y, z and the
+     * covariances are row-major, the pose ordered x, y, z, roll, pitch, yaw and the twist linear then angular
+     */
+    struct PoseSample
+    {
+        ///Stamp of the IMU measurement the estimate was computed from, nanoseconds of ROS time
+        int64_t stamp_ns;
+        double pos[3], q[4], vel[3], omega[3];
+        double pose_cov[36], twist_cov[36];
+    };
+
+    /**
+     * @brief Header of the ring, followed by capacity samples
+     */
+    struct PoseHistoryHeader
+    {
+        static const uint32_t Magic = 0x53524f48; //"SROH"
+        static const uint32_t Version = 1;
+        uint32_t magic, version, capacity, sample_size;
+        ///odd while the writer is updating a sample
+        alignas(64) std::atomic<uint64_t> seq;
+        ///Samples pushed so far, the latest is in slot (count - 1) % capacity
+        std::atomic<uint64_t> count;
+    };
+
+    class PoseHistory
+    {
+    public:
+        enum LookupResult
+        {
+            ///out is interpolated between the two samples around the stamp, or is the sample at the stamp
+            Found = 0,
+            ///nothing was pushed yet
+            Empty,
+            ///the stamp is older than the oldest sample, out is the oldest sample
+            BeforeHistory,
+            ///the stamp is newer than the latest sample, out is the latest sample
+            AfterHistory
+        };
+
+    private:
+        PoseHistoryHeader *header;
+        PoseSample *samples;
+        std::size_t mappedSize;
+        bool writable;
+        std::string name;
+
+        static std::size_t samplesOffset()
+        {
+            return (sizeof(PoseHistoryHeader) + 63) & ~std::size_t(63);
+        }
+
+        static std::size_t segmentSize(std::size_t capacity)
+        {
+            return samplesOffset() + capacity * sizeof(PoseSample);
+        }
+
+        void map(void *p, std::size_t size)
+        {
+            mappedSize = size;
+            header = static_cast<PoseHistoryHeader *>(p);
+            samples = reinterpret_cast<PoseSample *>(static_cast<char *>(p) + samplesOffset());
+        }
+
+        /** @fn LookupResult search(int64_t stamp_ns, PoseSample &a, PoseSample &b) const
+         *  @brief copies the samples around stamp_ns under the sequence lock, a == b when a single sample is returned
+        */
+        LookupResult search(int64_t stamp_ns, PoseSample &a, PoseSample &b) const
+        {
+            const uint64_t capacity = header->capacity;
+            for (;;)
+            {
+                const uint64_t s0 = header->seq.load(std::memory_order_acquire);
+                if (s0 & 1)
+                    continue;
+                const uint64_t count = header->count.load(std::memory_order_relaxed);
+                if (count == 0)
+                    return Empty;
+                const uint64_t first = count > capacity ? count - capacity : 0;
+                LookupResult r = Found;
+                uint64_t lo = first, hi = count - 1;
+                if (stamp_ns <= samples[lo % capacity].stamp_ns)
+                {
+                    r = stamp_ns < samples[lo % capacity].stamp_ns ? BeforeHistory : Found;
+                    hi = lo;
+                }
+                else if (stamp_ns >= samples[hi % capacity].stamp_ns)
+                {
+                    r = stamp_ns > samples[hi % capacity].stamp_ns ? AfterHistory : Found;
+                    lo = hi;
+                }
+                else
+                {
+                    //samples[lo] < stamp < samples[hi]
+                    while (hi - lo > 1)
+                    {
+                        const uint64_t mid = lo + (hi - lo) / 2;
+                        if (samples[mid % capacity].stamp_ns <= stamp_ns)
+                            lo = mid;
+                        else
+                            hi = mid;
+                    }
+                }
+                std::memcpy(&a, &samples[lo % capacity], sizeof(PoseSample));
+                std::memcpy(&b, &samples[hi % capacity], sizeof(PoseSample));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (header->seq.load(std::memory_order_relaxed) == s0)
+                    return r;
+            }
+        }
+
+    public:
+        PoseHistory() : header(NULL), samples(NULL), mappedSize(0), writable(false) {}
+        ~PoseHistory()
+        {
+            close();
+        }
+
+        /** @fn bool create(std::size_t capacity, const std::string &name_ = "")
+         *  @brief allocates a ring of capacity samples for the writer, in the shared memory object name_
+         *  (e.g. "/serow_pose_history") when given, otherwise in private memory
+        */
+        bool create(std::size_t capacity, const std::string &name_ = "")
+        {
+            close();
+            if (capacity < 2)
+                return false;
+            const std::size_t size = segmentSize(capacity);
+            void *p;
+            if (name_.empty())
+            {
+                p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            }
+            else
+            {
+                int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+                if (fd < 0)
+                    return false;
+                if (ftruncate(fd, size) < 0)
+                {
+                    ::close(fd);
+                    return false;
+                }
+                p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+            }
+            if (p == MAP_FAILED)
+                return false;
+            map(p, size);
+            writable = true;
+            name = name_;
+            //readers ignore the segment until the header is complete
+            header->magic = 0;
+            header->seq.store(0, std::memory_order_relaxed);
+            header->count.store(0, std::memory_order_relaxed);
+            header->version = PoseHistoryHeader::Version;
+            header->capacity = capacity;
+            header->sample_size = sizeof(PoseSample);
+            std::atomic_thread_fence(std::memory_order_release);
+            header->magic = PoseHistoryHeader::Magic;
+            return true;
+        }
+
+        /** @fn bool attach(const std::string &name_)
+         *  @brief maps the history of a running estimator read-only, fails if it does not exist or has another layout
+        */
+        bool attach(const std::string &name_)
+        {
+            close();
+            int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) < 0 || st.st_size < (off_t)samplesOffset())
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            map(p, st.st_size);
+            if (header->magic != PoseHistoryHeader::Magic || header->version != PoseHistoryHeader::Version ||
+                header->sample_size != sizeof(PoseSample) || segmentSize(header->capacity) > mappedSize)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        bool isOpen() const
+        {
+            return header != NULL;
+        }
+
+        std::size_t capacity() const
+        {
+            return header ? header->capacity : 0;
+        }
+
+        /** @fn bool push(const PoseSample &s)
+         *  @brief appends s over the oldest sample, wait-free, stamps must increase so older or repeated ones are dropped
+        */
+        bool push(const PoseSample &s)
+        {
+            if (!writable)
+                return false;
+            const uint64_t count = header->count.load(std::memory_order_relaxed);
+            if (count > 0 && s.stamp_ns <= samples[(count - 1) % header->capacity].stamp_ns)
+                return false;
+            const uint64_t seq = header->seq.load(std::memory_order_relaxed);
+            header->seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&samples[count % header->capacity], &s, sizeof(PoseSample));
+            header->count.store(count + 1, std::memory_order_relaxed);
+            header->seq.store(seq + 2, std::memory_order_release);
+            return true;
+        }
+
+        /** @fn LookupResult lookup(int64_t stamp_ns, PoseSample &out) const
+         *  @brief estimate at stamp_ns, O(log n) and without locks, see LookupResult for the samples returned
+        */
+        LookupResult lookup(int64_t stamp_ns, PoseSample &out) const
+        {
+            if (!header)
+                return Empty;
+            PoseSample b;
+            LookupResult r = search(stamp_ns, out, b);
+            if (r == Found && b.stamp_ns != out.stamp_ns)
+                interpolate(out, b, double(stamp_ns - out.stamp_ns) / double(b.stamp_ns - out.stamp_ns), out);
+            return r;
+        }
+
+        /** @fn static void interpolate(const PoseSample &a, const PoseSample &b, double s, PoseSample &out)
+         *  @brief pose on the SE(3) geodesic a exp(s log(a^-1 b)), twist and covariances linearly, out may alias a or b
+        */
+        static void interpolate(const PoseSample &a, const PoseSample &b, double s, PoseSample &out)
+        {
+            typedef Eigen::Map<const Eigen::Vector3d> CVec3;
+            typedef Eigen::Map<const Eigen::Matrix<double, 36, 1> > CVec36;
+            const Eigen::Matrix3d Ra = Eigen::Quaterniond(a.q[0], a.q[1], a.q[2], a.q[3]).normalized().toRotationMatrix();
+            const Eigen::Matrix3d Rb = Eigen::Quaterniond(b.q[0], b.q[1], b.q[2], b.q[3]).normalized().toRotationMatrix();
+            Eigen::Matrix4d Tab = Eigen::Matrix4d::Identity();
+            Tab.topLeftCorner<3, 3>().noalias() = Ra.transpose() * Rb;
+            Tab.topRightCorner<3, 1>().noalias() = Ra.transpose() * (CVec3(b.pos) - CVec3(a.pos));
+            const Eigen::Matrix<double, 6, 1> xi = s * lie::logSEK3(Tab);
+            const Eigen::Matrix4d Ts = lie::expSEK3(xi);
+
+            const Eigen::Vector3d p = CVec3(a.pos) + Ra * Ts.topRightCorner<3, 1>();
+            const Eigen::Quaterniond q(Eigen::Matrix3d(Ra * Ts.topLeftCorner<3, 3>()));
+            const int64_t stamp_ns = a.stamp_ns + int64_t(s * double(b.stamp_ns - a.stamp_ns));
+            const Eigen::Vector3d v = (1.0 - s) * CVec3(a.vel) + s * CVec3(b.vel);
+            const Eigen::Vector3d w = (1.0 - s) * CVec3(a.omega) + s * CVec3(b.omega);
+            const Eigen::Matrix<double, 36, 1> Pp = (1.0 - s) * CVec36(a.pose_cov) + s * CVec36(b.pose_cov);
+            const Eigen::Matrix<double, 36, 1> Pt = (1.0 - s) * CVec36(a.twist_cov) + s * CVec36(b.twist_cov);
+
+            out.stamp_ns = stamp_ns;
+            Eigen::Map<Eigen::Vector3d>(out.pos) = p;
+            out.q[0] = q.w();
+            out.q[1] = q.x();
+            out.q[2] = q.y();
+            out.q[3] = q.z();
+            Eigen::Map<Eigen::Vector3d>(out.vel) = v;
+            Eigen::Map<Eigen::Vector3d>(out.omega) = w;
+            Eigen::Map<Eigen::Matrix<double, 36, 1> >(out.pose_cov) = Pp;
+            Eigen::Map<Eigen::Matrix<double, 36, 1> >(out.twist_cov) = Pt;
+        }
+
+        /** @fn void close(bool unlink = false)
+         *  @brief unmaps the ring, unlinking a shared one removes the name so that readers can not attach any more
+        */
+        void close(bool unlink = false)
+        {
+            if (!header)
+                return;
+            munmap(header, mappedSize);
+            header = NULL;
+            samples = NULL;
+            if (unlink && writable && !name.empty())
+                shm_unlink(name.c_str());
+            writable = false;
+        }
+    };
+} // namespace serow
+#endif
@@ -0,0 +1,175 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Real-time configuration of the estimator and publisher threads
+ * @author Stylianos Piperakis
+ * @details scheduling policy and priority, CPU affinity and memory locking with stack prefaulting,
+ * every call returns whether it was applied and a one line report, lacking privileges is not an error
+ */
+
+#ifndef REALTIMETHREAD_H
+#define REALTIMETHREAD_H
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <alloca.h>
+#endif
+
+namespace serow
+{
+    /** @fn bool setThreadScheduling(const std::string &policy, int priority, std::string &report)
+     *  @brief sets the scheduling policy ("other", "fifo" or "rr") and priority of the calling thread
+    */
+    inline bool setThreadScheduling(const std::string &policy, int priority, std::string &report)
+    {
+        std::ostringstream os;
+        os << "scheduling " << policy;
+#ifdef __linux__
+        int p = SCHED_OTHER;
+        if (policy == "fifo")
+            p = SCHED_FIFO;
+        else if (policy == "rr")
+            p = SCHED_RR;
+        else if (policy != "other")
+        {
+            os << ": unknown policy, kept the default";
+            report = os.str();
+            return false;
+        }
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        if (p != SCHED_OTHER)
+        {
+            int pmin = sched_get_priority_min(p), pmax = sched_get_priority_max(p);
+            param.sched_priority = priority < pmin ? pmin : (priority > pmax ? pmax : priority);
+            os << " priority " << param.sched_priority;
+        }
+        int err = pthread_setschedparam(pthread_self(), p, &param);
+        if (err)
+        {
+            os << ": not applied (" << std::strerror(err) << ")";
+            if (err == EPERM)
+                os << ", needs CAP_SYS_NICE or an rtprio limit in /etc/security/limits.conf";
+            report = os.str();
+            return false;
+        }
+        os << ": applied";
+        report = os.str();
+        return true;
+#else
+        os << ": not supported on this platform";
+        report = os.str();
+        return false;
+#endif
+    }
+
+    /** @fn bool setThreadAffinity(const std::vector<int> &cpus, std::string &report)
+     *  @brief pins the calling thread to the given CPUs, an empty list leaves the affinity untouched
+    */
+    inline bool setThreadAffinity(const std::vector<int> &cpus, std::string &report)
+    {
+        std::ostringstream os;
+        os << "affinity";
+        if (cpus.empty())
+        {
+            os << ": any CPU";
+            report = os.str();
+            return true;
+        }
+        for (unsigned int i = 0; i < cpus.size(); i++)
+            os << (i ? "," : " ") << cpus[i];
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned int i = 0; i < cpus.size(); i++)
+            if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+                CPU_SET(cpus[i], &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err)
+        {
+            os << ": not applied (" << std::strerror(err) << ")";
+            report = os.str();
+            return false;
+        }
+        os << ": applied";
+        report = os.str();
+        return true;
+#else
+        os << ": not supported on this platform";
+        report = os.str();
+        return false;
+#endif
+    }
+
+    /** @fn bool lockProcessMemory(unsigned long stackPrefault, std::string &report)
+     *  @brief locks the current and future pages of the process in RAM, keeps malloc from returning memory to
+     *  the system and touches stackPrefault bytes of the calling thread's stack so that they are resident
+    */
+    inline bool lockProcessMemory(unsigned long stackPrefault, std::string &report)
+    {
+        std::ostringstream os;
+        os << "mlockall";
+#ifdef __linux__
+        if (mlockall(MCL_CURRENT | MCL_FUTURE))
+        {
+            os << ": not applied (" << std::strerror(errno) << ")";
+            if (errno == EPERM || errno == ENOMEM)
+                os << ", needs CAP_IPC_LOCK or a larger memlock limit";
+            report = os.str();
+            return false;
+        }
+        //freed memory stays mapped and locked, large blocks do not get their own mmap
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        if (stackPrefault > 0)
+        {
+            volatile unsigned char *stack = (volatile unsigned char *)alloca(stackPrefault);
+            for (unsigned long i = 0; i < stackPrefault; i += 4096)
+                stack[i] = 0;
+            os << ", prefaulted " << stackPrefault / 1024 << " KiB of stack";
+        }
+        os << ": applied";
+        report = os.str();
+        return true;
+#else
+        (void)stackPrefault;
+        os << ": not supported on this platform";
+        report = os.str();
+        return false;
+#endif
+    }
+} // namespace serow
+#endif
@@ -0,0 +1,257 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Shared memory output channel of the latest estimate
+ * @author Stylianos Piperakis
+ * @details the estimator writes a fixed layout SharedEstimate to a POSIX shared memory object every cycle,
+ * readers on the same host copy it out under a sequence lock, without system calls or locks, a read
+ * that overlaps a write is retried. Include this header and link with -lrt to read the channel.
+ */
+
+#ifndef SHAREDESTIMATE_H
+#define SHAREDESTIMATE_H
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace serow
+{
+    /**
+     * @brief Latest estimate as laid out in shared memory
+     * @details plain data only, quaternions are stored w, x, y, z, legs are ordered LLeg, RLeg
+     * for humanoids and LF, LH, RF, RH for quadrupeds
+     */
+    struct SharedEstimate
+    {
+        static const int MaxLegs = 4;
+        ///Estimator cycle counter
+        uint64_t cycle;
+        ///Time of the estimate and of the IMU measurement it was computed from, nanoseconds of ROS time
+        int64_t stamp_ns, sensor_stamp_ns;
+        ///Base in the world frame
+        double base_pos[3], base_q[4], base_vel[3], base_omega[3], base_acc[3];
+        ///Center of mass in the world frame, valid when com_valid is set
+        double com_pos[3], com_vel[3];
+        int32_t com_valid;
+        ///Contact state per leg
+        int32_t num_legs;
+        int32_t contact[MaxLegs];
+        double contact_prob[MaxLegs];
+        ///Index of the support leg, -1 when unknown
+        int32_t support_leg;
+        ///Degradation level of the deadline governor
+        int32_t degradation;
+    };
+
+    /**
+     * @brief Header and payload of the shared memory object
+     */
+    struct SharedEstimateSegment
+    {
+        static const uint32_t Magic = 0x53524f57; //"SROW"
+        static const uint32_t Version = 1;
+        uint32_t magic, version, size, reserved;
+        ///odd while the writer is updating the payload
+        alignas(64) std::atomic<uint64_t> seq;
+        alignas(64) SharedEstimate payload;
+    };
+
+    /**
+     * @brief Creates the shared memory object and writes estimates into it, single writer
+     */
+    class SharedEstimateWriter
+    {
+    private:
+        SharedEstimateSegment *segment;
+        std::string name;
+
+    public:
+        SharedEstimateWriter() : segment(NULL) {}
+        ~SharedEstimateWriter()
+        {
+            close();
+        }
+
+        /** @fn bool open(const std::string &name_)
+         *  @brief creates or reuses the shared memory object name_ (e.g. "/serow_estimate")
+        */
+        bool open(const std::string &name_)
+        {
+            close();
+            int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+            if (fd < 0)
+                return false;
+            if (ftruncate(fd, sizeof(SharedEstimateSegment)) < 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, sizeof(SharedEstimateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            segment = static_cast<SharedEstimateSegment *>(p);
+            //readers ignore the segment until the header is complete
+            segment->magic = 0;
+            segment->seq.store(0, std::memory_order_relaxed);
+            segment->version = SharedEstimateSegment::Version;
+            segment->size = sizeof(SharedEstimate);
+            std::atomic_thread_fence(std::memory_order_release);
+            segment->magic = SharedEstimateSegment::Magic;
+            name = name_;
+            return true;
+        }
+
+        bool isOpen() const
+        {
+            return segment != NULL;
+        }
+
+        /** @fn void write(const SharedEstimate &e)
+         *  @brief publishes e to the readers, wait-free
+        */
+        void write(const SharedEstimate &e)
+        {
+            if (!segment)
+                return;
+            uint64_t s = segment->seq.load(std::memory_order_relaxed);
+            segment->seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&segment->payload, &e, sizeof(SharedEstimate));
+            segment->seq.store(s + 2, std::memory_order_release);
+        }
+
+        /** @fn void close(bool unlink = false)
+         *  @brief unmaps the channel, unlinking it removes the name so that readers can not attach any more
+        */
+        void close(bool unlink = false)
+        {
+            if (!segment)
+                return;
+            munmap(segment, sizeof(SharedEstimateSegment));
+            segment = NULL;
+            if (unlink)
+                shm_unlink(name.c_str());
+        }
+    };
+
+    /**
+     * @brief Attaches to the channel of a running estimator and copies out the latest estimate
+     */
+    class SharedEstimateReader
+    {
+    private:
+        const SharedEstimateSegment *segment;
+
+    public:
+        SharedEstimateReader() : segment(NULL) {}
+        ~SharedEstimateReader()
+        {
+            close();
+        }
+
+        /** @fn bool open(const std::string &name)
+         *  @brief maps the shared memory object name read-only, fails if it does not exist or has another layout
+        */
+        bool open(const std::string &name)
+        {
+            close();
+            int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SharedEstimateSegment))
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, sizeof(SharedEstimateSegment), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            segment = static_cast<const SharedEstimateSegment *>(p);
+            if (segment->magic != SharedEstimateSegment::Magic || segment->version != SharedEstimateSegment::Version ||
+                segment->size != sizeof(SharedEstimate))
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        bool isOpen() const
+        {
+            return segment != NULL;
+        }
+
+        /** @fn bool read(SharedEstimate &e) const
+         *  @brief copies the latest estimate to e, returns false until the estimator has written one
+        */
+        bool read(SharedEstimate &e) const
+        {
+            if (!segment)
+                return false;
+            for (;;)
+            {
+                uint64_t s0 = segment->seq.load(std::memory_order_acquire);
+                if (s0 == 0)
+                    return false;
+                if (s0 & 1)
+                    continue;
+                std::memcpy(&e, &segment->payload, sizeof(SharedEstimate));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (segment->seq.load(std::memory_order_relaxed) == s0)
+                    return true;
+            }
+        }
+
+        /** @fn uint64_t sequence() const
+         *  @brief write counter of the channel, changes when a new estimate is available
+        */
+        uint64_t sequence() const
+        {
+            return segment ? segment->seq.load(std::memory_order_acquire) / 2 : 0;
+        }
+
+        void close()
+        {
+            if (!segment)
+                return;
+            munmap(const_cast<SharedEstimateSegment *>(segment), sizeof(SharedEstimateSegment));
+            segment = NULL;
+        }
+    };
+} // namespace serow
+#endif
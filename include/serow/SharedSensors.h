@@ -0,0 +1,353 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Shared memory sensor input ring
+ * @author Stylianos Piperakis
+ * @details a robot middleware that already holds IMU, joint and foot wrench data in shared memory writes
+ * one SharedSensorFrame per IMU sample into a single producer ring, the estimator drains the frames it has
+ * not seen yet every loop. Slots carry their own sequence number so that a reader lapped by the writer
+ * detects the overwritten frames and skips them instead of reading torn data.
+ */
+
+#ifndef SHAREDSENSORS_H
+#define SHAREDSENSORS_H
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace serow
+{
+    /**
+     * @brief One sensor sample as laid out in shared memory
+     * @details wrenches are ordered LLeg, RLeg for humanoids and LF, LH, RF, RH for quadrupeds and are
+     * expressed in the F/T sensor frames, like the ROS topics they replace
+     */
+    struct SharedSensorFrame
+    {
+        static const int MaxJoints = 64;
+        static const int MaxWrenches = 4;
+        enum Parts
+        {
+            HasImu = 1,
+            HasJoints = 2,
+            HasWrenches = 4
+        };
+        ///Sensor time, nanoseconds of ROS time
+        int64_t stamp_ns;
+        ///Parts of the frame that carry new data
+        uint32_t parts;
+        int32_t num_joints, num_wrenches;
+        double gyro[3], acc[3];
+        double joint_pos[MaxJoints], joint_vel[MaxJoints];
+        double force[MaxWrenches][3], torque[MaxWrenches][3];
+    };
+
+    struct SharedSensorSlot
+    {
+        ///2 * frame index + 2 once the frame is complete, odd while it is written
+        alignas(64) std::atomic<uint64_t> seq;
+        SharedSensorFrame frame;
+    };
+
+    /**
+     * @brief Header of the ring, followed by capacity slots
+     */
+    struct SharedSensorHeader
+    {
+        static const uint32_t Magic = 0x53524f49; //"SROI"
+        static const uint32_t Version = 1;
+        static const int NameLength = 64;
+        uint32_t magic, version, frame_size, capacity;
+        int32_t num_joints;
+        ///incremented by every writer that (re)creates the ring, attached readers detach when it changes
+        uint32_t generation;
+        ///joint names in the order of SharedSensorFrame::joint_pos
+        char joint_names[SharedSensorFrame::MaxJoints][NameLength];
+        ///frames written so far
+        alignas(64) std::atomic<uint64_t> head;
+    };
+
+    inline size_t sharedSensorSegmentSize(uint32_t capacity)
+    {
+        return sizeof(SharedSensorHeader) + capacity * sizeof(SharedSensorSlot);
+    }
+
+    /**
+     * @brief Producer side of the ring, the robot middleware or a stand-in writer
+     */
+    class SharedSensorWriter
+    {
+    private:
+        SharedSensorHeader *header;
+        SharedSensorSlot *slots;
+        uint32_t capacity;
+        std::string name;
+
+    public:
+        SharedSensorWriter() : header(NULL), slots(NULL), capacity(0) {}
+        ~SharedSensorWriter()
+        {
+            close();
+        }
+
+        /** @fn bool open(const std::string &name_, const std::vector<std::string> &joint_names, uint32_t capacity_ = 256)
+         *  @brief creates the ring name_ (e.g. "/serow_sensors") for frames with the given joints
+        */
+        bool open(const std::string &name_, const std::vector<std::string> &joint_names, uint32_t capacity_ = 256)
+        {
+            close();
+            if (capacity_ == 0 || joint_names.size() > (size_t)SharedSensorFrame::MaxJoints)
+                return false;
+            int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+            if (fd < 0)
+                return false;
+            //a restarted writer invalidates the ring it finds before resizing it
+            uint32_t generation = 1;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SharedSensorHeader))
+            {
+                void *old = mmap(NULL, sizeof(SharedSensorHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (old != MAP_FAILED)
+                {
+                    SharedSensorHeader *h = static_cast<SharedSensorHeader *>(old);
+                    if (h->magic == SharedSensorHeader::Magic)
+                        generation = h->generation + 1;
+                    h->magic = 0;
+                    munmap(old, sizeof(SharedSensorHeader));
+                }
+            }
+            size_t size = sharedSensorSegmentSize(capacity_);
+            if (ftruncate(fd, size) < 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            header = static_cast<SharedSensorHeader *>(p);
+            slots = reinterpret_cast<SharedSensorSlot *>(header + 1);
+            capacity = capacity_;
+            //readers ignore the ring until the header is complete
+            header->magic = 0;
+            header->version = SharedSensorHeader::Version;
+            header->frame_size = sizeof(SharedSensorFrame);
+            header->capacity = capacity;
+            header->num_joints = joint_names.size();
+            header->generation = generation;
+            std::memset(header->joint_names, 0, sizeof(header->joint_names));
+            for (unsigned int i = 0; i < joint_names.size(); i++)
+                std::strncpy(header->joint_names[i], joint_names[i].c_str(), SharedSensorHeader::NameLength - 1);
+            for (uint32_t i = 0; i < capacity; i++)
+                slots[i].seq.store(0, std::memory_order_relaxed);
+            header->head.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            header->magic = SharedSensorHeader::Magic;
+            name = name_;
+            return true;
+        }
+
+        bool isOpen() const
+        {
+            return header != NULL;
+        }
+
+        /** @fn void write(const SharedSensorFrame &f)
+         *  @brief appends f to the ring, wait-free, overwrites the oldest frame when the ring is full
+        */
+        void write(const SharedSensorFrame &f)
+        {
+            if (!header)
+                return;
+            uint64_t h = header->head.load(std::memory_order_relaxed);
+            SharedSensorSlot &s = slots[h % capacity];
+            s.seq.store(2 * h + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&s.frame, &f, sizeof(SharedSensorFrame));
+            s.seq.store(2 * h + 2, std::memory_order_release);
+            header->head.store(h + 1, std::memory_order_release);
+        }
+
+        void close(bool unlink = false)
+        {
+            if (!header)
+                return;
+            munmap(header, sharedSensorSegmentSize(capacity));
+            header = NULL;
+            slots = NULL;
+            if (unlink)
+                shm_unlink(name.c_str());
+        }
+    };
+
+    /**
+     * @brief Consumer side of the ring, used by the estimator
+     */
+    class SharedSensorReader
+    {
+    private:
+        const SharedSensorHeader *header;
+        const SharedSensorSlot *slots;
+        uint32_t capacity, generation;
+        ///bytes mapped, the segment size when it was opened
+        size_t mapped;
+        uint64_t next, dropped;
+
+    public:
+        SharedSensorReader() : header(NULL), slots(NULL), capacity(0), generation(0), mapped(0), next(0), dropped(0) {}
+        ~SharedSensorReader()
+        {
+            close();
+        }
+
+        /** @fn bool open(const std::string &name)
+         *  @brief attaches to the ring name, reading starts with the next frame written
+        */
+        bool open(const std::string &name)
+        {
+            close();
+            int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SharedSensorHeader))
+            {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            header = static_cast<const SharedSensorHeader *>(p);
+            capacity = header->capacity;
+            if (header->magic != SharedSensorHeader::Magic || header->version != SharedSensorHeader::Version ||
+                header->frame_size != sizeof(SharedSensorFrame) || capacity == 0 ||
+                (off_t)sharedSensorSegmentSize(capacity) > st.st_size)
+            {
+                munmap(const_cast<SharedSensorHeader *>(header), st.st_size);
+                header = NULL;
+                return false;
+            }
+            slots = reinterpret_cast<const SharedSensorSlot *>(header + 1);
+            generation = header->generation;
+            mapped = st.st_size;
+            next = header->head.load(std::memory_order_acquire);
+            return true;
+        }
+
+        bool isOpen() const
+        {
+            return header != NULL;
+        }
+
+        int numJoints() const
+        {
+            return header ? header->num_joints : 0;
+        }
+
+        std::string jointName(int i) const
+        {
+            return std::string(header->joint_names[i]);
+        }
+
+        /** @fn bool poll(SharedSensorFrame &f)
+         *  @brief copies the oldest unread frame to f, returns false when the reader is up to date
+         *  @details a writer restart detaches the reader, isOpen() turns false and open() attaches to the new ring
+        */
+        bool poll(SharedSensorFrame &f)
+        {
+            if (!header)
+                return false;
+            if (header->magic != SharedSensorHeader::Magic || header->generation != generation)
+            {
+                close();
+                return false;
+            }
+            for (;;)
+            {
+                uint64_t head = header->head.load(std::memory_order_acquire);
+                //the head went back, a writer restarted the ring without a new generation
+                if (head < next)
+                {
+                    close();
+                    return false;
+                }
+                if (next == head)
+                    return false;
+                //lapped by the writer, continue with the oldest frame still in the ring
+                if (head - next > capacity)
+                {
+                    dropped += head - capacity - next;
+                    next = head - capacity;
+                }
+                const SharedSensorSlot &s = slots[next % capacity];
+                uint64_t s0 = s.seq.load(std::memory_order_acquire);
+                if (s0 == 2 * next + 2)
+                {
+                    std::memcpy(&f, &s.frame, sizeof(SharedSensorFrame));
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s.seq.load(std::memory_order_relaxed) == s0)
+                    {
+                        next++;
+                        return true;
+                    }
+                }
+                //overwritten while reading
+                dropped++;
+                next++;
+            }
+        }
+
+        /** @fn uint64_t droppedFrames() const
+         *  @brief frames the writer overwrote before they were read, summed over re-attachments
+        */
+        uint64_t droppedFrames() const
+        {
+            return dropped;
+        }
+
+        void close()
+        {
+            if (!header)
+                return;
+            munmap(const_cast<SharedSensorHeader *>(header), mapped);
+            header = NULL;
+            slots = NULL;
+        }
+    };
+} // namespace serow
+#endif
@@ -0,0 +1,258 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Low overhead per-stage timing
+ * @author Stylianos Piperakis
+ * @details monotonic clock scoped timers feeding lock-free log-linear (HDR style) latency histograms,
+ * the SEROW_PROFILE_* macros compile to nothing unless SEROW_PROFILING is defined
+ */
+
+#ifndef STAGEPROFILER_H
+#define STAGEPROFILER_H
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <stdint.h>
+
+namespace serow
+{
+    /** @fn uint64_t monotonicNs()
+     *  @brief nanoseconds of the monotonic clock, unaffected by wall clock or simulated time
+    */
+    inline uint64_t monotonicNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Log-linear histogram of nanosecond values
+     * @details values below 2^SubBits get exact buckets, every further power of two is split in 2^SubBits
+     * buckets, so the relative error of a quantile is below 1/2^SubBits (~6%) over the full 64 bit range.
+     * Recording is wait-free and never allocates.
+     */
+    class LatencyHistogram
+    {
+    private:
+        static const int SubBits = 4;
+        static const int SubCount = 1 << SubBits;
+        static const int NumBuckets = (64 - SubBits + 1) << SubBits;
+        std::atomic<uint64_t> counts[NumBuckets];
+        std::atomic<uint64_t> total, sum, maximum;
+
+        static int bucket(uint64_t v)
+        {
+            if (v < (uint64_t)SubCount)
+                return (int)v;
+            int msb = 63 - __builtin_clzll(v);
+            int shift = msb - SubBits;
+            return ((shift + 1) << SubBits) + (int)((v >> shift) & (SubCount - 1));
+        }
+
+        static uint64_t bucketUpperBound(int idx)
+        {
+            if (idx < SubCount)
+                return idx;
+            int shift = (idx >> SubBits) - 1;
+            uint64_t lower = (uint64_t)(SubCount + (idx & (SubCount - 1))) << shift;
+            return lower + ((uint64_t)1 << shift) - 1;
+        }
+
+    public:
+        LatencyHistogram()
+        {
+            reset();
+        }
+
+        /** @fn void record(uint64_t ns)
+         *  @brief adds one value, safe to call concurrently with readers
+        */
+        void record(uint64_t ns)
+        {
+            counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t m = maximum.load(std::memory_order_relaxed);
+            while (ns > m && !maximum.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+                ;
+        }
+
+        /** @fn uint64_t percentile(double p) const
+         *  @brief upper bound of the bucket holding the p-th percentile (p in [0,100]), 0 if empty
+        */
+        uint64_t percentile(double p) const
+        {
+            uint64_t n = count();
+            if (n == 0)
+                return 0;
+            uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+            if (rank < 1)
+                rank = 1;
+            uint64_t acc = 0;
+            for (int i = 0; i < NumBuckets; i++)
+            {
+                acc += counts[i].load(std::memory_order_relaxed);
+                if (acc >= rank)
+                    return std::min(bucketUpperBound(i), max());
+            }
+            return max();
+        }
+
+        uint64_t count() const
+        {
+            return total.load(std::memory_order_relaxed);
+        }
+
+        uint64_t max() const
+        {
+            return maximum.load(std::memory_order_relaxed);
+        }
+
+        double mean() const
+        {
+            uint64_t n = count();
+            return n ? (double)sum.load(std::memory_order_relaxed) / n : 0.0;
+        }
+
+        /** @fn void reset()
+         *  @brief clears the histogram, not atomic with respect to concurrent record() calls
+        */
+        void reset()
+        {
+            for (int i = 0; i < NumBuckets; i++)
+                counts[i].store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            sum.store(0, std::memory_order_relaxed);
+            maximum.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * @brief A fixed set of named latency histograms, one per estimator stage
+     */
+    class StageProfiler
+    {
+    public:
+        static const int MaxStages = 16;
+
+    private:
+        LatencyHistogram stages[MaxStages];
+        std::string names[MaxStages];
+        int numStages;
+
+    public:
+        StageProfiler() : numStages(0) {}
+
+        /** @fn void setStageName(int stage, const std::string &name)
+         *  @brief names a stage before it is used, stages are reported in index order
+        */
+        void setStageName(int stage, const std::string &name)
+        {
+            if (stage < 0 || stage >= MaxStages)
+                return;
+            names[stage] = name;
+            if (stage >= numStages)
+                numStages = stage + 1;
+        }
+
+        void record(int stage, uint64_t ns)
+        {
+            stages[stage].record(ns);
+        }
+
+        const LatencyHistogram &stage(int stage) const
+        {
+            return stages[stage];
+        }
+
+        const std::string &stageName(int stage) const
+        {
+            return names[stage];
+        }
+
+        int size() const
+        {
+            return numStages;
+        }
+
+        /** @fn std::string report() const
+         *  @brief human readable table of all stages in microseconds
+        */
+        std::string report() const
+        {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1);
+            out << std::setw(14) << std::left << "stage" << std::right << std::setw(10) << "count"
+                << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90"
+                << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << " [us]" << std::endl;
+            for (int i = 0; i < numStages; i++)
+            {
+                const LatencyHistogram &h = stages[i];
+                if (names[i].empty())
+                    continue;
+                out << std::setw(14) << std::left << names[i] << std::right << std::setw(10) << h.count()
+                    << std::setw(10) << h.mean() * 1e-3 << std::setw(10) << h.percentile(50) * 1e-3
+                    << std::setw(10) << h.percentile(90) * 1e-3 << std::setw(10) << h.percentile(99) * 1e-3
+                    << std::setw(10) << h.percentile(99.9) * 1e-3 << std::setw(10) << h.max() * 1e-3 << std::endl;
+            }
+            return out.str();
+        }
+    };
+
+    /**
+     * @brief Records the lifetime of the enclosing scope into a profiler stage
+     */
+    class ScopedStageTimer
+    {
+    private:
+        StageProfiler &profiler;
+        int stage;
+        uint64_t start;
+
+    public:
+        ScopedStageTimer(StageProfiler &profiler_, int stage_) : profiler(profiler_), stage(stage_), start(monotonicNs()) {}
+        ~ScopedStageTimer()
+        {
+            profiler.record(stage, monotonicNs() - start);
+        }
+    };
+} // namespace serow
+
+#define SEROW_PROFILE_CONCAT_(a, b) a##b
+#define SEROW_PROFILE_CONCAT(a, b) SEROW_PROFILE_CONCAT_(a, b)
+#ifdef SEROW_PROFILING
+#define SEROW_PROFILE_SCOPE(profiler, stage) serow::ScopedStageTimer SEROW_PROFILE_CONCAT(serow_stage_timer_, __LINE__)(profiler, stage)
+#define SEROW_PROFILE_RECORD(profiler, stage, ns) (profiler).record(stage, ns)
+#else
+#define SEROW_PROFILE_SCOPE(profiler, stage) ((void)0)
+#define SEROW_PROFILE_RECORD(profiler, stage, ns) ((void)0)
+#endif
+#endif
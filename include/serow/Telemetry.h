@@ -0,0 +1,353 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Binary telemetry of filter internals
+ * @author Stylianos Piperakis
+ * @details filters push fixed size records into a bounded lock-free ring from any thread, a background
+ * thread drains the ring and appends the records to a columnar file with one write per batch.
+ * Logging a record costs a few nanoseconds and never blocks, allocates or touches the file, a full ring
+ * drops the record. rosrun serow serow_telemetry_csv converts a file to one CSV per channel.
+ *
+ * File layout, host byte order: TelemetryFileHeader, then blocks, each a TelemetryBlockHeader and its payload.
+ * A Definition block names channel `channel` and its `columns` columns as `count` bytes of NUL terminated
+ * strings (channel name first), a Data block holds `count` records of one channel column-major:
+ * uint64_t stamps[count] followed by double values[columns][count].
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <serow/StageProfiler.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace serow
+{
+    struct TelemetryFileHeader
+    {
+        char magic[8]; //"SEROWTLM"
+        uint32_t version, reserved;
+    };
+
+    struct TelemetryBlockHeader
+    {
+        enum Type
+        {
+            Definition = 1,
+            Data = 2
+        };
+        uint32_t type, channel, count, columns;
+    };
+
+    ///One sample of a channel, a cache line
+    struct TelemetryRecord
+    {
+        static const int MaxValues = 6;
+        uint64_t stamp;
+        uint32_t channel, count;
+        double values[MaxValues];
+    };
+
+    class Telemetry
+    {
+    private:
+        static const uint32_t Version = 1;
+        struct Slot
+        {
+            std::atomic<uint64_t> seq;
+            TelemetryRecord record;
+        };
+        struct Channel
+        {
+            std::string name;
+            std::vector<std::string> columns;
+            bool written;
+            std::vector<uint64_t> stamps;
+            std::vector<double> values;
+        };
+
+        Slot *slots;
+        uint64_t mask;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) uint64_t head;
+        std::atomic<uint64_t> dropped, written;
+        int fd;
+        std::string path;
+        double flush_period;
+        std::atomic<bool> running;
+        std::thread writer;
+        ///Channel table, changed by channel() and read by the writer thread
+        std::mutex channelMutex;
+        std::vector<Channel> channels;
+        std::vector<char> batch;
+
+        template <class T>
+        void append(const T *data, size_t n)
+        {
+            const char *p = reinterpret_cast<const char *>(data);
+            batch.insert(batch.end(), p, p + n * sizeof(T));
+        }
+
+        /** @fn bool pop(TelemetryRecord &r)
+         *  @brief single consumer side of the ring
+        */
+        bool pop(TelemetryRecord &r)
+        {
+            Slot &s = slots[head & mask];
+            if (s.seq.load(std::memory_order_acquire) != head + 1)
+                return false;
+            r = s.record;
+            s.seq.store(head + mask + 1, std::memory_order_release);
+            head++;
+            return true;
+        }
+
+        /** @fn void drain()
+         *  @brief moves the records in the ring to the file, grouped per channel
+        */
+        void drain()
+        {
+            TelemetryRecord r;
+            std::lock_guard<std::mutex> lock(channelMutex);
+            while (pop(r))
+            {
+                if (r.channel >= channels.size())
+                    continue;
+                Channel &c = channels[r.channel];
+                size_t n = std::min((size_t)r.count, c.columns.size());
+                c.stamps.push_back(r.stamp);
+                c.values.insert(c.values.end(), r.values, r.values + n);
+                c.values.resize(c.values.size() + c.columns.size() - n, 0.0);
+            }
+            batch.clear();
+            for (uint32_t i = 0; i < channels.size(); i++)
+            {
+                Channel &c = channels[i];
+                if (!c.written)
+                {
+                    std::string names = c.name + '\0';
+                    for (size_t k = 0; k < c.columns.size(); k++)
+                        names += c.columns[k] + '\0';
+                    TelemetryBlockHeader h = {TelemetryBlockHeader::Definition, i, (uint32_t)names.size(), (uint32_t)c.columns.size()};
+                    append(&h, 1);
+                    append(names.data(), names.size());
+                    c.written = true;
+                }
+                if (c.stamps.empty())
+                    continue;
+                uint32_t n = c.stamps.size(), m = c.columns.size();
+                TelemetryBlockHeader h = {TelemetryBlockHeader::Data, i, n, m};
+                append(&h, 1);
+                append(&c.stamps[0], n);
+                //records are stored row-major, columns are contiguous in the file
+                for (uint32_t k = 0; k < m; k++)
+                    for (uint32_t j = 0; j < n; j++)
+                        append(&c.values[j * m + k], 1);
+                written += n;
+                c.stamps.clear();
+                c.values.clear();
+            }
+            size_t off = 0;
+            while (off < batch.size())
+            {
+                ssize_t w = ::write(fd, &batch[off], batch.size() - off);
+                if (w <= 0)
+                    break;
+                off += w;
+            }
+        }
+
+        void writerLoop()
+        {
+            std::chrono::microseconds period((long)(flush_period * 1e6));
+            while (running.load(std::memory_order_acquire))
+            {
+                std::this_thread::sleep_for(period);
+                drain();
+            }
+            drain();
+        }
+
+    public:
+        Telemetry() : slots(NULL), mask(0), tail(0), head(0), dropped(0), written(0), fd(-1), flush_period(0.05), running(false) {}
+        ~Telemetry()
+        {
+            close();
+        }
+
+        /** @fn bool open(const std::string &path_, size_t capacity = 65536, double flush_period_ = 0.05)
+         *  @brief creates (truncates) path_ and starts the writer thread, draining every flush_period_ seconds
+         *  @details capacity is rounded up to a power of two records
+        */
+        bool open(const std::string &path_, size_t capacity = 65536, double flush_period_ = 0.05)
+        {
+            close();
+            fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            if (fd < 0)
+                return false;
+            path = path_;
+            TelemetryFileHeader h;
+            std::memcpy(h.magic, "SEROWTLM", 8);
+            h.version = Version;
+            h.reserved = 0;
+            if (::write(fd, &h, sizeof(h)) != (ssize_t)sizeof(h))
+            {
+                ::close(fd);
+                fd = -1;
+                return false;
+            }
+            uint64_t n = 2;
+            while (n < capacity)
+                n <<= 1;
+            slots = new Slot[n];
+            for (uint64_t i = 0; i < n; i++)
+                slots[i].seq.store(i, std::memory_order_relaxed);
+            mask = n - 1;
+            tail = 0;
+            head = 0;
+            dropped = 0;
+            written = 0;
+            flush_period = flush_period_ > 0 ? flush_period_ : 0.05;
+            running = true;
+            writer = std::thread(&Telemetry::writerLoop, this);
+            return true;
+        }
+
+        /** @fn void close()
+         *  @brief stops the writer thread after writing out what is left in the ring
+        */
+        void close()
+        {
+            if (fd < 0)
+                return;
+            running = false;
+            if (writer.joinable())
+                writer.join();
+            ::close(fd);
+            fd = -1;
+            delete[] slots;
+            slots = NULL;
+            std::lock_guard<std::mutex> lock(channelMutex);
+            for (size_t i = 0; i < channels.size(); i++)
+                channels[i].written = false;
+        }
+
+        bool isOpen() const
+        {
+            return fd >= 0;
+        }
+
+        /** @fn int channel(const std::string &name, const std::vector<std::string> &columns)
+         *  @brief registers a channel with up to TelemetryRecord::MaxValues columns, not meant for the hot path
+         *  @return the channel id to log with, or -1 if there are too many columns
+        */
+        int channel(const std::string &name, const std::vector<std::string> &columns)
+        {
+            if (columns.empty() || columns.size() > (size_t)TelemetryRecord::MaxValues)
+                return -1;
+            std::lock_guard<std::mutex> lock(channelMutex);
+            for (size_t i = 0; i < channels.size(); i++)
+            {
+                if (channels[i].name == name)
+                    return channels[i].columns == columns ? (int)i : -1;
+            }
+            Channel c;
+            c.name = name;
+            c.columns = columns;
+            c.written = false;
+            channels.push_back(c);
+            return channels.size() - 1;
+        }
+
+        /** @fn bool log(int channel, uint64_t stamp, const double *values, int count)
+         *  @brief pushes one record, wait-free for a single producer and lock-free for several
+         *  @return false if the logger is closed or the ring is full, the record is then dropped
+        */
+        bool log(int channel, uint64_t stamp, const double *values, int count)
+        {
+            if (!slots || channel < 0)
+                return false;
+            uint64_t pos = tail.load(std::memory_order_relaxed);
+            Slot *s;
+            while (true)
+            {
+                s = &slots[pos & mask];
+                int64_t diff = (int64_t)(s->seq.load(std::memory_order_acquire) - pos);
+                if (diff == 0)
+                {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else
+                {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+            s->record.stamp = stamp;
+            s->record.channel = channel;
+            s->record.count = count < TelemetryRecord::MaxValues ? count : TelemetryRecord::MaxValues;
+            std::memcpy(s->record.values, values, s->record.count * sizeof(double));
+            s->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool log(int channel, const double *values, int count)
+        {
+            return log(channel, monotonicNs(), values, count);
+        }
+
+        uint64_t droppedRecords() const
+        {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+        uint64_t writtenRecords() const
+        {
+            return written.load(std::memory_order_relaxed);
+        }
+
+        const std::string &filePath() const
+        {
+            return path;
+        }
+    };
+} // namespace serow
+#endif
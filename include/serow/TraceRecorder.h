@@ -0,0 +1,188 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief In-memory trace of estimator events
+ * @author Stylianos Piperakis
+ * @details a fixed size ring of complete events (name, thread, start, duration, sensor stamp) that any thread can
+ * append to without locks or allocations, written out as a Chrome trace / Perfetto JSON file on demand
+ */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+#include <serow/StageProfiler.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace serow
+{
+    /** @fn int currentThreadId()
+     *  @brief kernel thread id of the caller, looked up once per thread
+    */
+    inline int currentThreadId()
+    {
+        static thread_local int tid = (int)syscall(SYS_gettid);
+        return tid;
+    }
+
+    struct TraceEvent
+    {
+        ///name and category must be string literals, they are stored by pointer
+        const char *name;
+        const char *category;
+        uint64_t start, duration;
+        double sensor_stamp;
+        int tid;
+        ///even and equal to 2*(index+1) once the event is complete, odd while being written
+        std::atomic<uint64_t> seq;
+    };
+
+    class TraceRecorder
+    {
+    private:
+        TraceEvent *events;
+        size_t capacity;
+        std::atomic<uint64_t> head;
+
+    public:
+        TraceRecorder() : events(NULL), capacity(0), head(0) {}
+        ~TraceRecorder()
+        {
+            delete[] events;
+        }
+
+        /** @fn void init(size_t capacity_)
+         *  @brief allocates the ring, a capacity of 0 leaves the recorder disabled
+         *  @details must be called before any thread records
+        */
+        void init(size_t capacity_)
+        {
+            delete[] events;
+            events = NULL;
+            capacity = capacity_;
+            head = 0;
+            if (capacity == 0)
+                return;
+            events = new TraceEvent[capacity];
+            for (size_t i = 0; i < capacity; i++)
+                events[i].seq.store(0, std::memory_order_relaxed);
+        }
+
+        bool enabled() const
+        {
+            return capacity > 0;
+        }
+
+        /** @fn void record(const char *name, const char *category, uint64_t start, uint64_t end, double sensor_stamp)
+         *  @brief appends a complete event, overwriting the oldest one when the ring is full
+        */
+        void record(const char *name, const char *category, uint64_t start, uint64_t end, double sensor_stamp)
+        {
+            if (!capacity)
+                return;
+            uint64_t i = head.fetch_add(1, std::memory_order_relaxed);
+            TraceEvent &e = events[i % capacity];
+            e.seq.store(2 * i + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            e.name = name;
+            e.category = category;
+            e.start = start;
+            e.duration = end - start;
+            e.sensor_stamp = sensor_stamp;
+            e.tid = currentThreadId();
+            e.seq.store(2 * i + 2, std::memory_order_release);
+        }
+
+        /** @fn long writeChromeTrace(const std::string &path) const
+         *  @brief writes the events currently in the ring as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+         *  @return number of events written or -1 if the file could not be opened
+         *  @details may run concurrently with record(), events overwritten while being copied are skipped
+        */
+        long writeChromeTrace(const std::string &path) const
+        {
+            std::ofstream out(path.c_str());
+            if (!out.is_open())
+                return -1;
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = end > capacity ? end - capacity : 0;
+            int pid = (int)getpid();
+            long written = 0;
+            out.precision(15);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            for (uint64_t i = begin; i < end; i++)
+            {
+                const TraceEvent &e = events[i % capacity];
+                uint64_t seq = e.seq.load(std::memory_order_acquire);
+                if (seq != 2 * i + 2)
+                    continue;
+                const char *name = e.name;
+                const char *category = e.category;
+                uint64_t start = e.start, duration = e.duration;
+                double sensor_stamp = e.sensor_stamp;
+                int tid = e.tid;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (e.seq.load(std::memory_order_relaxed) != seq)
+                    continue;
+                out << (written ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << category
+                    << "\",\"ph\":\"X\",\"ts\":" << start * 1e-3 << ",\"dur\":" << duration * 1e-3
+                    << ",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"sensor_stamp\":" << sensor_stamp << "}}";
+                written++;
+            }
+            out << "\n]}\n";
+            return written;
+        }
+    };
+
+    /**
+     * @brief Records the enclosing scope as one trace event
+     */
+    class ScopedTrace
+    {
+    private:
+        TraceRecorder &recorder;
+        const char *name, *category;
+        double sensor_stamp;
+        uint64_t start;
+
+    public:
+        ScopedTrace(TraceRecorder &recorder_, const char *name_, const char *category_, double sensor_stamp_ = 0.0)
+            : recorder(recorder_), name(name_), category(category_), sensor_stamp(sensor_stamp_),
+              start(recorder_.enabled() ? monotonicNs() : 0) {}
+        ~ScopedTrace()
+        {
+            if (recorder.enabled())
+                recorder.record(name, category, start, monotonicNs(), sensor_stamp);
+        }
+    };
+} // namespace serow
+
+#define SEROW_TRACE_SCOPE(recorder, name, category, sensor_stamp) serow::ScopedTrace SEROW_PROFILE_CONCAT(serow_trace_, __LINE__)(recorder, name, category, sensor_stamp)
+#endif
@@ -0,0 +1,361 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Streaming absolute and relative trajectory error evaluation against ground truth
+ * @author Stylianos Piperakis
+ * @details ground truth samples are matched to the estimate interpolated at their stamp, the estimate is
+ * buffered for two samples only. The absolute trajectory error (ATE) of every match and the relative pose
+ * error (RPE) over each configured window are accumulated with running statistics, so memory stays
+ * constant over arbitrarily long runs. RPE windows are non-overlapping: the first match after a window
+ * length has elapsed since the anchor is compared with the anchor and becomes the next anchor.
+ * The ground truth is expected in the estimate frame, as aligned by the estimators at the first sample.
+ */
+
+#ifndef TRAJECTORYEVALUATOR_H
+#define TRAJECTORYEVALUATOR_H
+#include <eigen3/Eigen/Dense>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+namespace serow
+{
+    /**
+     * @brief Running mean, RMSE, standard deviation and maximum of a scalar error
+     */
+    struct ErrorStats
+    {
+        long n;
+        double mean, m2, sq, max;
+
+        ErrorStats()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            n = 0;
+            mean = m2 = sq = max = 0;
+        }
+
+        void add(double e)
+        {
+            n++;
+            const double d = e - mean;
+            mean += d / n;
+            m2 += d * (e - mean);
+            sq += e * e;
+            max = std::max(max, e);
+        }
+
+        double rmse() const
+        {
+            return n > 0 ? std::sqrt(sq / n) : 0.0;
+        }
+
+        double stddev() const
+        {
+            return n > 1 ? std::sqrt(m2 / (n - 1)) : 0.0;
+        }
+    };
+
+    struct TrajectorySample
+    {
+        double t;
+        Eigen::Vector3d p;
+        Eigen::Quaterniond q;
+        TrajectorySample() : t(0), p(Eigen::Vector3d::Zero()), q(Eigen::Quaterniond::Identity()) {}
+    };
+
+    class TrajectoryEvaluator
+    {
+    public:
+        ///Translation error in m and rotation error in rad
+        struct Errors
+        {
+            ErrorStats trans, rot;
+            void reset()
+            {
+                trans.reset();
+                rot.reset();
+            }
+        };
+
+        ///Relative pose error over window seconds
+        struct Window
+        {
+            double length;
+            bool anchored;
+            TrajectorySample est, gt;
+            Errors total, period;
+        };
+
+    private:
+        ///Rotation errors are skipped for position only trajectories, e.g. the CoM
+        bool useOrientation;
+        double maxGap;
+        TrajectorySample prev, cur, pendingGt;
+        bool hasPrev, hasCur, hasPending;
+        Errors ateTotal, atePeriod;
+        std::vector<Window, Eigen::aligned_allocator<Window> > windows;
+        long unmatched;
+
+        static double angle(const Eigen::Quaterniond &q)
+        {
+            return 2.0 * std::atan2(q.vec().norm(), std::fabs(q.w()));
+        }
+
+        /** @fn bool interpolate(double t, TrajectorySample &s) const
+         *  @brief the estimate at t from the two buffered samples, false if t is not between them or they are maxGap apart
+        */
+        bool interpolate(double t, TrajectorySample &s) const
+        {
+            if (!hasCur || t > cur.t)
+                return false;
+            if (t == cur.t)
+            {
+                s = cur;
+                return true;
+            }
+            if (!hasPrev || t < prev.t || cur.t - prev.t > maxGap)
+                return false;
+            const double a = (t - prev.t) / (cur.t - prev.t);
+            s.t = t;
+            s.p = prev.p + a * (cur.p - prev.p);
+            s.q = prev.q.slerp(a, cur.q);
+            return true;
+        }
+
+        void evaluate(const TrajectorySample &est, const TrajectorySample &gt)
+        {
+            const double et = (est.p - gt.p).norm();
+            ateTotal.trans.add(et);
+            atePeriod.trans.add(et);
+            if (useOrientation)
+            {
+                const double er = angle(gt.q.inverse() * est.q);
+                ateTotal.rot.add(er);
+                atePeriod.rot.add(er);
+            }
+            for (std::size_t i = 0; i < windows.size(); i++)
+            {
+                Window &w = windows[i];
+                if (w.anchored && gt.t - w.gt.t >= w.length)
+                {
+                    double rt, rr = 0;
+                    if (useOrientation)
+                    {
+                        //E = (Tgt_a^-1 Tgt_b)^-1 (Test_a^-1 Test_b)
+                        const Eigen::Quaterniond dqe = w.est.q.inverse() * est.q, dqg = w.gt.q.inverse() * gt.q;
+                        const Eigen::Vector3d dpe = w.est.q.inverse() * (est.p - w.est.p), dpg = w.gt.q.inverse() * (gt.p - w.gt.p);
+                        rt = (dqg.inverse() * (dpe - dpg)).norm();
+                        rr = angle(dqg.inverse() * dqe);
+                    }
+                    else
+                        rt = ((est.p - w.est.p) - (gt.p - w.gt.p)).norm();
+                    w.total.trans.add(rt);
+                    w.period.trans.add(rt);
+                    if (useOrientation)
+                    {
+                        w.total.rot.add(rr);
+                        w.period.rot.add(rr);
+                    }
+                    w.anchored = false;
+                }
+                if (!w.anchored)
+                {
+                    w.est = est;
+                    w.gt = gt;
+                    w.anchored = true;
+                }
+            }
+        }
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        TrajectoryEvaluator() : useOrientation(true), maxGap(0.1)
+        {
+            reset();
+        }
+
+        /** @fn void setParams(const std::vector<double> &windows_, bool useOrientation_, double maxGap_)
+         *  @param windows_ RPE window lengths in s
+         *  @param useOrientation_ false to evaluate positions only
+         *  @param maxGap_ largest time between two estimates that are interpolated in s
+        */
+        void setParams(const std::vector<double> &windows_, bool useOrientation_, double maxGap_)
+        {
+            useOrientation = useOrientation_;
+            maxGap = maxGap_;
+            windows.clear();
+            for (std::size_t i = 0; i < windows_.size(); i++)
+            {
+                if (windows_[i] <= 0)
+                    continue;
+                Window w;
+                w.length = windows_[i];
+                w.anchored = false;
+                windows.push_back(w);
+            }
+            reset();
+        }
+
+        void reset()
+        {
+            hasPrev = hasCur = hasPending = false;
+            unmatched = 0;
+            ateTotal.reset();
+            atePeriod.reset();
+            for (std::size_t i = 0; i < windows.size(); i++)
+            {
+                windows[i].anchored = false;
+                windows[i].total.reset();
+                windows[i].period.reset();
+            }
+        }
+
+        /** @fn void addEstimate(double t, const Eigen::Vector3d &p, const Eigen::Quaterniond &q)
+         *  @brief buffers the estimate at t and evaluates a pending ground truth sample it reaches, does not allocate
+        */
+        void addEstimate(double t, const Eigen::Vector3d &p, const Eigen::Quaterniond &q)
+        {
+            if (hasCur && t <= cur.t)
+                return;
+            prev = cur;
+            hasPrev = hasCur;
+            cur.t = t;
+            cur.p = p;
+            cur.q = q;
+            hasCur = true;
+            if (hasPending && pendingGt.t <= t)
+            {
+                hasPending = false;
+                TrajectorySample est;
+                if (interpolate(pendingGt.t, est))
+                    evaluate(est, pendingGt);
+                else
+                    unmatched++;
+            }
+        }
+
+        /** @fn void addGroundTruth(double t, const Eigen::Vector3d &p, const Eigen::Quaterniond &q)
+         *  @brief evaluates the ground truth at t, or holds it until the estimate reaches t
+        */
+        void addGroundTruth(double t, const Eigen::Vector3d &p, const Eigen::Quaterniond &q)
+        {
+            TrajectorySample gt;
+            gt.t = t;
+            gt.p = p;
+            gt.q = q;
+            if (hasCur && t > cur.t)
+            {
+                //Only the latest sample ahead of the estimate is kept
+                if (hasPending)
+                    unmatched++;
+                pendingGt = gt;
+                hasPending = true;
+                return;
+            }
+            TrajectorySample est;
+            if (interpolate(t, est))
+                evaluate(est, gt);
+            else
+                unmatched++;
+        }
+
+        /** @fn void resetPeriod()
+         *  @brief starts a new summary period, the totals are kept
+        */
+        void resetPeriod()
+        {
+            atePeriod.reset();
+            for (std::size_t i = 0; i < windows.size(); i++)
+                windows[i].period.reset();
+        }
+
+        const Errors &ate() const
+        {
+            return ateTotal;
+        }
+
+        ///ATE since the last resetPeriod()
+        const Errors &periodAte() const
+        {
+            return atePeriod;
+        }
+
+        int windowCount() const
+        {
+            return windows.size();
+        }
+
+        const Window &window(int i) const
+        {
+            return windows[i];
+        }
+
+        bool hasOrientation() const
+        {
+            return useOrientation;
+        }
+
+        ///Ground truth samples that could not be matched to the estimate
+        long unmatchedSamples() const
+        {
+            return unmatched;
+        }
+
+        /** @fn std::string report(const std::string &name) const
+         *  @brief the total ATE and RPE, one line each
+        */
+        std::string report(const std::string &name) const
+        {
+            std::ostringstream s;
+            s << name << " ATE over " << ateTotal.trans.n << " samples: rmse " << ateTotal.trans.rmse() << " m, mean " << ateTotal.trans.mean
+              << " m, std " << ateTotal.trans.stddev() << " m, max " << ateTotal.trans.max << " m";
+            if (useOrientation)
+                s << ", rotation rmse " << ateTotal.rot.rmse() * 180.0 / M_PI << " deg, max " << ateTotal.rot.max * 180.0 / M_PI << " deg";
+            s << ", " << unmatched << " unmatched" << std::endl;
+            for (std::size_t i = 0; i < windows.size(); i++)
+            {
+                const Errors &e = windows[i].total;
+                s << name << " RPE " << windows[i].length << " s over " << e.trans.n << " windows: rmse " << e.trans.rmse() << " m, max " << e.trans.max << " m";
+                if (useOrientation)
+                    s << ", rotation rmse " << e.rot.rmse() * 180.0 / M_PI << " deg, max " << e.rot.max * 180.0 / M_PI << " deg";
+                s << std::endl;
+            }
+            return s.str();
+        }
+    };
+} // namespace serow
+#endif
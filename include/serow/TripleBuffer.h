@@ -0,0 +1,100 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Lock-free triple buffer
+ * @author Stylianos Piperakis
+ * @details hands the latest value from a single writer thread to a single reader thread without
+ * locks or allocations; the writer never waits and the reader always sees a complete value
+ */
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+#include <atomic>
+
+namespace serow
+{
+    template <typename T>
+    class TripleBuffer
+    {
+    private:
+        static const int IndexMask = 0x3;
+        static const int NewData = 0x4;
+        T buffers[3];
+        /// index of the shared slot, NewData is set when the writer has swapped in a fresh value
+        std::atomic<int> middle;
+        int back, front;
+
+    public:
+        TripleBuffer() : middle(1), back(0), front(2) {}
+
+        /** @fn T& write()
+         *  @brief returns the slot owned by the writer, it must be filled completely before publish()
+        */
+        T &write()
+        {
+            return buffers[back];
+        }
+
+        /** @fn void publish()
+         *  @brief makes the value in the writer slot available to the reader
+        */
+        void publish()
+        {
+            back = middle.exchange(back | NewData, std::memory_order_acq_rel) & IndexMask;
+        }
+
+        /** @fn bool update()
+         *  @brief acquires the most recently published value, returns false if nothing new was published
+        */
+        bool update()
+        {
+            if (!(middle.load(std::memory_order_relaxed) & NewData))
+                return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+            return true;
+        }
+
+        /** @fn const T& read() const
+         *  @brief returns the slot owned by the reader
+        */
+        const T &read() const
+        {
+            return buffers[front];
+        }
+
+        /** @fn T& slot(int i)
+         *  @brief direct access to the three slots, only safe before the reader is started (e.g. to preallocate)
+        */
+        T &slot(int i)
+        {
+            return buffers[i];
+        }
+    };
+} // namespace serow
+#endif
@@ -1,6 +1,6 @@
 #include <math.h>
 #include <eigen3/Eigen/Dense>
-#include <fstream>
+#include <serow/Telemetry.h>
 using namespace std;
 namespace serow{
 
@@ -16,7 +16,9 @@ namespace serow{
             double Ts, Tv;
             double freqvmin,freqvmax;
             double mass, g;
-            ofstream outFileX,outFileY,outFileZ,outFileKX,outFileKY,outFileKZ;
+            ///optional telemetry of the fused and the kinematic velocity
+            Telemetry *telemetry;
+            int telemetryChannel;
 
             double computeCrossoverFreq(double GRFz)
             {
@@ -39,12 +41,8 @@ namespace serow{
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW
             bodyVelCF(double freq_, double mass_, double freqvmin_ = 0.1, double freqvmax_ = 2.5, double g_ = 9.81)
             {
-                outFileX.open("/home/master/outputX.txt");
-                outFileY.open("/home/master/outputY.txt");
-                outFileZ.open("/home/master/outputZ.txt");
-                outFileKX.open("/home/master/outputKX.txt");
-                outFileKY.open("/home/master/outputKY.txt");
-                outFileKZ.open("/home/master/outputKZ.txt");
+                telemetry = NULL;
+                telemetryChannel = -1;
                 freqvmax = freqvmax_;
                 freqvmin = freqvmin_;
                 mass = mass_;
@@ -59,6 +57,19 @@ namespace serow{
                 acc0 = Eigen::Vector3d::Zero();
             }
 
+            /** @fn void setTelemetry(Telemetry *telemetry_)
+             *  @brief logs every filtered sample to the "bodyVelCF" channel of telemetry_, NULL disables it
+            */
+            void setTelemetry(Telemetry *telemetry_)
+            {
+                telemetry = telemetry_;
+                if (telemetry)
+                {
+                    const char *columns[] = {"vx", "vy", "vz", "kin_vx", "kin_vy", "kin_vz"};
+                    telemetryChannel = telemetry->channel("bodyVelCF", std::vector<std::string>(columns, columns + 6));
+                }
+            }
+
             Eigen:: Vector3d filter(Eigen::Vector3d vwbKCFS, Eigen::Vector3d acc, double GRFz)
             {
                 
@@ -70,12 +81,11 @@ namespace serow{
                 vwb = -(Ts-2.0*Tv)/temp * vwb0 + Ts*Tv/temp * (acc + acc0) + Ts/temp * (vwbKCFS + vwbKCFS0);
 
 
-	            outFileKX<<vwbKCFS(0)<<std::endl;
-	            outFileKY<<vwbKCFS(1)<<std::endl;
-	            outFileKZ<<vwbKCFS(2)<<std::endl;
-	            outFileX<<vwb(0)<<std::endl;
-	            outFileY<<vwb(1)<<std::endl;
-	            outFileZ<<vwb(2)<<std::endl;
+                if (telemetry)
+                {
+                    double v[6] = {vwb(0), vwb(1), vwb(2), vwbKCFS(0), vwbKCFS(1), vwbKCFS(2)};
+                    telemetry->log(telemetryChannel, v, 6);
+                }
                 acc0 = acc;
                 vwb0 = vwb;
                 vwbKCFS0 = vwbKCFS;
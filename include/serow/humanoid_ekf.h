@@ -39,6 +39,9 @@
 // ROS Headers
 #include <serow/robotDyn.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
 
 // Estimator Headers
 #include "serow/IMUEKF.h"
@@ -64,25 +67,112 @@
 #include <nav_msgs/Odometry.h>
 
 #include <dynamic_reconfigure/server.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Trigger.h>
 #include "serow/VarianceControlConfig.h"
 #include "serow/mediator.h"
 #include "serow/differentiator.h"
 #include "serow/Madgwick.h"
 #include "serow/Mahony.h"
+#include "serow/ImuRingBuffer.h"
 #include "serow/deadReckoning.h"
 #include "serow/Median.h"
 #include <serow/ContactDetection.h>
+#include "serow/TripleBuffer.h"
+#include "serow/StageProfiler.h"
+#include "serow/PerfCounters.h"
+#include "serow/TraceRecorder.h"
+#include "serow/AllocationCounter.h"
+#include "serow/RealtimeThread.h"
+#include "serow/DeadlineGovernor.h"
+#include "serow/SharedEstimate.h"
+#include "serow/PoseHistory.h"
+#include "serow/Checkpoint.h"
+#include "serow/ImuBiasCalibrator.h"
+#include "serow/TrajectoryEvaluator.h"
+#include <serow/LookupPose.h>
+#include "serow/Telemetry.h"
+#include "serow/SharedSensors.h"
+#include "serow/Estimator.h"
+#include "serow/NoiseParameters.h"
+#include <thread>
+#include <atomic>
 
 using namespace Eigen;
 using namespace std;
 
+/**
+ * @brief Snapshot of everything the humanoid estimator publishes in one cycle
+ * @details filled by the estimator thread and handed to the publisher thread through a TripleBuffer
+ */
+struct HumanoidEstimate
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	ros::Time stamp;
+	///Stamp of the IMU measurement the estimate was computed from
+	ros::Time sensor_stamp;
+	///Base from the rigid body EKF
+	Vector3d base_pos, base_vel, base_acc, base_gyro;
+	Quaterniond base_q;
+	///Base from leg odometry
+	Vector3d lo_pos, lo_vel, lo_omega;
+	Quaterniond lo_q;
+	///Feet in the world frame and relative to the base
+	Vector3d pwl, pwr, vwl, vwr, omegawl, omegawr, pbl, pbr, pws;
+	Quaterniond qwl, qwr, qbl, qbr, qws;
+	std::string support_leg;
+	Vector3d LLegGRF, LLegGRT, RLegGRF, RLegGRT;
+	///CoM EKF
+	Vector3d com_pos, com_vel, com_force, com_leg_odom, com_rel, cop;
+	///Filtered joint states
+	VectorXd joint_pos, joint_vel;
+	///Aligned ground-truth and comparison odometry
+	Vector3d gt_pos, gt_com_pos, gt_com_vel, gt_com_omega;
+	Quaterniond gt_q, gt_com_q;
+	bool comp_odom0_valid;
+	///Degradation level of the deadline governor when the estimate was computed
+	int degradation;
+	Vector3d comp_pos, comp_vel, comp_omega;
+	Quaterniond comp_q;
+};
+
 class humanoid_ekf{
 private:
 	// ROS Standard Variables
-	ros::NodeHandle n;
+	ros::NodeHandle n, n_p;
+	///Callback queue served by run(), NULL serves the global queue with ros::spinOnce()
+	ros::CallbackQueue* callbackQueue;
+	///Publish shared pointers so that subscribers in the same process receive the message without serialization
+	bool intraProcess;
+	///Stepped by a serow_host worker, which also publishes and owns the thread scheduling
+	bool hosted;
+	std::atomic<bool> stopRequested;
+	template <typename M>
+	void publishMsg(const ros::Publisher &pub, boost::shared_ptr<M> &ptr, const M &msg)
+	{
+		if (!intraProcess)
+		{
+			pub.publish(msg);
+			return;
+		}
+		//a message still queued for a subscriber must not change, publish a fresh one instead
+		if (!ptr || !ptr.unique())
+			ptr = boost::make_shared<M>(msg);
+		else
+			*ptr = msg;
+		pub.publish(ptr);
+	}
 	ros::Publisher supportPose_est_pub, bodyAcc_est_pub,leftleg_odom_pub, rightleg_odom_pub, support_leg_pub, RLeg_est_pub, LLeg_est_pub, COP_pub, joint_filt_pub, rel_CoMPose_pub,
 	external_force_filt_pub, odom_est_pub, leg_odom_pub, ground_truth_com_pub, CoM_odom_pub, CoM_leg_odom_pub, ground_truth_odom_pub,ds_pub, 
 	rel_leftlegPose_pub,rel_rightlegPose_pub, comp_odom0_pub;
+	///Messages handed to the publishers in intra-process mode, reused once the subscribers released them
+	boost::shared_ptr<geometry_msgs::WrenchStamped> LLeg_est_ptr, RLeg_est_ptr, external_force_filt_ptr;
+	boost::shared_ptr<geometry_msgs::PointStamped> COP_ptr;
+	boost::shared_ptr<nav_msgs::Odometry> CoM_odom_ptr, CoM_leg_odom_ptr, odom_est_ptr, leg_odom_ptr, ground_truth_com_ptr, ground_truth_odom_ptr, comp_odom0_ptr, leftleg_odom_ptr, rightleg_odom_ptr;
+	boost::shared_ptr<geometry_msgs::PoseStamped> rel_CoMPose_ptr, supportPose_est_ptr, rel_leftlegPose_ptr, rel_rightlegPose_ptr;
+	boost::shared_ptr<sensor_msgs::JointState> joint_filt_ptr;
+	boost::shared_ptr<sensor_msgs::Imu> bodyAcc_est_ptr;
+	boost::shared_ptr<std_msgs::String> support_leg_ptr;
     
 	ros::Subscriber imu_sub, joint_state_sub, lfsr_sub, rfsr_sub, odom_sub, 
 	ground_truth_odom_sub,ds_sub, ground_truth_com_sub,support_idx_sub, compodom0_sub;
@@ -97,11 +187,17 @@ private:
 	serow::Madgwick* mw;
     serow::Mahony* mh;
     double Kp, Ki;
+	///Raw IMU samples for the attitude filter, consumed at the native IMU rate
+	serow::ImuRingBuffer<256> imuBuffer;
+	double imu_native_freq, last_imu_stamp;
+	int imu_queue_size;
+	bool firstImuSample;
 	serow::deadReckoning* dr;
-	Vector3d bias_a,bias_g;
-	int imuCalibrationCycles,maxImuCalibrationCycles;
-	bool imuCalibrated;
-   	std::map<std::string, double> joint_state_pos_map, joint_state_vel_map;
+	int maxImuCalibrationCycles;
+	///Online IMU bias calibration, enabled with calibrateIMUbiases, refines the bias priors while the IMU is still
+	bool imuCalibrated, imuBiasesRefined, imuBiasesReport, imuBiasesRestored;
+	serow::ImuBiasCalibrator imuBiasCalibrator;
+	double no_motion_gyro_threshold, no_motion_acc_threshold;
 
 	double Tau0, Tau1, VelocityThres;
 	double  freq, joint_freq, fsr_freq;
@@ -123,12 +219,94 @@ private:
 	Quaterniond  q_B_P, q_B_GT, tempq, qoffsetGTCoM, tempq_, gt_odomq; 
 	bool useCoMEKF, useLegOdom, firstGT,firstGTCoM, useOutlierDetection;
     bool debug_mode;
+	///Asynchronous publishing of the estimates
+	serow::TripleBuffer<HumanoidEstimate> estimateBuffer;
+	std::thread publisherThread;
+	std::atomic<bool> publisherRunning;
+	bool usePublisherThread;
+	unsigned long publish_cycle;
+	int joint_pub_decimation, body_pub_decimation, leg_pub_decimation, support_pub_decimation,
+	contact_pub_decimation, grf_pub_decimation, com_pub_decimation;
+	std::vector<std::string> joint_names;
+	///Real-time mode, estimator cycles after the warm up are checked for heap allocations
+	bool rt_mode, rt_abort_on_allocation;
+	int rt_warmup_cycles;
+	unsigned long rt_cycle;
+	///Scheduling, CPU affinity and memory locking of the estimator and publisher threads
+	std::string rt_sched_policy;
+	int rt_priority, rt_stack_prefault;
+	bool rt_lock_memory;
+	std::vector<int> estimator_cpus, publisher_cpus;
+	///Deadline monitor, steps the estimator down when cycles overrun the IMU period
+	serow::DeadlineGovernor governor;
+	int degraded_pub_decimation, degraded_com_decimation, com_step, com_cycle;
+	bool comSuspended;
+	///Latest estimate in shared memory for controllers on the same host
+	serow::SharedEstimateWriter shmEstimate;
+	///Binary telemetry of the estimates, converted with serow_telemetry_csv
+	serow::Telemetry telemetry;
+	int tlmBase, tlmCoM;
+	///Noise and threshold sets from the dynamic reconfigure thread, applied at the start of a cycle
+	boost::shared_ptr< dynamic_reconfigure::Server<serow::VarianceControlConfig> > dynamic_recfg_;
+	serow::VersionedParams<serow::EstimatorParams> noiseParams;
+	bool useDynamicReconfigure;
+	///Stamped base estimates for lookups at sensor times, in shared memory when pose_history_shm_name is set
+	serow::PoseHistory poseHistory;
+	std::string pose_history_shm_name;
+	ros::ServiceServer lookup_pose_srv;
+	///Streaming ATE/RPE of the base and CoM against the aligned ground truth, summarized every evaluation_period s
+	bool useEvaluation;
+	serow::TrajectoryEvaluator baseEvaluator, comEvaluator;
+	double evaluation_period;
+	ros::Time last_evaluation;
+	ros::Publisher evaluation_pub;
+	///Warm restart state, saved every checkpoint_period s and on exit to checkpoint_file and restored at startup
+	std::string checkpoint_file;
+	double checkpoint_period, last_checkpoint_time;
+	serow::Checkpoint checkpoint, restored;
+	serow::CheckpointWriter checkpointWriter;
+	std::string shm_estimate_name;
+	uint64_t shm_cycle;
+	///Sensor input backend, "ros" subscribes to the sensor topics, "shm" reads the shared memory ring
+	std::string sensor_input, shm_sensor_name;
+	serow::SharedSensorReader sensorRing;
+	serow::SharedSensorFrame sensorFrame;
+	sensor_msgs::Imu shm_imu_msg;
+	sensor_msgs::JointState shm_joint_msg;
+	geometry_msgs::WrenchStamped shm_wrench_msg;
+	///Per stage timing, compiled in with SEROW_PROFILING
+	enum ProfiledStage
+	{
+		AttitudeStage,
+		KinematicsStage,
+		BaseStage,
+		CoMStage,
+		HandoffStage,
+		PublishStage,
+		CycleStage,
+		LatencyStage
+	};
+	///Event trace of the last trace_buffer_size events, written to trace_file on request and on exit
+	serow::TraceRecorder tracer;
+	std::string trace_file;
+	ros::ServiceServer dump_trace_srv;
+#ifdef SEROW_PROFILING
+	serow::StageProfiler profiler;
+	///Hardware counters of the estimator thread stages, opened when perf_counters is set
+	serow::PerfCounters perfCounters;
+	bool usePerfCounters;
+	ros::Publisher diagnostics_pub;
+	double diagnostics_period;
+	ros::Time last_diagnostics;
+#endif
 	//ROS Messages
 	sensor_msgs::JointState joint_state_msg, joint_filt_msg;
 	sensor_msgs::Imu imu_msg;
 	nav_msgs::Odometry odom_msg, odom_msg_, odom_est_msg, leg_odom_msg, ground_truth_odom_msg, leftleg_odom_msg, rightleg_odom_msg,
 	ground_truth_com_odom_msg, CoM_odom_msg, ground_truth_odom_msg_, ground_truth_odom_pub_msg;
-	geometry_msgs::PoseStamped pose_msg, pose_msg_, temp_pose_msg, rel_supportPose_msg, rel_swingPose_msg;
+	geometry_msgs::PoseStamped pose_msg, pose_msg_, temp_pose_msg, rel_supportPose_msg, rel_swingPose_msg,
+	rel_leftlegPose_msg, rel_rightlegPose_msg, rel_CoMPose_msg;
+	nav_msgs::Odometry ground_truth_com_pub_msg, comp_odom0_pub_msg;
 	std_msgs::String support_leg_msg;
 	geometry_msgs::WrenchStamped RLeg_est_msg, LLeg_est_msg, lfsr_msg, rfsr_msg, external_force_filt_msg;
    
@@ -154,6 +332,10 @@ private:
 	IMUinEKF* imuInEKF;
 	bool useInIMUEKF;
 	CoMEKF* nipmEKF;
+	///Attitude, base, contact and CoM estimators composed by value, the component pointers alias its members
+	serow::EstimatorPipeline* pipeline;
+	///Estimation cycle instantiated for the composed pipeline, selected once in init()
+	void (humanoid_ekf::*estimationCycle)();
 	butterworthLPF** gyroLPF;
 	MovingAverageFilter** gyroMAF;
 	//Cuttoff Freqs for LPF
@@ -202,6 +384,10 @@ private:
 	 string odom_topic;
 	 string ground_truth_odom_topic, ground_truth_com_topic, support_idx_topic;
      string modelname;
+     ///generated kinematics library, empty to use Pinocchio
+     string kinematics_library;
+     ///parsed models are cached here, keyed by the URDF content, empty disables the cache
+     string model_cache_dir;
 	 bool usePoseUpdate;
 	//Odometry, from supportleg to inertial, transformation from support leg to other leg
      void subscribeToIMU();
@@ -214,31 +400,154 @@ private:
 	 void subscribeToSupportIdx();
 	 void support_idxCb(const std_msgs::Int32::ConstPtr& msg);
 	 void ground_truth_odomCb(const nav_msgs::Odometry::ConstPtr& msg);
+	 /** @fn void pollSharedSensors()
+	  *  @brief feeds the frames written to the shared memory ring since the last call to the sensor handlers
+	 */
+	 void pollSharedSensors();
+	 /** @fn bool openSensorRing()
+	  *  @brief attaches to the shared memory sensor ring and sizes the joint message to its joints
+	 */
+	 bool openSensorRing();
+	 /** @fn void waitForInputs()
+	  *  @brief returns once every configured input has a publisher, or the sensor ring exists, at most startup_timeout seconds
+	 */
+	 void waitForInputs();
+	 double startup_timeout;
 	 void imuCb(const sensor_msgs::Imu::ConstPtr& msg);
+	 void processImu(const sensor_msgs::Imu& msg);
 	 void joint_stateCb(const sensor_msgs::JointState::ConstPtr& msg);
+	 void processJointState(const sensor_msgs::JointState& msg);
 	 void odomCb(const nav_msgs::Odometry::ConstPtr& msg);
 	 void lfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processLFSR(const geometry_msgs::WrenchStamped& msg);
 	 void rfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processRFSR(const geometry_msgs::WrenchStamped& msg);
 	 void computeGlobalCOP(Affine3d Tis_, Affine3d Tssprime_);
-	 void filterGyrodot();
+	 /** @fn void filterGyrodot(const Vector3d &gyro)
+	  *  @brief differentiates and low-passes the base gyro rate for the CoM estimator
+	 */
+	 void filterGyrodot(const Vector3d &gyro);
+	 /** @fn void updateAttitude(AttitudeFilter &filter)
+	  *  @brief integrates the buffered IMU samples with the attitude filter of the pipeline
+	 */
+	 template <class AttitudeFilter>
+	 void updateAttitude(AttitudeFilter &filter);
 	//private methods
 	void init();
-	void estimateWithCoMEKF();
-	void estimateWithIMUEKF();
-	void estimateWithInIMUEKF();
-	void computeKinTFs();
+	template <class BaseFilter>
+	void estimateWithCoMEKF(CoMEKF &com, const BaseFilter &base);
+	/** @fn void scheduleCoMEKF(CoMEKF &com, const BaseFilter &base)
+	 *  @brief runs the CoM estimator at the rate the deadline governor allows, suspends it at the minimal level
+	*/
+	template <class BaseFilter>
+	void scheduleCoMEKF(CoMEKF &com, const BaseFilter &base);
+	///Pipelines without CoM estimation
+	template <class BaseFilter>
+	void scheduleCoMEKF(serow::NoCoMEstimation::None &, const BaseFilter &) {}
+	/** @fn void estimateBase(IMUEKF &base, serow::ContactDetection &detector)
+	 *  @brief predicts and updates the base filter of the pipeline, the overload is picked by the filter type
+	*/
+	void estimateBase(IMUEKF &base, serow::ContactDetection &detector);
+	void estimateBase(IMUinEKF &base, serow::ContactDetection &detector);
+	template <class E>
+	void computeKinTFs(E &est);
+	/** @fn void runCycle()
+	 *  @brief runs one estimation cycle of the pipeline E, the stage selection is resolved at compile time
+	*/
+	template <class E>
+	void runCycle();
+	/** @fn void composeBase()
+	 *  @brief picks the base, contact and CoM policies from the parameters and allocates the pipeline once,
+	 *  every configuration of the node is instantiated here
+	*/
+	template <class AttitudePolicy>
+	void composeBase();
+	template <class AttitudePolicy, class BaseFilterPolicy>
+	void composeContact();
+	template <class AttitudePolicy, class BaseFilterPolicy, class ContactPolicy>
+	void composeCoM();
+	template <class E>
+	void bindPipeline();
 	//publish functions
-	void publishGRF();
-	void publishJointEstimates();
-	void publishCoMEstimates();
+	template <class BaseFilter, class CoMFilter>
+	void fillEstimate(HumanoidEstimate &e, const BaseFilter &base, const CoMFilter &com);
+	void fillCoMEstimate(HumanoidEstimate &e, const CoMEKF &com);
+	void fillCoMEstimate(HumanoidEstimate &, const serow::NoCoMEstimation::None &) {}
+	void publishEstimates(const HumanoidEstimate &e);
+	void publisherLoop();
+	void startPublisher();
+	void stopPublisher();
+	void publishGRF(const HumanoidEstimate &e);
+	void publishJointEstimates(const HumanoidEstimate &e);
+	void publishCoMEstimates(const HumanoidEstimate &e);
 	void deAllocate();
-	void publishLegEstimates();
-	void publishSupportEstimates();
-	void publishBodyEstimates();
-	void publishContact();
-	void publishCOP();
+	void publishLegEstimates(const HumanoidEstimate &e);
+	void publishSupportEstimates(const HumanoidEstimate &e);
+	void publishBodyEstimates(const HumanoidEstimate &e);
+	void publishContact(const HumanoidEstimate &e);
+	void publishCOP(const HumanoidEstimate &e);
 	// Advertise to ROS Topics
 	void advertise();
+	void initMessages();
+	void initProfiler();
+	void openPerfCounters();
+	/** @fn void configureEstimatorThread()
+	 *  @brief applies the scheduling, affinity and memory locking options to the thread calling run()
+	*/
+	void configureEstimatorThread();
+	void profileEstimate(const HumanoidEstimate &e);
+	void reportProfiling();
+	bool dumpTraceCb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
+	void dumpTrace();
+	/** @fn void writeSharedEstimate(const HumanoidEstimate &e, serow::ContactDetection &detector)
+	 *  @brief copies the base and CoM state of e and the contacts of detector to the shared memory channel
+	*/
+	void writeSharedEstimate(const HumanoidEstimate &e, serow::ContactDetection &detector);
+	/** @fn void recordPose(const HumanoidEstimate &e, const BaseFilter &base)
+	 *  @brief pushes the base pose and twist of e with the covariances of base to the pose history
+	*/
+	template <class BaseFilter>
+	void recordPose(const HumanoidEstimate &e, const BaseFilter &base);
+	/** @fn void evaluateEstimate(const HumanoidEstimate &e)
+	 *  @brief feeds the base and CoM estimates of e to the trajectory evaluators, does not allocate
+	*/
+	void evaluateEstimate(const HumanoidEstimate &e);
+	/** @fn void publishEvaluation()
+	 *  @brief publishes the errors of the last evaluation_period to /diagnostics, called by the ground truth callbacks
+	*/
+	void publishEvaluation();
+	/** @fn void loadCheckpoint()
+	 *  @brief reads checkpoint_file, restores the IMU biases as calibration priors and the attitude filter,
+	 *  the leg odometry, base and CoM filters pick up their blocks when they are initialized
+	*/
+	void loadCheckpoint();
+	/** @fn void applyImuBiases(BaseFilter &base)
+	 *  @brief hands the biases refined by the online calibration to the base filter, they initialize a filter
+	 *  that has not started, a running one fuses the gyro bias of the still window as a pseudo-measurement
+	*/
+	template <class BaseFilter>
+	void applyImuBiases(BaseFilter &base);
+	/** @fn bool estimating()
+	 *  @brief true once the kinematics are initialized and the IMU biases are calibrated or restored
+	*/
+	bool estimating();
+	/** @fn void fillCheckpoint(serow::Checkpoint &c)
+	 *  @brief copies the biases, the attitude, the feet and the base/CoM filter states and covariances to c
+	*/
+	void fillCheckpoint(serow::Checkpoint &c);
+	bool lookupPoseCb(serow::LookupPose::Request &req, serow::LookupPose::Response &res);
+	/** @fn void logTelemetry(const HumanoidEstimate &e)
+	 *  @brief pushes the base and CoM of e to the telemetry ring
+	*/
+	void logTelemetry(const HumanoidEstimate &e);
+	/** @fn void startReconfigure()
+	 *  @brief starts the dynamic reconfigure server with the loaded noise parameters and thresholds
+	*/
+	void startReconfigure();
+	/** @fn void applyNoiseParams()
+	 *  @brief writes the latest published parameter set to the filters and the contact detector
+	*/
+	void applyNoiseParams();
 	void subscribe();
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -246,12 +555,55 @@ public:
 	humanoid_ekf();
 	~humanoid_ekf();
 	bool connect(const ros::NodeHandle nh);
+	/** @fn bool connect(const ros::NodeHandle nh, const ros::NodeHandle nh_p)
+	 *  @brief connects with nh and reads the parameters from the private handle nh_p, as needed by nodelets
+	*/
+	bool connect(const ros::NodeHandle nh, const ros::NodeHandle nh_p);
+	/** @fn void setCallbackQueue(ros::CallbackQueue* queue)
+	 *  @brief run() serves the subscriptions from queue instead of calling ros::spinOnce()
+	*/
+	void setCallbackQueue(ros::CallbackQueue* queue);
+	/** @fn void setIntraProcess(bool intraProcess_)
+	 *  @brief publish message shared pointers for zero-copy intra-process transport
+	*/
+	void setIntraProcess(bool intraProcess_);
+	/** @fn void stop()
+	 *  @brief makes run() return, safe to call from another thread
+	*/
+	void stop();
+	/** @fn void setHosted(bool hosted_)
+	 *  @brief to be called before connect() when a host process drives the estimator with begin(), step() and end()
+	 *  @details the estimates are then published by the thread calling step() and rt_mode is not available
+	*/
+	void setHosted(bool hosted_);
+	/** @fn void begin()
+	 *  @brief prepares the calling thread to step the estimator
+	*/
+	void begin();
+	/** @fn void step()
+	 *  @brief one iteration of the main loop without the sleep: a pending IMU sample is processed, then the callbacks
+	*/
+	void step();
+	/** @fn void end()
+	 *  @brief stops the publisher, reports and releases the estimator, on the thread that stepped it
+	*/
+	void end();
+	/** @fn double loopPeriod()
+	 *  @brief period in seconds at which step() is meant to be called
+	*/
+	double loopPeriod();
+	/** @fn bool running()
+	 *  @brief false once ROS shuts down or stop() is called
+	*/
+	bool running();
 	void disconnect();
 	// Parameter Server
 	void loadparams();
 	void loadIMUEKFparams();
 	void loadCoMEKFparams();
 	void loadJointKFparams();
+	// General Methods
+	void reconfigureCB(serow::VarianceControlConfig& config, uint32_t level);
 	void run();
 	bool connected();
 };
@@ -0,0 +1,493 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Lie group kernels for SO(3), SE(3) and SE_K(3)
+ * @author Stylianos Piperakis
+ * @details fixed-size exponential/logarithmic maps, left/right Jacobians and adjoints shared by all filters,
+ * templated on the scalar type and, for SE_K(3), on the number K of vectors carried with the rotation.
+ * Tangent vectors are ordered [phi; rho_1; ...; rho_K] and group elements are [R x_1 ... x_K; 0 I],
+ * so SE(3) is SE_1(3) and the contact aided InEKF states are SE_4(3) (humanoid) and SE_6(3) (quadruped)
+ */
+
+#ifndef SEROW_LIE_H
+#define SEROW_LIE_H
+#include <cmath>
+#include <limits>
+#include <eigen3/Eigen/Dense>
+
+namespace serow
+{
+namespace lie
+{
+    /// Angle below which the coefficients switch to their Taylor expansions
+    template <typename Scalar>
+    struct SmallAngle
+    {
+        /// ~eps^(1/8): the truncated series and the closed forms lose about the same precision there
+        static Scalar threshold() { return Scalar(1e-2); }
+    };
+
+    template <>
+    struct SmallAngle<float>
+    {
+        static float threshold() { return 1e-1f; }
+    };
+
+    /**
+     * @brief Scalar coefficients of the SO(3) series, computed once per angle
+     * @details a = sin(t)/t, b = (1-cos(t))/t^2, c = (t-sin(t))/t^3
+     */
+    template <typename Scalar>
+    struct SO3Coefficients
+    {
+        Scalar theta2, a, b, c;
+
+        explicit SO3Coefficients(Scalar theta2_) : theta2(theta2_)
+        {
+            const Scalar th = SmallAngle<Scalar>::threshold();
+            if (theta2 < th * th)
+            {
+                const Scalar t4 = theta2 * theta2;
+                a = Scalar(1) - theta2 / Scalar(6) + t4 / Scalar(120);
+                b = Scalar(0.5) - theta2 / Scalar(24) + t4 / Scalar(720);
+                c = Scalar(1) / Scalar(6) - theta2 / Scalar(120) + t4 / Scalar(5040);
+            }
+            else
+            {
+                using std::cos;
+                using std::sin;
+                using std::sqrt;
+                const Scalar theta = sqrt(theta2);
+                const Scalar s = sin(theta);
+                a = s / theta;
+                b = (Scalar(1) - cos(theta)) / theta2;
+                c = (theta - s) / (theta2 * theta);
+            }
+        }
+    };
+
+    /** @fn Matrix3 skew(const MatrixBase<Derived> &v)
+     *  @brief skew symmetric matrix of a 3-D vector, v x u = skew(v) * u
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> skew(const Eigen::MatrixBase<Derived> &v)
+    {
+        EIGEN_STATIC_ASSERT_VECTOR_SPECIFIC_SIZE(Derived, 3);
+        typedef typename Derived::Scalar Scalar;
+        Eigen::Matrix<Scalar, 3, 3> res;
+        res << Scalar(0), -v(2), v(1),
+            v(2), Scalar(0), -v(0),
+            -v(1), v(0), Scalar(0);
+        return res;
+    }
+
+    /** @fn Vector3 vee(const MatrixBase<Derived> &M)
+     *  @brief vector of a skew symmetric matrix, the inverse of skew()
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 1> vee(const Eigen::MatrixBase<Derived> &M)
+    {
+        return Eigen::Matrix<typename Derived::Scalar, 3, 1>(M(2, 1), M(0, 2), M(1, 0));
+    }
+
+    /** @fn Matrix3 rodrigues(const Vector3 &w, Scalar a, Scalar b)
+     *  @brief I + a skew(w) + b skew(w)^2 written out element-wise, the common form of exp(w), Jl(w) and Jr(w)
+    */
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 3, 3> rodrigues(const Eigen::Matrix<Scalar, 3, 1> &w, Scalar a, Scalar b)
+    {
+        //skew(w)^2 = w w' - |w|^2 I
+        const Scalar xx = w(0) * w(0), yy = w(1) * w(1), zz = w(2) * w(2);
+        const Scalar bxy = b * w(0) * w(1), bxz = b * w(0) * w(2), byz = b * w(1) * w(2);
+        const Scalar ax = a * w(0), ay = a * w(1), az = a * w(2);
+        Eigen::Matrix<Scalar, 3, 3> M;
+        M << Scalar(1) - b * (yy + zz), bxy - az, bxz + ay,
+            bxy + az, Scalar(1) - b * (xx + zz), byz - ax,
+            bxz - ay, byz + ax, Scalar(1) - b * (xx + yy);
+        return M;
+    }
+
+    /** @fn Matrix3 expSO3(const MatrixBase<Derived> &phi)
+     *  @brief exponential map of so(3) (Rodrigues formula)
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> expSO3(const Eigen::MatrixBase<Derived> &phi)
+    {
+        EIGEN_STATIC_ASSERT_VECTOR_SPECIFIC_SIZE(Derived, 3);
+        typedef typename Derived::Scalar Scalar;
+        const Eigen::Matrix<Scalar, 3, 1> w = phi;
+        const SO3Coefficients<Scalar> k(w.squaredNorm());
+        return rodrigues(w, k.a, k.b);
+    }
+
+    /** @fn Vector3 logSO3(const MatrixBase<Derived> &R)
+     *  @brief logarithmic map of SO(3), well conditioned over the whole range [0, pi]
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 1> logSO3(const Eigen::MatrixBase<Derived> &R)
+    {
+        typedef typename Derived::Scalar Scalar;
+        using std::atan2;
+        using std::sqrt;
+        const Eigen::Matrix<Scalar, 3, 3> Rm = R;
+        Scalar cos_t = (Rm.trace() - Scalar(1)) / Scalar(2);
+        cos_t = cos_t > Scalar(1) ? Scalar(1) : (cos_t < Scalar(-1) ? Scalar(-1) : cos_t);
+        const Eigen::Matrix<Scalar, 3, 1> w = Scalar(0.5) * Eigen::Matrix<Scalar, 3, 1>(Rm(2, 1) - Rm(1, 2), Rm(0, 2) - Rm(2, 0), Rm(1, 0) - Rm(0, 1));
+        const Scalar sin2 = w.squaredNorm();
+        const Scalar th = SmallAngle<Scalar>::threshold();
+        if (cos_t > Scalar(0) && sin2 < th * th)
+        {
+            //theta/sin(theta) = asin(s)/s = 1 + s^2/6 + 3 s^4/40 with s = sin(theta)
+            return (Scalar(1) + sin2 / Scalar(6) + Scalar(3) / Scalar(40) * sin2 * sin2) * w;
+        }
+        const Scalar sin_t = sqrt(sin2);
+        const Scalar theta = atan2(sin_t, cos_t);
+        if (cos_t > Scalar(-0.99))
+            return (theta / sin_t) * w;
+
+        //Close to pi the antisymmetric part vanishes, recover the axis from the symmetric part
+        Eigen::Matrix<Scalar, 3, 3> B = Scalar(0.5) * (Rm + Rm.transpose());
+        B.diagonal().array() -= cos_t;
+        int i;
+        B.diagonal().maxCoeff(&i);
+        Eigen::Matrix<Scalar, 3, 1> axis = B.col(i) / sqrt(B(i, i) * (Scalar(1) - cos_t));
+        if (axis.dot(w) < Scalar(0))
+            axis = -axis;
+        return theta * axis;
+    }
+
+    /** @fn Vector3 logSO3(const Quaternion<Scalar> &q)
+     *  @brief logarithmic map of a (not necessarily unit) quaternion, the shortest rotation is returned
+    */
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 3, 1> logSO3(const Eigen::Quaternion<Scalar> &q)
+    {
+        using std::atan2;
+        using std::sqrt;
+        Eigen::Matrix<Scalar, 3, 1> v = q.vec();
+        Scalar w = q.w();
+        if (w < Scalar(0))
+        {
+            v = -v;
+            w = -w;
+        }
+        const Scalar n2 = v.squaredNorm();
+        const Scalar th = SmallAngle<Scalar>::threshold();
+        if (n2 < th * th * w * w)
+        {
+            //2 atan(n/w)/n = 2/w (1 - n^2/(3 w^2) + n^4/(5 w^4))
+            const Scalar r2 = n2 / (w * w);
+            return (Scalar(2) / w * (Scalar(1) - r2 / Scalar(3) + r2 * r2 / Scalar(5))) * v;
+        }
+        const Scalar n = sqrt(n2);
+        return (Scalar(2) * atan2(n, w) / n) * v;
+    }
+
+    /** @fn Matrix3 leftJacobianSO3(const MatrixBase<Derived> &phi)
+     *  @brief left Jacobian of SO(3), exp(phi + d) = exp(Jl(phi) d) exp(phi) to first order
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> leftJacobianSO3(const Eigen::MatrixBase<Derived> &phi)
+    {
+        EIGEN_STATIC_ASSERT_VECTOR_SPECIFIC_SIZE(Derived, 3);
+        typedef typename Derived::Scalar Scalar;
+        const Eigen::Matrix<Scalar, 3, 1> w = phi;
+        const SO3Coefficients<Scalar> k(w.squaredNorm());
+        return rodrigues(w, k.b, k.c);
+    }
+
+    /** @fn Matrix3 rightJacobianSO3(const MatrixBase<Derived> &phi)
+     *  @brief right Jacobian of SO(3), Jr(phi) = Jl(-phi)
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> rightJacobianSO3(const Eigen::MatrixBase<Derived> &phi)
+    {
+        return leftJacobianSO3(-phi);
+    }
+
+    /** @fn Matrix3 leftJacobianInverseSO3(const MatrixBase<Derived> &phi)
+     *  @brief closed form inverse of the left Jacobian of SO(3)
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> leftJacobianInverseSO3(const Eigen::MatrixBase<Derived> &phi)
+    {
+        EIGEN_STATIC_ASSERT_VECTOR_SPECIFIC_SIZE(Derived, 3);
+        typedef typename Derived::Scalar Scalar;
+        using std::cos;
+        using std::sin;
+        using std::sqrt;
+        const Eigen::Matrix<Scalar, 3, 1> w = phi;
+        const Scalar theta2 = w.squaredNorm();
+        const Scalar th = SmallAngle<Scalar>::threshold();
+        Scalar d;
+        if (theta2 < th * th)
+            d = Scalar(1) / Scalar(12) + theta2 / Scalar(720) + theta2 * theta2 / Scalar(30240);
+        else
+        {
+            //(1 + cos(theta)) / sin(theta) as cot(theta/2), the former cancels close to pi
+            const Scalar theta = sqrt(theta2);
+            const Scalar half = theta / Scalar(2);
+            d = Scalar(1) / theta2 - cos(half) / (Scalar(2) * theta * sin(half));
+        }
+        return rodrigues(w, Scalar(-0.5), d);
+    }
+
+    /** @fn Matrix3 rightJacobianInverseSO3(const MatrixBase<Derived> &phi)
+     *  @brief closed form inverse of the right Jacobian of SO(3)
+    */
+    template <typename Derived>
+    inline Eigen::Matrix<typename Derived::Scalar, 3, 3> rightJacobianInverseSO3(const Eigen::MatrixBase<Derived> &phi)
+    {
+        return leftJacobianInverseSO3(-phi);
+    }
+
+    /// Compile-time sizes of SE_K(3) deduced from a tangent vector (rows 3 + 3K) or a group element (rows 3 + K)
+    template <typename Derived>
+    struct SEK3Tangent
+    {
+        typedef typename Derived::Scalar Scalar;
+        enum
+        {
+            K = Derived::RowsAtCompileTime / 3 - 1,
+            Dim = 3 + 3 * K,
+            GroupDim = 3 + K
+        };
+        typedef Eigen::Matrix<Scalar, GroupDim, GroupDim> Group;
+        typedef Eigen::Matrix<Scalar, Dim, 1> Tangent;
+        typedef Eigen::Matrix<Scalar, Dim, Dim> Jacobian;
+    };
+
+    template <typename Derived>
+    struct SEK3Group
+    {
+        typedef typename Derived::Scalar Scalar;
+        enum
+        {
+            K = Derived::RowsAtCompileTime - 3,
+            Dim = 3 + 3 * K,
+            GroupDim = 3 + K
+        };
+        typedef Eigen::Matrix<Scalar, GroupDim, GroupDim> Group;
+        typedef Eigen::Matrix<Scalar, Dim, 1> Tangent;
+        typedef Eigen::Matrix<Scalar, Dim, Dim> Jacobian;
+    };
+
+    /** @fn Group expSEK3(const MatrixBase<Derived> &xi)
+     *  @brief exponential map of se_K(3), the rotation and the K left Jacobian products share one set of coefficients
+    */
+    template <typename Derived>
+    inline typename SEK3Tangent<Derived>::Group expSEK3(const Eigen::MatrixBase<Derived> &xi)
+    {
+        typedef SEK3Tangent<Derived> T;
+        typedef typename T::Scalar Scalar;
+        EIGEN_STATIC_ASSERT(int(T::K) >= 1 && int(Derived::RowsAtCompileTime) == int(T::Dim) && int(Derived::ColsAtCompileTime) == 1,
+                            YOU_MIXED_MATRICES_OF_DIFFERENT_SIZES);
+        const Eigen::Matrix<Scalar, 3, 1> w = xi.template head<3>();
+        const SO3Coefficients<Scalar> k(w.squaredNorm());
+        const Eigen::Matrix<Scalar, 3, 3> Jl = rodrigues(w, k.b, k.c);
+
+        typename T::Group X = T::Group::Identity();
+        X.template topLeftCorner<3, 3>() = rodrigues(w, k.a, k.b);
+        for (int i = 0; i < T::K; i++)
+            X.template block<3, 1>(0, 3 + i).noalias() = Jl * xi.template segment<3>(3 + 3 * i);
+        return X;
+    }
+
+    /** @fn Tangent logSEK3(const MatrixBase<Derived> &X)
+     *  @brief logarithmic map of SE_K(3)
+    */
+    template <typename Derived>
+    inline typename SEK3Group<Derived>::Tangent logSEK3(const Eigen::MatrixBase<Derived> &X)
+    {
+        typedef SEK3Group<Derived> T;
+        typedef typename T::Scalar Scalar;
+        EIGEN_STATIC_ASSERT(int(T::K) >= 1 && int(Derived::ColsAtCompileTime) == int(T::GroupDim), YOU_MIXED_MATRICES_OF_DIFFERENT_SIZES);
+        typename T::Tangent xi;
+        const Eigen::Matrix<Scalar, 3, 1> w = logSO3(X.template topLeftCorner<3, 3>());
+        xi.template head<3>() = w;
+        const Eigen::Matrix<Scalar, 3, 3> Jinv = leftJacobianInverseSO3(w);
+        for (int i = 0; i < T::K; i++)
+            xi.template segment<3>(3 + 3 * i).noalias() = Jinv * X.template block<3, 1>(0, 3 + i);
+        return xi;
+    }
+
+    /** @fn Jacobian adjointSEK3(const MatrixBase<Derived> &X)
+     *  @brief adjoint of SE_K(3): R on the diagonal and skew(x_i) R under it
+    */
+    template <typename Derived>
+    inline typename SEK3Group<Derived>::Jacobian adjointSEK3(const Eigen::MatrixBase<Derived> &X)
+    {
+        typedef SEK3Group<Derived> T;
+        typedef typename T::Scalar Scalar;
+        EIGEN_STATIC_ASSERT(int(T::K) >= 1 && int(Derived::ColsAtCompileTime) == int(T::GroupDim), YOU_MIXED_MATRICES_OF_DIFFERENT_SIZES);
+        typename T::Jacobian Ad = T::Jacobian::Zero();
+        const Eigen::Matrix<Scalar, 3, 3> R = X.template topLeftCorner<3, 3>();
+        Ad.template topLeftCorner<3, 3>() = R;
+        for (int i = 0; i < T::K; i++)
+        {
+            Ad.template block<3, 3>(3 + 3 * i, 3 + 3 * i) = R;
+            Ad.template block<3, 3>(3 + 3 * i, 0).noalias() = skew(X.template block<3, 1>(0, 3 + i)) * R;
+        }
+        return Ad;
+    }
+
+    /** @fn Matrix3 leftJacobianQ(const Vector3 &phi, const Vector3 &rho, const SO3Coefficients<Scalar> &k)
+     *  @brief coupling block of the left Jacobian of SE_K(3) between phi and one rho_i
+    */
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 3, 3> leftJacobianQ(const Eigen::Matrix<Scalar, 3, 1> &phi, const Eigen::Matrix<Scalar, 3, 1> &rho,
+                                                     const SO3Coefficients<Scalar> &k)
+    {
+        using std::cos;
+        using std::sin;
+        using std::sqrt;
+        const Scalar th = SmallAngle<Scalar>::threshold();
+        Scalar e, f;
+        if (k.theta2 < th * th)
+        {
+            const Scalar t4 = k.theta2 * k.theta2;
+            e = Scalar(1) / Scalar(24) - k.theta2 / Scalar(720) + t4 / Scalar(40320);
+            f = Scalar(1) / Scalar(120) - k.theta2 / Scalar(2520) + t4 / Scalar(120960);
+        }
+        else
+        {
+            const Scalar theta = sqrt(k.theta2);
+            const Scalar t4 = k.theta2 * k.theta2;
+            e = (k.theta2 + Scalar(2) * cos(theta) - Scalar(2)) / (Scalar(2) * t4);
+            f = (Scalar(2) * theta - Scalar(3) * sin(theta) + theta * cos(theta)) / (Scalar(2) * t4 * theta);
+        }
+        const Eigen::Matrix<Scalar, 3, 3> P = skew(phi);
+        const Eigen::Matrix<Scalar, 3, 3> Rh = skew(rho);
+        const Eigen::Matrix<Scalar, 3, 3> PR = P * Rh;
+        const Eigen::Matrix<Scalar, 3, 3> RP = Rh * P;
+        const Eigen::Matrix<Scalar, 3, 3> PRP = PR * P;
+        return Scalar(0.5) * Rh + k.c * (PR + RP + PRP) + e * (P * PR + RP * P - Scalar(3) * PRP) + f * (PRP * P + P * PRP);
+    }
+
+    /** @fn Jacobian leftJacobianSEK3(const MatrixBase<Derived> &xi)
+     *  @brief left Jacobian of SE_K(3), exp(xi + d) = exp(Jl(xi) d) exp(xi) to first order
+    */
+    template <typename Derived>
+    inline typename SEK3Tangent<Derived>::Jacobian leftJacobianSEK3(const Eigen::MatrixBase<Derived> &xi)
+    {
+        typedef SEK3Tangent<Derived> T;
+        typedef typename T::Scalar Scalar;
+        EIGEN_STATIC_ASSERT(int(T::K) >= 1 && int(Derived::RowsAtCompileTime) == int(T::Dim) && int(Derived::ColsAtCompileTime) == 1,
+                            YOU_MIXED_MATRICES_OF_DIFFERENT_SIZES);
+        const Eigen::Matrix<Scalar, 3, 1> w = xi.template head<3>();
+        const SO3Coefficients<Scalar> k(w.squaredNorm());
+        const Eigen::Matrix<Scalar, 3, 3> Jl = rodrigues(w, k.b, k.c);
+
+        typename T::Jacobian J = T::Jacobian::Zero();
+        J.template topLeftCorner<3, 3>() = Jl;
+        for (int i = 0; i < T::K; i++)
+        {
+            J.template block<3, 3>(3 + 3 * i, 3 + 3 * i) = Jl;
+            J.template block<3, 3>(3 + 3 * i, 0) = leftJacobianQ<Scalar>(w, xi.template segment<3>(3 + 3 * i), k);
+        }
+        return J;
+    }
+
+    /** @fn Jacobian rightJacobianSEK3(const MatrixBase<Derived> &xi)
+     *  @brief right Jacobian of SE_K(3), Jr(xi) = Jl(-xi)
+    */
+    template <typename Derived>
+    inline typename SEK3Tangent<Derived>::Jacobian rightJacobianSEK3(const Eigen::MatrixBase<Derived> &xi)
+    {
+        const typename SEK3Tangent<Derived>::Tangent minus_xi = -xi;
+        return leftJacobianSEK3(minus_xi);
+    }
+
+    /** @fn Jacobian leftJacobianInverseSEK3(const MatrixBase<Derived> &xi)
+     *  @brief inverse of the left Jacobian of SE_K(3) from its block structure, no dense inversion
+    */
+    template <typename Derived>
+    inline typename SEK3Tangent<Derived>::Jacobian leftJacobianInverseSEK3(const Eigen::MatrixBase<Derived> &xi)
+    {
+        typedef SEK3Tangent<Derived> T;
+        typedef typename T::Scalar Scalar;
+        EIGEN_STATIC_ASSERT(int(T::K) >= 1 && int(Derived::RowsAtCompileTime) == int(T::Dim) && int(Derived::ColsAtCompileTime) == 1,
+                            YOU_MIXED_MATRICES_OF_DIFFERENT_SIZES);
+        const Eigen::Matrix<Scalar, 3, 1> w = xi.template head<3>();
+        const SO3Coefficients<Scalar> k(w.squaredNorm());
+        const Eigen::Matrix<Scalar, 3, 3> Jinv = leftJacobianInverseSO3(w);
+
+        typename T::Jacobian J = T::Jacobian::Zero();
+        J.template topLeftCorner<3, 3>() = Jinv;
+        for (int i = 0; i < T::K; i++)
+        {
+            J.template block<3, 3>(3 + 3 * i, 3 + 3 * i) = Jinv;
+            J.template block<3, 3>(3 + 3 * i, 0).noalias() = -Jinv * leftJacobianQ<Scalar>(w, xi.template segment<3>(3 + 3 * i), k) * Jinv;
+        }
+        return J;
+    }
+
+    /** @fn Jacobian rightJacobianInverseSEK3(const MatrixBase<Derived> &xi)
+     *  @brief inverse of the right Jacobian of SE_K(3)
+    */
+    template <typename Derived>
+    inline typename SEK3Tangent<Derived>::Jacobian rightJacobianInverseSEK3(const Eigen::MatrixBase<Derived> &xi)
+    {
+        const typename SEK3Tangent<Derived>::Tangent minus_xi = -xi;
+        return leftJacobianInverseSEK3(minus_xi);
+    }
+
+    /// SE(3) is SE_1(3) with the tangent ordered [phi; rho]
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 4, 4> expSE3(const Eigen::Matrix<Scalar, 6, 1> &xi)
+    {
+        return expSEK3(xi);
+    }
+
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 6, 1> logSE3(const Eigen::Matrix<Scalar, 4, 4> &X)
+    {
+        return logSEK3(X);
+    }
+
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 6, 6> adjointSE3(const Eigen::Matrix<Scalar, 4, 4> &X)
+    {
+        return adjointSEK3(X);
+    }
+
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 6, 6> leftJacobianSE3(const Eigen::Matrix<Scalar, 6, 1> &xi)
+    {
+        return leftJacobianSEK3(xi);
+    }
+
+    template <typename Scalar>
+    inline Eigen::Matrix<Scalar, 6, 6> rightJacobianSE3(const Eigen::Matrix<Scalar, 6, 1> &xi)
+    {
+        return rightJacobianSEK3(xi);
+    }
+} // namespace lie
+} // namespace serow
+#endif
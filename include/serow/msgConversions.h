@@ -0,0 +1,135 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Conversions from Eigen types to the ROS messages published by SEROW
+ * @author Stylianos Piperakis
+ * @details header and frame ids are left untouched so that preallocated messages keep them
+ */
+
+#ifndef MSGCONVERSIONS_H
+#define MSGCONVERSIONS_H
+#include <eigen3/Eigen/Dense>
+#include <geometry_msgs/Pose.h>
+#include <geometry_msgs/Twist.h>
+#include <geometry_msgs/Wrench.h>
+#include <geometry_msgs/Point.h>
+#include <nav_msgs/Odometry.h>
+#include <diagnostic_msgs/KeyValue.h>
+#include <sstream>
+#include "serow/PoseHistory.h"
+#include "serow/TrajectoryEvaluator.h"
+
+namespace serow
+{
+    inline void toPoint(geometry_msgs::Point &m, const Eigen::Vector3d &p)
+    {
+        m.x = p(0);
+        m.y = p(1);
+        m.z = p(2);
+    }
+
+    inline void toPose(geometry_msgs::Pose &m, const Eigen::Vector3d &p, const Eigen::Quaterniond &q)
+    {
+        toPoint(m.position, p);
+        m.orientation.x = q.x();
+        m.orientation.y = q.y();
+        m.orientation.z = q.z();
+        m.orientation.w = q.w();
+    }
+
+    inline void toTwist(geometry_msgs::Twist &m, const Eigen::Vector3d &v, const Eigen::Vector3d &w)
+    {
+        m.linear.x = v(0);
+        m.linear.y = v(1);
+        m.linear.z = v(2);
+        m.angular.x = w(0);
+        m.angular.y = w(1);
+        m.angular.z = w(2);
+    }
+
+    inline void toWrench(geometry_msgs::Wrench &m, const Eigen::Vector3d &f, const Eigen::Vector3d &t)
+    {
+        m.force.x = f(0);
+        m.force.y = f(1);
+        m.force.z = f(2);
+        m.torque.x = t(0);
+        m.torque.y = t(1);
+        m.torque.z = t(2);
+    }
+
+    inline void toWrench(geometry_msgs::Wrench &m, const double *f, const double *t)
+    {
+        toWrench(m, Eigen::Vector3d(f[0], f[1], f[2]), Eigen::Vector3d(t[0], t[1], t[2]));
+    }
+
+    inline void toOdometry(nav_msgs::Odometry &m, const PoseSample &s)
+    {
+        m.header.stamp.fromNSec(s.stamp_ns);
+        toPose(m.pose.pose, Eigen::Vector3d(s.pos[0], s.pos[1], s.pos[2]), Eigen::Quaterniond(s.q[0], s.q[1], s.q[2], s.q[3]));
+        toTwist(m.twist.twist, Eigen::Vector3d(s.vel[0], s.vel[1], s.vel[2]), Eigen::Vector3d(s.omega[0], s.omega[1], s.omega[2]));
+        for (int i = 0; i < 36; i++)
+        {
+            m.pose.covariance[i] = s.pose_cov[i];
+            m.twist.covariance[i] = s.twist_cov[i];
+        }
+    }
+
+    inline void appendKeyValue(std::vector<diagnostic_msgs::KeyValue> &values, const std::string &key, const serow::ErrorStats &e, double scale)
+    {
+        std::ostringstream value;
+        value << e.n << " / " << e.rmse() * scale << " / " << e.max * scale;
+        diagnostic_msgs::KeyValue kv;
+        kv.key = key;
+        kv.value = value.str();
+        values.push_back(kv);
+    }
+
+    /** @fn void toKeyValues(std::vector<diagnostic_msgs::KeyValue> &values, const std::string &name, const TrajectoryEvaluator &ev)
+     *  @brief appends the ATE and RPE of the current period and the total ATE of ev as count/rmse/max entries
+    */
+    inline void toKeyValues(std::vector<diagnostic_msgs::KeyValue> &values, const std::string &name, const TrajectoryEvaluator &ev)
+    {
+        const double deg = 180.0 / M_PI;
+        appendKeyValue(values, name + " ATE count/rmse/max [m]", ev.periodAte().trans, 1.0);
+        if (ev.hasOrientation())
+            appendKeyValue(values, name + " ATE rotation count/rmse/max [deg]", ev.periodAte().rot, deg);
+        for (int i = 0; i < ev.windowCount(); i++)
+        {
+            std::ostringstream key;
+            key << name << " RPE " << ev.window(i).length << " s";
+            appendKeyValue(values, key.str() + " count/rmse/max [m]", ev.window(i).period.trans, 1.0);
+            if (ev.hasOrientation())
+                appendKeyValue(values, key.str() + " rotation count/rmse/max [deg]", ev.window(i).period.rot, deg);
+        }
+        appendKeyValue(values, name + " total ATE count/rmse/max [m]", ev.ate().trans, 1.0);
+        if (ev.hasOrientation())
+            appendKeyValue(values, name + " total ATE rotation count/rmse/max [deg]", ev.ate().rot, deg);
+    }
+} // namespace serow
+#endif
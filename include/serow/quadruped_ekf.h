@@ -38,6 +38,9 @@
 // ROS Headers
 #include <serow/robotDyn.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
 
 // Estimator Headers
 #include <serow/IMUinEKFQuad.h>
@@ -61,26 +64,115 @@
 #include <nav_msgs/Odometry.h>
 
 #include <dynamic_reconfigure/server.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Trigger.h>
 #include <serow/VarianceControlConfig.h>
 #include <serow/mediator.h>
 #include <serow/differentiator.h>
 #include <serow/Madgwick.h>
 #include <serow/Mahony.h>
+#include <serow/ImuRingBuffer.h>
 #include <serow/deadReckoningQuad.h>
 #include <serow/ContactDetectionQuad.h>
+#include <serow/TripleBuffer.h>
+#include <serow/StageProfiler.h>
+#include <serow/PerfCounters.h>
+#include <serow/TraceRecorder.h>
+#include <serow/AllocationCounter.h>
+#include <serow/RealtimeThread.h>
+#include <serow/DeadlineGovernor.h>
+#include <serow/SharedEstimate.h>
+#include <serow/PoseHistory.h>
+#include <serow/Checkpoint.h>
+#include <serow/ImuBiasCalibrator.h>
+#include <serow/TrajectoryEvaluator.h>
+#include <serow/LookupPose.h>
+#include <serow/Telemetry.h>
+#include <serow/SharedSensors.h>
+#include <serow/Estimator.h>
+#include <serow/NoiseParameters.h>
+#include <thread>
+#include <atomic>
 
 using namespace Eigen;
 using namespace std;
 
+/**
+ * @brief Snapshot of everything the quadruped estimator publishes in one cycle
+ * @details filled by the estimator thread and handed to the publisher thread through a TripleBuffer
+ */
+struct QuadrupedEstimate
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	ros::Time stamp;
+	///Stamp of the IMU measurement the estimate was computed from
+	ros::Time sensor_stamp;
+	///Base from the rigid body EKF
+	Vector3d base_pos, base_vel, base_acc, base_gyro;
+	Quaterniond base_q;
+	///Base from leg odometry
+	Vector3d lo_pos, lo_vel, lo_omega;
+	Quaterniond lo_q;
+	///Feet in the world frame and relative to the base
+	Vector3d pwLF, pwLH, pwRF, pwRH, vwLF, vwLH, vwRF, vwRH, omegawLF, omegawLH, omegawRF, omegawRH;
+	Vector3d pbLF, pbLH, pbRF, pbRH, pws;
+	Quaterniond qwLF, qwLH, qwRF, qwRH, qbLF, qbLH, qbRF, qbRH, qws;
+	std::string support_leg;
+	Vector3d LFLegGRF, LHLegGRF, RFLegGRF, RHLegGRF, LFLegGRT, LHLegGRT, RFLegGRT, RHLegGRT;
+	///CoM EKF
+	Vector3d com_pos, com_vel, com_force, com_leg_odom, com_rel, cop;
+	///Filtered joint states
+	VectorXd joint_pos, joint_vel;
+	///Aligned ground-truth and comparison odometry
+	Vector3d gt_pos, gt_com_pos, gt_com_vel, gt_com_omega;
+	Quaterniond gt_q, gt_com_q;
+	bool comp_odom0_valid;
+	///Degradation level of the deadline governor when the estimate was computed
+	int degradation;
+	Vector3d comp_pos, comp_vel, comp_omega;
+	Quaterniond comp_q;
+};
+
 class quadruped_ekf{
 private:
 	///ROS Standard Variables
-	ros::NodeHandle n;
+	ros::NodeHandle n, n_p;
+	///Callback queue served by run(), NULL serves the global queue with ros::spinOnce()
+	ros::CallbackQueue* callbackQueue;
+	///Publish shared pointers so that subscribers in the same process receive the message without serialization
+	bool intraProcess;
+	///Stepped by a serow_host worker, which also publishes and owns the thread scheduling
+	bool hosted;
+	std::atomic<bool> stopRequested;
+	template <typename M>
+	void publishMsg(const ros::Publisher &pub, boost::shared_ptr<M> &ptr, const M &msg)
+	{
+		if (!intraProcess)
+		{
+			pub.publish(msg);
+			return;
+		}
+		//a message still queued for a subscriber must not change, publish a fresh one instead
+		if (!ptr || !ptr.unique())
+			ptr = boost::make_shared<M>(msg);
+		else
+			*ptr = msg;
+		pub.publish(ptr);
+	}
 	ros::Publisher supportPose_est_pub, bodyAcc_est_pub, LFLeg_odom_pub, LHLeg_odom_pub, RFLeg_odom_pub, RHLeg_odom_pub,
 	support_leg_pub, RFLeg_est_pub, RHLeg_est_pub, LFLeg_est_pub, LHLeg_est_pub, COP_pub, joint_filt_pub, rel_CoMPose_pub,
 	external_force_filt_pub, odom_est_pub, leg_odom_pub, ground_truth_com_pub, CoM_odom_pub, 
 	CoM_leg_odom_pub, ground_truth_odom_pub, ds_pub, 
 	rel_LFLegPose_pub, rel_LHLegPose_pub, rel_RFLegPose_pub, rel_RHLegPose_pub, comp_odom0_pub;
+	///Messages handed to the publishers in intra-process mode, reused once the subscribers released them
+	boost::shared_ptr<geometry_msgs::WrenchStamped> LFLeg_est_ptr, LHLeg_est_ptr, RFLeg_est_ptr, RHLeg_est_ptr, external_force_filt_ptr;
+	boost::shared_ptr<geometry_msgs::PointStamped> COP_ptr;
+	boost::shared_ptr<nav_msgs::Odometry> CoM_odom_ptr, CoM_leg_odom_ptr, odom_est_ptr, leg_odom_ptr, ground_truth_com_ptr, ground_truth_odom_ptr, comp_odom0_ptr, LFLeg_odom_ptr, LHLeg_odom_ptr, RFLeg_odom_ptr, RHLeg_odom_ptr;
+	boost::shared_ptr<geometry_msgs::PoseStamped> rel_CoMPose_ptr, supportPose_est_ptr, rel_LFLegPose_ptr, rel_LHLegPose_ptr, rel_RFLegPose_ptr, rel_RHLegPose_ptr;
+	boost::shared_ptr<sensor_msgs::JointState> joint_filt_ptr;
+	boost::shared_ptr<sensor_msgs::Imu> bodyAcc_est_ptr;
+	boost::shared_ptr<std_msgs::Int32> ds_ptr;
+	boost::shared_ptr<std_msgs::String> support_leg_ptr;
     
 	ros::Subscriber imu_sub, joint_state_sub, LFft_sub, LHft_sub, RFft_sub, RHft_sub, odom_sub, 
 	ground_truth_odom_sub, ds_sub, ground_truth_com_sub, support_idx_sub, compodom0_sub;
@@ -102,13 +194,19 @@ private:
 	serow::Madgwick* mw;
     serow::Mahony* mh;
     double Kp, Ki;
-	Vector3d bias_a,bias_g;
-	int imuCalibrationCycles,maxImuCalibrationCycles;
-	bool imuCalibrated;
+	///Raw IMU samples for the attitude filter, consumed at the native IMU rate
+	serow::ImuRingBuffer<256> imuBuffer;
+	double imu_native_freq, last_imu_stamp;
+	int imu_queue_size;
+	bool firstImuSample;
+	int maxImuCalibrationCycles;
+	///Online IMU bias calibration, enabled with calibrateIMUbiases, refines the bias priors while the IMU is still
+	bool imuCalibrated, imuBiasesRefined, imuBiasesReport, imuBiasesRestored;
+	serow::ImuBiasCalibrator imuBiasCalibrator;
+	double no_motion_gyro_threshold, no_motion_acc_threshold;
 	///Leg Odometry Computation
 	serow::deadReckoningQuad* dr;
 	///Joint State Estimator 
-  	std::map<std::string, double> joint_state_pos_map, joint_state_vel_map;
 	JointDF** JointVF;
 	double jointFreq,joint_cutoff_freq;
 
@@ -133,13 +231,95 @@ private:
 	Quaterniond  q_B_P, q_B_GT, tempq, qoffsetGTCoM, tempq_, gt_odomq; 
 	bool useCoMEKF, useLegOdom, firstGT,firstGTCoM, useOutlierDetection;
     bool debug_mode;
+	///Asynchronous publishing of the estimates
+	serow::TripleBuffer<QuadrupedEstimate> estimateBuffer;
+	std::thread publisherThread;
+	std::atomic<bool> publisherRunning;
+	bool usePublisherThread;
+	unsigned long publish_cycle;
+	int joint_pub_decimation, body_pub_decimation, leg_pub_decimation, support_pub_decimation,
+	contact_pub_decimation, grf_pub_decimation, com_pub_decimation;
+	std::vector<std::string> joint_names;
+	///Real-time mode, estimator cycles after the warm up are checked for heap allocations
+	bool rt_mode, rt_abort_on_allocation;
+	int rt_warmup_cycles;
+	unsigned long rt_cycle;
+	///Scheduling, CPU affinity and memory locking of the estimator and publisher threads
+	std::string rt_sched_policy;
+	int rt_priority, rt_stack_prefault;
+	bool rt_lock_memory;
+	std::vector<int> estimator_cpus, publisher_cpus;
+	///Deadline monitor, steps the estimator down when cycles overrun the IMU period
+	serow::DeadlineGovernor governor;
+	int degraded_pub_decimation, degraded_com_decimation, com_step, com_cycle;
+	bool comSuspended;
+	///Latest estimate in shared memory for controllers on the same host
+	serow::SharedEstimateWriter shmEstimate;
+	///Binary telemetry of the estimates, converted with serow_telemetry_csv
+	serow::Telemetry telemetry;
+	int tlmBase, tlmCoM;
+	///Noise and threshold sets from the dynamic reconfigure thread, applied at the start of a cycle
+	boost::shared_ptr< dynamic_reconfigure::Server<serow::VarianceControlConfig> > dynamic_recfg_;
+	serow::VersionedParams<serow::EstimatorParams> noiseParams;
+	bool useDynamicReconfigure;
+	///Stamped base estimates for lookups at sensor times, in shared memory when pose_history_shm_name is set
+	serow::PoseHistory poseHistory;
+	std::string pose_history_shm_name;
+	ros::ServiceServer lookup_pose_srv;
+	///Streaming ATE/RPE of the base and CoM against the aligned ground truth, summarized every evaluation_period s
+	bool useEvaluation;
+	serow::TrajectoryEvaluator baseEvaluator, comEvaluator;
+	double evaluation_period;
+	ros::Time last_evaluation;
+	ros::Publisher evaluation_pub;
+	///Warm restart state, saved every checkpoint_period s and on exit to checkpoint_file and restored at startup
+	std::string checkpoint_file;
+	double checkpoint_period, last_checkpoint_time;
+	serow::Checkpoint checkpoint, restored;
+	serow::CheckpointWriter checkpointWriter;
+	std::string shm_estimate_name;
+	uint64_t shm_cycle;
+	///Sensor input backend, "ros" subscribes to the sensor topics, "shm" reads the shared memory ring
+	std::string sensor_input, shm_sensor_name;
+	serow::SharedSensorReader sensorRing;
+	serow::SharedSensorFrame sensorFrame;
+	sensor_msgs::Imu shm_imu_msg;
+	sensor_msgs::JointState shm_joint_msg;
+	geometry_msgs::WrenchStamped shm_wrench_msg;
+	///Per stage timing, compiled in with SEROW_PROFILING
+	enum ProfiledStage
+	{
+		AttitudeStage,
+		KinematicsStage,
+		BaseStage,
+		CoMStage,
+		HandoffStage,
+		PublishStage,
+		CycleStage,
+		LatencyStage
+	};
+	///Event trace of the last trace_buffer_size events, written to trace_file on request and on exit
+	serow::TraceRecorder tracer;
+	std::string trace_file;
+	ros::ServiceServer dump_trace_srv;
+#ifdef SEROW_PROFILING
+	serow::StageProfiler profiler;
+	///Hardware counters of the estimator thread stages, opened when perf_counters is set
+	serow::PerfCounters perfCounters;
+	bool usePerfCounters;
+	ros::Publisher diagnostics_pub;
+	double diagnostics_period;
+	ros::Time last_diagnostics;
+#endif
 
 	//ROS Messages
 	sensor_msgs::JointState joint_state_msg, joint_filt_msg;
 	sensor_msgs::Imu imu_msg;
 	nav_msgs::Odometry odom_msg, odom_msg_, odom_est_msg, leg_odom_msg, ground_truth_odom_msg, LFLeg_odom_msg, LHLeg_odom_msg, RFLeg_odom_msg, RHLeg_odom_msg,
 	ground_truth_com_odom_msg, CoM_odom_msg, ground_truth_odom_msg_, ground_truth_odom_pub_msg;
-	geometry_msgs::PoseStamped pose_msg, pose_msg_, temp_pose_msg, rel_supportPose_msg, rel_swingPose_msg;
+	geometry_msgs::PoseStamped pose_msg, pose_msg_, temp_pose_msg, rel_supportPose_msg, rel_swingPose_msg,
+	rel_LFLegPose_msg, rel_LHLegPose_msg, rel_RFLegPose_msg, rel_RHLegPose_msg, rel_CoMPose_msg;
+	nav_msgs::Odometry ground_truth_com_pub_msg, comp_odom0_pub_msg;
 	std_msgs::String support_leg_msg;
 	geometry_msgs::WrenchStamped RFLeg_est_msg, LFLeg_est_msg, RHLeg_est_msg, LHLeg_est_msg, LFfsr_msg, LHfsr_msg, RFfsr_msg, RHfsr_msg, external_force_filt_msg;
    
@@ -158,12 +338,14 @@ private:
 
 	
 
-    boost::shared_ptr< dynamic_reconfigure::Server<serow::VarianceControlConfig> > dynamic_recfg_;
-
 	double mass;
 	IMUinEKFQuad* imuInEKF;
 	bool useInIMUEKF;
 	CoMEKF* nipmEKF;
+	///Attitude, base, contact and CoM estimators composed by value, the component pointers alias its members
+	serow::EstimatorPipeline* pipeline;
+	///Estimation cycle instantiated for the composed pipeline, selected once in init()
+	void (quadruped_ekf::*estimationCycle)();
 	butterworthLPF** gyroLPF;
 	MovingAverageFilter** gyroMAF;
 	///Cuttoff Freqs for LPF
@@ -211,6 +393,10 @@ private:
 	 string odom_topic;
 	 string ground_truth_odom_topic, ground_truth_com_topic, support_idx_topic;
      string modelname;
+     ///generated kinematics library, empty to use Pinocchio
+     string kinematics_library;
+     ///parsed models are cached here, keyed by the URDF content, empty disables the cache
+     string model_cache_dir;
 
      void subscribeToIMU();
 	 void subscribeToFSR();
@@ -222,41 +408,160 @@ private:
 	 void subscribeToSupportIdx();
 	 void support_idxCb(const std_msgs::Int32::ConstPtr& msg);
 	 void ground_truth_odomCb(const nav_msgs::Odometry::ConstPtr& msg);
+	 /** @fn void pollSharedSensors()
+	  *  @brief feeds the frames written to the shared memory ring since the last call to the sensor handlers
+	 */
+	 void pollSharedSensors();
+	 /** @fn bool openSensorRing()
+	  *  @brief attaches to the shared memory sensor ring and sizes the joint message to its joints
+	 */
+	 bool openSensorRing();
+	 /** @fn void waitForInputs()
+	  *  @brief returns once every configured input has a publisher, or the sensor ring exists, at most startup_timeout seconds
+	 */
+	 void waitForInputs();
+	 double startup_timeout;
 	 void imuCb(const sensor_msgs::Imu::ConstPtr& msg);
+	 void processImu(const sensor_msgs::Imu& msg);
 	 void joint_stateCb(const sensor_msgs::JointState::ConstPtr& msg);
+	 void processJointState(const sensor_msgs::JointState& msg);
 	 void odomCb(const nav_msgs::Odometry::ConstPtr& msg);
 	 void LFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processLFFSR(const geometry_msgs::WrenchStamped& msg);
 	 void LHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processLHFSR(const geometry_msgs::WrenchStamped& msg);
 	 void RFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processRFFSR(const geometry_msgs::WrenchStamped& msg);
 	 void RHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr& msg);
+	 void processRHFSR(const geometry_msgs::WrenchStamped& msg);
 
 
 	void computeGlobalCOP(Affine3d TwLF_, Affine3d TwLH_, Affine3d TwRF_, Affine3d TwRH_);
-	 void filterGyrodot();
+	 /** @fn void filterGyrodot(const Vector3d &gyro)
+	  *  @brief differentiates and low-passes the base gyro rate for the CoM estimator
+	 */
+	 void filterGyrodot(const Vector3d &gyro);
+	 /** @fn void updateAttitude(AttitudeFilter &filter)
+	  *  @brief integrates the buffered IMU samples with the attitude filter of the pipeline
+	 */
+	 template <class AttitudeFilter>
+	 void updateAttitude(AttitudeFilter &filter);
 	//private methods
 	void init();
 
-	void estimateWithCoMEKF();
-	void estimateWithIMUEKF();
-	void estimateWithInIMUEKF();
-
-
-
-
-	void computeKinTFs();
+	void estimateWithCoMEKF(CoMEKF &com, const IMUinEKFQuad &base);
+	/** @fn void scheduleCoMEKF(CoMEKF &com, const IMUinEKFQuad &base)
+	 *  @brief runs the CoM estimator at the rate the deadline governor allows, suspends it at the minimal level
+	*/
+	void scheduleCoMEKF(CoMEKF &com, const IMUinEKFQuad &base);
+	///Pipelines without CoM estimation
+	void scheduleCoMEKF(serow::NoCoMEstimation::None &, const IMUinEKFQuad &) {}
+	/** @fn void estimateBase(IMUinEKFQuad &base, serow::ContactDetectionQuad &detector)
+	 *  @brief predicts and updates the base filter of the pipeline
+	*/
+	void estimateBase(IMUinEKFQuad &base, serow::ContactDetectionQuad &detector);
+
+
+
+
+	template <class E>
+	void computeKinTFs(E &est);
+	/** @fn void runCycle()
+	 *  @brief runs one estimation cycle of the pipeline E, the stage selection is resolved at compile time
+	*/
+	template <class E>
+	void runCycle();
+	/** @fn void composeBase()
+	 *  @brief picks the contact and CoM policies from the parameters and allocates the pipeline once,
+	 *  every configuration of the node is instantiated here
+	*/
+	template <class AttitudePolicy>
+	void composeBase();
+	template <class AttitudePolicy, class BaseFilterPolicy>
+	void composeContact();
+	template <class AttitudePolicy, class BaseFilterPolicy, class ContactPolicy>
+	void composeCoM();
+	template <class E>
+	void bindPipeline();
 	//publish functions
-	void publishGRF();
-	void publishJointEstimates();
-	void publishCoMEstimates();
+	template <class CoMFilter>
+	void fillEstimate(QuadrupedEstimate &e, const IMUinEKFQuad &base, const CoMFilter &com);
+	void fillCoMEstimate(QuadrupedEstimate &e, const CoMEKF &com);
+	void fillCoMEstimate(QuadrupedEstimate &, const serow::NoCoMEstimation::None &) {}
+	void publishEstimates(const QuadrupedEstimate &e);
+	void publisherLoop();
+	void startPublisher();
+	void stopPublisher();
+	void publishGRF(const QuadrupedEstimate &e);
+	void publishJointEstimates(const QuadrupedEstimate &e);
+	void publishCoMEstimates(const QuadrupedEstimate &e);
 	void deAllocate();
-	void publishLegEstimates();
-	void publishSupportEstimates();
+	void publishLegEstimates(const QuadrupedEstimate &e);
+	void publishSupportEstimates(const QuadrupedEstimate &e);
 
-	void publishBodyEstimates();
-	void publishContact();
-	void publishCOP();
+	void publishBodyEstimates(const QuadrupedEstimate &e);
+	void publishContact(const QuadrupedEstimate &e);
+	void publishCOP(const QuadrupedEstimate &e);
 	// Advertise to ROS Topics
 	void advertise();
+	void initMessages();
+	void initProfiler();
+	void openPerfCounters();
+	/** @fn void configureEstimatorThread()
+	 *  @brief applies the scheduling, affinity and memory locking options to the thread calling run()
+	*/
+	void configureEstimatorThread();
+	void profileEstimate(const QuadrupedEstimate &e);
+	void reportProfiling();
+	bool dumpTraceCb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
+	void dumpTrace();
+	/** @fn void writeSharedEstimate(const QuadrupedEstimate &e, serow::ContactDetectionQuad &detector)
+	 *  @brief copies the base and CoM state of e and the contacts of detector to the shared memory channel
+	*/
+	void writeSharedEstimate(const QuadrupedEstimate &e, serow::ContactDetectionQuad &detector);
+	/** @fn void recordPose(const QuadrupedEstimate &e, const IMUinEKFQuad &base)
+	 *  @brief pushes the base pose and twist of e with the covariances of base to the pose history
+	*/
+	void recordPose(const QuadrupedEstimate &e, const IMUinEKFQuad &base);
+	/** @fn void evaluateEstimate(const QuadrupedEstimate &e)
+	 *  @brief feeds the base and CoM estimates of e to the trajectory evaluators, does not allocate
+	*/
+	void evaluateEstimate(const QuadrupedEstimate &e);
+	/** @fn void publishEvaluation()
+	 *  @brief publishes the errors of the last evaluation_period to /diagnostics, called by the ground truth callbacks
+	*/
+	void publishEvaluation();
+	/** @fn void loadCheckpoint()
+	 *  @brief reads checkpoint_file, restores the IMU biases as calibration priors and the attitude filter,
+	 *  the leg odometry, base and CoM filters pick up their blocks when they are initialized
+	*/
+	void loadCheckpoint();
+	/** @fn void applyImuBiases(IMUinEKFQuad &base)
+	 *  @brief hands the biases refined by the online calibration to the base filter, they initialize a filter
+	 *  that has not started, a running one fuses the gyro bias of the still window as a pseudo-measurement
+	*/
+	void applyImuBiases(IMUinEKFQuad &base);
+	/** @fn bool estimating()
+	 *  @brief true once the kinematics are initialized and the IMU biases are calibrated or restored
+	*/
+	bool estimating();
+	/** @fn void fillCheckpoint(serow::Checkpoint &c)
+	 *  @brief copies the biases, the attitude, the feet and the base/CoM filter states and covariances to c
+	*/
+	void fillCheckpoint(serow::Checkpoint &c);
+	bool lookupPoseCb(serow::LookupPose::Request &req, serow::LookupPose::Response &res);
+	/** @fn void logTelemetry(const QuadrupedEstimate &e)
+	 *  @brief pushes the base and CoM of e to the telemetry ring
+	*/
+	void logTelemetry(const QuadrupedEstimate &e);
+	/** @fn void startReconfigure()
+	 *  @brief starts the dynamic reconfigure server with the loaded noise parameters and thresholds
+	*/
+	void startReconfigure();
+	/** @fn void applyNoiseParams()
+	 *  @brief writes the latest published parameter set to the filters and the contact detector
+	*/
+	void applyNoiseParams();
 	void subscribe();
 
 public:
@@ -268,6 +573,47 @@ public:
 
 	// Connect/Disconnet to ALProxies
 	bool connect(const ros::NodeHandle nh);
+	/** @fn bool connect(const ros::NodeHandle nh, const ros::NodeHandle nh_p)
+	 *  @brief connects with nh and reads the parameters from the private handle nh_p, as needed by nodelets
+	*/
+	bool connect(const ros::NodeHandle nh, const ros::NodeHandle nh_p);
+	/** @fn void setCallbackQueue(ros::CallbackQueue* queue)
+	 *  @brief run() serves the subscriptions from queue instead of calling ros::spinOnce()
+	*/
+	void setCallbackQueue(ros::CallbackQueue* queue);
+	/** @fn void setIntraProcess(bool intraProcess_)
+	 *  @brief publish message shared pointers for zero-copy intra-process transport
+	*/
+	void setIntraProcess(bool intraProcess_);
+	/** @fn void stop()
+	 *  @brief makes run() return, safe to call from another thread
+	*/
+	void stop();
+	/** @fn void setHosted(bool hosted_)
+	 *  @brief to be called before connect() when a host process drives the estimator with begin(), step() and end()
+	 *  @details the estimates are then published by the thread calling step() and rt_mode is not available
+	*/
+	void setHosted(bool hosted_);
+	/** @fn void begin()
+	 *  @brief prepares the calling thread to step the estimator
+	*/
+	void begin();
+	/** @fn void step()
+	 *  @brief one iteration of the main loop without the sleep: a pending IMU sample is processed, then the callbacks
+	*/
+	void step();
+	/** @fn void end()
+	 *  @brief stops the publisher, reports and releases the estimator, on the thread that stepped it
+	*/
+	void end();
+	/** @fn double loopPeriod()
+	 *  @brief period in seconds at which step() is meant to be called
+	*/
+	double loopPeriod();
+	/** @fn bool running()
+	 *  @brief false once ROS shuts down or stop() is called
+	*/
+	bool running();
 
 	void disconnect();
 
@@ -37,12 +37,25 @@
 #include <pinocchio/multibody/model.hpp>
 #include <pinocchio/multibody/data.hpp>
 #include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/serialization/model.hpp>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <iostream>
 #include <Eigen/Dense>
+#include <serow/GeneratedKinematics.h>
 
 
 using namespace std;
@@ -58,26 +71,243 @@ namespace serow
         
         
     private:
-        pinocchio::Model *pmodel_;
+        ///The model is immutable once loaded and shared by all instances of the process, see acquireModel()
+        std::shared_ptr<const pinocchio::Model> model_;
+        const pinocchio::Model *pmodel_;
         pinocchio::Data *data_;
         std::vector<std::string> jnames_;
         Eigen::VectorXd qmin_, qmax_, dqmax_, q_, qdot_, qn;
         bool has_floating_base_;
+        ///Work buffers sized once in the constructor, so that kinematics do not allocate
+        pinocchio::Data::Matrix6x J_;
+        Eigen::MatrixXd Jg_, Jlin_, Jang_;
+        Eigen::VectorXd qpin_;
+        ///Configuration/velocity index and nq of every joint in the joint state message order, -1 if not in the model
+        std::vector<int> msg_qidx_, msg_vidx_, msg_nqs_;
+        std::vector<std::string> msg_names_;
+        ///Generated kinematics backend and its buffers, see loadGeneratedKinematics()
+        void *glib_;
+        const GeneratedKinematics *gk_;
+        Eigen::VectorXd gq_, gqdot_, gqn_;
+        std::vector<double> gpos_, grot_, gjac_;
+        ///Index of every joint in the joint state message order in the generated configuration, -1 if not generated
+        std::vector<int> msg_gidx_;
+
+        /** @fn int generatedFrame(const std::string &frame_name) const
+         *  @brief index of frame_name in the generated library, -1 if it was not generated
+        */
+        int generatedFrame(const std::string &frame_name) const
+        {
+            for (int f = 0; f < gk_->num_frames; f++)
+            {
+                if (frame_name.compare(gk_->frame_names[f]) == 0)
+                    return f;
+            }
+            return -1;
+        }
+
+        void mapGeneratedJoints()
+        {
+            msg_gidx_.assign(msg_names_.size(), -1);
+            if (!gk_)
+                return;
+            for (unsigned int i = 0; i < msg_names_.size(); i++)
+            {
+                for (int j = 0; j < gk_->num_joints; j++)
+                {
+                    if (msg_names_[i].compare(gk_->joint_names[j]) == 0)
+                        msg_gidx_[i] = j;
+                }
+            }
+        }
+
+        /** @fn void computeGeneratedKinematics(double joint_std)
+         *  @brief generated counterpart of computeKinematics(), frame poses and jacobians for the current gq_
+        */
+        void computeGeneratedKinematics(double joint_std)
+        {
+            gk_->frames(gq_.data(), &gpos_[0], &grot_[0], &gjac_[0]);
+            gqn_.setConstant(joint_std);
+        }
+
+        Eigen::Map<const Eigen::MatrixXd> generatedJacobian(int f) const
+        {
+            return Eigen::Map<const Eigen::MatrixXd>(&gjac_[6 * gk_->num_joints * f], 6, gk_->num_joints);
+        }
+
+        Eigen::Map<const Eigen::Matrix3d> generatedRotation(int f) const
+        {
+            return Eigen::Map<const Eigen::Matrix3d>(&grot_[9 * f]);
+        }
+
+        void invalidFrame(const std::string &frame_name) const
+        {
+            std::cerr << "WARNING: Frame name " << frame_name << " is not in the generated kinematics! ... "
+            <<  "Returning zeros" << std::endl;
+        }
+
+        /** @fn void computeKinematics(double joint_std)
+         *  @brief forward kinematics and joint jacobians for the current q_
+        */
+        void computeKinematics(double joint_std)
+        {
+            if (has_floating_base_)
+            {
+                // Change quaternion order: in Pinocchio it is
+                // (x,y,z,w)
+                qpin_ = q_;
+                qpin_[3] = q_[4];
+                qpin_[4] = q_[5];
+                qpin_[5] = q_[6];
+                qpin_[6] = q_[3];
+                //pinocchio::forwardKinematics(*pmodel_, *data_, qpin_);
+                pinocchio::framesForwardKinematics(*pmodel_, *data_, qpin_);
+                pinocchio::computeJointJacobians(*pmodel_, *data_, qpin_);
+
+            }
+            else
+            {                
+                pinocchio::framesForwardKinematics(*pmodel_, *data_, q_);
+                pinocchio::computeJointJacobians(*pmodel_, *data_, q_);
+                
+            }
+             qn.setOnes();
+             qn *= joint_std;
+        }
+        /** @fn std::string modelCachePath(const std::string &model_name, const std::string &cache_dir) const
+         *  @brief cache file of the model, keyed by a hash of the URDF content, empty if the URDF can not be read
+        */
+        std::string modelCachePath(const std::string &model_name, const std::string &cache_dir) const
+        {
+            std::ifstream urdf(model_name.c_str(), std::ios::binary);
+            if (!urdf)
+                return std::string();
+            //64-bit FNV-1a over the URDF, the base type and the Pinocchio version
+            uint64_t h = 14695981039346656037ULL;
+            std::ostringstream key;
+            key << urdf.rdbuf() << has_floating_base_;
+#ifdef PINOCCHIO_VERSION
+            key << PINOCCHIO_VERSION;
+#endif
+            const std::string &k = key.str();
+            for (size_t i = 0; i < k.size(); i++)
+            {
+                h ^= (unsigned char)k[i];
+                h *= 1099511628211ULL;
+            }
+            std::string base = model_name.substr(model_name.find_last_of('/') + 1);
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+            return cache_dir + "/" + base + "." + hex + ".bin";
+        }
+
+        /** @fn bool loadModel(const std::string &model_name, const std::string &cache_dir, bool verbose, pinocchio::Model &model)
+         *  @brief builds the model from the URDF, or deserializes it from cache_dir when the URDF did not change
+         *  @return true if the model came from the cache
+        */
+        bool loadModel(const std::string &model_name, const std::string &cache_dir, bool verbose, pinocchio::Model &model)
+        {
+            std::string cache = cache_dir.empty() ? std::string() : modelCachePath(model_name, cache_dir);
+            if (!cache.empty() && access(cache.c_str(), R_OK) == 0)
+            {
+                try
+                {
+                    model.loadFromBinary(cache);
+                    return true;
+                }
+                catch (std::exception &e)
+                {
+                    std::cerr << "WARNING: Model cache " << cache << " is unreadable, rebuilding it: " << e.what() << std::endl;
+                    model = pinocchio::Model();
+                }
+            }
+
+            if (has_floating_base_)
+                pinocchio::urdf::buildModel(model_name, pinocchio::JointModelFreeFlyer(),
+                                      model, verbose);
+            else
+                pinocchio::urdf::buildModel(model_name, model, verbose);
+
+            if (!cache.empty())
+            {
+                //Written aside and renamed, so a concurrent or interrupted start never reads a partial file
+                for (size_t i = 1; i <= cache_dir.size(); i++)
+                {
+                    if (i == cache_dir.size() || cache_dir[i] == '/')
+                        mkdir(cache_dir.substr(0, i).c_str(), 0755);
+                }
+                std::ostringstream tmp;
+                tmp << cache << ".tmp" << getpid();
+                try
+                {
+                    model.saveToBinary(tmp.str());
+                    if (rename(tmp.str().c_str(), cache.c_str()) != 0)
+                        remove(tmp.str().c_str());
+                }
+                catch (std::exception &e)
+                {
+                    std::cerr << "WARNING: Could not write the model cache " << cache << ": " << e.what() << std::endl;
+                    remove(tmp.str().c_str());
+                }
+            }
+            return false;
+        }
+
+        /** @fn std::shared_ptr<const pinocchio::Model> acquireModel(const std::string &model_name, const std::string &cache_dir, bool verbose, bool &cached, bool &shared)
+         *  @brief the model of model_name, loaded once per process and base type and shared by every robotDyn built from it
+         *  @details only the pinocchio::Data are per instance, the registry holds weak references so the model is
+         *  released with its last user. cached is true if it was deserialized from cache_dir, shared if it was already loaded.
+        */
+        std::shared_ptr<const pinocchio::Model> acquireModel(const std::string &model_name, const std::string &cache_dir, bool verbose, bool &cached, bool &shared)
+        {
+            static std::mutex registry_mutex;
+            static std::map<std::string, std::weak_ptr<const pinocchio::Model> > registry;
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            std::weak_ptr<const pinocchio::Model> &entry = registry[model_name + (has_floating_base_ ? "#floating" : "#fixed")];
+            std::shared_ptr<const pinocchio::Model> model = entry.lock();
+            cached = false;
+            shared = (bool)model;
+            if (shared)
+                return model;
+
+            //Not make_shared, pinocchio::Model needs its aligned operator new
+            std::shared_ptr<pinocchio::Model> loaded(new pinocchio::Model());
+            cached = loadModel(model_name, cache_dir, verbose, *loaded);
+            entry = loaded;
+            return loaded;
+        }
+
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-          
+        /** @fn static std::string defaultModelCacheDir()
+         *  @brief $ROS_HOME/serow, or ~/.ros/serow
+        */
+        static std::string defaultModelCacheDir()
+        {
+            if (getenv("ROS_HOME"))
+                return std::string(getenv("ROS_HOME")) + "/serow";
+            if (getenv("HOME"))
+                return std::string(getenv("HOME")) + "/.ros/serow";
+            return std::string();
+        }
+
+        /** @fn robotDyn(const std::string& model_name, const bool& has_floating_base, const bool& verbose = false, const std::string& cache_dir = "")
+         *  @brief loads the URDF model_name, with a non-empty cache_dir the parsed model is serialized there on the
+         *  first start and deserialized on the following ones, until the URDF changes
+        */
         robotDyn(const std::string& model_name,
-                 const bool& has_floating_base, const bool& verbose = false)
+                 const bool& has_floating_base, const bool& verbose = false, const std::string& cache_dir = "")
         {
             has_floating_base_ = has_floating_base;
-            pmodel_ = new pinocchio::Model();
-            
-            if (has_floating_base)
-                pinocchio::urdf::buildModel(model_name, pinocchio::JointModelFreeFlyer(),
-                                      *pmodel_, verbose);
-            else
-                pinocchio::urdf::buildModel(model_name, *pmodel_, verbose);
+            glib_ = NULL;
+            gk_ = NULL;
+
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            bool cached, shared;
+            model_ = acquireModel(model_name, cache_dir, verbose, cached, shared);
+            pmodel_ = model_.get();
             
             data_ = new pinocchio::Data(*pmodel_);
             
@@ -128,12 +358,112 @@ namespace serow
                     dqmax_[i] = 200.0;
                 }
             }
-            std::cout<<"Joint Names "<<std::endl;
-            printJointNames();
-	        std::cout<<"with "<<ndofActuated()<<" actuated joints"<<std::endl;
-            std::cout << "Model loaded: " << model_name << std::endl;
+            q_.setZero(pmodel_->nq);
+            qdot_.setZero(pmodel_->nv);
+            qpin_.setZero(pmodel_->nq);
+            J_.setZero(6, pmodel_->nv);
+            Jg_.setZero(6, has_floating_base_ ? pmodel_->nq : pmodel_->nv);
+            Jlin_.setZero(3, has_floating_base_ ? pmodel_->nq : pmodel_->nv);
+            Jang_.setZero(3, has_floating_base_ ? pmodel_->nq : pmodel_->nv);
+            if (verbose)
+            {
+                std::cout<<"Joint Names "<<std::endl;
+                printJointNames();
+            }
+            std::cout << "Model with " << ndofActuated() << " actuated joints loaded: " << model_name << (shared ? " shared" : cached ? " from the cache" : "") << " in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() << " ms" << std::endl;
 	
 	}
+
+        ~robotDyn()
+        {
+            unloadGeneratedKinematics();
+            delete data_;
+        }
+
+        /** @fn bool loadGeneratedKinematics(const std::string &library, std::string &report)
+         *  @brief switches the foot kinematics and the CoM to a library built by scripts/serow_kinematics_codegen.py
+         *  @details the library must be generated from the same URDF, its version, joint names and frames are
+         *  checked against the model, report holds the result. On a mismatch the library is unloaded and
+         *  Pinocchio stays in use. The numerical cross-check against Pinocchio is run offline with
+         *  serow_kinematics_check. Only the generated frames can be queried afterwards.
+        */
+        bool loadGeneratedKinematics(const std::string &library, std::string &report)
+        {
+            unloadGeneratedKinematics();
+            std::ostringstream out;
+            void *lib = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!lib)
+            {
+                report = dlerror();
+                return false;
+            }
+            GeneratedKinematicsEntry entry = (GeneratedKinematicsEntry)dlsym(lib, SEROW_GENERATED_KINEMATICS_ENTRY);
+            const GeneratedKinematics *gk = entry ? entry() : NULL;
+            if (!gk || gk->version != SEROW_GENERATED_KINEMATICS_VERSION)
+                out << library << " is not a generated kinematics library of this version";
+            else if (has_floating_base_ || gk->num_joints != pmodel_->nv)
+                out << library << " has " << gk->num_joints << " joints, the model " << pmodel_->nv;
+            else
+            {
+                for (int j = 0; j < gk->num_joints && out.str().empty(); j++)
+                {
+                    if (!pmodel_->existJointName(gk->joint_names[j]) || pmodel_->nvs[pmodel_->getJointId(gk->joint_names[j])] != 1)
+                        out << "joint " << gk->joint_names[j] << " of " << library << " does not match the model";
+                }
+                for (int f = 0; f < gk->num_frames && out.str().empty(); f++)
+                {
+                    if (!pmodel_->existFrame(gk->frame_names[f]))
+                        out << "frame " << gk->frame_names[f] << " of " << library << " is not in the model";
+                }
+            }
+            if (!out.str().empty())
+            {
+                report = out.str();
+                dlclose(lib);
+                return false;
+            }
+
+            glib_ = lib;
+            gk_ = gk;
+            int nj = gk_->num_joints;
+            gq_.setZero(nj);
+            gqdot_.setZero(nj);
+            gqn_.setZero(nj);
+            gpos_.assign(3 * gk_->num_frames, 0.0);
+            grot_.assign(9 * gk_->num_frames, 0.0);
+            gjac_.assign(6 * nj * gk_->num_frames, 0.0);
+
+            out << gk_->robot << " kinematics from " << library << ", " << nj << " joints, " << gk_->num_frames << " frames";
+            report = out.str();
+            mapGeneratedJoints();
+            return true;
+        }
+
+        /** @fn void unloadGeneratedKinematics()
+         *  @brief returns to the Pinocchio kinematics
+        */
+        void unloadGeneratedKinematics()
+        {
+            gk_ = NULL;
+            msg_gidx_.clear();
+            if (glib_)
+                dlclose(glib_);
+            glib_ = NULL;
+        }
+
+        bool hasGeneratedKinematics() const
+        {
+            return gk_ != NULL;
+        }
+
+        /** @fn bool hasGeneratedFrame(const std::string &frame_name) const
+         *  @brief true if generated kinematics are loaded and provide frame_name
+        */
+        bool hasGeneratedFrame(const std::string &frame_name) const
+        {
+            return gk_ && generatedFrame(frame_name) >= 0;
+        }
         
         
         int ndof()
@@ -154,119 +484,189 @@ namespace serow
 
         //void updateJointConfig(const Eigen::VectorXd& q)
 
-        void updateJointConfig(std::map<std::string, double> qmap, std::map<std::string, double> qdotmap, double joint_std)
+        void updateJointConfig(const std::map<std::string, double> &qmap, const std::map<std::string, double> &qdotmap, double joint_std)
         {
             mapJointNamesIDs(qmap,qdotmap);
-            if (has_floating_base_)
+            if (gk_)
             {
-                // Change quaternion order: in Pinocchio it is
-                // (x,y,z,w)
-                Eigen::VectorXd qpin; qpin = q_;
-                qpin[3] = q_[4];
-                qpin[4] = q_[5];
-                qpin[5] = q_[6];
-                qpin[6] = q_[3];
-                //pinocchio::forwardKinematics(*pmodel_, *data_, qpin);
-                pinocchio::framesForwardKinematics(*pmodel_, *data_, qpin);
-                pinocchio::computeJointJacobians(*pmodel_, *data_, qpin);
+                for (int j = 0; j < gk_->num_joints; j++)
+                {
+                    std::map<std::string, double>::const_iterator qit = qmap.find(gk_->joint_names[j]);
+                    std::map<std::string, double>::const_iterator qdotit = qdotmap.find(gk_->joint_names[j]);
+                    gq_[j] = qit != qmap.end() ? qit->second : 0.0;
+                    gqdot_[j] = qdotit != qdotmap.end() ? qdotit->second : 0.0;
+                }
+                computeGeneratedKinematics(joint_std);
+                return;
+            }
+            computeKinematics(joint_std);
+        }
 
+        /** @fn void mapJointNames(const std::vector<std::string> &names)
+         *  @brief caches where each joint of a joint state message goes in the configuration, call once with the message joint names
+        */
+        void mapJointNames(const std::vector<std::string> &names)
+        {
+            msg_names_ = names;
+            mapGeneratedJoints();
+            msg_qidx_.assign(names.size(), -1);
+            msg_vidx_.assign(names.size(), -1);
+            msg_nqs_.assign(names.size(), 0);
+            for (unsigned int i = 0; i < names.size(); i++)
+            {
+                if (!pmodel_->existJointName(names[i]))
+                    continue;
+                int jidx = pmodel_->getJointId(names[i]);
+                msg_qidx_[i] = pmodel_->idx_qs[jidx];
+                msg_vidx_[i] = pmodel_->idx_vs[jidx];
+                msg_nqs_[i] = pmodel_->nqs[jidx];
             }
-            else
-            {                
-                pinocchio::framesForwardKinematics(*pmodel_, *data_, q_);
-                pinocchio::computeJointJacobians(*pmodel_, *data_, q_);
-                
+        }
+
+        /** @fn void updateJointConfig(const Eigen::VectorXd &qmsg, const Eigen::VectorXd &qdotmsg, double joint_std)
+         *  @brief updates the kinematics with joint positions/velocities in the order given to mapJointNames(), does not allocate
+        */
+        void updateJointConfig(const Eigen::VectorXd &qmsg, const Eigen::VectorXd &qdotmsg, double joint_std)
+        {
+            for (unsigned int i = 0; i < msg_qidx_.size() && i < (unsigned int)qmsg.size(); i++)
+            {
+                int qidx = msg_qidx_[i];
+                if (qidx < 0)
+                    continue;
+                //this value is equal to 2 for continuous joints
+                if (msg_nqs_[i] == 2)
+                {
+                    q_[qidx] = cos(qmsg(i));
+                    q_[qidx + 1] = sin(qmsg(i));
+                }
+                else
+                {
+                    q_[qidx] = qmsg(i);
+                }
+                qdot_[msg_vidx_[i]] = qdotmsg(i);
             }
-             qn.setOnes();
-             qn *= joint_std;
+            if (gk_)
+            {
+                for (unsigned int i = 0; i < msg_gidx_.size() && i < (unsigned int)qmsg.size(); i++)
+                {
+                    if (msg_gidx_[i] < 0)
+                        continue;
+                    gq_[msg_gidx_[i]] = qmsg(i);
+                    gqdot_[msg_gidx_[i]] = qdotmsg(i);
+                }
+                computeGeneratedKinematics(joint_std);
+                return;
+            }
+            computeKinematics(joint_std);
         }
         
         
         Eigen::Vector3d getLinearVelocityNoise(const std::string& frame_name)
         {
-            return linearJacobian(frame_name) * qn;
+            Eigen::Vector3d v;
+            v.noalias() = linearJacobian(frame_name) * (gk_ ? gqn_ : qn);
+            return v;
 
         }
         Eigen::Vector3d getAngularVelocityNoise(const std::string& frame_name)
         {
-            return angularJacobian(frame_name) * qn;
+            Eigen::Vector3d v;
+            v.noalias() = angularJacobian(frame_name) * (gk_ ? gqn_ : qn);
+            return v;
 
         }
         
         //TODO
-        void mapJointNamesIDs(std::map<std::string, double> qmap, std::map<std::string, double> qdotmap)
+        void mapJointNamesIDs(const std::map<std::string, double> &qmap, const std::map<std::string, double> &qdotmap)
         {
-            q_.resize(pmodel_->nq);
-            qdot_.resize(pmodel_->nv);
-
             for(int i = 0; i<jnames_.size();i++)
             {
                 int jidx=pmodel_->getJointId(jnames_[i]);
                 int qidx=pmodel_->idx_qs[jidx];
                 int vidx=pmodel_->idx_vs[jidx];
+                std::map<std::string, double>::const_iterator qit = qmap.find(jnames_[i]);
+                std::map<std::string, double>::const_iterator qdotit = qdotmap.find(jnames_[i]);
+                double qj = qit != qmap.end() ? qit->second : 0.0;
+                double qdotj = qdotit != qdotmap.end() ? qdotit->second : 0.0;
                 
                 //this value is equal to 2 for continuous joints
                 if(pmodel_->nqs[jidx]==2)
                 {
-                    q_[qidx] = cos(qmap[jnames_[i]]);
-                    q_[qidx+1] = sin(qmap[jnames_[i]]);
-                    qdot_[vidx] = qdotmap[jnames_[i]];  
+                    q_[qidx] = cos(qj);
+                    q_[qidx+1] = sin(qj);
+                    qdot_[vidx] = qdotj;  
                 }
                 else
                 {
-                    q_[qidx] = qmap[jnames_[i]];
-                    qdot_[vidx] = qdotmap[jnames_[i]];
+                    q_[qidx] = qj;
+                    qdot_[vidx] = qdotj;
                 }
 
             }         
         }
         
         
-        Eigen::MatrixXd geometricJacobian(const std::string& frame_name)
+        /** @fn const Eigen::MatrixXd& geometricJacobian(const std::string& frame_name)
+         *  @brief returns a reference to an internal buffer, valid until the next jacobian of the same kind
+        */
+        const Eigen::MatrixXd& geometricJacobian(const std::string& frame_name)
         {
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                if (f >= 0)
+                    Jg_ = generatedJacobian(f);
+                else
+                {
+                    invalidFrame(frame_name);
+                    Jg_.setZero();
+                }
+                return Jg_;
+            }
             try
             {
-                pinocchio::Data::Matrix6x J(6,pmodel_->nv); J.fill(0);
+                J_.setZero();
                 // Jacobian in pinocchio::LOCAL (link) frame
                 pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
 
-                pinocchio::getFrameJacobian(*pmodel_, *data_, link_number, pinocchio::LOCAL, J);
+                pinocchio::getFrameJacobian(*pmodel_, *data_, link_number, pinocchio::LOCAL, J_);
 
                 if (has_floating_base_)
                 {
-                    Eigen::MatrixXd Jg; Jg.resize(6, this->ndof()); Jg.setZero();
-                    Eigen::Matrix3d Rbase; Rbase = quaternionToRotation(q_.segment(3,4));
-                    Jg.topLeftCorner(3,3) =
-                    Rbase.transpose()*data_->oMf[link_number].rotation()*J.block(0,0,3,3);
-                    Jg.topRightCorner(3,ndofActuated()) =
-                    (data_->oMf[link_number].rotation())*J.block(0,6,3,ndofActuated());
-                    Jg.bottomRightCorner(3,ndofActuated()) =
-                    (data_->oMf[link_number].rotation())*J.block(3,6,3,ndofActuated());
+                    Jg_.setZero();
+                    Eigen::Matrix3d Rbase; Rbase = quaternionToRotation(q_.segment<4>(3));
+                    Jg_.topLeftCorner<3,3>().noalias() =
+                    Rbase.transpose()*data_->oMf[link_number].rotation()*J_.block<3,3>(0,0);
+                    Jg_.topRightCorner(3,ndofActuated()).noalias() =
+                    (data_->oMf[link_number].rotation())*J_.block(0,6,3,ndofActuated());
+                    Jg_.bottomRightCorner(3,ndofActuated()).noalias() =
+                    (data_->oMf[link_number].rotation())*J_.block(3,6,3,ndofActuated());
                     
-                    Eigen::MatrixXd T; T.resize(3,4);
+                    Eigen::Matrix<double,3,4> T;
                     T <<
                     -2.0*q_(4),  2.0*q_(3), -2.0*q_(6),  2.0*q_(5),
                     -2.0*q_(5),  2.0*q_(6),  2.0*q_(3), -2.0*q_(4),
                     -2.0*q_(6), -2.0*q_(5),  2.0*q_(4),  2.0*q_(3);
-                    Jg.block(0,3,3,4) =
-                    data_->oMf[link_number].rotation()*J.block(0,3,3,3)*Rbase.transpose()*T;
-                    Jg.block(3,3,3,4) = T;
+                    Jg_.block<3,4>(0,3).noalias() =
+                    data_->oMf[link_number].rotation()*J_.block<3,3>(0,3)*Rbase.transpose()*T;
+                    Jg_.block<3,4>(3,3) = T;
                     
-                            return Jg;
+                            return Jg_;
                         }
                     else
                     {
                     // Transform Jacobians from pinocchio::LOCAL frame to base frame
-                    J.topRows(3) = (data_->oMf[link_number].rotation())*J.topRows(3);
-                    J.bottomRows(3) = (data_->oMf[link_number].rotation())*J.bottomRows(3);
-                    return J;
+                    Jg_.topRows<3>().noalias() = (data_->oMf[link_number].rotation())*J_.topRows<3>();
+                    Jg_.bottomRows<3>().noalias() = (data_->oMf[link_number].rotation())*J_.bottomRows<3>();
+                    return Jg_;
                 }
             }
             catch (std::exception& e)
             {
                 std::cerr << "WARNING: Link name " << frame_name << " is invalid! ... "
                 <<  "Returning zeros" << std::endl;
-                return Eigen::MatrixXd::Zero(6,ndofActuated());
+                Jg_.setZero();
+                return Jg_;
             }
         }
         
@@ -276,12 +676,16 @@ namespace serow
 
         Eigen::Vector3d getLinearVelocity(const std::string& frame_name)
         {
-            return  (linearJacobian(frame_name)* qdot_);
+            Eigen::Vector3d v;
+            v.noalias() = linearJacobian(frame_name) * (gk_ ? gqdot_ : qdot_);
+            return v;
         }
 
         Eigen::Vector3d getAngularVelocity(const std::string& frame_name)
         {
-            return  (angularJacobian(frame_name)* qdot_);
+            Eigen::Vector3d v;
+            v.noalias() = angularJacobian(frame_name) * (gk_ ? gqdot_ : qdot_);
+            return v;
         }
         
      
@@ -290,6 +694,14 @@ namespace serow
         
         Eigen::Vector3d linkPosition(const std::string& frame_name)
         {
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                if (f >= 0)
+                    return Eigen::Map<const Eigen::Vector3d>(&gpos_[3 * f]);
+                invalidFrame(frame_name);
+                return Eigen::Vector3d::Zero();
+            }
             try{ 
            	 pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
 
@@ -308,6 +720,17 @@ namespace serow
         
         Eigen::Quaterniond linkOrientation(const std::string& frame_name)
         {
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                if (f < 0)
+                {
+                    invalidFrame(frame_name);
+                    return Eigen::Quaterniond::Identity();
+                }
+                Eigen::Vector4d temp = rotationToQuaternion(generatedRotation(f));
+                return Eigen::Quaterniond(temp(0), temp(1), temp(2), temp(3));
+            }
             try{
 
                 pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
@@ -332,6 +755,13 @@ namespace serow
         Eigen::VectorXd linkPose(const std::string& frame_name)
         {
             Eigen::VectorXd lpose(7);
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                lpose.head(3) = linkPosition(frame_name);
+                lpose.tail(4) = f >= 0 ? rotationToQuaternion(generatedRotation(f)) : Eigen::Vector4d(1, 0, 0, 0);
+                return lpose;
+            }
             pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
 
             lpose.head(3) = data_->oMf[link_number].translation();
@@ -344,12 +774,27 @@ namespace serow
         
         
        
-        Eigen::MatrixXd linearJacobian(const std::string& frame_name)
+        /** @fn const Eigen::MatrixXd& linearJacobian(const std::string& frame_name)
+         *  @brief returns a reference to an internal buffer, valid until the next linear jacobian
+        */
+        const Eigen::MatrixXd& linearJacobian(const std::string& frame_name)
         {
-            pinocchio::Data::Matrix6x J(6, pmodel_->nv); J.fill(0);
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                if (f >= 0)
+                    Jlin_ = generatedJacobian(f).topRows<3>();
+                else
+                {
+                    invalidFrame(frame_name);
+                    Jlin_.setZero();
+                }
+                return Jlin_;
+            }
+            J_.setZero();
             pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
 
-            pinocchio::getFrameJacobian(*pmodel_, *data_, link_number, pinocchio::LOCAL, J);
+            pinocchio::getFrameJacobian(*pmodel_, *data_, link_number, pinocchio::LOCAL, J_);
             try
             {
                 if (has_floating_base_)
@@ -358,41 +803,58 @@ namespace serow
                     // [ Rworld_wrt_link*Rbase_wrt_world |
                     //   Rworld_wrt_link*skew(Pbase_wrt_world-Plink_wrt_world)*R_base_wrt_world |
                     //   Jq_wrt_link]
-                    Eigen::MatrixXd Jlin; Jlin.resize(3, this->ndof()); Jlin.setZero();
-                    Eigen::Matrix3d Rbase; Rbase = quaternionToRotation(q_.segment(3,4));
-                    Jlin.leftCols(3) =
-                    Rbase.transpose()*data_->oMf[link_number].rotation()*J.block(0,0,3,3);
-                    Jlin.rightCols(ndofActuated()) =
-                    (data_->oMf[link_number].rotation())*J.block(0,6,3,ndofActuated());
+                    Jlin_.setZero();
+                    Eigen::Matrix3d Rbase; Rbase = quaternionToRotation(q_.segment<4>(3));
+                    Jlin_.leftCols<3>().noalias() =
+                    Rbase.transpose()*data_->oMf[link_number].rotation()*J_.block<3,3>(0,0);
+                    Jlin_.rightCols(ndofActuated()).noalias() =
+                    (data_->oMf[link_number].rotation())*J_.block(0,6,3,ndofActuated());
                     
-                    Eigen::MatrixXd T; T.resize(3,4);
+                    Eigen::Matrix<double,3,4> T;
                     T <<
                     -2.0*q_(4),  2.0*q_(3), -2.0*q_(6),  2.0*q_(5),
                     -2.0*q_(5),  2.0*q_(6),  2.0*q_(3), -2.0*q_(4),
                     -2.0*q_(6), -2.0*q_(5),  2.0*q_(4),  2.0*q_(3);
-                    Jlin.middleCols(3,4) =
-                    data_->oMf[link_number].rotation()*J.block(0,3,3,3)*Rbase.transpose()*T;
+                    Jlin_.middleCols<4>(3).noalias() =
+                    data_->oMf[link_number].rotation()*J_.block<3,3>(0,3)*Rbase.transpose()*T;
                     
-                    return Jlin;
+                    return Jlin_;
                 }
                 else
                 {
                     // Transform Jacobian from pinocchio::LOCAL frame to base frame
-                    return (data_->oMf[link_number].rotation())*J.topRows(3);
+                    Jlin_.noalias() = (data_->oMf[link_number].rotation())*J_.topRows<3>();
+                    return Jlin_;
                 }
             }
             catch (std::exception& e)
             {
                 std::cerr << "WARNING: Link name " << frame_name << " is invalid! ... "
                 <<  "Returning zeros" << std::endl;
-                return Eigen::MatrixXd::Zero(3,ndofActuated());
+                Jlin_.setZero();
+                return Jlin_;
             }
         }
         
 
-        Eigen::MatrixXd angularJacobian(const std::string& frame_name)
+        /** @fn const Eigen::MatrixXd& angularJacobian(const std::string& frame_name)
+         *  @brief returns a reference to an internal buffer, valid until the next angular jacobian
+        */
+        const Eigen::MatrixXd& angularJacobian(const std::string& frame_name)
         {
-            pinocchio::Data::Matrix6x J(6, pmodel_->nv); J.fill(0);
+            if (gk_)
+            {
+                int f = generatedFrame(frame_name);
+                if (f >= 0)
+                    Jang_ = generatedJacobian(f).bottomRows<3>();
+                else
+                {
+                    invalidFrame(frame_name);
+                    Jang_.setZero();
+                }
+                return Jang_;
+            }
+            J_.setZero();
             pinocchio::Model::FrameIndex link_number =  pmodel_->getFrameId(frame_name);
 
 
@@ -401,62 +863,66 @@ namespace serow
                 if (has_floating_base_)
                 {
 
-                    Eigen::MatrixXd Jang; 
-                    Jang.resize(3, this->ndof()); Jang.setZero();
+                    Jang_.setZero();
                     Eigen::Vector4d q;
                     
                     // Jacobian in global frame
-                    pinocchio::getFrameJacobian(*pmodel_, *data_, link_number,pinocchio::LOCAL, J);
+                    pinocchio::getFrameJacobian(*pmodel_, *data_, link_number,pinocchio::LOCAL, J_);
                     
                     // The structure of J is: [0 | Rot_ff_wrt_world | Jq_wrt_world]
-                    Jang.rightCols(ndofActuated()) = J.block(3,6,3,ndofActuated());
-                    q = rotationToQuaternion(J.block(3,3,3,3));
-                    Jang.middleCols(3,4) <<
+                    Jang_.rightCols(ndofActuated()) = J_.block(3,6,3,ndofActuated());
+                    q = rotationToQuaternion(J_.block<3,3>(3,3));
+                    Jang_.middleCols<4>(3) <<
                     -2.0*q(1),  2.0*q(0), -2.0*q(3),  2.0*q(2),
                     -2.0*q(2),  2.0*q(3),  2.0*q(0), -2.0*q(1),
                     -2.0*q(3), -2.0*q(2),  2.0*q(1),  2.0*q(0);
-                    return Jang;
+                    return Jang_;
 
                 }
                 else
                 {
 
                     // Jacobian in pinocchio::LOCAL frame
-                    pinocchio::getFrameJacobian(*pmodel_, *data_, link_number,pinocchio::LOCAL, J);
+                    pinocchio::getFrameJacobian(*pmodel_, *data_, link_number,pinocchio::LOCAL, J_);
 
                     // Transform Jacobian from pinocchio::LOCAL frame to base frame
-                    return (data_->oMf[link_number].rotation())*J.bottomRows(3);
+                    Jang_.noalias() = (data_->oMf[link_number].rotation())*J_.bottomRows<3>();
+                    return Jang_;
                 }
             }
             catch (std::exception& e)
             {
                 std::cerr << "WARNING: Link name " << frame_name << " is invalid! ... "
                 <<  "Returning zeros" << std::endl;
-                return Eigen::MatrixXd::Zero(3,ndofActuated());
+                Jang_.setZero();
+                return Jang_;
             }
         }
         
       
         
         
-        Eigen::VectorXd comPosition()
+        Eigen::Vector3d comPosition()
         {
             Eigen::Vector3d com;
             
+            if (gk_)
+            {
+                gk_->com(gq_.data(), com.data());
+                return com;
+            }
             if (has_floating_base_)
             {
                 // Change quaternion order: in oscr it is (w,x,y,z) and in Pinocchio it is
                 // (x,y,z,w)
-                Eigen::VectorXd qpin;
-                
-                qpin = q_;
-                qpin[3] = q_[4];
-                qpin[4] = q_[5];
-                qpin[5] = q_[6];
-                qpin[6] = q_[3];
-                //Eigen::Vector3d com = pinocchio::centerOfMass(*pmodel_, *data_, qpin);
-                //std::cout << qpin.head(7).transpose() << std::endl;
-                pinocchio::centerOfMass(*pmodel_, *data_, qpin);
+                qpin_ = q_;
+                qpin_[3] = q_[4];
+                qpin_[4] = q_[5];
+                qpin_[5] = q_[6];
+                qpin_[6] = q_[3];
+                //Eigen::Vector3d com = pinocchio::centerOfMass(*pmodel_, *data_, qpin_);
+                //std::cout << qpin_.head(7).transpose() << std::endl;
+                pinocchio::centerOfMass(*pmodel_, *data_, qpin_);
                 
                 // Eigen::Matrix3d Rbase; Rbase = quaternionToRotation(q_.segment(3,4));
                 // com = Rbase*data_->com[0];
@@ -0,0 +1,410 @@
+#!/usr/bin/env python3
+# Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+# License: BSD
+"""
+Kinematics code generator for SERoW
+
+Reads a URDF and the foot frames the estimator uses and writes a C++ source with fixed-size, branch-free
+forward kinematics, frame Jacobians and CoM. The source builds into a shared library that robotDyn loads
+with the kinematics_library parameter instead of running the generic Pinocchio algorithms;
+serow_kinematics_check compares the library to Pinocchio and times both.
+
+Every quantity is expressed in the root link of the URDF, exactly as robotDyn does for a fixed base model.
+Constant joint origins are folded into the expressions, so each revolute joint costs one sin/cos pair
+and a handful of multiply-adds.
+
+usage: serow_kinematics_codegen.py model.urdf output.cpp frame [frame ...] [--name robot]
+"""
+
+import argparse
+import math
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+MOVABLE = ('revolute', 'continuous', 'prismatic')
+EPS = 1e-12
+
+
+def snap(x):
+    """Rounds the numerical noise of cos(pi/2) and friends so that exact zeros and ones fold away"""
+    for v in (0.0, 1.0, -1.0):
+        if abs(x - v) < EPS:
+            return v
+    return x
+
+
+class Poly(object):
+    """Polynomial in the generated variables, {sorted tuple of symbols: coefficient}"""
+
+    def __init__(self, terms=None):
+        self.terms = {}
+        if terms:
+            for k, v in terms.items():
+                v = snap(v)
+                if v != 0.0:
+                    self.terms[k] = v
+
+    @staticmethod
+    def const(c):
+        return Poly({(): c})
+
+    @staticmethod
+    def sym(name):
+        return Poly({(name,): 1.0})
+
+    def __add__(self, other):
+        t = dict(self.terms)
+        for k, v in other.terms.items():
+            t[k] = t.get(k, 0.0) + v
+        return Poly(t)
+
+    def __neg__(self):
+        return Poly(dict((k, -v) for k, v in self.terms.items()))
+
+    def __sub__(self, other):
+        return self + (-other)
+
+    def __mul__(self, other):
+        if not isinstance(other, Poly):
+            other = Poly.const(other)
+        t = {}
+        for ka, va in self.terms.items():
+            for kb, vb in other.terms.items():
+                k = tuple(sorted(ka + kb))
+                t[k] = t.get(k, 0.0) + va * vb
+        return Poly(t)
+
+    def is_trivial(self):
+        """Constants and bare symbols are used in place, everything else gets its own variable"""
+        if not self.terms:
+            return True
+        if len(self.terms) != 1:
+            return False
+        k, v = next(iter(self.terms.items()))
+        return len(k) == 0 or (len(k) == 1 and v == 1.0)
+
+    def code(self):
+        if not self.terms:
+            return '0.0'
+        out = []
+        for k in sorted(self.terms, key=lambda k: (len(k), k)):
+            v = self.terms[k]
+            if not k:
+                term = num(abs(v))
+            elif abs(v) == 1.0:
+                term = '*'.join(k)
+            else:
+                term = num(abs(v)) + '*' + '*'.join(k)
+            sign = '-' if v < 0 else '+'
+            out.append((sign, term))
+        s = ('-' if out[0][0] == '-' else '') + out[0][1]
+        for sign, term in out[1:]:
+            s += ' %s %s' % (sign, term)
+        return s
+
+
+def num(x):
+    s = repr(float(x))
+    return s if ('.' in s or 'e' in s) else s + '.0'
+
+
+def matmul(A, B):
+    return [[sum((A[i][k] * B[k][j] for k in range(3)), Poly()) for j in range(3)] for i in range(3)]
+
+
+def matvec(A, v):
+    return [sum((A[i][k] * v[k] for k in range(3)), Poly()) for i in range(3)]
+
+
+def cross(a, b):
+    return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+
+
+def const_mat(M):
+    return [[Poly.const(M[i][j]) for j in range(3)] for i in range(3)]
+
+
+def rpy_matrix(r, p, y):
+    cr, sr, cp, sp, cy, sy = math.cos(r), math.sin(r), math.cos(p), math.sin(p), math.cos(y), math.sin(y)
+    return [[cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr],
+            [sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr],
+            [-sp, cp * sr, cp * cr]]
+
+
+def floats(text, default):
+    return [float(x) for x in text.split()] if text is not None else list(default)
+
+
+class Joint(object):
+    def __init__(self, e):
+        self.name = e.get('name')
+        self.type = e.get('type')
+        self.parent = e.find('parent').get('link')
+        self.child = e.find('child').get('link')
+        origin = e.find('origin')
+        self.xyz = floats(origin.get('xyz') if origin is not None else None, (0, 0, 0))
+        self.rpy = floats(origin.get('rpy') if origin is not None else None, (0, 0, 0))
+        axis = e.find('axis')
+        a = floats(axis.get('xyz') if axis is not None else None, (1, 0, 0))
+        n = math.sqrt(sum(x * x for x in a))
+        self.axis = [x / n for x in a] if n > 0.0 else [1.0, 0.0, 0.0]
+        self.index = -1
+
+
+class Model(object):
+    def __init__(self, path):
+        root = ET.parse(path).getroot()
+        self.name = root.get('name', 'robot')
+        self.mass = {}
+        self.com = {}
+        for l in root.findall('link'):
+            inertial = l.find('inertial')
+            m, c = 0.0, [0.0, 0.0, 0.0]
+            if inertial is not None:
+                if inertial.find('mass') is not None:
+                    m = float(inertial.find('mass').get('value'))
+                if inertial.find('origin') is not None:
+                    c = floats(inertial.find('origin').get('xyz'), (0, 0, 0))
+            self.mass[l.get('name')] = m
+            self.com[l.get('name')] = c
+        self.joints = [Joint(j) for j in root.findall('joint')]
+        for j in self.joints:
+            if j.type not in MOVABLE + ('fixed',):
+                raise SystemExit('joint %s: %s joints are not supported' % (j.name, j.type))
+        self.parent_joint = dict((j.child, j) for j in self.joints)
+        children = set(self.parent_joint)
+        roots = [l for l in self.mass if l not in children]
+        if len(roots) != 1:
+            raise SystemExit('expected one root link, found %s' % roots)
+        self.root = roots[0]
+        #Depth first over the joints, robotDyn maps the configuration by joint name so the order is free
+        self.movable = []
+        stack = [self.root]
+        order = []
+        while stack:
+            link = stack.pop()
+            order.append(link)
+            kids = [j for j in self.joints if j.parent == link]
+            for j in reversed(kids):
+                stack.append(j.child)
+        self.link_order = order
+        for link in order:
+            j = self.parent_joint.get(link)
+            if j is not None and j.type in MOVABLE:
+                j.index = len(self.movable)
+                self.movable.append(j)
+
+    def chain(self, link):
+        """Joints from the root to link"""
+        if link not in self.mass:
+            raise SystemExit('unknown frame %s' % link)
+        out = []
+        while link in self.parent_joint:
+            j = self.parent_joint[link]
+            out.append(j)
+            link = j.parent
+        return list(reversed(out))
+
+
+class Emitter(object):
+    """Straight-line forward kinematics over a set of links, shared sub-chains are computed once"""
+
+    def __init__(self, model):
+        self.model = model
+        self.lines = []
+        self.pose = {model.root: ([[Poly.const(1.0 if i == j else 0.0) for j in range(3)] for i in range(3)],
+                                  [Poly(), Poly(), Poly()])}
+        self.trig = set()
+        self.count = 0
+        self.seen = {}
+
+    def assign(self, p, prefix):
+        if p.is_trivial():
+            return p
+        expr = p.code()
+        if expr in self.seen:
+            return Poly.sym(self.seen[expr])
+        name = '%s%d' % (prefix, self.count)
+        self.count += 1
+        self.seen[expr] = name
+        self.lines.append('    const double %s = %s;' % (name, expr))
+        return Poly.sym(name)
+
+    def joint_trig(self, j):
+        k = j.index
+        if k in self.trig:
+            return
+        self.trig.add(k)
+        if j.type == 'prismatic':
+            return
+        self.lines.append('    const double s%d = std::sin(q[%d]);' % (k, k))
+        self.lines.append('    const double c%d = std::cos(q[%d]);' % (k, k))
+        if not self.aligned(j.axis):
+            self.lines.append('    const double v%d = 1.0 - c%d;' % (k, k))
+
+    @staticmethod
+    def aligned(a):
+        return sum(1 for x in a if snap(x) != 0.0) == 1
+
+    def motion(self, j):
+        """Rotation of a revolute joint about its axis, c I + s [a]x + (1 - c) a a'"""
+        k = j.index
+        a = [snap(x) for x in j.axis]
+        c, s = Poly.sym('c%d' % k), Poly.sym('s%d' % k)
+        W = [[Poly(), s * (-a[2]), s * a[1]], [s * a[2], Poly(), s * (-a[0])], [s * (-a[1]), s * a[0], Poly()]]
+        if self.aligned(a):
+            ax = [i for i in range(3) if a[i] != 0.0][0]
+            return [[(Poly.const(1.0) if i == ax else c) if i == j_ else W[i][j_] for j_ in range(3)] for i in range(3)]
+        v = Poly.sym('v%d' % k)
+        return [[(c if i == j_ else Poly()) + W[i][j_] + v * (a[i] * a[j_]) for j_ in range(3)] for i in range(3)]
+
+    def link(self, link):
+        if link in self.pose:
+            return self.pose[link]
+        j = self.model.parent_joint[link]
+        R, p = self.link(j.parent)
+        Ro = const_mat(rpy_matrix(*j.rpy))
+        po = [Poly.const(x) for x in j.xyz]
+        self.lines.append('    // %s (%s)' % (j.name, j.type))
+        R1 = matmul(R, Ro)
+        p1 = [p[i] + matvec(R, po)[i] for i in range(3)]
+        if j.type in ('revolute', 'continuous'):
+            self.joint_trig(j)
+            R1 = matmul(R1, self.motion(j))
+        elif j.type == 'prismatic':
+            self.joint_trig(j)
+            d = Poly.sym('q[%d]' % j.index)
+            p1 = [p1[i] + matvec(R1, [Poly.const(x) * d for x in j.axis])[i] for i in range(3)]
+        R1 = [[self.assign(R1[i][k], 'R') for k in range(3)] for i in range(3)]
+        p1 = [self.assign(p1[i], 'p') for i in range(3)]
+        self.pose[link] = (R1, p1)
+        return self.pose[link]
+
+
+def prune(lines):
+    """Drops the temporaries no output depends on, e.g. the rotation of a link whose CoM is at its origin"""
+    decl = re.compile(r'^    const double (\w+) = (.*);$')
+    used = set()
+    keep = []
+    for line in reversed(lines):
+        m = decl.match(line)
+        if m and m.group(1) not in used:
+            continue
+        used.update(re.findall(r'[A-Za-z_]\w*', line.split('=', 1)[-1]))
+        keep.append(line)
+    keep.reverse()
+    #Comments of joints whose code was dropped entirely
+    return [l for i, l in enumerate(keep)
+            if not (l.startswith('    //') and (i + 1 == len(keep) or keep[i + 1].startswith('    //')))]
+
+
+def frames_function(model, frames):
+    e = Emitter(model)
+    nj = len(model.movable)
+    body = []
+    for f, name in enumerate(frames):
+        R, p = e.link(name)
+        e.lines.append('    // frame %s' % name)
+        for i in range(3):
+            e.lines.append('    pos[%d] = %s;' % (3 * f + i, p[i].code()))
+        for c in range(3):
+            for r in range(3):
+                e.lines.append('    rot[%d] = %s;' % (9 * f + 3 * c + r, R[r][c].code()))
+        for j in model.chain(name):
+            if j.index < 0:
+                continue
+            Rj, pj = e.link(j.child)
+            z = matvec(Rj, [Poly.const(x) for x in j.axis])
+            base = 6 * nj * f + 6 * j.index
+            if j.type == 'prismatic':
+                lin, ang = z, [Poly(), Poly(), Poly()]
+            else:
+                lin = cross(z, [p[i] - pj[i] for i in range(3)])
+                ang = z
+            for i in range(3):
+                e.lines.append('    jac[%d] = %s;' % (base + i, lin[i].code()))
+                e.lines.append('    jac[%d] = %s;' % (base + 3 + i, ang[i].code()))
+    body.append('static void frames(const double *q, double *pos, double *rot, double *jac)')
+    body.append('{')
+    body.append('    (void)q;')
+    body.append('    for (int i = 0; i < %d; i++)' % (6 * nj * len(frames)))
+    body.append('        jac[i] = 0.0;')
+    body += prune(e.lines)
+    body.append('}')
+    return body
+
+
+def com_function(model):
+    e = Emitter(model)
+    total = sum(model.mass.values())
+    acc = [Poly(), Poly(), Poly()]
+    for link in model.link_order:
+        m = model.mass[link]
+        if m <= 0.0:
+            continue
+        R, p = e.link(link)
+        c = matvec(R, [Poly.const(x) for x in model.com[link]])
+        for i in range(3):
+            acc[i] = acc[i] + (p[i] + c[i]) * (m / total)
+    body = ['static void com(const double *q, double *c)', '{', '    (void)q;']
+    for i in range(3):
+        e.lines.append('    c[%d] = %s;' % (i, acc[i].code()))
+    body += prune(e.lines)
+    body.append('}')
+    return body, total
+
+
+def generate(model, frames, name, urdf):
+    out = []
+    out.append('// Generated by serow_kinematics_codegen.py from %s, do not edit' % urdf)
+    out.append('// frames: %s' % ' '.join(frames))
+    out.append('#include <cmath>')
+    out.append('#include <serow/GeneratedKinematics.h>')
+    out.append('')
+    out.append('namespace')
+    out.append('{')
+    out.append('const char *const joint_names[] = {%s};' % ', '.join('"%s"' % j.name for j in model.movable))
+    out.append('const char *const frame_names[] = {%s};' % ', '.join('"%s"' % f for f in frames))
+    out.append('')
+    out += frames_function(model, frames)
+    out.append('')
+    com, total = com_function(model)
+    out += com
+    out.append('')
+    out.append('const serow::GeneratedKinematics table = {')
+    out.append('    SEROW_GENERATED_KINEMATICS_VERSION,')
+    out.append('    "%s",' % name)
+    out.append('    "%s",' % model.root)
+    out.append('    %d,' % len(model.movable))
+    out.append('    joint_names,')
+    out.append('    %d,' % len(frames))
+    out.append('    frame_names,')
+    out.append('    %s,' % num(total))
+    out.append('    frames,')
+    out.append('    com};')
+    out.append('} // namespace')
+    out.append('')
+    out.append('extern "C" const serow::GeneratedKinematics *serow_generated_kinematics()')
+    out.append('{')
+    out.append('    return &table;')
+    out.append('}')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generates specialized foot kinematics and CoM from a URDF')
+    parser.add_argument('urdf')
+    parser.add_argument('output')
+    parser.add_argument('frames', nargs='+', help='foot frames, in the order the node configures them')
+    parser.add_argument('--name', default=None, help='robot name stored in the library, default the URDF name')
+    args = parser.parse_args()
+    model = Model(args.urdf)
+    src = generate(model, args.frames, args.name or model.name, args.urdf.split('/')[-1])
+    with open(args.output, 'w') as f:
+        f.write(src)
+    sys.stdout.write('%s: %d joints, %d frames, %d lines\n' % (args.output, len(model.movable), len(args.frames), src.count('\n')))
+
+
+if __name__ == '__main__':
+    main()
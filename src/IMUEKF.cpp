@@ -154,25 +154,25 @@ void IMUEKF::init() {
 }
 
 
-Matrix<double,15,15> IMUEKF::computeTrans(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_)
+Matrix<double,15,15> IMUEKF::computeTrans(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_)
 {
     omega_.noalias() -= x_.segment<3>(9);
     f_.noalias() -= x_.segment<3>(12);
     v = x_.segment<3>(0);
     Matrix<double,15,15> res = Matrix<double,15,15>::Zero();
-    res.block<3,3>(0,0).noalias()  = -wedge(omega_);
-    res.block<3,3>(0,3).noalias()  = wedge(Rib_.transpose() * g);
+    res.block<3,3>(0,0).noalias()  = -serow::lie::skew(omega_);
+    res.block<3,3>(0,3).noalias()  = serow::lie::skew(Rib_.transpose() * g);
     res.block<3,3>(0,12).noalias() = -Matrix3d::Identity();
-    res.block<3,3>(0,9).noalias()  = -wedge(v);
-    res.block<3,3>(3,3).noalias() = -wedge(omega_);
+    res.block<3,3>(0,9).noalias()  = -serow::lie::skew(v);
+    res.block<3,3>(3,3).noalias() = -serow::lie::skew(omega_);
     res.block<3,3>(3,9).noalias() = -Matrix3d::Identity();
     res.block<3,3>(6,0) = Rib_;
-    res.block<3,3>(6,3).noalias() = -Rib_ * wedge(v);
+    res.block<3,3>(6,3).noalias() = -Rib_ * serow::lie::skew(v);
     return res;
 }
 
 
-void IMUEKF::euler(Vector3d omega_, Vector3d f_)
+void IMUEKF::euler(const Vector3d &omega_, const Vector3d &f_)
 {
     Acf=computeTrans(x,Rib,omega_,f_);
     //Euler Discretization - First order Truncation
@@ -183,7 +183,7 @@ void IMUEKF::euler(Vector3d omega_, Vector3d f_)
 }
 
 
-Matrix<double,15,1> IMUEKF::computeContinuousDyn(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_)
+Matrix<double,15,1> IMUEKF::computeContinuousDyn(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_)
 {
     Matrix<double,15,1> res = Matrix<double,15,1>::Zero();
     
@@ -201,7 +201,7 @@ Matrix<double,15,1> IMUEKF::computeContinuousDyn(Matrix<double,15,1> x_, Matrix<
     return res;
 }
 
-Matrix<double,15,1> IMUEKF::computeDiscreteDyn(Matrix<double,15,1> x_, Matrix<double,3,3> Rib_, Vector3d omega_, Vector3d f_)
+Matrix<double,15,1> IMUEKF::computeDiscreteDyn(const Matrix<double,15,1> &x_, const Matrix<double,3,3> &Rib_, Vector3d omega_, Vector3d f_)
 {
 
     Matrix<double,15,1> res = Matrix<double,15,1>::Zero();
@@ -234,7 +234,7 @@ Matrix<double,15,1> IMUEKF::computeDiscreteDyn(Matrix<double,15,1> x_, Matrix<do
 }
 
 
-void IMUEKF::predict(Vector3d omega_, Vector3d f_)
+void IMUEKF::predict(const Vector3d &omega_, const Vector3d &f_)
 {
     omega = omega_;
     f = f_;
@@ -243,7 +243,7 @@ void IMUEKF::predict(Vector3d omega_, Vector3d f_)
     v = x.segment<3>(0);
     
     //Update the Input-noise Jacobian
-    Lcf.block<3,3>(0,0).noalias() = -wedge(v);
+    Lcf.block<3,3>(0,0).noalias() = -serow::lie::skew(v);
     
     
     euler(omega_,f_);
@@ -277,7 +277,7 @@ void IMUEKF::predict(Vector3d omega_, Vector3d f_)
     
     if (omegahat(0) != 0 && omegahat(1) != 0 && omegahat(2) != 0)
     {
-        Rib  *=  expMap(omegahat*dt);
+        Rib  *=  serow::lie::expSO3(omegahat*dt);
     }
     
     x.segment<3>(3) = Vector3d::Zero();
@@ -286,7 +286,7 @@ void IMUEKF::predict(Vector3d omega_, Vector3d f_)
 
 
 /** Update **/
-void IMUEKF::updateWithTwist(Vector3d y)
+void IMUEKF::updateWithTwist(const Vector3d &y)
 {
 
     Rv(0, 0) = vel_px * vel_px;
@@ -300,7 +300,7 @@ void IMUEKF::updateWithTwist(Vector3d y)
     zv.noalias() -= Rib * v;
     
     Hv.block<3,3>(0,0) = Rib;
-    Hv.block<3,3>(0,3).noalias() = -Rib * wedge(v);
+    Hv.block<3,3>(0,3).noalias() = -Rib * serow::lie::skew(v);
     sv = Rv;
     sv.noalias() += Hv * P * Hv.transpose();
     Kv.noalias() = P * Hv.transpose() * sv.inverse();
@@ -317,7 +317,7 @@ void IMUEKF::updateWithTwist(Vector3d y)
     
     if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
     {
-        Rib *=  expMap(dxf.segment<3>(3));
+        Rib *=  serow::lie::expSO3(dxf.segment<3>(3));
     }
     x.segment<3>(3) = Vector3d::Zero();
     
@@ -327,7 +327,7 @@ void IMUEKF::updateWithTwist(Vector3d y)
 }
 
 
-void IMUEKF::updateWithTwistRotation(Vector3d y,Quaterniond qy)
+void IMUEKF::updateWithTwistRotation(const Vector3d &y,const Quaterniond &qy)
 {
 
     R(0, 0) = vel_px * vel_px;
@@ -345,11 +345,11 @@ void IMUEKF::updateWithTwistRotation(Vector3d y,Quaterniond qy)
     //Innovetion vector
     z.segment<3>(0) = y;
     z.segment<3>(0).noalias() -= Rib * v;
-    z.segment<3>(3) = logMap((Rib.transpose() * qy.toRotationMatrix()));
+    z.segment<3>(3) = serow::lie::logSO3((Rib.transpose() * qy.toRotationMatrix()));
 
 
     Hvf.block<3,3>(0,0) = Rib;
-    Hvf.block<3,3>(0,3).noalias() = -Rib * wedge(v);
+    Hvf.block<3,3>(0,3).noalias() = -Rib * serow::lie::skew(v);
     s = R;
     s.noalias() += Hvf * P * Hvf.transpose();
     Kf.noalias() = P * Hvf.transpose() * s.inverse();
@@ -366,7 +366,7 @@ void IMUEKF::updateWithTwistRotation(Vector3d y,Quaterniond qy)
     
     if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
     {
-        Rib *=  expMap(dxf.segment<3>(3));
+        Rib *=  serow::lie::expSO3(dxf.segment<3>(3));
     }
     x.segment<3>(3) = Vector3d::Zero();
     
@@ -375,7 +375,7 @@ void IMUEKF::updateWithTwistRotation(Vector3d y,Quaterniond qy)
     
 }
 
-void IMUEKF::updateWithLegOdom(Vector3d y, Quaterniond qy)
+void IMUEKF::updateWithLegOdom(const Vector3d &y, const Quaterniond &qy)
 {
     R(0, 0) = leg_odom_px * leg_odom_px;
     R(1, 1) = leg_odom_py * leg_odom_py;
@@ -389,8 +389,8 @@ void IMUEKF::updateWithLegOdom(Vector3d y, Quaterniond qy)
         r = x.segment<3>(6);
         //Innovetion vector
         z.segment<3>(0) = y - r;
-        z.segment<3>(3) = logMap((Rib.transpose() * qy.toRotationMatrix()));
-        //z.segment<3>(3) = logMap(qy.toRotationMatrix().transpose() * Rib);
+        z.segment<3>(3) = serow::lie::logSO3((Rib.transpose() * qy.toRotationMatrix()));
+        //z.segment<3>(3) = serow::lie::logSO3(qy.toRotationMatrix().transpose() * Rib);
         
         //Compute the Kalman Gain
         s = R;
@@ -405,7 +405,7 @@ void IMUEKF::updateWithLegOdom(Vector3d y, Quaterniond qy)
         x.noalias() += dxf;
         if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
         {
-             Rib *=  expMap(dxf.segment<3>(3));
+             Rib *=  serow::lie::expSO3(dxf.segment<3>(3));
         }
         x.segment<3>(3) = Vector3d::Zero();
 
@@ -415,7 +415,28 @@ void IMUEKF::updateWithLegOdom(Vector3d y, Quaterniond qy)
 
 }
 
-bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection)
+void IMUEKF::updateWithGyroBias(const Vector3d &y, const Matrix3d &Ry)
+{
+    //The pseudo-measurement observes the gyro bias states directly
+    Matrix<double, 3, 15> Hb = Matrix<double, 3, 15>::Zero();
+    Hb.block<3, 3>(0, 9) = Matrix3d::Identity();
+    Matrix3d sb = Ry + P.block<3, 3>(9, 9);
+    Matrix<double, 15, 3> Kb = P.block<15, 3>(0, 9) * sb.inverse();
+
+    P = (If - Kb * Hb) * P * (If - Kb * Hb).transpose();
+    P.noalias() += Kb * Ry * Kb.transpose();
+
+    dxf.noalias() = Kb * (y - x.segment<3>(9));
+    x.noalias() += dxf;
+    if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
+    {
+        Rib *= serow::lie::expSO3(dxf.segment<3>(3));
+    }
+    x.segment<3>(3) = Vector3d::Zero();
+    updateVars();
+}
+
+bool IMUEKF::updateWithOdom(const Vector3d &y, const Quaterniond &qy, bool useOutlierDetection)
 {
     R(0, 0) = odom_px * odom_px;
     R(1, 1) = odom_py * odom_py;
@@ -433,9 +454,9 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
             r = x.segment<3>(6);
             //Innovetion vector
             z.segment<3>(0) = y - r;
-            z.segment<3>(3) = logMap((Rib.transpose() * qy.toRotationMatrix()));
-            //z.segment<3>(3) = logMap(qy.toRotationMatrix() * Rib.transpose());
-            //z.segment<3>(3) = logMap(qy.toRotationMatrix().transpose() * Rib);
+            z.segment<3>(3) = serow::lie::logSO3((Rib.transpose() * qy.toRotationMatrix()));
+            //z.segment<3>(3) = serow::lie::logSO3(qy.toRotationMatrix() * Rib.transpose());
+            //z.segment<3>(3) = serow::lie::logSO3(qy.toRotationMatrix().transpose() * Rib);
             //Compute the Kalman Gain
             s = R;
             s.noalias() += Hf * P * Hf.transpose();
@@ -450,7 +471,7 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
             x += dxf;
             if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
             {
-                 Rib *=  expMap(dxf.segment<3>(3));
+                 Rib *=  serow::lie::expSO3(dxf.segment<3>(3));
             }
             x.segment<3>(3) = Vector3d::Zero();
         }
@@ -459,8 +480,8 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
             r = x.segment<3>(6);
             //Innovetion vector
             z.segment<3>(0) = y - r;
-            z.segment<3>(3) = logMap((Rib.transpose() * qy.toRotationMatrix()));
-            //z.segment<3>(3) = logMap(qy.toRotationMatrix() * Rib.transpose());
+            z.segment<3>(3) = serow::lie::logSO3((Rib.transpose() * qy.toRotationMatrix()));
+            //z.segment<3>(3) = serow::lie::logSO3(qy.toRotationMatrix() * Rib.transpose());
             
             //Compute the Kalman Gain
             s = R;
@@ -476,7 +497,7 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
             
             if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
             {
-                Rib_i =  Rib*expMap(dxf.segment<3>(3));
+                Rib_i =  Rib*serow::lie::expSO3(dxf.segment<3>(3));
             }
             s =  Hf * P_i * Hf.transpose() + R;
             temp = y-x_i.segment<3>(6);
@@ -509,8 +530,8 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
         //Innovetion vector
         r = x.segment<3>(6);
         z.segment<3>(0) = y -r;
-        z.segment<3>(3) = logMap((Rib.transpose() * qy.toRotationMatrix()));
-        //z.segment<3>(3) = logMap(qy.toRotationMatrix().transpose() * Rib);
+        z.segment<3>(3) = serow::lie::logSO3((Rib.transpose() * qy.toRotationMatrix()));
+        //z.segment<3>(3) = serow::lie::logSO3(qy.toRotationMatrix().transpose() * Rib);
 
         unsigned int j=0;
         while(j<4)
@@ -534,7 +555,7 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
                 
                 if (dxf(3) != 0 && dxf(4) != 0 && dxf(5) != 0)
                 {
-                    Rib_i =  Rib *expMap(dxf.segment<3>(3));
+                    Rib_i =  Rib *serow::lie::expSO3(dxf.segment<3>(3));
                 }
                 x_i.segment<3>(3) = Vector3d::Zero();
                 
@@ -570,7 +591,7 @@ bool IMUEKF::updateWithOdom(Vector3d y, Quaterniond qy, bool useOutlierDetection
 
 
 //Update the outlier indicator Zeta
-void IMUEKF::updateOutlierDetectionParams(Eigen::Matrix<double, 3,3> BetaT)
+void IMUEKF::updateOutlierDetectionParams(const Eigen::Matrix<double, 3,3> &BetaT)
 {
     efpsi = computePsi(e_t+f_t);
     lnp = computePsi(e_t) - efpsi;
@@ -664,3 +685,23 @@ void IMUEKF::updateVars()
     angleY = angle(1);
     angleZ = angle(2);
 }
+
+Matrix<double, 6, 6> IMUEKF::poseCovariance() const
+{
+    //The orientation error is expressed in the base frame, Rib * exp(dtheta)
+    Matrix<double, 6, 15> J = Matrix<double, 6, 15>::Zero();
+    J.block<3, 3>(0, 6) = Matrix3d::Identity();
+    J.block<3, 3>(3, 3) = Rib;
+    return J * P * J.transpose();
+}
+
+Matrix<double, 6, 6> IMUEKF::twistCovariance() const
+{
+    //The velocity is in the base frame, the angular velocity is R * (omega - bgyr)
+    Matrix<double, 6, 15> J = Matrix<double, 6, 15>::Zero();
+    J.block<3, 3>(0, 0) = Rib;
+    J.block<3, 3>(3, 9) = Rib;
+    Matrix<double, 6, 6> C = J * P * J.transpose();
+    C.block<3, 3>(3, 3) += Rib * Vector3d(gyr_qx * gyr_qx, gyr_qy * gyr_qy, gyr_qz * gyr_qz).asDiagonal() * Rib.transpose();
+    return C;
+}
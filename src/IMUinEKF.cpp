@@ -63,7 +63,7 @@ void IMUinEKF::init()
     P(20, 20) = 1e-1;
 
     Af = Matrix<double, 21, 21>::Zero();
-    Af.block<3, 3>(3, 0).noalias() = skew(g);
+    Af.block<3, 3>(3, 0).noalias() = serow::lie::skew(g);
     Af.block<3, 3>(6, 3).noalias() = Matrix3d::Identity();
 
     Qff = Matrix<double, 21, 21>::Zero();
@@ -111,64 +111,11 @@ void IMUinEKF::seperateState(Matrix<double, 7, 7> X_, Matrix<double, 6, 1> theta
     ba_ = theta_.segment<3>(3);
 }
 
-Matrix<double, 7, 7> IMUinEKF::exp_SE3(Matrix<double, 15, 1> v)
-{
-    Matrix<double, 7, 7> dX_ = Matrix<double, 7, 7>::Identity();
-    double phi = v.segment<3>(0).norm();
-    Matrix3d R_ = Matrix3d::Identity();
-    Matrix3d Jr_ = Matrix3d::Identity();
-    if (phi >= 1e-6)
-    {
-        Matrix3d A = skew(v.segment<3>(0));
-        Matrix3d A2 = A * A;
-        double phi2 = phi * phi;
-        R_.noalias() += sin(phi) / phi * A;
-        R_.noalias() += (1 - cos(phi)) / (phi2)*A2;
-
-        Jr_.noalias() += (1 - cos(phi)) / (phi2)*A;
-        Jr_.noalias() += (phi - sin(phi)) / (phi2 * phi) * A2;
-    }
-    dX_.block<3, 3>(0, 0) = R_;
-    dX_.block<3, 1>(0, 3).noalias() = Jr_ * v.segment<3>(3);
-    dX_.block<3, 1>(0, 4).noalias() = Jr_ * v.segment<3>(6);
-    dX_.block<3, 1>(0, 5).noalias() = Jr_ * v.segment<3>(9);
-    dX_.block<3, 1>(0, 6).noalias() = Jr_ * v.segment<3>(12);
-
-    return dX_;
-}
-
-Matrix3d IMUinEKF::exp_SO3(Vector3d v)
-{
-    Matrix3d R_ = Matrix3d::Identity();
-    Matrix3d A = skew(v);
-    double phi = v.norm();
-    if (phi >= 1e-6)
-    {
-        R_.noalias() += (sin(phi) / phi) * A;
-        R_.noalias() += (1 - cos(phi)) / (phi * phi) * A * A;
-    }
-
-    return R_;
-}
-
 Matrix<double, 21, 21> IMUinEKF::Adjoint(Matrix<double, 7, 7> X_)
 {
+    //SE_K(3) adjoint of the Lie group part, the IMU biases are Euclidean
     Matrix<double, 21, 21> AdjX = Matrix<double, 21, 21>::Identity();
-    Matrix3d R_;
-    Vector3d v_, p_, dR_, dL_, bg_, ba_;
-    seperateState(X_, Matrix<double, 6, 1>::Zero(), R_, v_, p_, dR_, dL_, bg_, ba_);
-
-    AdjX.block<3, 3>(0, 0) = R_;
-    AdjX.block<3, 3>(3, 3) = R_;
-    AdjX.block<3, 3>(6, 6) = R_;
-    AdjX.block<3, 3>(9, 9) = R_;
-    AdjX.block<3, 3>(12, 12) = R_;
-
-    AdjX.block<3, 3>(3, 0).noalias() = skew(v_) * R_;
-    AdjX.block<3, 3>(6, 0).noalias() = skew(p_) * R_;
-    AdjX.block<3, 3>(9, 0).noalias() = skew(dR_) * R_;
-    AdjX.block<3, 3>(12, 0).noalias() = skew(dL_) * R_;
-
+    AdjX.block<15, 15>(0, 0) = serow::lie::adjointSEK3(X_);
     return AdjX;
 }
 
@@ -185,10 +132,10 @@ void IMUinEKF::predict(Vector3d angular_velocity, Vector3d linear_acceleration,
 
     Af.block<3, 3>(0, 15).noalias() = -Rwb;
     Af.block<3, 3>(3, 18).noalias() = -Rwb;
-    Af.block<3, 3>(3, 15).noalias() = -skew(vwb) * Rwb;
-    Af.block<3, 3>(6, 15).noalias() = -skew(pwb) * Rwb;
-    Af.block<3, 3>(9, 15).noalias() = -skew(dR) * Rwb;
-    Af.block<3, 3>(12, 15).noalias() = -skew(dL) * Rwb;
+    Af.block<3, 3>(3, 15).noalias() = -serow::lie::skew(vwb) * Rwb;
+    Af.block<3, 3>(6, 15).noalias() = -serow::lie::skew(pwb) * Rwb;
+    Af.block<3, 3>(9, 15).noalias() = -serow::lie::skew(dR) * Rwb;
+    Af.block<3, 3>(12, 15).noalias() = -serow::lie::skew(dL) * Rwb;
 
     Phi = If + Af * dt;
     Adj = Adjoint(X);
@@ -223,7 +170,7 @@ void IMUinEKF::predict(Vector3d angular_velocity, Vector3d linear_acceleration,
 
     pwb += vwb * dt + 0.5 * (Rwb * a + g) * dt * dt;
     vwb += (Rwb * a + g) * dt;
-    Rwb *= exp_SO3(w * dt);
+    Rwb *= serow::lie::expSO3(w * dt);
     //Foot Position Dynamics
     dR = contactR * dR + (1 - contactR) * (pwb + Rwb * pbr);
     dL = contactL * dL + (1 - contactL) * (pwb + Rwb * pbl);
@@ -267,7 +214,7 @@ void IMUinEKF::updateVelocity(Matrix<double, 7, 1> Y_, Matrix<double, 7, 1> b_,
 
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
     X = X * dX_;
@@ -282,7 +229,7 @@ void IMUinEKF::updateVelocity(Matrix<double, 7, 1> Y_, Matrix<double, 7, 1> b_,
 void IMUinEKF::updateWithOdom(Vector3d py, Quaterniond qy)
 {
     Matrix<double, 14, 1> Y = Matrix<double, 14, 1>::Zero();
-    Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+    Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
     Y.segment<3>(7) = py;
     Y(11) = 1.000;
 
@@ -329,7 +276,7 @@ void IMUinEKF::updatePositionOrientation(Matrix<double, 14, 1> Y_, Matrix<double
 
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
     X = X * dX_;
@@ -345,7 +292,7 @@ void IMUinEKF::updateWithOrient(Quaterniond qy)
 {
     Matrix<double, 7, 1> Y = Matrix<double, 7, 1>::Zero();
 
-    Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+    Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
     Matrix<double, 3, 21> H = Matrix<double, 3, 21>::Zero();
     H.block<3, 3>(0, 0) = Matrix3d::Identity();
     Matrix<double, 3, 3> N = Matrix<double, 3, 3>::Zero();
@@ -373,7 +320,7 @@ void IMUinEKF::updateOrientation(Matrix<double, 7, 1> Y_, Matrix<double, 7, 1> b
     Z_.segment<3>(0) = Y_.segment<3>(0);
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
     X = X * dX_;
@@ -391,7 +338,7 @@ void IMUinEKF::updateOrientation(Matrix<double, 7, 1> Y_, Matrix<double, 7, 1> b
 void IMUinEKF::updateWithTwistOrient(Vector3d vy, Quaterniond qy)
 {
     Matrix<double, 14, 1> Y = Matrix<double, 14, 1>::Zero();
-    Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+    Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
     Y.segment<3>(7) = vy;
     Y(10) = 1.00;
 
@@ -433,7 +380,7 @@ void IMUinEKF::updateVelocityOrientation(Matrix<double, 14, 1> Y_, Matrix<double
     Z_.segment<3>(0) = Y_.segment<3>(0);
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
     X = X * dX_;
@@ -540,7 +487,7 @@ void IMUinEKF::updateStateSingleContact(Matrix<double, 7, 1> Y_, Matrix<double,
 
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
     X = dX_ * X;
@@ -567,7 +514,7 @@ void IMUinEKF::updateStateDoubleContact(Matrix<double, 14, 1> Y_, Matrix<double,
     //Update State
     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
 
-    Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+    Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
     X = dX_ * X;
     theta += dtheta_;
@@ -576,6 +523,24 @@ void IMUinEKF::updateStateDoubleContact(Matrix<double, 14, 1> Y_, Matrix<double,
     P = IKH * P * IKH.transpose() + K_ * N_ * K_.transpose();
 }
 
+void IMUinEKF::updateWithGyroBias(const Vector3d &bg_, const Matrix3d &Rbg)
+{
+    //The bias block is the same in the right and left invariant error, so the update is done in place
+    Matrix<double, 3, 21> H_ = Matrix<double, 3, 21>::Zero();
+    H_.block<3, 3>(0, 15) = Matrix3d::Identity();
+    Matrix3d S_ = Rbg + P.block<3, 3>(15, 15);
+    Matrix<double, 21, 3> K_ = P.block<21, 3>(0, 15) * S_.inverse();
+
+    //Update State
+    Matrix<double, 21, 1> delta_ = K_ * (bg_ - theta.segment<3>(0));
+    X = serow::lie::expSEK3(delta_.segment<15>(0)) * X;
+    theta += delta_.segment<6>(15);
+
+    Matrix<double, 21, 21> IKH = If - K_ * H_;
+    P = IKH * P * IKH.transpose() + K_ * Rbg * K_.transpose();
+    updateVars();
+}
+
 void IMUinEKF::updateVars()
 {
 
@@ -618,3 +583,25 @@ void IMUinEKF::updateVars()
     angleY = angle(1);
     angleZ = angle(2);
 }
+
+Matrix<double, 6, 6> IMUinEKF::poseCovariance() const
+{
+    //Right invariant error: R = exp(phi) R, p = p + phi x p + xi_p
+    Matrix<double, 6, 21> J = Matrix<double, 6, 21>::Zero();
+    J.block<3, 3>(0, 0) = -serow::lie::skew(pwb);
+    J.block<3, 3>(0, 6) = Matrix3d::Identity();
+    J.block<3, 3>(3, 0) = Matrix3d::Identity();
+    return J * P * J.transpose();
+}
+
+Matrix<double, 6, 6> IMUinEKF::twistCovariance() const
+{
+    //v = v + phi x v + xi_v, the angular velocity is Rwb * (w - bgyr)
+    Matrix<double, 6, 21> J = Matrix<double, 6, 21>::Zero();
+    J.block<3, 3>(0, 0) = -serow::lie::skew(vwb);
+    J.block<3, 3>(0, 3) = Matrix3d::Identity();
+    J.block<3, 3>(3, 15) = Rwb;
+    Matrix<double, 6, 6> C = J * P * J.transpose();
+    C.block<3, 3>(3, 3) += Rwb * Vector3d(gyr_qx * gyr_qx, gyr_qy * gyr_qy, gyr_qz * gyr_qz).asDiagonal() * Rwb.transpose();
+    return C;
+}
@@ -75,7 +75,7 @@ void IMUinEKFQuad::init()
     P(26, 26) = 1e-1;
 
     Af = Matrix<double, 27, 27>::Zero();
-    Af.block<3, 3>(3, 0).noalias() = skew(g);
+    Af.block<3, 3>(3, 0).noalias() = serow::lie::skew(g);
     Af.block<3, 3>(6, 3).noalias() = Matrix3d::Identity();
 
     Qff = Matrix<double, 27, 27>::Zero();
@@ -130,70 +130,11 @@ void IMUinEKFQuad::seperateState(Matrix<double, 9, 9> X_, Matrix<double, 6, 1> t
     ba_ = theta_.segment<3>(3);
 }
 
-Matrix<double, 9, 9> IMUinEKFQuad::exp_SE3(Matrix<double, 21, 1> v)
-{
-    Matrix<double, 9, 9> dX_ = Matrix<double, 9, 9>::Identity();
-    double phi = v.segment<3>(0).norm();
-    Matrix3d R_ = Matrix3d::Identity();
-    Matrix3d Jr_ = Matrix3d::Identity();
-    if (phi >= 1e-6)
-    {
-        Matrix3d A = skew(v.segment<3>(0));
-        Matrix3d A2 = A * A;
-        double phi2 = phi * phi;
-        R_.noalias() += sin(phi) / phi * A;
-        R_.noalias() += (1 - cos(phi)) / (phi2)*A2;
-
-        Jr_.noalias() += (1 - cos(phi)) / (phi2)*A;
-        Jr_.noalias() += (phi - sin(phi)) / (phi2 * phi) * A2;
-    }
-    dX_.block<3, 3>(0, 0) = R_;
-    dX_.block<3, 1>(0, 3).noalias() = Jr_ * v.segment<3>(3);
-    dX_.block<3, 1>(0, 4).noalias() = Jr_ * v.segment<3>(6);
-    dX_.block<3, 1>(0, 5).noalias() = Jr_ * v.segment<3>(9);
-    dX_.block<3, 1>(0, 6).noalias() = Jr_ * v.segment<3>(12);
-    dX_.block<3, 1>(0, 7).noalias() = Jr_ * v.segment<3>(15);
-    dX_.block<3, 1>(0, 8).noalias() = Jr_ * v.segment<3>(18);
-    return dX_;
-}
-
-Matrix3d IMUinEKFQuad::exp_SO3(Vector3d v)
-{
-    Matrix3d R_ = Matrix3d::Identity();
-    Matrix3d A = skew(v);
-    double phi = v.norm();
-    if (phi >= 1e-6)
-    {
-        R_.noalias() += (sin(phi) / phi) * A;
-        R_.noalias() += (1 - cos(phi)) / (phi * phi) * A * A;
-    }
-
-    return R_;
-}
-
 Matrix<double, 27, 27> IMUinEKFQuad::Adjoint(Matrix<double, 9, 9> X_)
 {
+    //SE_K(3) adjoint of the Lie group part, the IMU biases are Euclidean
     Matrix<double, 27, 27> AdjX = Matrix<double, 27, 27>::Identity();
-    Matrix3d R_;
-    Vector3d v_, p_, dRF_, dRH_, dLF_, dLH_, bg_, ba_;
-    seperateState(X_, Matrix<double, 6, 1>::Zero(), R_, v_, p_, dRF_, dRH_, dLF_, dLH_, bg_, ba_);
-
-    AdjX.block<3, 3>(0, 0) = R_;
-    AdjX.block<3, 3>(3, 3) = R_;
-    AdjX.block<3, 3>(6, 6) = R_;
-    AdjX.block<3, 3>(9, 9) = R_;
-    AdjX.block<3, 3>(12, 12) = R_;
-    AdjX.block<3, 3>(15, 15) = R_;
-    AdjX.block<3, 3>(18, 18) = R_;
-
-
-    AdjX.block<3, 3>(3, 0).noalias() = skew(v_) * R_;
-    AdjX.block<3, 3>(6, 0).noalias() = skew(p_) * R_;
-    AdjX.block<3, 3>(9, 0).noalias() = skew(dRF_) * R_;
-    AdjX.block<3, 3>(12, 0).noalias() = skew(dRH_) * R_;
-    AdjX.block<3, 3>(15, 0).noalias() = skew(dLF_) * R_;
-    AdjX.block<3, 3>(18, 0).noalias() = skew(dLH_) * R_;
-
+    AdjX.block<21, 21>(0, 0) = serow::lie::adjointSEK3(X_);
     return AdjX;
 }
 
@@ -212,12 +153,12 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 
     Af.block<3, 3>(0, 21).noalias() = -Rwb;
     Af.block<3, 3>(3, 24).noalias() = -Rwb;
-    Af.block<3, 3>(3, 21).noalias() = -skew(vwb) * Rwb;
-    Af.block<3, 3>(6, 21).noalias() = -skew(pwb) * Rwb;
-    Af.block<3, 3>(9, 21).noalias() = -skew(dRF) * Rwb;
-    Af.block<3, 3>(12, 21).noalias() = -skew(dRH) * Rwb;
-    Af.block<3, 3>(15, 21).noalias() = -skew(dLF) * Rwb;
-    Af.block<3, 3>(18, 21).noalias() = -skew(dLH) * Rwb;
+    Af.block<3, 3>(3, 21).noalias() = -serow::lie::skew(vwb) * Rwb;
+    Af.block<3, 3>(6, 21).noalias() = -serow::lie::skew(pwb) * Rwb;
+    Af.block<3, 3>(9, 21).noalias() = -serow::lie::skew(dRF) * Rwb;
+    Af.block<3, 3>(12, 21).noalias() = -serow::lie::skew(dRH) * Rwb;
+    Af.block<3, 3>(15, 21).noalias() = -serow::lie::skew(dLF) * Rwb;
+    Af.block<3, 3>(18, 21).noalias() = -serow::lie::skew(dLH) * Rwb;
 
 
 
@@ -260,7 +201,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 
     pwb += vwb * dt + 0.5 * (Rwb * a + g) * dt * dt;
     vwb += (Rwb * a + g) * dt;
-    Rwb *= exp_SO3(w * dt);
+    Rwb *= serow::lie::expSO3(w * dt);
     //Foot Position Dynamics
     dRF = contactRF * dRF + (1 - contactRF) * (pwb + Rwb * pbRF);
     dRH = contactRH * dRH + (1 - contactRH) * (pwb + Rwb * pbRH);
@@ -308,7 +249,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 
 //     //Update State
 //     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-//     Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+//     Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
 //     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
 //     X = X * dX_;
@@ -323,7 +264,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 // void IMUinEKFQuad::updateWithOdom(Vector3d py, Quaterniond qy)
 // {
 //     Matrix<double, 14, 1> Y = Matrix<double, 14, 1>::Zero();
-//     Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+//     Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
 //     Y.segment<3>(7) = py;
 //     Y(11) = 1.000;
 
@@ -370,7 +311,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 
 //     //Update State
 //     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-//     Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+//     Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
 //     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
 //     X = X * dX_;
@@ -386,7 +327,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 // {
 //     Matrix<double, 7, 1> Y = Matrix<double, 7, 1>::Zero();
 
-//     Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+//     Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
 //     Matrix<double, 3, 21> H = Matrix<double, 3, 21>::Zero();
 //     H.block<3, 3>(0, 0) = Matrix3d::Identity();
 //     Matrix<double, 3, 3> N = Matrix<double, 3, 3>::Zero();
@@ -414,7 +355,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 //     Z_.segment<3>(0) = Y_.segment<3>(0);
 //     //Update State
 //     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-//     Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+//     Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
 //     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
 //     X = X * dX_;
@@ -432,7 +373,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 // void IMUinEKFQuad::updateWithTwistOrient(Vector3d vy, Quaterniond qy)
 // {
 //     Matrix<double, 14, 1> Y = Matrix<double, 14, 1>::Zero();
-//     Y.segment<3>(0) = logMap(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
+//     Y.segment<3>(0) = serow::lie::logSO3(X.block<3, 3>(0, 0).inverse() * qy.toRotationMatrix());
 //     Y.segment<3>(7) = vy;
 //     Y(10) = 1.00;
 
@@ -474,7 +415,7 @@ void IMUinEKFQuad::predict(Vector3d angular_velocity, Vector3d linear_accelerati
 //     Z_.segment<3>(0) = Y_.segment<3>(0);
 //     //Update State
 //     Matrix<double, 21, 1> delta_ = K_ * PI_ * Z_;
-//     Matrix<double, 7, 7> dX_ = exp_SE3(delta_.segment<15>(0));
+//     Matrix<double, 7, 7> dX_ = serow::lie::expSEK3(delta_.segment<15>(0));
 //     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(15);
 
 //     X = X * dX_;
@@ -596,7 +537,7 @@ void IMUinEKFQuad::updateStateSingleContact(Matrix<double, 9, 1> Y_, Matrix<doub
 
     //Update State
     Matrix<double, 27, 1> delta_ = K_ * PI_  * Z_;
-    Matrix<double, 9, 9> dX_ = exp_SE3(delta_.segment<21>(0));
+    Matrix<double, 9, 9> dX_ = serow::lie::expSEK3(delta_.segment<21>(0));
     Matrix<double, 6, 1> dtheta_ = delta_.segment<6>(21);
 
     X = dX_ * X;
@@ -607,6 +548,24 @@ void IMUinEKFQuad::updateStateSingleContact(Matrix<double, 9, 1> Y_, Matrix<doub
 }
 
 
+void IMUinEKFQuad::updateWithGyroBias(const Vector3d &bg_, const Matrix3d &Rbg)
+{
+    //The bias block is the same in the right and left invariant error, so the update is done in place
+    Matrix<double, 3, 27> H_ = Matrix<double, 3, 27>::Zero();
+    H_.block<3, 3>(0, 21) = Matrix3d::Identity();
+    Matrix3d S_ = Rbg + P.block<3, 3>(21, 21);
+    Matrix<double, 27, 3> K_ = P.block<27, 3>(0, 21) * S_.inverse();
+
+    //Update State
+    Matrix<double, 27, 1> delta_ = K_ * (bg_ - theta.segment<3>(0));
+    X = serow::lie::expSEK3(delta_.segment<21>(0)) * X;
+    theta += delta_.segment<6>(21);
+
+    Matrix<double, 27, 27> IKH = If - K_ * H_;
+    P = IKH * P * IKH.transpose() + K_ * Rbg * K_.transpose();
+    updateVars();
+}
+
 void IMUinEKFQuad::updateVars()
 {
 
@@ -653,3 +612,25 @@ void IMUinEKFQuad::updateVars()
     angleY = angle(1);
     angleZ = angle(2);
 }
+
+Matrix<double, 6, 6> IMUinEKFQuad::poseCovariance() const
+{
+    //Right invariant error: R = exp(phi) R, p = p + phi x p + xi_p
+    Matrix<double, 6, 27> J = Matrix<double, 6, 27>::Zero();
+    J.block<3, 3>(0, 0) = -serow::lie::skew(pwb);
+    J.block<3, 3>(0, 6) = Matrix3d::Identity();
+    J.block<3, 3>(3, 0) = Matrix3d::Identity();
+    return J * P * J.transpose();
+}
+
+Matrix<double, 6, 6> IMUinEKFQuad::twistCovariance() const
+{
+    //v = v + phi x v + xi_v, the angular velocity is Rwb * (w - bgyr)
+    Matrix<double, 6, 27> J = Matrix<double, 6, 27>::Zero();
+    J.block<3, 3>(0, 0) = -serow::lie::skew(vwb);
+    J.block<3, 3>(0, 3) = Matrix3d::Identity();
+    J.block<3, 3>(3, 21) = Rwb;
+    Matrix<double, 6, 6> C = J * P * J.transpose();
+    C.block<3, 3>(3, 3) += Rwb * Vector3d(gyr_qx * gyr_qx, gyr_qy * gyr_qy, gyr_qz * gyr_qz).asDiagonal() * Rwb.transpose();
+    return C;
+}
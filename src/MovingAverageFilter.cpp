@@ -37,6 +37,8 @@ MovingAverageFilter::MovingAverageFilter()
     x = 0.000;
     //Window Size
     windowSize = 10;
+    windowBuffer.assign(windowSize, 0.0f);
+    head = 0;
     currentstep = 0;
     std::cout<<"Moving Average Filter Initialized Successfully"<<std::endl;
 }
@@ -47,8 +49,7 @@ void MovingAverageFilter::reset()
 {
     x = 0.000;
     currentstep = 0;
-    while(windowBuffer.size()>0)
-        windowBuffer.pop();
+    head = 0;
     std::cout<<"Moving Average Filter Reseted"<<std::endl;
 }
 
@@ -61,14 +62,15 @@ void MovingAverageFilter::filter(float  y)
     {
         //Moving Window
         x = (x*currentstep + y) /(currentstep + 1);
+        windowBuffer[currentstep] = y;
         currentstep++;
     }
     else
     {
-        x+=(y-windowBuffer.front())/windowSize;
-        if(windowBuffer.size()>=windowSize)
-            windowBuffer.pop();
+        //Overwrite the oldest sample in place
+        x+=(y-windowBuffer[head])/windowSize;
+        windowBuffer[head] = y;
+        head = (head + 1) % windowSize;
     }
-    windowBuffer.push(y);
     /** ------------------------------------------------------------- **/
 }
@@ -32,20 +32,36 @@
 #include <iostream>
 #include <algorithm>
 #include <serow/quadruped_ekf.h>
+#include <serow/msgConversions.h>
 
 void quadruped_ekf::loadparams()
 {
 
-    ros::NodeHandle n_p("~");
     // Load Server Parameters
     n_p.param<std::string>("modelname", modelname, "centauro.urdf");
-    rd = new serow::robotDyn(modelname, false);
+    n_p.param<std::string>("model_cache_dir", model_cache_dir, serow::robotDyn::defaultModelCacheDir());
+    rd = new serow::robotDyn(modelname, false, false, model_cache_dir);
 
     n_p.param<std::string>("base_link", base_link_frame, "base_link");
     n_p.param<std::string>("LFfoot", LFfoot_frame, "lf_ankle");
     n_p.param<std::string>("LHfoot", LHfoot_frame, "lh_ankle");
     n_p.param<std::string>("RFfoot", RFfoot_frame, "rf_ankle");
     n_p.param<std::string>("RHfoot", RHfoot_frame, "rh_ankle");
+    n_p.param<std::string>("kinematics_library", kinematics_library, "");
+    if (!kinematics_library.empty())
+    {
+        std::string report;
+        if (!rd->loadGeneratedKinematics(kinematics_library, report))
+            ROS_WARN("Generated kinematics not used, falling back to Pinocchio: %s", report.c_str());
+        else if (!rd->hasGeneratedFrame(LFfoot_frame) || !rd->hasGeneratedFrame(LHfoot_frame) ||
+                 !rd->hasGeneratedFrame(RFfoot_frame) || !rd->hasGeneratedFrame(RHfoot_frame))
+        {
+            rd->unloadGeneratedKinematics();
+            ROS_WARN("Generated kinematics %s lack the foot frames, falling back to Pinocchio", kinematics_library.c_str());
+        }
+        else
+            ROS_INFO("%s", report.c_str());
+    }
 
     n_p.param<std::string>("LFfoot_force_torque_topic", LFfsr_topic, "force_torque/leftFront");
     n_p.param<std::string>("LHfoot_force_torque_topic", LHfsr_topic, "force_torque/leftHind");
@@ -55,6 +71,8 @@ void quadruped_ekf::loadparams()
 
     n_p.param<double>("imu_topic_freq", freq, 100.0);
     n_p.param<double>("fsr_topic_freq", fsr_freq, 100.0);
+    n_p.param<double>("imu_native_freq", imu_native_freq, freq);
+    n_p.param<int>("imu_queue_size", imu_queue_size, (int)imuBuffer.capacity());
 
 
     n_p.param<double>("VelocityThres", VelocityThres, 0.5);
@@ -62,6 +80,10 @@ void quadruped_ekf::loadparams()
     n_p.param<bool>("useGEM", useGEM, true);
     n_p.param<bool>("calibrateIMUbiases", imuCalibrated, true);
     n_p.param<int>("maxImuCalibrationCycles", maxImuCalibrationCycles, 500);
+    n_p.param<double>("no_motion_threshold", no_motion_threshold, 5e-4);
+    n_p.param<int>("no_motion_it_threshold", no_motion_it_threshold, 500);
+    n_p.param<double>("no_motion_gyro_threshold", no_motion_gyro_threshold, 0.05);
+    n_p.param<double>("no_motion_acc_threshold", no_motion_acc_threshold, 0.3);
 
 
 
@@ -103,6 +125,88 @@ void quadruped_ekf::loadparams()
     n_p.param<bool>("ground_truth", ground_truth, false);
     n_p.param<bool>("debug_mode", debug_mode, false);
 
+    //Publishing in a separate thread and per topic group decimation
+    n_p.param<bool>("usePublisherThread", usePublisherThread, true);
+    n_p.param<int>("publish_decimation/joints", joint_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/body", body_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/legs", leg_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/support", support_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/contact", contact_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/grf", grf_pub_decimation, 1);
+    n_p.param<int>("publish_decimation/com", com_pub_decimation, 1);
+
+    //Real-time mode, the estimation thread must not allocate once warmed up
+    n_p.param<bool>("rt_mode", rt_mode, false);
+    n_p.param<int>("rt_warmup_cycles", rt_warmup_cycles, 1000);
+    n_p.param<bool>("rt_abort_on_allocation", rt_abort_on_allocation, false);
+    if (rt_mode)
+    {
+        //publishing allocates, keep it off the estimation thread
+        usePublisherThread = true;
+        if (!serow::allocationTrackingAvailable())
+            std::cout << "rt_mode: allocation tracking not compiled in, build with -DSEROW_ALLOCATION_TRACKING=ON" << std::endl;
+    }
+    if (hosted)
+    {
+        if (rt_mode)
+            std::cout << "rt_mode is not available to a hosted estimator, the host workers own the scheduling" << std::endl;
+        rt_mode = false;
+        usePublisherThread = false;
+    }
+    n_p.param<std::string>("rt_sched_policy", rt_sched_policy, "other");
+    n_p.param<int>("rt_priority", rt_priority, 80);
+    n_p.param<std::vector<int>>("estimator_cpus", estimator_cpus, std::vector<int>());
+    n_p.param<std::vector<int>>("publisher_cpus", publisher_cpus, std::vector<int>());
+    n_p.param<bool>("rt_lock_memory", rt_lock_memory, false);
+    n_p.param<int>("rt_stack_prefault", rt_stack_prefault, 512 * 1024);
+
+    //Deadline monitor and degraded mode governor
+    double deadline_budget, deadline_overrun_ratio, deadline_restore_budget;
+    int deadline_window, deadline_restore_windows, deadline_max_level;
+    n_p.param<double>("deadline_budget", deadline_budget, 0.8);
+    n_p.param<int>("deadline_window", deadline_window, 100);
+    n_p.param<double>("deadline_overrun_ratio", deadline_overrun_ratio, 0.05);
+    n_p.param<double>("deadline_restore_budget", deadline_restore_budget, 0.5);
+    n_p.param<int>("deadline_restore_windows", deadline_restore_windows, 5);
+    n_p.param<int>("deadline_max_level", deadline_max_level, serow::DeadlineGovernor::MinimalBase);
+    n_p.param<int>("degraded_publish_decimation", degraded_pub_decimation, 4);
+    n_p.param<int>("degraded_com_decimation", degraded_com_decimation, 2);
+    degraded_pub_decimation = std::max(degraded_pub_decimation, 1);
+    degraded_com_decimation = std::max(degraded_com_decimation, 1);
+    //Shared memory output of the latest estimate, empty disables it
+    n_p.param<std::string>("shm_estimate_name", shm_estimate_name, "");
+    if (!shm_estimate_name.empty() && !shmEstimate.open(shm_estimate_name))
+        ROS_WARN("Could not create the shared memory estimate channel %s", shm_estimate_name.c_str());
+    //History of the base estimates for the serow/lookup_pose service, 0 disables it
+    int pose_history_size;
+    n_p.param<int>("pose_history_size", pose_history_size, 1000);
+    n_p.param<std::string>("pose_history_shm_name", pose_history_shm_name, "");
+    if (pose_history_size > 0 && !poseHistory.create(pose_history_size, pose_history_shm_name))
+        ROS_WARN("Could not create the pose history of %d estimates %s", pose_history_size, pose_history_shm_name.c_str());
+    //Binary telemetry written by a background thread, empty disables it
+    std::string telemetry_file;
+    int telemetry_buffer_size;
+    double telemetry_flush_period;
+    n_p.param<std::string>("telemetry_file", telemetry_file, "");
+    n_p.param<int>("telemetry_buffer_size", telemetry_buffer_size, 65536);
+    n_p.param<double>("telemetry_flush_period", telemetry_flush_period, 0.05);
+    if (!telemetry_file.empty() && !telemetry.open(telemetry_file, std::max(telemetry_buffer_size, 2), telemetry_flush_period))
+        ROS_WARN("Could not create the telemetry file %s", telemetry_file.c_str());
+    if (telemetry.isOpen())
+    {
+        const char *columns[] = {"px", "py", "pz", "vx", "vy", "vz"};
+        tlmBase = telemetry.channel("base", std::vector<std::string>(columns, columns + 6));
+        tlmCoM = telemetry.channel("com", std::vector<std::string>(columns, columns + 6));
+    }
+
+    governor.init(freq, deadline_budget, deadline_window, deadline_overrun_ratio, deadline_restore_budget, deadline_restore_windows, deadline_max_level);
+
+    //Event trace for chrome://tracing or ui.perfetto.dev, 0 disables it
+    int trace_buffer_size;
+    n_p.param<int>("trace_buffer_size", trace_buffer_size, 0);
+    n_p.param<std::string>("trace_file", trace_file, "/tmp/serow_trace.json");
+    tracer.init(trace_buffer_size > 0 ? trace_buffer_size : 0);
+
     n_p.param<bool>("support_idx_provided", support_idx_provided, false);
     if (support_idx_provided)
         n_p.param<std::string>("support_idx_topic", support_idx_topic, "support_idx");
@@ -111,10 +215,21 @@ void quadruped_ekf::loadparams()
 
     std::vector<double> affine_list;
 
+    useEvaluation = false;
     if (ground_truth)
     {
         n_p.param<std::string>("ground_truth_odom_topic", ground_truth_odom_topic, "ground_truth");
         n_p.param<std::string>("ground_truth_com_topic", ground_truth_com_topic, "ground_truth_com");
+        n_p.param<bool>("evaluation", useEvaluation, true);
+        n_p.param<double>("evaluation_period", evaluation_period, 5.0);
+        std::vector<double> evaluation_windows;
+        if (!n_p.getParam("evaluation_windows", evaluation_windows))
+        {
+            evaluation_windows.push_back(1.0);
+            evaluation_windows.push_back(10.0);
+        }
+        baseEvaluator.setParams(evaluation_windows, true, 0.1);
+        comEvaluator.setParams(evaluation_windows, false, 0.1);
         n_p.getParam("T_B_GT", affine_list);
         T_B_GT(0, 0) = affine_list[0];
         T_B_GT(0, 1) = affine_list[1];
@@ -200,6 +315,10 @@ void quadruped_ekf::loadparams()
     n_p.param<std::string>("odom_topic", odom_topic, "odom");
     n_p.param<std::string>("imu_topic", imu_topic, "imu");
     n_p.param<std::string>("joint_state_topic", joint_state_topic, "joint_states");
+    n_p.param<std::string>("sensor_input", sensor_input, "ros");
+    n_p.param<std::string>("shm_sensor_name", shm_sensor_name, "/serow_sensors");
+    n_p.param<double>("startup_timeout", startup_timeout, 1.0);
+    n_p.param<bool>("useDynamicReconfigure", useDynamicReconfigure, true);
     n_p.param<double>("joint_noise_density", joint_noise_density, 0.03);
 
 
@@ -301,13 +420,11 @@ void quadruped_ekf::loadparams()
         //Mahony Filter for Attitude Estimation
         n_p.param<double>("Mahony_Kp", Kp, 0.25);
         n_p.param<double>("Mahony_Ki", Ki, 0.0);
-        mh = new serow::Mahony(freq, Kp, Ki);
     }
     else
     {
         //Madgwick Filter for Attitude Estimation
         n_p.param<double>("Madgwick_gain", beta, 0.012f);
-        mw = new serow::Madgwick(freq, beta);
     }
 
 
@@ -320,14 +437,12 @@ void quadruped_ekf::loadparams()
 
 void quadruped_ekf::loadJointKFparams()
 {
-    ros::NodeHandle n_p("~");
     n_p.param<double>("joint_topic_freq", joint_freq, 100.0);
     n_p.param<double>("joint_cutoff_freq", joint_cutoff_freq, 10.0);
 }
 
 void quadruped_ekf::loadIMUEKFparams()
 {
-    ros::NodeHandle n_p("~");
     n_p.param<double>("bias_ax", bias_ax, 0.0);
     n_p.param<double>("bias_ay", bias_ay, 0.0);
     n_p.param<double>("bias_az", bias_az, 0.0);
@@ -372,14 +487,14 @@ void quadruped_ekf::loadIMUEKFparams()
         n_p.param<double>("odom_orientation_noise_density", imuInEKF->odom_ax, 1.0e-01);
         n_p.param<double>("odom_orientation_noise_density", imuInEKF->odom_ay, 1.0e-01);
         n_p.param<double>("odom_orientation_noise_density", imuInEKF->odom_az, 1.0e-01);
-
-    
+    //The calibration starts from the configured biases, the first still window replaces them
+    imuBiasCalibrator.setParams(g, no_motion_gyro_threshold, no_motion_acc_threshold, no_motion_it_threshold, maxImuCalibrationCycles);
+    imuBiasCalibrator.setPrior(Vector3d(bias_ax, bias_ay, bias_az), Vector3d(bias_gx, bias_gy, bias_gz), 0);
 }
 
 void quadruped_ekf::loadCoMEKFparams()
 {
 
-    ros::NodeHandle n_p("~");
     n_p.param<double>("com_position_random_walk", nipmEKF->com_q, 1.0e-04);
     n_p.param<double>("com_velocity_random_walk", nipmEKF->comd_q, 1.0e-03);
     n_p.param<double>("external_force_random_walk", nipmEKF->fd_q, 1.0);
@@ -401,6 +516,34 @@ void quadruped_ekf::loadCoMEKFparams()
 
 quadruped_ekf::quadruped_ekf()
 {
+    is_connected_ = false;
+    callbackQueue = NULL;
+    intraProcess = false;
+    hosted = false;
+    stopRequested = false;
+    publisherRunning = false;
+    usePublisherThread = false;
+    rt_mode = false;
+    rt_abort_on_allocation = false;
+    rt_warmup_cycles = 0;
+    rt_cycle = 0;
+    rt_sched_policy = "other";
+    rt_priority = 0;
+    rt_stack_prefault = 0;
+    rt_lock_memory = false;
+    degraded_pub_decimation = 1;
+    degraded_com_decimation = 1;
+    com_step = 1;
+    com_cycle = 0;
+    comSuspended = false;
+    shm_cycle = 0;
+    tlmBase = -1;
+    tlmCoM = -1;
+    pipeline = NULL;
+    estimationCycle = NULL;
+    beta = 0.0;
+    Kp = 0.0;
+    Ki = 0.0;
     useCoMEKF = true;
     useLegOdom = false;
     firstUpdate = false;
@@ -417,16 +560,23 @@ void quadruped_ekf::disconnect()
 {
     if (!is_connected_)
         return;
+    stopPublisher();
 
     is_connected_ = false;
 }
 
 bool quadruped_ekf::connect(const ros::NodeHandle nh)
+{
+    return connect(nh, ros::NodeHandle("~"));
+}
+
+bool quadruped_ekf::connect(const ros::NodeHandle nh, const ros::NodeHandle nh_p)
 {
     ROS_INFO_STREAM("SERoW Initializing...");
 
     // Initialize ROS nodes
     n = nh;
+    n_p = nh_p;
     // Load ROS Parameters
     loadparams();
     //Initialization
@@ -437,18 +587,18 @@ bool quadruped_ekf::connect(const ros::NodeHandle nh)
 
     if (useCoMEKF)
         loadCoMEKFparams();
+    loadCheckpoint();
 
     //Subscribe/Publish ROS Topics/Services
     subscribe();
     advertise();
-    //
-    //ros::NodeHandle np("~")
-    //dynamic_recfg_ = boost::make_shared< dynamic_reconfigure::Server<serow::VarianceControlConfig> >(np);
-    //dynamic_reconfigure::Server<serow::VarianceControlConfig>::CallbackType cb = boost::bind(&quadruped_ekf::reconfigureCB, this, _1, _2);
-    // dynamic_recfg_->setCallback(cb);
+    initMessages();
+    initProfiler();
+    startPublisher();
+    if (useDynamicReconfigure)
+        startReconfigure();
     is_connected_ = true;
-
-    ros::Duration(1.0).sleep();
+    waitForInputs();
     ROS_INFO_STREAM("SERoW Initialized");
 
     return true;
@@ -460,12 +610,42 @@ bool quadruped_ekf::connected()
     return is_connected_;
 }
 
+void quadruped_ekf::setCallbackQueue(ros::CallbackQueue* queue)
+{
+    callbackQueue = queue;
+}
+
+void quadruped_ekf::setIntraProcess(bool intraProcess_)
+{
+    intraProcess = intraProcess_;
+}
+
+void quadruped_ekf::stop()
+{
+    stopRequested = true;
+}
+
+void quadruped_ekf::setHosted(bool hosted_)
+{
+    hosted = hosted_;
+}
+
 void quadruped_ekf::subscribe()
 {
 
-    subscribeToIMU();
-    subscribeToFSR();
-    subscribeToJointState();
+    if (sensor_input == "shm")
+    {
+        //IMU, joint and F/T data come from the shared memory ring, polled by run()
+        firstJointStates = true;
+        if (!openSensorRing())
+            ROS_INFO("Waiting for the shared memory sensor ring %s", shm_sensor_name.c_str());
+    }
+    else
+    {
+        subscribeToIMU();
+        subscribeToFSR();
+        subscribeToJointState();
+    }
 
     if (!useLegOdom)
         subscribeToOdom();
@@ -561,9 +741,6 @@ void quadruped_ekf::init()
     firstGyrodot = true;
     firstContact = true;
 
-    // Initialize the IMU based EKF
-    imuInEKF = new IMUinEKFQuad;
-    imuInEKF->init();
     if (useCoMEKF)
     {
         if (useGyroLPF)
@@ -578,10 +755,14 @@ void quadruped_ekf::init()
             for (unsigned int i = 0; i < 3; i++)
                 gyroMAF[i] = new MovingAverageFilter();
         }
-        nipmEKF = new CoMEKF;
-        nipmEKF->init();
     }
 
+    //Compose the attitude, base, contact and CoM estimators into one pipeline
+    if (useMahony)
+        composeBase<serow::MahonyAttitude>();
+    else
+        composeBase<serow::MadgwickAttitude>();
+
     imu_inc = false;
     LFfsr_inc = false;
     RFfsr_inc = false;
@@ -604,125 +785,793 @@ void quadruped_ekf::init()
     LHmdf = MediatorNew(medianWindow);
     RHmdf = MediatorNew(medianWindow);
 
-    imuCalibrationCycles = 0;
-    bias_g = Vector3d::Zero();
-    bias_a = Vector3d::Zero();
+    imuBiasesRefined = false;
+    imuBiasesReport = false;
+    imuBiasesRestored = false;
+    gt_odom = Vector3d::Zero();
+    gt_odomq = Quaterniond::Identity();
+    firstImuSample = true;
+    last_imu_stamp = 0.0;
+
+
+}
+
+template <class AttitudePolicy>
+void quadruped_ekf::composeBase()
+{
+    composeContact<AttitudePolicy, serow::ContactAidedBase<IMUinEKFQuad> >();
+}
+
+template <class AttitudePolicy, class BaseFilterPolicy>
+void quadruped_ekf::composeContact()
+{
+    if (useGEM)
+        composeCoM<AttitudePolicy, BaseFilterPolicy, serow::ProbabilisticContact<serow::ContactDetectionQuad> >();
+    else
+        composeCoM<AttitudePolicy, BaseFilterPolicy, serow::ThresholdContact<serow::ContactDetectionQuad> >();
+}
+
+template <class AttitudePolicy, class BaseFilterPolicy, class ContactPolicy>
+void quadruped_ekf::composeCoM()
+{
+    if (useCoMEKF)
+        bindPipeline<serow::Estimator<AttitudePolicy, BaseFilterPolicy, ContactPolicy, serow::CoMEstimation<CoMEKF> > >();
+    else
+        bindPipeline<serow::Estimator<AttitudePolicy, BaseFilterPolicy, ContactPolicy, serow::NoCoMEstimation> >();
+}
 
+template <class E>
+void quadruped_ekf::bindPipeline()
+{
+    serow::AttitudeParams p;
+    p.freq = imu_native_freq;
+    p.beta = beta;
+    p.Kp = Kp;
+    p.Ki = Ki;
+    E *est = new E(p);
+    pipeline = est;
+    //The rest of the node keeps working through these non-owning pointers
+    mw = serow::componentOf<serow::Madgwick>(est->attitude.filter);
+    mh = serow::componentOf<serow::Mahony>(est->attitude.filter);
+    imuInEKF = serow::componentOf<IMUinEKFQuad>(est->base.filter);
+    cd = &est->contact.detector;
+    nipmEKF = serow::componentOf<CoMEKF>(est->com.filter);
+    estimationCycle = &quadruped_ekf::runCycle<E>;
+}
 
+/** One estimation cycle of the composed pipeline **/
+template <class E>
+void quadruped_ekf::runCycle()
+{
+    E &est = static_cast<E &>(*pipeline);
+    //Noise parameters and thresholds only change between cycles
+    if (noiseParams.fetch())
+        applyNoiseParams();
+    predictWithImu = false;
+    predictWithCoM = false;
+    updateAttitude(est.attitude.filter);
+
+    if (imuBiasesRefined)
+        applyImuBiases(est.base.filter);
+    //Compute the required transformation matrices (tfs) with Kinematics
+    if (joint_inc)
+        computeKinTFs(est);
+
+    //Main Loop
+    if (estimating())
+    {
+        estimateBase(est.base.filter, est.contact.detector);
+        scheduleCoMEKF(est.com.filter, est.base.filter);
+
+        //Hand the estimates to the publisher
+        fillEstimate(estimateBuffer.write(), est.base.filter, est.com.filter);
+        writeSharedEstimate(estimateBuffer.write(), est.contact.detector);
+        recordPose(estimateBuffer.write(), est.base.filter);
+        evaluateEstimate(estimateBuffer.write());
+        if (checkpointWriter.isOpen() && ros::WallTime::now().toSec() - last_checkpoint_time >= checkpoint_period)
+        {
+            fillCheckpoint(checkpointWriter.write());
+            checkpointWriter.publish();
+            last_checkpoint_time = ros::WallTime::now().toSec();
+        }
+        logTelemetry(estimateBuffer.write());
+        estimateBuffer.publish();
+        if (!usePublisherThread && estimateBuffer.update())
+            publishEstimates(estimateBuffer.read());
+    }
 }
 
 /** Main Loop **/
 void quadruped_ekf::run()
 {
+    configureEstimatorThread();
+    begin();
 
-    static ros::Rate rate(2.0*freq); //ROS Node Loop Rate
-    while (ros::ok())
+    ros::Rate rate(1.0/loopPeriod()); //ROS Node Loop Rate
+    while (running())
     {
-        if (imu_inc)
-        {
-            predictWithImu = false;
-            predictWithCoM = false;
-            if (useMahony)
-            {
-                mh->updateIMU(T_B_G.linear() * (Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z)),
-                              T_B_A.linear() * (Vector3d(imu_msg.linear_acceleration.x, imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z)));
-                Rwb = mh->getR();
-            }
-            else
-            {
-                mw->updateIMU(T_B_G.linear() * (Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z)),
-                              T_B_A.linear() * (Vector3d(imu_msg.linear_acceleration.x, imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z)));
+        step();
+        rate.sleep();
+    }
+    end();
+}
 
-                Rwb = mw->getR();
-            }
+void quadruped_ekf::begin()
+{
+    openPerfCounters();
+}
 
-            if(imuCalibrationCycles < maxImuCalibrationCycles && imuCalibrated)
-            {
-                bias_g += T_B_G.linear() * Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z);
-                bias_a += T_B_A.linear() * Vector3d(imu_msg.linear_acceleration.x, imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z) -  Rwb.transpose() * Vector3d(0,0,g); 
+double quadruped_ekf::loopPeriod()
+{
+    return 0.5/freq;
+}
 
-                imuCalibrationCycles++;
-                continue;
-            }
-            else if(imuCalibrated)
-            {
-                bias_ax = bias_a(0)/imuCalibrationCycles;
-                bias_ay = bias_a(1)/imuCalibrationCycles;
-                bias_az = bias_a(2)/imuCalibrationCycles;
-                bias_gx = bias_g(0)/imuCalibrationCycles;
-                bias_gy = bias_g(1)/imuCalibrationCycles;
-                bias_gz = bias_g(2)/imuCalibrationCycles;
-                imuCalibrated = false;
-                std::cout<<"Calibration finished at "<<imuCalibrationCycles<<std::endl;
-                std::cout<<"Gyro biases "<<bias_gx<<" "<<bias_gy<<" "<<bias_gz<<std::endl;
-                std::cout<<"Acc biases "<<bias_ax<<" "<<bias_ay<<" "<<bias_az<<std::endl;
-            }
-            //Compute the required transformation matrices (tfs) with Kinematics
-            if (joint_inc)
-                computeKinTFs();
-        
-            //Main Loop
-            if (kinematicsInitialized)
-            {
-                
-                estimateWithInIMUEKF();
-                if (useCoMEKF)
-                    estimateWithCoMEKF();
-
-                //Publish Data
-                publishJointEstimates();
-                publishBodyEstimates();
-                publishLegEstimates();
-                publishSupportEstimates();
-                publishContact();
-                publishGRF();
-
-                if (useCoMEKF)
-                {
-                    publishCoMEstimates();
-                    publishCOP();
-                }
-            }
-        }
+bool quadruped_ekf::running()
+{
+    return ros::ok() && !stopRequested;
+}
+
+void quadruped_ekf::step()
+{
+    if (sensor_input == "shm")
+        pollSharedSensors();
+    bool levelChanged = false;
+    if (imu_inc)
+    {
+        SEROW_PROFILE_SCOPE(profiler, CycleStage);
+        SEROW_PERF_SCOPE(perfCounters, CycleStage);
+        SEROW_TRACE_SCOPE(tracer, "cycle", "estimator", imu_msg.header.stamp.toSec());
+        serow::ScopedAllocationCheck rtCheck(rt_mode && estimating() && rt_cycle++ >= (unsigned long)rt_warmup_cycles, rt_abort_on_allocation);
+        governor.start();
+        (this->*estimationCycle)();
+        levelChanged = governor.stop();
+    }
+    //Logged after the checked cycle, rosconsole allocates
+    if (levelChanged)
+        ROS_WARN("Estimator deadline governor: %s", serow::DeadlineGovernor::levelName(governor.level()));
+    if (imuBiasesReport)
+    {
+        imuBiasesReport = false;
+        std::cout << "IMU biases calibrated while standing still" << std::endl;
+        std::cout << "Gyro biases " << imuBiasCalibrator.gyroBias().transpose() << std::endl;
+        std::cout << "Acc biases " << imuBiasCalibrator.accBias().transpose() << std::endl;
+    }
+    if (callbackQueue)
+        callbackQueue->callAvailable();
+    else
         ros::spinOnce();
-        rate.sleep();
+}
+
+void quadruped_ekf::end()
+{
+    stopPublisher();
+    std::cout << "Estimator " << governor.report() << std::endl;
+    reportProfiling();
+    dumpTrace();
+    shmEstimate.close(true);
+    poseHistory.close(true);
+    checkpointWriter.close();
+    if (!checkpoint_file.empty() && estimating())
+    {
+        fillCheckpoint(checkpoint);
+        if (checkpoint.save(checkpoint_file))
+            std::cout << "Checkpoint written to " << checkpoint_file << std::endl;
+        else
+            std::cerr << "Could not write the checkpoint " << checkpoint_file << std::endl;
+    }
+    if (useEvaluation)
+    {
+        std::cout << baseEvaluator.report("Base");
+        if (useCoMEKF)
+            std::cout << comEvaluator.report("CoM");
     }
+    if (telemetry.isOpen())
+    {
+        telemetry.close();
+        std::cout << "Telemetry " << telemetry.filePath() << ": " << telemetry.writtenRecords() << " records, "
+                  << telemetry.droppedRecords() << " dropped" << std::endl;
+    }
+    if (sensorRing.isOpen())
+        std::cout << "Shared memory sensor input dropped " << sensorRing.droppedFrames() << " frames" << std::endl;
     //De-allocation of Heap
     deAllocate();
 }
 
-void quadruped_ekf::estimateWithInIMUEKF()
+template <class CoMFilter>
+void quadruped_ekf::fillEstimate(QuadrupedEstimate &e, const IMUinEKFQuad &base, const CoMFilter &com)
+{
+    SEROW_PROFILE_SCOPE(profiler, HandoffStage);
+    SEROW_PERF_SCOPE(perfCounters, HandoffStage);
+    e.stamp = ros::Time::now();
+    e.sensor_stamp = imu_msg.header.stamp;
+    e.degradation = governor.level();
+    e.base_pos = Vector3d(base.rX, base.rY, base.rZ);
+    e.base_vel = Vector3d(base.velX, base.velY, base.velZ);
+    e.base_acc = Vector3d(base.accX, base.accY, base.accZ);
+    e.base_gyro = Vector3d(base.gyroX, base.gyroY, base.gyroZ);
+    e.base_q = base.qib;
+
+    e.lo_pos = Twb.translation();
+    e.lo_q = qwb;
+    e.lo_vel = vwb;
+    e.lo_omega = omegawb;
+
+    e.pwLF = TwLF.translation();
+    e.qwLF = qwLF;
+    e.vwLF = vwLF;
+    e.omegawLF = omegawLF;
+    e.pbLF = TbLF.translation();
+    e.qbLF = qbLF;
+    e.LFLegGRF = LFLegGRF;
+    e.LFLegGRT = LFLegGRT;
+    e.pwLH = TwLH.translation();
+    e.qwLH = qwLH;
+    e.vwLH = vwLH;
+    e.omegawLH = omegawLH;
+    e.pbLH = TbLH.translation();
+    e.qbLH = qbLH;
+    e.LHLegGRF = LHLegGRF;
+    e.LHLegGRT = LHLegGRT;
+    e.pwRF = TwRF.translation();
+    e.qwRF = qwRF;
+    e.vwRF = vwRF;
+    e.omegawRF = omegawRF;
+    e.pbRF = TbRF.translation();
+    e.qbRF = qbRF;
+    e.RFLegGRF = RFLegGRF;
+    e.RFLegGRT = RFLegGRT;
+    e.pwRH = TwRH.translation();
+    e.qwRH = qwRH;
+    e.vwRH = vwRH;
+    e.omegawRH = omegawRH;
+    e.pbRH = TbRH.translation();
+    e.qbRH = qbRH;
+    e.RHLegGRF = RHLegGRF;
+    e.RHLegGRT = RHLegGRT;
+    e.pws = Tws.translation();
+    e.qws = qws;
+    e.support_leg = support_leg;
+
+    fillCoMEstimate(e, com);
+
+    //Sized once per slot, afterwards the copy does not allocate
+    if (e.joint_pos.size() != number_of_joints)
+    {
+        e.joint_pos.resize(number_of_joints);
+        e.joint_vel.resize(number_of_joints);
+    }
+    for (unsigned int i = 0; i < number_of_joints; i++)
+    {
+        e.joint_pos(i) = JointVF[i]->JointPosition;
+        e.joint_vel(i) = JointVF[i]->JointVelocity;
+    }
+
+    if (ground_truth)
+    {
+        e.gt_pos = gt_odom;
+        e.gt_q = gt_odomq;
+        e.gt_com_pos = Vector3d(ground_truth_com_odom_msg.pose.pose.position.x, ground_truth_com_odom_msg.pose.pose.position.y, ground_truth_com_odom_msg.pose.pose.position.z);
+        e.gt_com_q = Quaterniond(ground_truth_com_odom_msg.pose.pose.orientation.w, ground_truth_com_odom_msg.pose.pose.orientation.x, ground_truth_com_odom_msg.pose.pose.orientation.y, ground_truth_com_odom_msg.pose.pose.orientation.z);
+        e.gt_com_vel = Vector3d(ground_truth_com_odom_msg.twist.twist.linear.x, ground_truth_com_odom_msg.twist.twist.linear.y, ground_truth_com_odom_msg.twist.twist.linear.z);
+        e.gt_com_omega = Vector3d(ground_truth_com_odom_msg.twist.twist.angular.x, ground_truth_com_odom_msg.twist.twist.angular.y, ground_truth_com_odom_msg.twist.twist.angular.z);
+    }
+
+    e.comp_odom0_valid = comp_odom0_inc;
+    if (comp_odom0_inc)
+    {
+        e.comp_pos = Vector3d(comp_odom0_msg.pose.pose.position.x, comp_odom0_msg.pose.pose.position.y, comp_odom0_msg.pose.pose.position.z);
+        e.comp_q = Quaterniond(comp_odom0_msg.pose.pose.orientation.w, comp_odom0_msg.pose.pose.orientation.x, comp_odom0_msg.pose.pose.orientation.y, comp_odom0_msg.pose.pose.orientation.z);
+        e.comp_vel = Vector3d(comp_odom0_msg.twist.twist.linear.x, comp_odom0_msg.twist.twist.linear.y, comp_odom0_msg.twist.twist.linear.z);
+        e.comp_omega = Vector3d(comp_odom0_msg.twist.twist.angular.x, comp_odom0_msg.twist.twist.angular.y, comp_odom0_msg.twist.twist.angular.z);
+        comp_odom0_inc = false;
+    }
+}
+
+void quadruped_ekf::fillCoMEstimate(QuadrupedEstimate &e, const CoMEKF &com)
+{
+    e.com_pos = Vector3d(com.comX, com.comY, com.comZ);
+    e.com_vel = Vector3d(com.velX, com.velY, com.velZ);
+    e.com_force = Vector3d(com.fX, com.fY, com.fZ);
+    e.com_leg_odom = CoM_leg_odom;
+    e.com_rel = CoM_enc;
+    e.cop = COP_fsr;
+}
+
+void quadruped_ekf::logTelemetry(const QuadrupedEstimate &e)
+{
+    if (!telemetry.isOpen())
+        return;
+    uint64_t stamp = e.sensor_stamp.toNSec();
+    double v[6];
+    Map<Vector3d>(v) = e.base_pos;
+    Map<Vector3d>(v + 3) = e.base_vel;
+    telemetry.log(tlmBase, stamp, v, 6);
+    if (useCoMEKF && e.degradation < serow::DeadlineGovernor::MinimalBase)
+    {
+        Map<Vector3d>(v) = e.com_pos;
+        Map<Vector3d>(v + 3) = e.com_vel;
+        telemetry.log(tlmCoM, stamp, v, 6);
+    }
+}
+
+void quadruped_ekf::writeSharedEstimate(const QuadrupedEstimate &e, serow::ContactDetectionQuad &detector)
+{
+    if (!shmEstimate.isOpen())
+        return;
+    serow::SharedEstimate s;
+    std::memset(&s, 0, sizeof(s));
+    s.cycle = ++shm_cycle;
+    s.stamp_ns = e.stamp.toNSec();
+    s.sensor_stamp_ns = e.sensor_stamp.toNSec();
+    Map<Vector3d>(s.base_pos) = e.base_pos;
+    s.base_q[0] = e.base_q.w();
+    s.base_q[1] = e.base_q.x();
+    s.base_q[2] = e.base_q.y();
+    s.base_q[3] = e.base_q.z();
+    Map<Vector3d>(s.base_vel) = e.base_vel;
+    Map<Vector3d>(s.base_omega) = e.base_gyro;
+    Map<Vector3d>(s.base_acc) = e.base_acc;
+    s.com_valid = useCoMEKF && e.degradation < serow::DeadlineGovernor::MinimalBase;
+    Map<Vector3d>(s.com_pos) = e.com_pos;
+    Map<Vector3d>(s.com_vel) = e.com_vel;
+    s.num_legs = 4;
+    s.contact[0] = firstContact ? 0 : detector.isLFLegContact();
+    s.contact[1] = firstContact ? 0 : detector.isLHLegContact();
+    s.contact[2] = firstContact ? 0 : detector.isRFLegContact();
+    s.contact[3] = firstContact ? 0 : detector.isRHLegContact();
+    s.contact_prob[0] = firstContact ? 0.0 : detector.getLFLegContactProb();
+    s.contact_prob[1] = firstContact ? 0.0 : detector.getLHLegContactProb();
+    s.contact_prob[2] = firstContact ? 0.0 : detector.getRFLegContactProb();
+    s.contact_prob[3] = firstContact ? 0.0 : detector.getRHLegContactProb();
+    s.support_leg = -1;
+    if (e.support_leg == "LFLeg")
+        s.support_leg = 0;
+    else if (e.support_leg == "LHLeg")
+        s.support_leg = 1;
+    else if (e.support_leg == "RFLeg")
+        s.support_leg = 2;
+    else if (e.support_leg == "RHLeg")
+        s.support_leg = 3;
+    s.degradation = e.degradation;
+    shmEstimate.write(s);
+}
+
+void quadruped_ekf::recordPose(const QuadrupedEstimate &e, const IMUinEKFQuad &base)
+{
+    if (!poseHistory.isOpen())
+        return;
+    const Matrix<double, 6, 6> Cp = base.poseCovariance();
+    const Matrix<double, 6, 6> Ct = base.twistCovariance();
+    serow::PoseSample s;
+    s.stamp_ns = e.sensor_stamp.toNSec();
+    Map<Vector3d>(s.pos) = e.base_pos;
+    s.q[0] = e.base_q.w();
+    s.q[1] = e.base_q.x();
+    s.q[2] = e.base_q.y();
+    s.q[3] = e.base_q.z();
+    Map<Vector3d>(s.vel) = e.base_vel;
+    Map<Vector3d>(s.omega) = e.base_gyro;
+    Map<Matrix<double, 6, 6, RowMajor> >(s.pose_cov) = Cp;
+    Map<Matrix<double, 6, 6, RowMajor> >(s.twist_cov) = Ct;
+    poseHistory.push(s);
+}
+
+void quadruped_ekf::evaluateEstimate(const QuadrupedEstimate &e)
+{
+    if (!useEvaluation)
+        return;
+    //Matched on the sensor stamps, which the ground truth shares in simulation
+    const double t = (e.sensor_stamp.isZero() ? e.stamp : e.sensor_stamp).toSec();
+    baseEvaluator.addEstimate(t, e.base_pos, e.base_q);
+    if (useCoMEKF)
+        comEvaluator.addEstimate(t, e.com_pos, Quaterniond::Identity());
+}
+
+void quadruped_ekf::publishEvaluation()
+{
+    ros::Time now = ros::Time::now();
+    if ((now - last_evaluation).toSec() < evaluation_period)
+        return;
+    last_evaluation = now;
+
+    diagnostic_msgs::DiagnosticArray evaluation_msg;
+    evaluation_msg.header.stamp = now;
+    evaluation_msg.status.resize(1);
+    diagnostic_msgs::DiagnosticStatus &status = evaluation_msg.status[0];
+    status.name = "serow: accuracy";
+    status.hardware_id = "serow";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+    serow::toKeyValues(status.values, "base", baseEvaluator);
+    baseEvaluator.resetPeriod();
+    if (useCoMEKF)
+    {
+        serow::toKeyValues(status.values, "CoM", comEvaluator);
+        comEvaluator.resetPeriod();
+    }
+    evaluation_pub.publish(evaluation_msg);
+}
+
+void quadruped_ekf::applyImuBiases(IMUinEKFQuad &base)
+{
+    imuBiasesRefined = false;
+    if (imuBiasCalibrator.refinedWindows() == 1)
+        imuBiasesReport = true;
+    if (base.firstrun)
+    {
+        //A base filter that has not started yet is initialized with bias_*
+        const Vector3d ba = imuBiasCalibrator.accBias();
+        const Vector3d bg = imuBiasCalibrator.gyroBias();
+        bias_ax = ba(0);
+        bias_ay = ba(1);
+        bias_az = ba(2);
+        bias_gx = bg(0);
+        bias_gy = bg(1);
+        bias_gz = bg(2);
+        return;
+    }
+    //A running filter keeps its own estimate and fuses the gyro bias of the window with the variance of its mean,
+    //the acc bias average depends on the tilt of the attitude filter and only seeds the filter
+    const Matrix3d Rbg = (imuBiasCalibrator.gyroVariance().cwiseMax(1e-10) / (double)imuBiasCalibrator.windowSamples()).asDiagonal();
+    base.updateWithGyroBias(imuBiasCalibrator.windowGyroBias(), Rbg);
+}
+
+bool quadruped_ekf::estimating()
+{
+    //With the online calibration the base filter starts with the biases of the first still window, as the
+    //startup calibration did, unless a checkpoint restored them
+    return kinematicsInitialized && (!imuCalibrated || imuBiasesRestored || imuBiasCalibrator.refinedWindows() > 0);
+}
+
+void quadruped_ekf::loadCheckpoint()
+{
+    bool checkpoint_restore;
+    double checkpoint_max_age;
+    n_p.param<std::string>("checkpoint_file", checkpoint_file, "");
+    n_p.param<double>("checkpoint_period", checkpoint_period, 10.0);
+    n_p.param<bool>("checkpoint_restore", checkpoint_restore, true);
+    n_p.param<double>("checkpoint_max_age", checkpoint_max_age, 0.0);
+    if (checkpoint_file.empty())
+        return;
+    last_checkpoint_time = ros::WallTime::now().toSec();
+    if (checkpoint_period > 0)
+    {
+        //Only the block layout is used here, it sizes the writer slots so the periodic fill does not allocate
+        fillCheckpoint(checkpoint);
+        checkpointWriter.open(checkpoint_file, checkpoint);
+    }
+    if (!checkpoint_restore)
+        return;
+    if (!restored.load(checkpoint_file))
+    {
+        ROS_WARN("No checkpoint to restore in %s", checkpoint_file.c_str());
+        return;
+    }
+    const double age = ((int64_t)ros::WallTime::now().toNSec() - restored.stamp_ns) * 1e-9;
+    Vector3d ba, bg;
+    Matrix<double, 7, 1> attitude;
+    if ((checkpoint_max_age > 0 && age > checkpoint_max_age) || !restored.take("acc_bias", ba) || !restored.take("gyro_bias", bg) ||
+        !restored.take("attitude", attitude))
+    {
+        ROS_WARN("Ignoring the checkpoint %s, %.1f s old", checkpoint_file.c_str(), age);
+        restored.clear();
+        return;
+    }
+    bias_ax = ba(0);
+    bias_ay = ba(1);
+    bias_az = ba(2);
+    bias_gx = bg(0);
+    bias_gy = bg(1);
+    bias_gz = bg(2);
+    imuBiasCalibrator.setPrior(ba, bg, maxImuCalibrationCycles);
+    imuBiasesRestored = true;
+    const Quaterniond q(attitude(0), attitude(1), attitude(2), attitude(3));
+    if (mh)
+        mh->setState(q, attitude.tail<3>());
+    else if (mw)
+        mw->setQ(q);
+    std::cout << "Restored the checkpoint " << checkpoint_file << ", " << age << " s old" << std::endl;
+}
+
+void quadruped_ekf::fillCheckpoint(serow::Checkpoint &c)
+{
+    c.clear();
+    c.stamp_ns = ros::WallTime::now().toNSec();
+    c.put("acc_bias", imuInEKF->bacc);
+    c.put("gyro_bias", imuInEKF->bgyr);
+    const Quaterniond q = mh ? mh->getQ() : mw->getQ();
+    Matrix<double, 7, 1> attitude;
+    attitude << q.w(), q.x(), q.y(), q.z(), (mh ? mh->getIntegralFeedback() : Vector3d::Zero());
+    c.put("attitude", attitude);
+    const Affine3d *Tw[4] = {&TwLF, &TwLH, &TwRF, &TwRH};
+    const Quaterniond *qw[4] = {&qwLF, &qwLH, &qwRF, &qwRH};
+    Matrix<double, 28, 1> feet;
+    for (int i = 0; i < 4; i++)
+        feet.segment<7>(7 * i) << Tw[i]->translation(), qw[i]->w(), qw[i]->x(), qw[i]->y(), qw[i]->z();
+    c.put("feet", feet);
+    c.put("inekf_X", imuInEKF->X);
+    c.put("inekf_P", imuInEKF->covariance());
+    if (useCoMEKF)
+    {
+        c.put("comekf_x", nipmEKF->x);
+        c.put("comekf_P", nipmEKF->covariance());
+    }
+}
+
+bool quadruped_ekf::lookupPoseCb(serow::LookupPose::Request &req, serow::LookupPose::Response &res)
+{
+    serow::PoseSample s;
+    serow::PoseHistory::LookupResult r = poseHistory.lookup(req.stamp.toNSec(), s);
+    res.success = r == serow::PoseHistory::Found;
+    if (r == serow::PoseHistory::Empty)
+    {
+        res.message = "the pose history is empty";
+        return true;
+    }
+    if (r == serow::PoseHistory::BeforeHistory)
+        res.message = "the stamp is older than the pose history, returning the oldest estimate";
+    else if (r == serow::PoseHistory::AfterHistory)
+        res.message = "the stamp is newer than the pose history, returning the latest estimate";
+    res.odom.header.frame_id = "odom";
+    res.odom.child_frame_id = base_link_frame;
+    serow::toOdometry(res.odom, s);
+    return true;
+}
+
+void quadruped_ekf::publishEstimates(const QuadrupedEstimate &e)
+{
+    SEROW_PROFILE_SCOPE(profiler, PublishStage);
+    SEROW_TRACE_SCOPE(tracer, "publishEstimates", "publish", e.sensor_stamp.toSec());
+    //Per topic group rate decimation, when degraded only the base estimates keep their rate
+    publish_cycle++;
+    const unsigned long slow = e.degradation >= serow::DeadlineGovernor::DecimatePublishing ? degraded_pub_decimation : 1;
+    if (publish_cycle % (joint_pub_decimation * slow) == 0)
+        publishJointEstimates(e);
+    if (publish_cycle % body_pub_decimation == 0)
+        publishBodyEstimates(e);
+    if (publish_cycle % (leg_pub_decimation * slow) == 0)
+        publishLegEstimates(e);
+    if (publish_cycle % (support_pub_decimation * slow) == 0)
+        publishSupportEstimates(e);
+    if (publish_cycle % (contact_pub_decimation * slow) == 0)
+        publishContact(e);
+    if (publish_cycle % (grf_pub_decimation * slow) == 0)
+        publishGRF(e);
+
+    if (useCoMEKF && e.degradation < serow::DeadlineGovernor::MinimalBase && publish_cycle % (com_pub_decimation * slow) == 0)
+    {
+        publishCoMEstimates(e);
+        publishCOP(e);
+    }
+    profileEstimate(e);
+}
+
+void quadruped_ekf::initProfiler()
+{
+#ifdef SEROW_PROFILING
+    profiler.setStageName(AttitudeStage, "attitude");
+    profiler.setStageName(KinematicsStage, "kinematics");
+    profiler.setStageName(BaseStage, "base");
+    profiler.setStageName(CoMStage, "com");
+    profiler.setStageName(HandoffStage, "handoff");
+    profiler.setStageName(PublishStage, "publish");
+    profiler.setStageName(CycleStage, "cycle");
+    profiler.setStageName(LatencyStage, "imu_to_publish");
+    n_p.param<bool>("perf_counters", usePerfCounters, false);
+    perfCounters.setStageName(AttitudeStage, "attitude");
+    perfCounters.setStageName(KinematicsStage, "kinematics");
+    perfCounters.setStageName(BaseStage, "base");
+    perfCounters.setStageName(CoMStage, "com");
+    perfCounters.setStageName(HandoffStage, "handoff");
+    perfCounters.setStageName(CycleStage, "cycle");
+    n_p.param<double>("diagnostics_period", diagnostics_period, 1.0);
+    diagnostics_pub = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+    last_diagnostics = ros::Time::now();
+#endif
+}
+
+void quadruped_ekf::configureEstimatorThread()
+{
+    //Runs on the estimator thread, every option degrades to a report line when not permitted
+    std::string report;
+    std::cout << "Estimator thread real-time configuration:" << std::endl;
+    serow::setThreadScheduling(rt_sched_policy, rt_priority, report);
+    std::cout << "  " << report << std::endl;
+    serow::setThreadAffinity(estimator_cpus, report);
+    std::cout << "  " << report << std::endl;
+    if (rt_lock_memory)
+    {
+        serow::lockProcessMemory(rt_stack_prefault > 0 ? rt_stack_prefault : 0, report);
+        std::cout << "  " << report << std::endl;
+    }
+    else
+        std::cout << "  mlockall: off" << std::endl;
+}
+
+void quadruped_ekf::openPerfCounters()
+{
+#ifdef SEROW_PROFILING
+    //Counters count the calling thread, so they are opened by the thread that runs the estimator
+    if (usePerfCounters && !perfCounters.open())
+        ROS_WARN("Hardware performance counters are not available, only timings will be reported");
+#endif
+}
+
+void quadruped_ekf::profileEstimate(const QuadrupedEstimate &e)
+{
+#ifdef SEROW_PROFILING
+    ros::Time now = ros::Time::now();
+    //Sensor stamp to publish latency, skipped when the driver does not stamp or the clocks disagree
+    if (!e.sensor_stamp.isZero() && now > e.sensor_stamp)
+        profiler.record(LatencyStage, (now - e.sensor_stamp).toNSec());
+
+    if ((now - last_diagnostics).toSec() < diagnostics_period)
+        return;
+    last_diagnostics = now;
+
+    diagnostic_msgs::DiagnosticArray diagnostics_msg;
+    diagnostics_msg.header.stamp = now;
+    diagnostics_msg.status.resize(1);
+    diagnostic_msgs::DiagnosticStatus &status = diagnostics_msg.status[0];
+    status.name = "serow: stage timing";
+    status.hardware_id = "serow";
+    //Overrun if one in a hundred cycles does not fit in the estimation period
+    if (profiler.stage(CycleStage).percentile(99) * 1e-9 > 1.0 / freq)
+    {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = "cycle p99 exceeds the estimation period";
+    }
+    else
+    {
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = "OK";
+    }
+    for (int i = 0; i < profiler.size(); i++)
+    {
+        const serow::LatencyHistogram &hist = profiler.stage(i);
+        std::ostringstream value;
+        value << hist.count() << " / " << hist.percentile(50) * 1e-3 << " / " << hist.percentile(99) * 1e-3 << " / " << hist.max() * 1e-3;
+        diagnostic_msgs::KeyValue kv;
+        kv.key = profiler.stageName(i) + " count/p50/p99/max [us]";
+        kv.value = value.str();
+        status.values.push_back(kv);
+    }
+    if (perfCounters.available())
+    {
+        for (int i = 0; i < profiler.size(); i++)
+        {
+            if (!perfCounters.stageCalls(i))
+                continue;
+            std::ostringstream value;
+            value << perfCounters.ipc(i) << " / " << perfCounters.perCall(i, serow::PerfCounters::LLCMisses) << " / "
+                  << perfCounters.perCall(i, serow::PerfCounters::L1DMisses);
+            diagnostic_msgs::KeyValue kv;
+            kv.key = profiler.stageName(i) + " IPC/LLC miss/L1D miss per call";
+            kv.value = value.str();
+            status.values.push_back(kv);
+        }
+    }
+    diagnostics_pub.publish(diagnostics_msg);
+#endif
+}
+
+void quadruped_ekf::reportProfiling()
+{
+#ifdef SEROW_PROFILING
+    std::cout << "SERoW stage timing" << std::endl;
+    std::cout << profiler.report();
+    if (perfCounters.available())
+    {
+        std::cout << "SERoW hardware counters" << std::endl;
+        std::cout << perfCounters.report();
+        perfCounters.close();
+    }
+#endif
+}
+
+bool quadruped_ekf::dumpTraceCb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
+    long events = tracer.writeChromeTrace(trace_file);
+    res.success = events >= 0;
+    std::ostringstream message;
+    if (res.success)
+        message << events << " events written to " << trace_file;
+    else
+        message << "could not open " << trace_file;
+    res.message = message.str();
+    return true;
+}
+
+void quadruped_ekf::dumpTrace()
+{
+    if (!tracer.enabled())
+        return;
+    long events = tracer.writeChromeTrace(trace_file);
+    if (events >= 0)
+        std::cout << "SERoW trace: " << events << " events written to " << trace_file << std::endl;
+    else
+        std::cerr << "SERoW trace: could not open " << trace_file << std::endl;
+}
+
+void quadruped_ekf::publisherLoop()
+{
+    std::string report;
+    serow::setThreadAffinity(publisher_cpus, report);
+    std::cout << "Publisher thread " << report << std::endl;
+    ros::Rate rate(2.0 * freq);
+    while (publisherRunning && ros::ok())
+    {
+        if (estimateBuffer.update())
+            publishEstimates(estimateBuffer.read());
+        rate.sleep();
+    }
+}
+
+void quadruped_ekf::startPublisher()
+{
+    publish_cycle = 0;
+    if (!usePublisherThread)
+        return;
+    publisherRunning = true;
+    publisherThread = std::thread(&quadruped_ekf::publisherLoop, this);
+}
+
+void quadruped_ekf::stopPublisher()
+{
+    publisherRunning = false;
+    if (publisherThread.joinable())
+        publisherThread.join();
+}
+
+void quadruped_ekf::estimateBase(IMUinEKFQuad &base, serow::ContactDetectionQuad &detector)
+{
+    SEROW_PROFILE_SCOPE(profiler, BaseStage);
+    SEROW_PERF_SCOPE(perfCounters, BaseStage);
     //Initialize the IMU EKF state
-    if (imuInEKF->firstrun == true)
+    if (base.firstrun)
     {
-        imuInEKF->setdt(1.0 / freq);
-        imuInEKF->setBodyPos(Twb.translation());
-        imuInEKF->setBodyOrientation(Twb.linear());
-        imuInEKF->setAccBias(Vector3d(bias_ax, bias_ay, bias_az));
-        imuInEKF->setGyroBias(Vector3d(bias_gx, bias_gy, bias_gz));
-        imuInEKF->setLeftFrontContact(Vector3d(dr->getLFFootIMVPPosition()(0), dr->getLFFootIMVPPosition()(1), 0.00));
-        imuInEKF->setLeftHindContact(Vector3d(dr->getLHFootIMVPPosition()(0), dr->getLHFootIMVPPosition()(1), 0.00));
-        imuInEKF->setRightFrontContact(Vector3d(dr->getRFFootIMVPPosition()(0), dr->getRFFootIMVPPosition()(1), 0.00));
-        imuInEKF->setRightHindContact(Vector3d(dr->getRHFootIMVPPosition()(0), dr->getRHFootIMVPPosition()(1), 0.00));
-        imuInEKF->firstrun = false;
+        base.setdt(1.0 / freq);
+        base.setBodyPos(Twb.translation());
+        base.setBodyOrientation(Twb.linear());
+        base.setAccBias(Vector3d(bias_ax, bias_ay, bias_az));
+        base.setGyroBias(Vector3d(bias_gx, bias_gy, bias_gz));
+        base.setLeftFrontContact(Vector3d(dr->getLFFootIMVPPosition()(0), dr->getLFFootIMVPPosition()(1), 0.00));
+        base.setLeftHindContact(Vector3d(dr->getLHFootIMVPPosition()(0), dr->getLHFootIMVPPosition()(1), 0.00));
+        base.setRightFrontContact(Vector3d(dr->getRFFootIMVPPosition()(0), dr->getRFFootIMVPPosition()(1), 0.00));
+        base.setRightHindContact(Vector3d(dr->getRHFootIMVPPosition()(0), dr->getRHFootIMVPPosition()(1), 0.00));
+        Matrix<double, 9, 9> X;
+        Matrix<double, 27, 27> P;
+        if (restored.take("inekf_X", X) && restored.take("inekf_P", P))
+        {
+            base.setBodyOrientation(X.block<3, 3>(0, 0));
+            base.setBodyVel(X.block<3, 1>(0, 3));
+            base.setBodyPos(X.block<3, 1>(0, 4));
+            base.setRightFrontContact(X.block<3, 1>(0, 5));
+            base.setRightHindContact(X.block<3, 1>(0, 6));
+            base.setLeftFrontContact(X.block<3, 1>(0, 7));
+            base.setLeftHindContact(X.block<3, 1>(0, 8));
+            base.setCovariance(P);
+            base.updateVars();
+        }
+        base.firstrun = false;
     }
 
 
     // cout<<"Contact Status"<<endl;
-    // cout<<"RF "<<cd->isRFLegContact()<<endl;
-    // cout<<"RH "<< cd->isRHLegContact()<<endl;
-    //  cout<<"LF "<< cd->isLFLegContact()<<endl;
-    //   cout<<"LH "<<cd->isLHLegContact()<<endl;
+    // cout<<"RF "<<detector.isRFLegContact()<<endl;
+    // cout<<"RH "<< detector.isRHLegContact()<<endl;
+    //  cout<<"LF "<< detector.isLFLegContact()<<endl;
+    //   cout<<"LH "<<detector.isLHLegContact()<<endl;
     //Compute the attitude and posture with the IMU-Kinematics Fusion
     //Predict with the IMU gyro and acceleration
-    if (imu_inc && !predictWithImu && !imuInEKF->firstrun)
+    if (imu_inc && !predictWithImu && !base.firstrun)
     {
-        imuInEKF->predict(T_B_G.linear() * Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z),
-                          T_B_A.linear() * Vector3d(imu_msg.linear_acceleration.x, imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z),
-                          dr->getRFFootIMVPPosition(), dr->getRHFootIMVPPosition(), dr->getLFFootIMVPPosition(),  dr->getLHFootIMVPPosition(),
-                          dr->getRFFootIMVPOrientation(),  dr->getRHFootIMVPOrientation(), dr->getLFFootIMVPOrientation(), dr->getLHFootIMVPOrientation(),
-                          cd->isRFLegContact(), cd->isRHLegContact(), cd->isLFLegContact(), cd->isLHLegContact());
+        SEROW_TRACE_SCOPE(tracer, "IMUinEKF::predict", "predict", imu_msg.header.stamp.toSec());
+        base.predict(T_B_G.linear() * Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z),
+                     T_B_A.linear() * Vector3d(imu_msg.linear_acceleration.x, imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z),
+                     dr->getRFFootIMVPPosition(), dr->getRHFootIMVPPosition(), dr->getLFFootIMVPPosition(),  dr->getLHFootIMVPPosition(),
+                     dr->getRFFootIMVPOrientation(),  dr->getRHFootIMVPOrientation(), dr->getLFFootIMVPOrientation(), dr->getLHFootIMVPOrientation(),
+                     detector.isRFLegContact(), detector.isRHLegContact(), detector.isLFLegContact(), detector.isLHLegContact());
         imu_inc = false;
         predictWithImu = true;
     }
@@ -732,47 +1581,82 @@ void quadruped_ekf::estimateWithInIMUEKF()
     {
         if (leg_odom_inc)
         {
+            SEROW_TRACE_SCOPE(tracer, "IMUinEKF::updateWithContacts", "update", joint_state_msg.header.stamp.toSec());
           
-            imuInEKF->updateWithContacts(dr->getRFFootIMVPPosition(), dr->getRHFootIMVPPosition(), dr->getLFFootIMVPPosition(), dr->getLHFootIMVPPosition(),
-             JRFQnJRFt  +  cd->getRFDiffForce()/(m*g)*Matrix3d::Identity(),  JRHQnJRHt +  cd->getRHDiffForce()/(m*g)*Matrix3d::Identity(),
-             JLFQnJLFt  +  cd->getLFDiffForce()/(m*g)*Matrix3d::Identity(),  JLHQnJLHt +  cd->getLHDiffForce()/(m*g)*Matrix3d::Identity(), 
-             cd->isRFLegContact(), cd->isRHLegContact(), cd->isLFLegContact(), cd->isLHLegContact(),
-             cd->getRFLegContactProb(), cd->getRHLegContactProb(), cd->getLFLegContactProb(), cd->getLHLegContactProb());
-            //imuInEKF->updateWithOrient(qwb);
-            //imuInEKF->updateWithTwist(vwb, dr->getVelocityCovariance() +  cd->getDiffForce()/(m*g)*Matrix3d::Identity());
-            //imuInEKF->updateWithTwistOrient(vwb,qwb);
-            //imuInEKF->updateWithOdom(Twb.translation(),qwb);
+            base.updateWithContacts(dr->getRFFootIMVPPosition(), dr->getRHFootIMVPPosition(), dr->getLFFootIMVPPosition(), dr->getLHFootIMVPPosition(),
+             JRFQnJRFt  +  detector.getRFDiffForce()/(m*g)*Matrix3d::Identity(),  JRHQnJRHt +  detector.getRHDiffForce()/(m*g)*Matrix3d::Identity(),
+             JLFQnJLFt  +  detector.getLFDiffForce()/(m*g)*Matrix3d::Identity(),  JLHQnJLHt +  detector.getLHDiffForce()/(m*g)*Matrix3d::Identity(), 
+             detector.isRFLegContact(), detector.isRHLegContact(), detector.isLFLegContact(), detector.isLHLegContact(),
+             detector.getRFLegContactProb(), detector.getRHLegContactProb(), detector.getLFLegContactProb(), detector.getLHLegContactProb());
+            //base.updateWithOrient(qwb);
+            //base.updateWithTwist(vwb, dr->getVelocityCovariance() +  detector.getDiffForce()/(m*g)*Matrix3d::Identity());
+            //base.updateWithTwistOrient(vwb,qwb);
+            //base.updateWithOdom(Twb.translation(),qwb);
             leg_odom_inc = false;
         }
     }
     //Estimated TFs for Legs and Support foot
 
-    TwLF = imuInEKF->Tib * TbLF;
-    TwLH = imuInEKF->Tib * TbLH;
-    TwRF = imuInEKF->Tib * TbRF;
-    TwRH = imuInEKF->Tib * TbRH;
+    TwLF = base.Tib * TbLF;
+    TwLH = base.Tib * TbLH;
+    TwRF = base.Tib * TbRF;
+    TwRH = base.Tib * TbRH;
 
     qwLF = Quaterniond(TwLF.linear());
     qwLH = Quaterniond(TwLH.linear());
     qwRF = Quaterniond(TwRF.linear());
     qwRH = Quaterniond(TwRH.linear());
 
-    Tws = imuInEKF->Tib * Tbs;
+    Tws = base.Tib * Tbs;
     qws = Quaterniond(Tws.linear());
 }
 
-void quadruped_ekf::estimateWithCoMEKF()
+void quadruped_ekf::scheduleCoMEKF(CoMEKF &com, const IMUinEKFQuad &base)
 {
+    if (governor.atLeast(serow::DeadlineGovernor::MinimalBase))
+    {
+        comSuspended = true;
+        return;
+    }
+    if (comSuspended)
+    {
+        //Restart from the current kinematics, the state is stale after a suspension
+        com.firstrun = true;
+        firstGyrodot = true;
+        comSuspended = false;
+    }
+    int step = governor.atLeast(serow::DeadlineGovernor::SlowCoM) ? degraded_com_decimation : 1;
+    if (++com_cycle < step)
+        return;
+    com_cycle = 0;
+    if (step != com_step)
+    {
+        com_step = step;
+        com.setdt(com_step / fsr_freq);
+    }
+    estimateWithCoMEKF(com, base);
+}
 
+void quadruped_ekf::estimateWithCoMEKF(CoMEKF &com, const IMUinEKFQuad &base)
+{
+    SEROW_PROFILE_SCOPE(profiler, CoMStage);
+    SEROW_PERF_SCOPE(perfCounters, CoMStage);
     if (com_inc)
     {
-        if (nipmEKF->firstrun)
+        if (com.firstrun)
         {
-            nipmEKF->setdt(1.0 / fsr_freq);
-            nipmEKF->setParams(mass, I_xx, I_yy, g);
-            nipmEKF->setCoMPos(CoM_leg_odom);
-            nipmEKF->setCoMExternalForce(Vector3d(bias_fx, bias_fy, bias_fz));
-            nipmEKF->firstrun = false;
+            com.setdt(com_step / fsr_freq);
+            com.setParams(mass, I_xx, I_yy, g);
+            com.setCoMPos(CoM_leg_odom);
+            com.setCoMExternalForce(Vector3d(bias_fx, bias_fy, bias_fz));
+            Matrix<double, 9, 1> x;
+            Matrix<double, 9, 9> P;
+            if (restored.take("comekf_x", x) && restored.take("comekf_P", P))
+            {
+                com.x = x;
+                com.setCovariance(P);
+            }
+            com.firstrun = false;
             if (useGyroLPF)
             {
                 gyroLPF[0]->init("gyro X LPF", freq, gyro_fx);
@@ -788,13 +1672,14 @@ void quadruped_ekf::estimateWithCoMEKF()
     }
 
     //Compute the COP in the Inertial Frame
-    if (LFfsr_inc && LHfsr_inc && RHfsr_inc && RFfsr_inc && !predictWithCoM && !nipmEKF->firstrun)
+    if (LFfsr_inc && LHfsr_inc && RHfsr_inc && RFfsr_inc && !predictWithCoM && !com.firstrun)
     {
+        SEROW_TRACE_SCOPE(tracer, "CoMEKF::predict", "predict", LFfsr_msg.header.stamp.toSec());
         computeGlobalCOP(TwLF, TwLH, TwRF, TwRH);
         //Numerically compute the Gyro acceleration in the Inertial Frame and use a 3-Point Low-Pass filter
-        filterGyrodot();
+        filterGyrodot(base.gyro);
         DiagonalMatrix<double, 3> Inertia(I_xx, I_yy, I_zz);
-        nipmEKF->predict(COP_fsr, GRF_fsr, imuInEKF->Rib * Inertia * Gyrodot);
+        com.predict(COP_fsr, GRF_fsr, base.Rib * Inertia * Gyrodot);
         LFfsr_inc = false;
         LHfsr_inc = false;
         RFfsr_inc = false;
@@ -804,19 +1689,24 @@ void quadruped_ekf::estimateWithCoMEKF()
 
     if (com_inc && predictWithCoM)
     {
-        nipmEKF->update(
-            imuInEKF->acc + imuInEKF->g,
-            imuInEKF->Tib * CoM_enc,
-            imuInEKF->gyro, Gyrodot);
+        SEROW_TRACE_SCOPE(tracer, "CoMEKF::update", "update", LFfsr_msg.header.stamp.toSec());
+        com.update(
+            base.acc + base.g,
+            base.Tib * CoM_enc,
+            base.gyro, Gyrodot);
         com_inc = false;
     }
 }
 
-void quadruped_ekf::computeKinTFs()
+template <class E>
+void quadruped_ekf::computeKinTFs(E &est)
 {
-
+    SEROW_PROFILE_SCOPE(profiler, KinematicsStage);
+    SEROW_PERF_SCOPE(perfCounters, KinematicsStage);
+    SEROW_TRACE_SCOPE(tracer, "computeKinTFs", "kinematics", joint_state_msg.header.stamp.toSec());
+    serow::ContactDetectionQuad &detector = est.contact.detector;
     //Update the Kinematic Structure
-    rd->updateJointConfig(joint_state_pos_map, joint_state_vel_map, joint_noise_density);
+    rd->updateJointConfig(joint_state_pos, joint_state_vel, joint_noise_density);
 
     //Get the CoM w.r.t Body Frame
     CoM_enc = rd->comPosition();
@@ -851,7 +1741,17 @@ void quadruped_ekf::computeKinTFs()
         TwLH.linear() = TbLH.linear();
         TwRH.translation() << TbRH.translation()(0), TbRH.translation()(1), 0.00;
         TwRH.linear() = TbRH.linear();
-
+        //Resume the leg odometry from the feet of the checkpoint, ordered LF, LH, RF, RH
+        Matrix<double, 28, 1> feet;
+        if (restored.take("feet", feet))
+        {
+            Affine3d *Tw[4] = {&TwLF, &TwLH, &TwRF, &TwRH};
+            for (int i = 0; i < 4; i++)
+            {
+                Tw[i]->translation() = feet.segment<3>(7 * i);
+                Tw[i]->linear() = Quaterniond(feet(7 * i + 3), feet(7 * i + 4), feet(7 * i + 5), feet(7 * i + 6)).normalized().toRotationMatrix();
+            }
+        }
 
         dr = new serow::deadReckoningQuad(TwLF.translation(), TwLH.translation(), TwRF.translation(), TwRH.translation(), 
                                     TwLF.linear(), TwLH.linear(), TwRF.linear(), TwRH.linear(),
@@ -883,18 +1783,9 @@ void quadruped_ekf::computeKinTFs()
     JRFQnJRFt = vbRFn * vbRFn.transpose();
     JRHQnJRHt = vbRHn * vbRHn.transpose();
 
-    if(useMahony)
-    {
-        qwb_ = qwb;
-        qwb = Quaterniond(mh->getR());
-        omegawb = mh->getGyro();
-    }
-    else
-    {
-        qwb_ = qwb;
-        qwb = Quaterniond(mw->getR());
-        omegawb = mw->getGyro();
-    }
+    qwb_ = qwb;
+    qwb = Quaterniond(est.attitude.filter.getR());
+    omegawb = est.attitude.filter.getGyro();
     Twb.linear() = qwb.toRotationMatrix();
 
 
@@ -923,30 +1814,29 @@ void quadruped_ekf::computeKinTFs()
         GRF_fsr +=  RHLegGRF;
         if(firstContact)
         {
-            cd = new serow::ContactDetectionQuad();
-            if (useGEM)
+            if (E::Contact::Probabilistic)
             {
-                cd->init(LFfoot_frame, LHfoot_frame, RFfoot_frame, RHfoot_frame, LosingContact, LosingContact, LosingContact, LosingContact, foot_polygon_xmin, foot_polygon_xmax,
-                         foot_polygon_ymin, foot_polygon_ymax, LFforce_sigma, LHforce_sigma, RFforce_sigma,  RHforce_sigma, LFcop_sigma,  LHcop_sigma,
-                         RFcop_sigma, RHcop_sigma, VelocityThres, LFvnorm_sigma, LHvnorm_sigma, RFvnorm_sigma, RHvnorm_sigma, ContactDetectionWithCOP, ContactDetectionWithKinematics,  probabilisticContactThreshold,medianWindow);
+                detector.init(LFfoot_frame, LHfoot_frame, RFfoot_frame, RHfoot_frame, LosingContact, LosingContact, LosingContact, LosingContact, foot_polygon_xmin, foot_polygon_xmax,
+                              foot_polygon_ymin, foot_polygon_ymax, LFforce_sigma, LHforce_sigma, RFforce_sigma,  RHforce_sigma, LFcop_sigma,  LHcop_sigma,
+                              RFcop_sigma, RHcop_sigma, VelocityThres, LFvnorm_sigma, LHvnorm_sigma, RFvnorm_sigma, RHvnorm_sigma, ContactDetectionWithCOP, ContactDetectionWithKinematics,  probabilisticContactThreshold,medianWindow);
             }
             else
             {
-                cd->init(LFfoot_frame, LHfoot_frame, RFfoot_frame, RHfoot_frame, LegHighThres, LegLowThres, StrikingContact, VelocityThres, mass, g, medianWindow);
+                detector.init(LFfoot_frame, LHfoot_frame, RFfoot_frame, RHfoot_frame, LegHighThres, LegLowThres, StrikingContact, VelocityThres, mass, g, medianWindow);
             }
 
             firstContact = false;
         }
-        if(useGEM)
+        if (E::Contact::Probabilistic)
         {
-            cd->computeSupportFoot(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2), 
-                                    copLF(0), copLF(1), copLH(0), copLH(1), copRF(0), copRF(1),  copRH(0), copRH(1),
-                                    vwLF.norm(), vwLH.norm(), vwRF.norm(), vwRH.norm());
+            detector.computeSupportFoot(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2), 
+                                         copLF(0), copLF(1), copLH(0), copLH(1), copRF(0), copRF(1),  copRH(0), copRH(1),
+                                         vwLF.norm(), vwLH.norm(), vwRF.norm(), vwRH.norm());
         }
         else
         {
-            cd->computeForceWeights(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2));
-            cd->SchmittTrigger(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2));
+            detector.computeForceWeights(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2));
+            detector.SchmittTrigger(LFLegForceFilt(2), LHLegForceFilt(2), RFLegForceFilt(2), RHLegForceFilt(2));
         }
         LFft_inc = false;
         LHft_inc = false;
@@ -956,7 +1846,7 @@ void quadruped_ekf::computeKinTFs()
 
         Tbs = TbLF;
         qbs = qbLF;
-        support_leg = cd->getSupportLeg();
+        support_leg = detector.getSupportLeg();
         if(support_leg.compare("LHLeg")==0)
         {
             Tbs = TbLH;
@@ -980,7 +1870,7 @@ void quadruped_ekf::computeKinTFs()
         // dr->computeDeadReckoningGEM(Twb.linear(), TbLF.linear(), TbLH.linear(), TbRF.linear(), TbRH.linear(),  omegawb, T_B_G.linear() * Vector3d(imu_msg.angular_velocity.x, imu_msg.angular_velocity.y, imu_msg.angular_velocity.z),
         //                            TbLF.translation(),  TbLH.translation(), TbRF.translation(),  TbRH.translation(), 
         //                            vbLF, vbLH, vbRF, vbRH, omegabLF, omegabLH, omegabRF, omegabRH,
-        //                            cd->getLFLegContactProb(), cd->getLHLegContactProb(),  cd->getRFLegContactProb(), cd->getRHLegContactProb(), 
+        //                            detector.getLFLegContactProb(), detector.getLHLegContactProb(),  detector.getRFLegContactProb(), detector.getRHLegContactProb(), 
         //                            LFLegGRF, LHLegGRF, RFLegGRF, RHLegGRF, LFLegGRT, LHLegGRT, RFLegGRT, RHLegGRT);
  
      
@@ -1027,7 +1917,6 @@ void quadruped_ekf::deAllocate()
 
     if (useCoMEKF)
     {
-        delete nipmEKF;
         if (useGyroLPF)
         {
             for (unsigned int i = 0; i < 3; i++)
@@ -1041,20 +1930,17 @@ void quadruped_ekf::deAllocate()
             delete[] gyroMAF;
         }
     }
-    delete imuInEKF;
     delete rd;
-    delete mw;
-    delete mh;
+    delete pipeline;
     delete dr;
-    delete cd;
 }
 
-void quadruped_ekf::filterGyrodot()
+void quadruped_ekf::filterGyrodot(const Vector3d &gyro)
 {
     if (!firstGyrodot)
     {
         //Compute numerical derivative
-        Gyrodot = (imuInEKF->gyro - Gyro_) * freq;
+        Gyrodot = (gyro - Gyro_) * freq / com_step;
         if (useGyroLPF)
         {
             Gyrodot(0) = gyroLPF[0]->filter(Gyrodot(0));
@@ -1077,55 +1963,29 @@ void quadruped_ekf::filterGyrodot()
         Gyrodot = Vector3d::Zero();
         firstGyrodot = false;
     }
-    Gyro_ = imuInEKF->gyro;
+    Gyro_ = gyro;
 }
 
-void quadruped_ekf::publishGRF()
+void quadruped_ekf::publishGRF(const QuadrupedEstimate &e)
 {
 
     if (debug_mode)
     {
-        LFLeg_est_msg.wrench.force.x = LFLegGRF(0);
-        LFLeg_est_msg.wrench.force.y = LFLegGRF(1);
-        LFLeg_est_msg.wrench.force.z = LFLegGRF(2);
-        LFLeg_est_msg.wrench.torque.x = LFLegGRT(0);
-        LFLeg_est_msg.wrench.torque.y = LFLegGRT(1);
-        LFLeg_est_msg.wrench.torque.z = LFLegGRT(2);
-        LFLeg_est_msg.header.frame_id = LFfoot_frame;
-        LFLeg_est_msg.header.stamp = ros::Time::now();
-        LFLeg_est_pub.publish(LFLeg_est_msg);
-
-        LHLeg_est_msg.wrench.force.x = LHLegGRF(0);
-        LHLeg_est_msg.wrench.force.y = LHLegGRF(1);
-        LHLeg_est_msg.wrench.force.z = LHLegGRF(2);
-        LHLeg_est_msg.wrench.torque.x = LHLegGRT(0);
-        LHLeg_est_msg.wrench.torque.y = LHLegGRT(1);
-        LHLeg_est_msg.wrench.torque.z = LHLegGRT(2);
-        LHLeg_est_msg.header.frame_id = LHfoot_frame;
-        LHLeg_est_msg.header.stamp = ros::Time::now();
-        LHLeg_est_pub.publish(LHLeg_est_msg);
-
-
-        RFLeg_est_msg.wrench.force.x = RFLegGRF(0);
-        RFLeg_est_msg.wrench.force.y = RFLegGRF(1);
-        RFLeg_est_msg.wrench.force.z = RFLegGRF(2);
-        RFLeg_est_msg.wrench.torque.x = RFLegGRT(0);
-        RFLeg_est_msg.wrench.torque.y = RFLegGRT(1);
-        RFLeg_est_msg.wrench.torque.z = RFLegGRT(2);
-        RFLeg_est_msg.header.frame_id = RFfoot_frame;
-        RFLeg_est_msg.header.stamp = ros::Time::now();
-        RFLeg_est_pub.publish(RFLeg_est_msg);
-
-        RHLeg_est_msg.wrench.force.x = RHLegGRF(0);
-        RHLeg_est_msg.wrench.force.y = RHLegGRF(1);
-        RHLeg_est_msg.wrench.force.z = RHLegGRF(2);
-        RHLeg_est_msg.wrench.torque.x = RHLegGRT(0);
-        RHLeg_est_msg.wrench.torque.y = RHLegGRT(1);
-        RHLeg_est_msg.wrench.torque.z = RHLegGRT(2);
-        RHLeg_est_msg.header.frame_id = RHfoot_frame;
-        RHLeg_est_msg.header.stamp = ros::Time::now();
-        RHLeg_est_pub.publish(RHLeg_est_msg);
+        serow::toWrench(LFLeg_est_msg.wrench, e.LFLegGRF, e.LFLegGRT);
+        LFLeg_est_msg.header.stamp = e.stamp;
+        publishMsg(LFLeg_est_pub, LFLeg_est_ptr, LFLeg_est_msg);
+
+        serow::toWrench(LHLeg_est_msg.wrench, e.LHLegGRF, e.LHLegGRT);
+        LHLeg_est_msg.header.stamp = e.stamp;
+        publishMsg(LHLeg_est_pub, LHLeg_est_ptr, LHLeg_est_msg);
+
+        serow::toWrench(RFLeg_est_msg.wrench, e.RFLegGRF, e.RFLegGRT);
+        RFLeg_est_msg.header.stamp = e.stamp;
+        publishMsg(RFLeg_est_pub, RFLeg_est_ptr, RFLeg_est_msg);
 
+        serow::toWrench(RHLeg_est_msg.wrench, e.RHLegGRF, e.RHLegGRT);
+        RHLeg_est_msg.header.stamp = e.stamp;
+        publishMsg(RHLeg_est_pub, RHLeg_est_ptr, RHLeg_est_msg);
     }
 }
 
@@ -1145,77 +2005,53 @@ void quadruped_ekf::computeGlobalCOP(Affine3d TwLF_, Affine3d TwLH_, Affine3d Tw
     COP_fsr  = COP_fsr /(weightLF + weightRF + weightLH + weightRH);
 }
 
-void quadruped_ekf::publishCOP()
+void quadruped_ekf::publishCOP(const QuadrupedEstimate &e)
 {
-    COP_msg.point.x = COP_fsr(0);
-    COP_msg.point.y = COP_fsr(1);
-    COP_msg.point.z = COP_fsr(2);
-    COP_msg.header.stamp = ros::Time::now();
-    COP_msg.header.frame_id = "odom";
-    COP_pub.publish(COP_msg);
+    serow::toPoint(COP_msg.point, e.cop);
+    COP_msg.header.stamp = e.stamp;
+    publishMsg(COP_pub, COP_ptr, COP_msg);
 }
 
-void quadruped_ekf::publishCoMEstimates()
+void quadruped_ekf::publishCoMEstimates(const QuadrupedEstimate &e)
 {
-    CoM_odom_msg.child_frame_id = "CoM_frame";
-    CoM_odom_msg.header.stamp = ros::Time::now();
-    CoM_odom_msg.header.frame_id = "odom";
-    CoM_odom_msg.pose.pose.position.x = nipmEKF->comX;
-    CoM_odom_msg.pose.pose.position.y = nipmEKF->comY;
-    CoM_odom_msg.pose.pose.position.z = nipmEKF->comZ;
-    CoM_odom_msg.twist.twist.linear.x = nipmEKF->velX;
-    CoM_odom_msg.twist.twist.linear.y = nipmEKF->velY;
-    CoM_odom_msg.twist.twist.linear.z = nipmEKF->velZ;
-    //for(int i=0;i<36;i++)
-    //odom_est_msg.pose.covariance[i] = 0;
-    CoM_odom_pub.publish(CoM_odom_msg);
-    CoM_odom_msg.child_frame_id = "CoM_frame";
-    CoM_odom_msg.header.stamp = ros::Time::now();
-    CoM_odom_msg.header.frame_id = "odom";
-    CoM_odom_msg.pose.pose.position.x = CoM_leg_odom(0);
-    CoM_odom_msg.pose.pose.position.y = CoM_leg_odom(1);
-    CoM_odom_msg.pose.pose.position.z = CoM_leg_odom(2);
-    CoM_odom_msg.twist.twist.linear.x = 0;
-    CoM_odom_msg.twist.twist.linear.y = 0;
-    CoM_odom_msg.twist.twist.linear.z = 0;
-    //for(int i=0;i<36;i++)
-    //odom_est_msg.pose.covariance[i] = 0;
-    CoM_leg_odom_pub.publish(CoM_odom_msg);
+    CoM_odom_msg.header.stamp = e.stamp;
+    serow::toPoint(CoM_odom_msg.pose.pose.position, e.com_pos);
+    serow::toTwist(CoM_odom_msg.twist.twist, e.com_vel, Vector3d::Zero());
+    publishMsg(CoM_odom_pub, CoM_odom_ptr, CoM_odom_msg);
 
-    external_force_filt_msg.header.frame_id = "odom";
-    external_force_filt_msg.header.stamp = ros::Time::now();
-    external_force_filt_msg.wrench.force.x = nipmEKF->fX;
-    external_force_filt_msg.wrench.force.y = nipmEKF->fY;
-    external_force_filt_msg.wrench.force.z = nipmEKF->fZ;
-    external_force_filt_pub.publish(external_force_filt_msg);
+    serow::toPoint(CoM_odom_msg.pose.pose.position, e.com_leg_odom);
+    serow::toTwist(CoM_odom_msg.twist.twist, Vector3d::Zero(), Vector3d::Zero());
+    publishMsg(CoM_leg_odom_pub, CoM_leg_odom_ptr, CoM_odom_msg);
+
+    external_force_filt_msg.header.stamp = e.stamp;
+    serow::toWrench(external_force_filt_msg.wrench, e.com_force, Vector3d::Zero());
+    publishMsg(external_force_filt_pub, external_force_filt_ptr, external_force_filt_msg);
 
     if (debug_mode)
     {
-        temp_pose_msg.pose.position.x = CoM_enc(0);
-        temp_pose_msg.pose.position.y = CoM_enc(1);
-        temp_pose_msg.pose.position.z = CoM_enc(2);
-        temp_pose_msg.header.stamp = ros::Time::now();
-        temp_pose_msg.header.frame_id = base_link_frame;
-        rel_CoMPose_pub.publish(temp_pose_msg);
+        serow::toPoint(rel_CoMPose_msg.pose.position, e.com_rel);
+        rel_CoMPose_msg.header.stamp = e.stamp;
+        publishMsg(rel_CoMPose_pub, rel_CoMPose_ptr, rel_CoMPose_msg);
     }
 }
 
-void quadruped_ekf::publishJointEstimates()
+void quadruped_ekf::publishJointEstimates(const QuadrupedEstimate &e)
 {
-
-    joint_filt_msg.header.stamp = ros::Time::now();
-    joint_filt_msg.name.resize(number_of_joints);
-    joint_filt_msg.position.resize(number_of_joints);
-    joint_filt_msg.velocity.resize(number_of_joints);
-
-    for (unsigned int i = 0; i < number_of_joints; i++)
+    //Joint names are copied once, the message is reused afterwards
+    if (joint_filt_msg.name.size() != (unsigned int)e.joint_pos.size())
     {
-        joint_filt_msg.position[i] = JointVF[i]->JointPosition;
-        joint_filt_msg.velocity[i] = JointVF[i]->JointVelocity;
-        joint_filt_msg.name[i] = JointVF[i]->JointName;
+        joint_filt_msg.name = joint_names;
+        joint_filt_msg.position.resize(e.joint_pos.size());
+        joint_filt_msg.velocity.resize(e.joint_vel.size());
+    }
+    joint_filt_msg.header.stamp = e.stamp;
+    for (unsigned int i = 0; i < joint_filt_msg.position.size(); i++)
+    {
+        joint_filt_msg.position[i] = e.joint_pos(i);
+        joint_filt_msg.velocity[i] = e.joint_vel(i);
     }
 
-    joint_filt_pub.publish(joint_filt_msg);
+    publishMsg(joint_filt_pub, joint_filt_ptr, joint_filt_msg);
 }
 
 void quadruped_ekf::advertise()
@@ -1258,6 +2094,9 @@ void quadruped_ekf::advertise()
     {
         ground_truth_com_pub = n.advertise<nav_msgs::Odometry>("serow/ground_truth/CoM/odom", 1000);
         ground_truth_odom_pub = n.advertise<nav_msgs::Odometry>("serow/ground_truth/odom", 1000);
+        if (useEvaluation)
+            evaluation_pub = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+        last_evaluation = ros::Time::now();
         ds_pub = n.advertise<std_msgs::Int32>("serow/is_in_ds", 1000);
     }
 
@@ -1278,6 +2117,50 @@ void quadruped_ekf::advertise()
     }
     if (comp_with)
         comp_odom0_pub = n.advertise<nav_msgs::Odometry>("serow/comp/odom0", 1000);
+
+    if (tracer.enabled())
+        dump_trace_srv = n.advertiseService("serow/dump_trace", &quadruped_ekf::dumpTraceCb, this);
+    if (poseHistory.isOpen())
+        lookup_pose_srv = n.advertiseService("serow/lookup_pose", &quadruped_ekf::lookupPoseCb, this);
+}
+
+void quadruped_ekf::initMessages()
+{
+    //Frame ids never change, set them once so that publishing only writes numbers
+    bodyAcc_est_msg.header.frame_id = "odom";
+    odom_est_msg.header.frame_id = "odom";
+    odom_est_msg.child_frame_id = base_link_frame;
+    leg_odom_msg.header.frame_id = "odom";
+    leg_odom_msg.child_frame_id = base_link_frame;
+    LFLeg_odom_msg.header.frame_id = "odom";
+    LFLeg_odom_msg.child_frame_id = LFfoot_frame;
+    LHLeg_odom_msg.header.frame_id = "odom";
+    LHLeg_odom_msg.child_frame_id = LHfoot_frame;
+    RFLeg_odom_msg.header.frame_id = "odom";
+    RFLeg_odom_msg.child_frame_id = RFfoot_frame;
+    RHLeg_odom_msg.header.frame_id = "odom";
+    RHLeg_odom_msg.child_frame_id = RHfoot_frame;
+    supportPose_est_msg.header.frame_id = "odom";
+    COP_msg.header.frame_id = "odom";
+    CoM_odom_msg.header.frame_id = "odom";
+    CoM_odom_msg.child_frame_id = "CoM_frame";
+    external_force_filt_msg.header.frame_id = "odom";
+    LFLeg_est_msg.header.frame_id = LFfoot_frame;
+    LHLeg_est_msg.header.frame_id = LHfoot_frame;
+    RFLeg_est_msg.header.frame_id = RFfoot_frame;
+    RHLeg_est_msg.header.frame_id = RHfoot_frame;
+    rel_LFLegPose_msg.header.frame_id = base_link_frame;
+    rel_LHLegPose_msg.header.frame_id = base_link_frame;
+    rel_RFLegPose_msg.header.frame_id = base_link_frame;
+    rel_RHLegPose_msg.header.frame_id = base_link_frame;
+    rel_CoMPose_msg.header.frame_id = base_link_frame;
+    rel_CoMPose_msg.pose.orientation.w = 1.0;
+    ground_truth_com_pub_msg.header.frame_id = "odom";
+    ground_truth_com_pub_msg.child_frame_id = "CoM_frame";
+    ground_truth_odom_pub_msg.header.frame_id = "odom";
+    ground_truth_odom_pub_msg.child_frame_id = base_link_frame;
+    comp_odom0_pub_msg.header.frame_id = "odom";
+    comp_odom0_pub_msg.child_frame_id = base_link_frame;
 }
 
 void quadruped_ekf::subscribeToJointState()
@@ -1289,7 +2172,13 @@ void quadruped_ekf::subscribeToJointState()
 
 void quadruped_ekf::joint_stateCb(const sensor_msgs::JointState::ConstPtr &msg)
 {
-    joint_state_msg = *msg;
+    processJointState(*msg);
+}
+
+void quadruped_ekf::processJointState(const sensor_msgs::JointState &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "joint_stateCb", "callback", msg.header.stamp.toSec());
+    joint_state_msg = msg;
     joint_inc = true;
 
     if (firstJointStates)
@@ -1303,6 +2192,8 @@ void quadruped_ekf::joint_stateCb(const sensor_msgs::JointState::ConstPtr &msg)
             JointVF[i] = new JointDF();
             JointVF[i]->init(joint_state_msg.name[i], joint_freq, joint_cutoff_freq);
         }
+        joint_names = joint_state_msg.name;
+        rd->mapJointNames(joint_names);
         firstJointStates = false;
     }
 
@@ -1310,8 +2201,6 @@ void quadruped_ekf::joint_stateCb(const sensor_msgs::JointState::ConstPtr &msg)
     {
         joint_state_pos[i] = joint_state_msg.position[i];
         joint_state_vel[i] = JointVF[i]->filter(joint_state_msg.position[i]);
-        joint_state_pos_map[joint_state_msg.name[i]] = joint_state_pos[i];
-        joint_state_vel_map[joint_state_msg.name[i]] = joint_state_vel[i];
     }
 }
 
@@ -1324,6 +2213,7 @@ void quadruped_ekf::subscribeToOdom()
 
 void quadruped_ekf::odomCb(const nav_msgs::Odometry::ConstPtr &msg)
 {
+    SEROW_TRACE_SCOPE(tracer, "odomCb", "callback", msg->header.stamp.toSec());
     odom_msg = *msg;
     odom_inc = true;
     if (firstOdom)
@@ -1340,6 +2230,9 @@ void quadruped_ekf::subscribeToGroundTruth()
 }
 void quadruped_ekf::ground_truth_odomCb(const nav_msgs::Odometry::ConstPtr &msg)
 {
+    //Optional processing, skipped while the deadline governor is shedding load
+    if (governor.atLeast(serow::DeadlineGovernor::SkipOptional))
+        return;
     ground_truth_odom_msg = *msg;
     if (kinematicsInitialized)
     {
@@ -1361,17 +2254,11 @@ void quadruped_ekf::ground_truth_odomCb(const nav_msgs::Odometry::ConstPtr &msg)
              tempq_ = q_B_GT * Quaterniond(ground_truth_odom_msg_.pose.pose.orientation.w, ground_truth_odom_msg_.pose.pose.orientation.x, ground_truth_odom_msg_.pose.pose.orientation.y, ground_truth_odom_msg_.pose.pose.orientation.z);
              gt_odomq *= (tempq * tempq_.inverse());
         }
-        
-
-
-        ground_truth_odom_pub_msg.pose.pose.position.x = gt_odom(0);
-        ground_truth_odom_pub_msg.pose.pose.position.y = gt_odom(1);
-        ground_truth_odom_pub_msg.pose.pose.position.z = gt_odom(2);
-        ground_truth_odom_pub_msg.pose.pose.orientation.w = gt_odomq.w();
-        ground_truth_odom_pub_msg.pose.pose.orientation.x = gt_odomq.x();
-        ground_truth_odom_pub_msg.pose.pose.orientation.y = gt_odomq.y();
-        ground_truth_odom_pub_msg.pose.pose.orientation.z = gt_odomq.z();
-
+        if (useEvaluation)
+        {
+            baseEvaluator.addGroundTruth(ground_truth_odom_msg.header.stamp.toSec(), gt_odom, gt_odomq);
+            publishEvaluation();
+        }
     }
     ground_truth_odom_msg_ = ground_truth_odom_msg;
 
@@ -1384,6 +2271,9 @@ void quadruped_ekf::subscribeToGroundTruthCoM()
 }
 void quadruped_ekf::ground_truth_comCb(const nav_msgs::Odometry::ConstPtr &msg)
 {
+    //Optional processing, skipped while the deadline governor is shedding load
+    if (governor.atLeast(serow::DeadlineGovernor::SkipOptional))
+        return;
     if (kinematicsInitialized)
     {
         ground_truth_com_odom_msg = *msg;
@@ -1406,6 +2296,11 @@ void quadruped_ekf::ground_truth_comCb(const nav_msgs::Odometry::ConstPtr &msg)
         ground_truth_com_odom_msg.pose.pose.orientation.x = tempq.x();
         ground_truth_com_odom_msg.pose.pose.orientation.y = tempq.y();
         ground_truth_com_odom_msg.pose.pose.orientation.z = tempq.z();
+        if (useEvaluation && useCoMEKF)
+        {
+            comEvaluator.addGroundTruth(ground_truth_com_odom_msg.header.stamp.toSec(), temp, tempq);
+            publishEvaluation();
+        }
     }
 }
 
@@ -1418,6 +2313,9 @@ void quadruped_ekf::subscribeToCompOdom()
 
 void quadruped_ekf::compodom0Cb(const nav_msgs::Odometry::ConstPtr &msg)
 {
+    //Optional processing, skipped while the deadline governor is shedding load
+    if (governor.atLeast(serow::DeadlineGovernor::SkipOptional))
+        return;
     if (kinematicsInitialized)
     {
         comp_odom0_msg = *msg;
@@ -1475,12 +2373,208 @@ void quadruped_ekf::support_idxCb(const std_msgs::Int32::ConstPtr &msg)
 
 void quadruped_ekf::subscribeToIMU()
 {
-    imu_sub = n.subscribe(imu_topic, 1, &quadruped_ekf::imuCb, this, ros::TransportHints().tcpNoDelay());
+    imu_sub = n.subscribe(imu_topic, imu_queue_size, &quadruped_ekf::imuCb, this, ros::TransportHints().tcpNoDelay());
+}
+bool quadruped_ekf::openSensorRing()
+{
+    if (!sensorRing.open(shm_sensor_name))
+        return false;
+    shm_joint_msg.name.resize(sensorRing.numJoints());
+    for (int i = 0; i < sensorRing.numJoints(); i++)
+        shm_joint_msg.name[i] = sensorRing.jointName(i);
+    shm_joint_msg.position.resize(sensorRing.numJoints());
+    shm_joint_msg.velocity.resize(sensorRing.numJoints());
+    ROS_INFO("Reading sensors from the shared memory ring %s, %d joints", shm_sensor_name.c_str(), sensorRing.numJoints());
+    return true;
+}
+
+void quadruped_ekf::waitForInputs()
+{
+    ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(startup_timeout);
+    std::string missing;
+    while (ros::ok())
+    {
+        missing.clear();
+        if (sensor_input == "shm")
+        {
+            if (!sensorRing.isOpen() && !openSensorRing())
+                missing += " " + shm_sensor_name;
+        }
+        else
+        {
+            if (imu_sub.getNumPublishers() == 0)
+                missing += " " + imu_topic;
+            if (joint_state_sub.getNumPublishers() == 0)
+                missing += " " + joint_state_topic;
+            if (LFft_sub.getNumPublishers() == 0)
+                missing += " " + LFfsr_topic;
+            if (LHft_sub.getNumPublishers() == 0)
+                missing += " " + LHfsr_topic;
+            if (RFft_sub.getNumPublishers() == 0)
+                missing += " " + RFfsr_topic;
+            if (RHft_sub.getNumPublishers() == 0)
+                missing += " " + RHfsr_topic;
+        }
+        if (!useLegOdom && odom_sub.getNumPublishers() == 0)
+            missing += " " + odom_topic;
+        if (missing.empty() || ros::WallTime::now() >= deadline)
+            break;
+        ros::WallDuration(0.005).sleep();
+    }
+    if (!missing.empty())
+        ROS_WARN("Inputs not ready after %g s:%s, starting anyway", startup_timeout, missing.c_str());
+}
+
+void quadruped_ekf::startReconfigure()
+{
+    //Seed the server with the loaded parameters, the cfg defaults only fill what this configuration does not use
+    serow::VarianceControlConfig config = serow::VarianceControlConfig::__getDefault__();
+    serow::EstimatorParams p;
+    serow::paramsFromConfig(config, p);
+    if (imuInEKF)
+    {
+        serow::readImuNoise(*imuInEKF, p.imu);
+        serow::readContactNoise(*imuInEKF, p.imu);
+    }
+    if (nipmEKF)
+        serow::readCoMNoise(*nipmEKF, p.com);
+    if (useGEM)
+        p.contact.prob_TH = probabilisticContactThreshold;
+    else
+    {
+        p.contact.LegHighThres = LegHighThres;
+        p.contact.LegLowThres = LegLowThres;
+        p.contact.StrikingContact = StrikingContact;
+    }
+    p.contact.VelocityThres = VelocityThres;
+    serow::configFromParams(p, config);
+
+    dynamic_recfg_ = boost::make_shared< dynamic_reconfigure::Server<serow::VarianceControlConfig> >(n_p);
+    dynamic_recfg_->updateConfig(config);
+    dynamic_reconfigure::Server<serow::VarianceControlConfig>::CallbackType cb = boost::bind(&quadruped_ekf::reconfigureCB, this, _1, _2);
+    dynamic_recfg_->setCallback(cb);
 }
+
+void quadruped_ekf::reconfigureCB(serow::VarianceControlConfig &config, uint32_t level)
+{
+    //Runs on the reconfigure thread, the estimator picks the set up at its next cycle
+    serow::EstimatorParams p;
+    serow::paramsFromConfig(config, p);
+    unsigned long version = noiseParams.publish(p);
+    ROS_INFO("Noise parameters version %lu published", version);
+}
+
+void quadruped_ekf::applyNoiseParams()
+{
+    const serow::EstimatorParams &p = noiseParams.current();
+    if (imuInEKF)
+    {
+        serow::applyImuNoise(*imuInEKF, p.imu);
+        serow::applyContactNoise(*imuInEKF, p.imu);
+    }
+    if (nipmEKF)
+        serow::applyCoMNoise(*nipmEKF, p.com);
+
+    //The detector is initialized from these at the first contact
+    LegHighThres = p.contact.LegHighThres;
+    LegLowThres = p.contact.LegLowThres;
+    StrikingContact = p.contact.StrikingContact;
+    VelocityThres = p.contact.VelocityThres;
+    probabilisticContactThreshold = p.contact.prob_TH;
+    if (!firstContact)
+    {
+        cd->setThresholds(LegHighThres, LegLowThres, StrikingContact, VelocityThres);
+        if (useGEM)
+            cd->setProbabilityThreshold(probabilisticContactThreshold);
+    }
+}
+
+void quadruped_ekf::pollSharedSensors()
+{
+    //the middleware may create the ring after the estimator started
+    if (!sensorRing.isOpen() && !openSensorRing())
+        return;
+
+    //Same handlers as the ROS callbacks, without the deserialization
+    ros::Time stamp;
+    while (sensorRing.poll(sensorFrame))
+    {
+        stamp.fromNSec(sensorFrame.stamp_ns);
+        if ((sensorFrame.parts & serow::SharedSensorFrame::HasJoints) && sensorFrame.num_joints == (int)shm_joint_msg.name.size())
+        {
+            shm_joint_msg.header.stamp = stamp;
+            for (int i = 0; i < sensorFrame.num_joints; i++)
+            {
+                shm_joint_msg.position[i] = sensorFrame.joint_pos[i];
+                shm_joint_msg.velocity[i] = sensorFrame.joint_vel[i];
+            }
+            processJointState(shm_joint_msg);
+        }
+        if ((sensorFrame.parts & serow::SharedSensorFrame::HasWrenches) && sensorFrame.num_wrenches >= 4)
+        {
+            shm_wrench_msg.header.stamp = stamp;
+            serow::toWrench(shm_wrench_msg.wrench, sensorFrame.force[0], sensorFrame.torque[0]);
+            processLFFSR(shm_wrench_msg);
+            serow::toWrench(shm_wrench_msg.wrench, sensorFrame.force[1], sensorFrame.torque[1]);
+            processLHFSR(shm_wrench_msg);
+            serow::toWrench(shm_wrench_msg.wrench, sensorFrame.force[2], sensorFrame.torque[2]);
+            processRFFSR(shm_wrench_msg);
+            serow::toWrench(shm_wrench_msg.wrench, sensorFrame.force[3], sensorFrame.torque[3]);
+            processRHFSR(shm_wrench_msg);
+        }
+        if (sensorFrame.parts & serow::SharedSensorFrame::HasImu)
+        {
+            shm_imu_msg.header.stamp = stamp;
+            shm_imu_msg.angular_velocity.x = sensorFrame.gyro[0];
+            shm_imu_msg.angular_velocity.y = sensorFrame.gyro[1];
+            shm_imu_msg.angular_velocity.z = sensorFrame.gyro[2];
+            shm_imu_msg.linear_acceleration.x = sensorFrame.acc[0];
+            shm_imu_msg.linear_acceleration.y = sensorFrame.acc[1];
+            shm_imu_msg.linear_acceleration.z = sensorFrame.acc[2];
+            processImu(shm_imu_msg);
+        }
+    }
+}
+
 void quadruped_ekf::imuCb(const sensor_msgs::Imu::ConstPtr &msg)
 {
-    imu_msg = *msg;
+    processImu(*msg);
+}
+
+void quadruped_ekf::processImu(const sensor_msgs::Imu &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "imuCb", "callback", msg.header.stamp.toSec());
+    imu_msg = msg;
     imu_inc = true;
+    imuBuffer.push(msg.header.stamp.toSec(),
+                   Vector3d(msg.angular_velocity.x, msg.angular_velocity.y, msg.angular_velocity.z),
+                   Vector3d(msg.linear_acceleration.x, msg.linear_acceleration.y, msg.linear_acceleration.z));
+}
+
+/** Attitude Estimation at the native IMU rate **/
+template <class AttitudeFilter>
+void quadruped_ekf::updateAttitude(AttitudeFilter &filter)
+{
+    SEROW_PROFILE_SCOPE(profiler, AttitudeStage);
+    SEROW_PERF_SCOPE(perfCounters, AttitudeStage);
+    SEROW_TRACE_SCOPE(tracer, "updateAttitude", "attitude", imu_msg.header.stamp.toSec());
+    //Integrate every buffered sample, the base EKF keeps using the latest imu_msg at its own rate
+    serow::ImuSample s;
+    double dt;
+    while (imuBuffer.pop(s))
+    {
+        dt = 1.0 / imu_native_freq;
+        //Use the sensor stamps unless they are missing or jumped (e.g. rosbag restart)
+        if (!firstImuSample && s.t > last_imu_stamp && s.t - last_imu_stamp < 0.1)
+            dt = s.t - last_imu_stamp;
+        last_imu_stamp = s.t;
+        firstImuSample = false;
+
+        filter.updateIMU(T_B_G.linear() * s.gyro, T_B_A.linear() * s.acc, dt);
+        if (imuCalibrated && imuBiasCalibrator.add(T_B_G.linear() * s.gyro, T_B_A.linear() * s.acc, filter.getR()))
+            imuBiasesRefined = true;
+    }
+    Rwb = filter.getR();
 }
 
 void quadruped_ekf::subscribeToFSR()
@@ -1500,7 +2594,13 @@ void quadruped_ekf::subscribeToFSR()
 
 void quadruped_ekf::LFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 {
-    LFfsr_msg = *msg;
+    processLFFSR(*msg);
+}
+
+void quadruped_ekf::processLFFSR(const geometry_msgs::WrenchStamped &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "LFfsrCb", "callback", msg.header.stamp.toSec());
+    LFfsr_msg = msg;
     LFLegGRF(0) = LFfsr_msg.wrench.force.x;
     LFLegGRF(1) = LFfsr_msg.wrench.force.y;
     LFLegGRF(2) = LFfsr_msg.wrench.force.z;
@@ -1528,7 +2628,13 @@ void quadruped_ekf::LFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 
 void quadruped_ekf::RFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 {
-    RFfsr_msg = *msg;
+    processRFFSR(*msg);
+}
+
+void quadruped_ekf::processRFFSR(const geometry_msgs::WrenchStamped &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "RFfsrCb", "callback", msg.header.stamp.toSec());
+    RFfsr_msg = msg;
     RFLegGRF(0) = RFfsr_msg.wrench.force.x;
     RFLegGRF(1) = RFfsr_msg.wrench.force.y;
     RFLegGRF(2) = RFfsr_msg.wrench.force.z;
@@ -1556,7 +2662,13 @@ void quadruped_ekf::RFfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 
 void quadruped_ekf::LHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 {
-    LHfsr_msg = *msg;
+    processLHFSR(*msg);
+}
+
+void quadruped_ekf::processLHFSR(const geometry_msgs::WrenchStamped &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "LHfsrCb", "callback", msg.header.stamp.toSec());
+    LHfsr_msg = msg;
     LHLegGRF(0) = LHfsr_msg.wrench.force.x;
     LHLegGRF(1) = LHfsr_msg.wrench.force.y;
     LHLegGRF(2) = LHfsr_msg.wrench.force.z;
@@ -1585,7 +2697,13 @@ void quadruped_ekf::LHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 
 void quadruped_ekf::RHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
 {
-    RHfsr_msg = *msg;
+    processRHFSR(*msg);
+}
+
+void quadruped_ekf::processRHFSR(const geometry_msgs::WrenchStamped &msg)
+{
+    SEROW_TRACE_SCOPE(tracer, "RHfsrCb", "callback", msg.header.stamp.toSec());
+    RHfsr_msg = msg;
     RHLegGRF(0) = RHfsr_msg.wrench.force.x;
     RHLegGRF(1) = RHfsr_msg.wrench.force.y;
     RHLegGRF(2) = RHfsr_msg.wrench.force.z;
@@ -1611,222 +2729,99 @@ void quadruped_ekf::RHfsrCb(const geometry_msgs::WrenchStamped::ConstPtr &msg)
     RHft_inc = true;
 }
 
-void quadruped_ekf::publishBodyEstimates()
-{
-        bodyAcc_est_msg.header.stamp = ros::Time::now();
-        bodyAcc_est_msg.header.frame_id = "odom";
-        bodyAcc_est_msg.linear_acceleration.x = imuInEKF->accX;
-        bodyAcc_est_msg.linear_acceleration.y = imuInEKF->accY;
-        bodyAcc_est_msg.linear_acceleration.z = imuInEKF->accZ;
-
-        bodyAcc_est_msg.angular_velocity.x = imuInEKF->gyroX;
-        bodyAcc_est_msg.angular_velocity.y = imuInEKF->gyroY;
-        bodyAcc_est_msg.angular_velocity.z = imuInEKF->gyroZ;
-        bodyAcc_est_pub.publish(bodyAcc_est_msg);
-
-        odom_est_msg.child_frame_id = base_link_frame;
-        odom_est_msg.header.stamp = ros::Time::now();
-        odom_est_msg.header.frame_id = "odom";
-        odom_est_msg.pose.pose.position.x = imuInEKF->rX;
-        odom_est_msg.pose.pose.position.y = imuInEKF->rY;
-        odom_est_msg.pose.pose.position.z = imuInEKF->rZ;
-        odom_est_msg.pose.pose.orientation.x = imuInEKF->qib.x();
-        odom_est_msg.pose.pose.orientation.y = imuInEKF->qib.y();
-        odom_est_msg.pose.pose.orientation.z = imuInEKF->qib.z();
-        odom_est_msg.pose.pose.orientation.w = imuInEKF->qib.w();
-
-        odom_est_msg.twist.twist.linear.x = imuInEKF->velX;
-        odom_est_msg.twist.twist.linear.y = imuInEKF->velY;
-        odom_est_msg.twist.twist.linear.z = imuInEKF->velZ;
-        odom_est_msg.twist.twist.angular.x = imuInEKF->gyroX;
-        odom_est_msg.twist.twist.angular.y = imuInEKF->gyroY;
-        odom_est_msg.twist.twist.angular.z = imuInEKF->gyroZ;
-        odom_est_pub.publish(odom_est_msg);
-    
-
-    leg_odom_msg.child_frame_id = base_link_frame;
-    leg_odom_msg.header.stamp = ros::Time::now();
-    leg_odom_msg.header.frame_id = "odom";
-    leg_odom_msg.pose.pose.position.x = Twb.translation()(0);
-    leg_odom_msg.pose.pose.position.y = Twb.translation()(1);
-    leg_odom_msg.pose.pose.position.z = Twb.translation()(2);
-    leg_odom_msg.pose.pose.orientation.x = qwb.x();
-    leg_odom_msg.pose.pose.orientation.y = qwb.y();
-    leg_odom_msg.pose.pose.orientation.z = qwb.z();
-    leg_odom_msg.pose.pose.orientation.w = qwb.w();
-    leg_odom_msg.twist.twist.linear.x = vwb(0);
-    leg_odom_msg.twist.twist.linear.y = vwb(1);
-    leg_odom_msg.twist.twist.linear.z = vwb(2);
-    leg_odom_msg.twist.twist.angular.x = omegawb(0);
-    leg_odom_msg.twist.twist.angular.y = omegawb(1);
-    leg_odom_msg.twist.twist.angular.z = omegawb(2);
-    leg_odom_pub.publish(leg_odom_msg);
-
-    if (ground_truth)
+void quadruped_ekf::publishBodyEstimates(const QuadrupedEstimate &e)
+{
+    bodyAcc_est_msg.header.stamp = e.stamp;
+    bodyAcc_est_msg.linear_acceleration.x = e.base_acc(0);
+    bodyAcc_est_msg.linear_acceleration.y = e.base_acc(1);
+    bodyAcc_est_msg.linear_acceleration.z = e.base_acc(2);
+    bodyAcc_est_msg.angular_velocity.x = e.base_gyro(0);
+    bodyAcc_est_msg.angular_velocity.y = e.base_gyro(1);
+    bodyAcc_est_msg.angular_velocity.z = e.base_gyro(2);
+    publishMsg(bodyAcc_est_pub, bodyAcc_est_ptr, bodyAcc_est_msg);
+
+    odom_est_msg.header.stamp = e.stamp;
+    serow::toPose(odom_est_msg.pose.pose, e.base_pos, e.base_q);
+    serow::toTwist(odom_est_msg.twist.twist, e.base_vel, e.base_gyro);
+    publishMsg(odom_est_pub, odom_est_ptr, odom_est_msg);
+
+    leg_odom_msg.header.stamp = e.stamp;
+    serow::toPose(leg_odom_msg.pose.pose, e.lo_pos, e.lo_q);
+    serow::toTwist(leg_odom_msg.twist.twist, e.lo_vel, e.lo_omega);
+    publishMsg(leg_odom_pub, leg_odom_ptr, leg_odom_msg);
+
+    if (ground_truth && e.degradation < serow::DeadlineGovernor::SkipOptional)
     {
-        ground_truth_com_odom_msg.child_frame_id = "CoM_frame";
-        ground_truth_com_odom_msg.header.stamp = ros::Time::now();
-        ground_truth_com_odom_msg.header.frame_id = "odom";
-        ground_truth_com_pub.publish(ground_truth_com_odom_msg);
-
-        ground_truth_odom_pub_msg.child_frame_id = base_link_frame;
-        ground_truth_odom_pub_msg.header.stamp = ros::Time::now();
-        ground_truth_odom_pub_msg.header.frame_id = "odom";
-        ground_truth_odom_pub.publish(ground_truth_odom_pub_msg);
-        ds_pub.publish(is_in_ds_msg);
+        ground_truth_com_pub_msg.header.stamp = e.stamp;
+        serow::toPose(ground_truth_com_pub_msg.pose.pose, e.gt_com_pos, e.gt_com_q);
+        serow::toTwist(ground_truth_com_pub_msg.twist.twist, e.gt_com_vel, e.gt_com_omega);
+        publishMsg(ground_truth_com_pub, ground_truth_com_ptr, ground_truth_com_pub_msg);
+
+        ground_truth_odom_pub_msg.header.stamp = e.stamp;
+        serow::toPose(ground_truth_odom_pub_msg.pose.pose, e.gt_pos, e.gt_q);
+        publishMsg(ground_truth_odom_pub, ground_truth_odom_ptr, ground_truth_odom_pub_msg);
+        publishMsg(ds_pub, ds_ptr, is_in_ds_msg);
+    }
+    if (e.comp_odom0_valid)
+    {
+        comp_odom0_pub_msg.header.stamp = e.stamp;
+        serow::toPose(comp_odom0_pub_msg.pose.pose, e.comp_pos, e.comp_q);
+        serow::toTwist(comp_odom0_pub_msg.twist.twist, e.comp_vel, e.comp_omega);
+        publishMsg(comp_odom0_pub, comp_odom0_ptr, comp_odom0_pub_msg);
     }
-    comp_odom0_msg.header = odom_est_msg.header;
-    comp_odom0_pub.publish(comp_odom0_msg);
-    comp_odom0_inc = false;
 }
 
-void quadruped_ekf::publishSupportEstimates()
+void quadruped_ekf::publishSupportEstimates(const QuadrupedEstimate &e)
 {
-    supportPose_est_msg.header.stamp = ros::Time::now();
-    supportPose_est_msg.header.frame_id = "odom";
-    supportPose_est_msg.pose.position.x = Tws.translation()(0);
-    supportPose_est_msg.pose.position.y = Tws.translation()(1);
-    supportPose_est_msg.pose.position.z = Tws.translation()(2);
-    supportPose_est_msg.pose.orientation.x = qws.x();
-    supportPose_est_msg.pose.orientation.y = qws.y();
-    supportPose_est_msg.pose.orientation.z = qws.z();
-    supportPose_est_msg.pose.orientation.w = qws.w();
-    supportPose_est_pub.publish(supportPose_est_msg);
+    supportPose_est_msg.header.stamp = e.stamp;
+    serow::toPose(supportPose_est_msg.pose, e.pws, e.qws);
+    publishMsg(supportPose_est_pub, supportPose_est_ptr, supportPose_est_msg);
 }
 
-void quadruped_ekf::publishLegEstimates()
+void quadruped_ekf::publishLegEstimates(const QuadrupedEstimate &e)
 {
+    LFLeg_odom_msg.header.stamp = e.stamp;
+    serow::toPose(LFLeg_odom_msg.pose.pose, e.pwLF, e.qwLF);
+    serow::toTwist(LFLeg_odom_msg.twist.twist, e.vwLF, e.omegawLF);
+    publishMsg(LFLeg_odom_pub, LFLeg_odom_ptr, LFLeg_odom_msg);
+
+    LHLeg_odom_msg.header.stamp = e.stamp;
+    serow::toPose(LHLeg_odom_msg.pose.pose, e.pwLH, e.qwLH);
+    serow::toTwist(LHLeg_odom_msg.twist.twist, e.vwLH, e.omegawLH);
+    publishMsg(LHLeg_odom_pub, LHLeg_odom_ptr, LHLeg_odom_msg);
+
+    RFLeg_odom_msg.header.stamp = e.stamp;
+    serow::toPose(RFLeg_odom_msg.pose.pose, e.pwRF, e.qwRF);
+    serow::toTwist(RFLeg_odom_msg.twist.twist, e.vwRF, e.omegawRF);
+    publishMsg(RFLeg_odom_pub, RFLeg_odom_ptr, RFLeg_odom_msg);
+
+    RHLeg_odom_msg.header.stamp = e.stamp;
+    serow::toPose(RHLeg_odom_msg.pose.pose, e.pwRH, e.qwRH);
+    serow::toTwist(RHLeg_odom_msg.twist.twist, e.vwRH, e.omegawRH);
+    publishMsg(RHLeg_odom_pub, RHLeg_odom_ptr, RHLeg_odom_msg);
 
-    LFLeg_odom_msg.child_frame_id = LFfoot_frame;
-    LFLeg_odom_msg.header.stamp = ros::Time::now();
-    LFLeg_odom_msg.header.frame_id = "odom";
-    LFLeg_odom_msg.pose.pose.position.x = TwLF.translation()(0);
-    LFLeg_odom_msg.pose.pose.position.y = TwLF.translation()(1);
-    LFLeg_odom_msg.pose.pose.position.z = TwLF.translation()(2);
-    LFLeg_odom_msg.pose.pose.orientation.x = qwLF.x();
-    LFLeg_odom_msg.pose.pose.orientation.y = qwLF.y();
-    LFLeg_odom_msg.pose.pose.orientation.z = qwLF.z();
-    LFLeg_odom_msg.pose.pose.orientation.w = qwLF.w();
-    LFLeg_odom_msg.twist.twist.linear.x = vwLF(0);
-    LFLeg_odom_msg.twist.twist.linear.y = vwLF(1);
-    LFLeg_odom_msg.twist.twist.linear.z = vwLF(2);
-    LFLeg_odom_msg.twist.twist.angular.x = omegawLF(0);
-    LFLeg_odom_msg.twist.twist.angular.y = omegawLF(1);
-    LFLeg_odom_msg.twist.twist.angular.z = omegawLF(2);
-    LFLeg_odom_pub.publish(LFLeg_odom_msg);
-
-
-
-    LHLeg_odom_msg.child_frame_id = LHfoot_frame;
-    LHLeg_odom_msg.header.stamp = ros::Time::now();
-    LHLeg_odom_msg.header.frame_id = "odom";
-    LHLeg_odom_msg.pose.pose.position.x = TwLH.translation()(0);
-    LHLeg_odom_msg.pose.pose.position.y = TwLH.translation()(1);
-    LHLeg_odom_msg.pose.pose.position.z = TwLH.translation()(2);
-    LHLeg_odom_msg.pose.pose.orientation.x = qwLH.x();
-    LHLeg_odom_msg.pose.pose.orientation.y = qwLH.y();
-    LHLeg_odom_msg.pose.pose.orientation.z = qwLH.z();
-    LHLeg_odom_msg.pose.pose.orientation.w = qwLH.w();
-    LHLeg_odom_msg.twist.twist.linear.x = vwLH(0);
-    LHLeg_odom_msg.twist.twist.linear.y = vwLH(1);
-    LHLeg_odom_msg.twist.twist.linear.z = vwLH(2);
-    LHLeg_odom_msg.twist.twist.angular.x = omegawLH(0);
-    LHLeg_odom_msg.twist.twist.angular.y = omegawLH(1);
-    LHLeg_odom_msg.twist.twist.angular.z = omegawLH(2);
-    LHLeg_odom_pub.publish(LHLeg_odom_msg);
-
-    RFLeg_odom_msg.child_frame_id = RFfoot_frame;
-    RFLeg_odom_msg.header.stamp = ros::Time::now();
-    RFLeg_odom_msg.header.frame_id = "odom";
-    RFLeg_odom_msg.pose.pose.position.x = TwRF.translation()(0);
-    RFLeg_odom_msg.pose.pose.position.y = TwRF.translation()(1);
-    RFLeg_odom_msg.pose.pose.position.z = TwRF.translation()(2);
-    RFLeg_odom_msg.pose.pose.orientation.x = qwRF.x();
-    RFLeg_odom_msg.pose.pose.orientation.y = qwRF.y();
-    RFLeg_odom_msg.pose.pose.orientation.z = qwRF.z();
-    RFLeg_odom_msg.pose.pose.orientation.w = qwRF.w();
-    RFLeg_odom_msg.twist.twist.linear.x = vwRF(0);
-    RFLeg_odom_msg.twist.twist.linear.y = vwRF(1);
-    RFLeg_odom_msg.twist.twist.linear.z = vwRF(2);
-    RFLeg_odom_msg.twist.twist.angular.x = omegawRF(0);
-    RFLeg_odom_msg.twist.twist.angular.y = omegawRF(1);
-    RFLeg_odom_msg.twist.twist.angular.z = omegawRF(2);
-    RFLeg_odom_pub.publish(RFLeg_odom_msg);
+    if (debug_mode)
+    {
+        rel_LFLegPose_msg.header.stamp = e.stamp;
+        serow::toPose(rel_LFLegPose_msg.pose, e.pbLF, e.qbLF);
+        publishMsg(rel_LFLegPose_pub, rel_LFLegPose_ptr, rel_LFLegPose_msg);
 
+        rel_LHLegPose_msg.header.stamp = e.stamp;
+        serow::toPose(rel_LHLegPose_msg.pose, e.pbLH, e.qbLH);
+        publishMsg(rel_LHLegPose_pub, rel_LHLegPose_ptr, rel_LHLegPose_msg);
 
+        rel_RFLegPose_msg.header.stamp = e.stamp;
+        serow::toPose(rel_RFLegPose_msg.pose, e.pbRF, e.qbRF);
+        publishMsg(rel_RFLegPose_pub, rel_RFLegPose_ptr, rel_RFLegPose_msg);
 
-    RHLeg_odom_msg.child_frame_id = RHfoot_frame;
-    RHLeg_odom_msg.header.stamp = ros::Time::now();
-    RHLeg_odom_msg.header.frame_id = "odom";
-    RHLeg_odom_msg.pose.pose.position.x = TwRH.translation()(0);
-    RHLeg_odom_msg.pose.pose.position.y = TwRH.translation()(1);
-    RHLeg_odom_msg.pose.pose.position.z = TwRH.translation()(2);
-    RHLeg_odom_msg.pose.pose.orientation.x = qwRH.x();
-    RHLeg_odom_msg.pose.pose.orientation.y = qwRH.y();
-    RHLeg_odom_msg.pose.pose.orientation.z = qwRH.z();
-    RHLeg_odom_msg.pose.pose.orientation.w = qwRH.w();
-    RHLeg_odom_msg.twist.twist.linear.x = vwRH(0);
-    RHLeg_odom_msg.twist.twist.linear.y = vwRH(1);
-    RHLeg_odom_msg.twist.twist.linear.z = vwRH(2);
-    RHLeg_odom_msg.twist.twist.angular.x = omegawRH(0);
-    RHLeg_odom_msg.twist.twist.angular.y = omegawRH(1);
-    RHLeg_odom_msg.twist.twist.angular.z = omegawRH(2);
-    RHLeg_odom_pub.publish(RHLeg_odom_msg);
-
+        rel_RHLegPose_msg.header.stamp = e.stamp;
+        serow::toPose(rel_RHLegPose_msg.pose, e.pbRH, e.qbRH);
+        publishMsg(rel_RHLegPose_pub, rel_RHLegPose_ptr, rel_RHLegPose_msg);
+    }
+}
 
-    if (debug_mode)
-    {
-        temp_pose_msg.pose.position.x = TbLF.translation()(0);
-        temp_pose_msg.pose.position.y = TbLF.translation()(1);
-        temp_pose_msg.pose.position.z = TbLF.translation()(2);
-        temp_pose_msg.pose.orientation.x = qbLF.x();
-        temp_pose_msg.pose.orientation.y = qbLF.y();
-        temp_pose_msg.pose.orientation.z = qbLF.z();
-        temp_pose_msg.pose.orientation.w = qbLF.w();
-        temp_pose_msg.header.stamp = ros::Time::now();
-        temp_pose_msg.header.frame_id = base_link_frame;
-        rel_LFLegPose_pub.publish(temp_pose_msg);
-
-
-        temp_pose_msg.pose.position.x = TbLH.translation()(0);
-        temp_pose_msg.pose.position.y = TbLH.translation()(1);
-        temp_pose_msg.pose.position.z = TbLH.translation()(2);
-        temp_pose_msg.pose.orientation.x = qbLH.x();
-        temp_pose_msg.pose.orientation.y = qbLH.y();
-        temp_pose_msg.pose.orientation.z = qbLH.z();
-        temp_pose_msg.pose.orientation.w = qbLH.w();
-        temp_pose_msg.header.stamp = ros::Time::now();
-        temp_pose_msg.header.frame_id = base_link_frame;
-        rel_LHLegPose_pub.publish(temp_pose_msg);
-
-
-        temp_pose_msg.pose.position.x = TbRF.translation()(0);
-        temp_pose_msg.pose.position.y = TbRF.translation()(1);
-        temp_pose_msg.pose.position.z = TbRF.translation()(2);
-        temp_pose_msg.pose.orientation.x = qbRF.x();
-        temp_pose_msg.pose.orientation.y = qbRF.y();
-        temp_pose_msg.pose.orientation.z = qbRF.z();
-        temp_pose_msg.pose.orientation.w = qbRF.w();
-        temp_pose_msg.header.stamp = ros::Time::now();
-        temp_pose_msg.header.frame_id = base_link_frame;
-        rel_RFLegPose_pub.publish(temp_pose_msg);
-
-        temp_pose_msg.pose.position.x = TbRH.translation()(0);
-        temp_pose_msg.pose.position.y = TbRH.translation()(1);
-        temp_pose_msg.pose.position.z = TbRH.translation()(2);
-        temp_pose_msg.pose.orientation.x = qbRH.x();
-        temp_pose_msg.pose.orientation.y = qbRH.y();
-        temp_pose_msg.pose.orientation.z = qbRH.z();
-        temp_pose_msg.pose.orientation.w = qbRH.w();
-        temp_pose_msg.header.stamp = ros::Time::now();
-        temp_pose_msg.header.frame_id = base_link_frame;
-        rel_RHLegPose_pub.publish(temp_pose_msg);
-
-    }
-}
-
-void quadruped_ekf::publishContact()
-{
-    support_leg_msg.data = support_leg;
-    support_leg_pub.publish(support_leg_msg);
+void quadruped_ekf::publishContact(const QuadrupedEstimate &e)
+{
+    support_leg_msg.data = e.support_leg;
+    publishMsg(support_leg_pub, support_leg_ptr, support_leg_msg);
 }
@@ -0,0 +1,234 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Heap allocation check of the estimator steps
+ * @author Stylianos Piperakis
+ * @details runs the predict/update steps of IMUEKF, IMUinEKF, IMUinEKFQuad and CoMEKF, and with a URDF the
+ * kinematics of the given frames, on synthetic inputs and counts the heap allocations after a warm-up, so the
+ * rt_mode guarantee is checked without ROS. Exits non-zero on any allocation. Built with -DSEROW_ALLOCATION_TRACKING=ON.
+ * usage: serow_allocation_check [steps, default 1000] [model.urdf frame [frame ...]]
+ */
+
+#include <serow/AllocationCounter.h>
+#include <serow/IMUEKF.h>
+#include <serow/IMUinEKF.h>
+#include <serow/IMUinEKFQuad.h>
+#include <serow/CoMEKF.h>
+#include <serow/NoiseParameters.h>
+#include <serow/robotDyn.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+using namespace Eigen;
+
+/// Steps before the counting starts, the first cycles may size buffers
+static const int warmup = 100;
+
+static serow::ImuNoiseParams noise()
+{
+    serow::ImuNoiseParams p;
+    for (int j = 0; j < 3; j++)
+    {
+        p.acc_q[j] = 0.04;
+        p.gyr_q[j] = 0.01;
+        p.accb_q[j] = 1e-3;
+        p.gyrb_q[j] = 1e-4;
+        p.foot_contact[j] = 0.1;
+        p.odom_p[j] = 0.05;
+        p.odom_a[j] = 0.05;
+        p.leg_odom_p[j] = 0.01;
+        p.leg_odom_a[j] = 0.01;
+        p.vel_p[j] = 0.02;
+    }
+    p.mahalanobis_TH = -1;
+    return p;
+}
+
+/// IMU sample of a slow random rotation, gravity plus noise on the specific force
+static void imu(Vector3d &omega, Vector3d &f)
+{
+    omega = 0.5 * Vector3d::Random();
+    f = Vector3d(0, 0, 9.80) + 0.2 * Vector3d::Random();
+}
+
+/** @fn bool check(const char *name, int steps, Step step)
+ *  @brief runs step(k) warmup + steps times and reports the allocations of the last steps
+*/
+template <typename Step>
+static bool check(const char *name, int steps, Step step)
+{
+    for (int k = 0; k < warmup; k++)
+        step(k);
+    unsigned long start = serow::allocationCount();
+    for (int k = warmup; k < warmup + steps; k++)
+        step(k);
+    unsigned long n = serow::allocationCount() - start;
+    std::cout << std::left << std::setw(28) << name << std::right << std::setw(8) << n << " allocation(s) in " << steps
+              << " steps" << (n ? "  FAILED" : "") << std::endl;
+    return n == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const int steps = argc > 1 ? std::atoi(argv[1]) : 1000;
+    if (steps <= 0 || argc == 3)
+    {
+        std::cerr << "usage: serow_allocation_check [steps] [model.urdf frame [frame ...]]" << std::endl;
+        return 2;
+    }
+    if (!serow::allocationTrackingAvailable())
+    {
+        std::cerr << "allocation tracking not compiled in, build with -DSEROW_ALLOCATION_TRACKING=ON" << std::endl;
+        return 2;
+    }
+    const double dt = 0.005;
+    const Matrix3d Q = 1e-4 * Matrix3d::Identity();
+    bool ok = true;
+
+    //The filters report on init()
+    std::cout.setstate(std::ios::failbit);
+    IMUEKF *ekf = new IMUEKF();
+    ekf->setdt(dt);
+    ekf->init();
+    serow::applyImuNoise(*ekf, noise());
+    ekf->mahalanobis_TH = -1;
+    IMUinEKF *iekf = new IMUinEKF();
+    iekf->setdt(dt);
+    iekf->init();
+    serow::applyImuNoise(*iekf, noise());
+    serow::applyContactNoise(*iekf, noise());
+    iekf->setRightContact(Vector3d(0, -0.1, -0.5));
+    iekf->setLeftContact(Vector3d(0, 0.1, -0.5));
+    IMUinEKFQuad *qekf = new IMUinEKFQuad();
+    qekf->setdt(dt);
+    qekf->init();
+    serow::applyImuNoise(*qekf, noise());
+    serow::applyContactNoise(*qekf, noise());
+    qekf->setRightFrontContact(Vector3d(0.3, -0.15, -0.4));
+    qekf->setRightHindContact(Vector3d(-0.3, -0.15, -0.4));
+    qekf->setLeftFrontContact(Vector3d(0.3, 0.15, -0.4));
+    qekf->setLeftHindContact(Vector3d(-0.3, 0.15, -0.4));
+    CoMEKF *com = new CoMEKF();
+    com->init();
+    com->setdt(dt);
+    com->setParams(30.0, 0.5, 0.5, 9.80);
+    com->setCoMPos(Vector3d(0, 0, 0.8));
+    com->setCoMExternalForce(Vector3d::Zero());
+    com->firstrun = false;
+    std::cout.clear();
+
+    ok &= check("IMUEKF", steps, [&](int k) {
+        Vector3d omega, f;
+        imu(omega, f);
+        ekf->predict(omega, f);
+        Vector3d p = ekf->x.segment<3>(6) + 0.01 * Vector3d::Random();
+        Quaterniond q(ekf->Rib * serow::lie::expSO3(0.01 * Vector3d::Random()));
+        if (k % 5 == 0)
+            ekf->updateWithOdom(p, q, true);
+        else
+            ekf->updateWithLegOdom(p, q);
+        ekf->updateWithTwist(ekf->Rib * ekf->x.segment<3>(0) + 0.01 * Vector3d::Random());
+        if (k % 50 == 0)
+            ekf->updateWithGyroBias(ekf->x.segment<3>(9), Q);
+    });
+
+    ok &= check("IMUinEKF", steps, [&](int k) {
+        Vector3d omega, f;
+        imu(omega, f);
+        const Vector3d pR(0, -0.1, -0.5), pL(0, 0.1, -0.5);
+        const Matrix3d R = serow::lie::expSO3(0.05 * Vector3d::Random());
+        int cR = k % 4 != 0, cL = k % 4 != 2;
+        iekf->predict(omega, f, pR, pL, R, R, cR, cL);
+        iekf->updateWithContacts(pR, pL, Q, Q, cR, cL, 0.9, 0.9);
+        if (k % 5 == 0)
+            iekf->updateWithOdom(iekf->pwb + 0.01 * Vector3d::Random(), Quaterniond(iekf->Rib));
+        if (k % 50 == 0)
+            iekf->updateWithGyroBias(iekf->bgyr, Q);
+    });
+
+    ok &= check("IMUinEKFQuad", steps, [&](int k) {
+        Vector3d omega, f;
+        imu(omega, f);
+        const Vector3d pRF(0.3, -0.15, -0.4), pRH(-0.3, -0.15, -0.4), pLF(0.3, 0.15, -0.4), pLH(-0.3, 0.15, -0.4);
+        const Matrix3d R = serow::lie::expSO3(0.05 * Vector3d::Random());
+        int c = k % 2;
+        qekf->predict(omega, f, pRF, pRH, pLF, pLH, R, R, R, R, c, !c, !c, c);
+        qekf->updateWithContacts(pRF, pRH, pLF, pLH, Q, Q, Q, Q, c, !c, !c, c, 0.9, 0.9, 0.9, 0.9);
+        if (k % 50 == 0)
+            qekf->updateWithGyroBias(qekf->bgyr, Q);
+    });
+
+    ok &= check("CoMEKF", steps, [&](int) {
+        Vector3d cop = 0.05 * Vector3d::Random();
+        cop(2) = 0;
+        com->predict(cop, Vector3d(0, 0, 30.0 * 9.80) + Vector3d::Random(), 0.01 * Vector3d::Random());
+        com->update(Vector3d(0, 0, 9.80) + 0.1 * Vector3d::Random(), Vector3d(0, 0, 0.8) + 0.01 * Vector3d::Random(),
+                    0.1 * Vector3d::Random(), 0.1 * Vector3d::Random());
+    });
+
+    if (argc > 3)
+    {
+        std::vector<std::string> frames(argv + 3, argv + argc);
+        serow::robotDyn *rd = new serow::robotDyn(argv[2], false);
+        rd->mapJointNames(rd->jointNames());
+        const int nj = rd->jointNames().size();
+        VectorXd q = VectorXd::Zero(nj), qdot = VectorXd::Zero(nj);
+        double acc = 0.0;
+        //As computeKinTFs queries the feet and the CoM
+        ok &= check("robotDyn kinematics", steps, [&](int) {
+            q.setRandom();
+            qdot.setRandom();
+            rd->updateJointConfig(q, qdot, 0.01);
+            acc += rd->comPosition()(0);
+            for (unsigned int i = 0; i < frames.size(); i++)
+            {
+                acc += rd->linkPosition(frames[i])(0) + rd->linkOrientation(frames[i]).w();
+                acc += rd->getLinearVelocity(frames[i])(0) + rd->getAngularVelocity(frames[i])(0);
+                acc += rd->getLinearVelocityNoise(frames[i])(0) + rd->getAngularVelocityNoise(frames[i])(0);
+            }
+        });
+        if (acc != acc)
+            std::cerr << "NaN in the kinematics" << std::endl;
+        delete rd;
+    }
+
+    delete ekf;
+    delete iekf;
+    delete qekf;
+    delete com;
+    if (!ok)
+    {
+        std::cerr << "Heap allocations in the estimator steps" << std::endl;
+        return 1;
+    }
+    std::cout << "No heap allocations" << std::endl;
+    return 0;
+}
@@ -0,0 +1,804 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Micro-benchmark of the leg odometry
+ * @author Stylianos Piperakis
+ * @details times one dead reckoning cycle of the biped and the quadruped, with and without the force/torque IMVP,
+ * on a pool of random kinematic and force/torque inputs, before and after LegDeadReckoning. The per-leg kernels
+ * it replaced are kept below with only the fixes of the shared kernel applied, and both must agree.
+ * Exits non-zero when they do not.
+ * usage: serow_dead_reckoning_bench [iterations, default 1000000]
+ */
+
+#include <serow/deadReckoning.h>
+#include <serow/deadReckoningQuad.h>
+#include <serow/lie.h>
+#include <serow/StageProfiler.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+using namespace Eigen;
+
+namespace serow
+{
+namespace previous
+{
+//The biped and quadruped leg odometry before LegDeadReckoning, GEM and unused getters left out. Fixed as in the
+//shared kernel: the biped body velocity is weighted once, the quadruped takes the RF/RH joint velocities for the
+//RF/RH body velocities, its pb arguments are ordered LF, LH, RF, RH and Tm3 is computed after g is set
+
+class deadReckoning
+{
+  private:
+    double Tm, Tm2, ef, wl, wr, mass, g, freq, GRF, Tm3, alpha1, alpha3;
+    Eigen::Matrix3d C1l, C2l, C1r, C2r;
+    Eigen::Vector3d RpRm, LpLm, RpRmb, LpLmb;
+
+    Eigen::Vector3d pwr, pwl, pwb, pwb_;
+    Eigen::Vector3d vwr, vwl, vwb, vwb_r, vwb_l;
+    Eigen::Matrix3d Rwr, Rwl, vwb_cov;
+    Eigen::Vector3d pwl_, pwr_;
+    Eigen::Vector3d pb_l, pb_r;
+    Eigen::Matrix3d Rwl_, Rwr_;
+    Eigen::Vector3d vwbKCFS;
+    Eigen::Vector3d Lomega, Romega;
+    Eigen::Vector3d omegawl, omegawr;
+
+    Eigen::Matrix3d AL, AR, wedgerf, wedgelf, RRpRm, RLpLm;
+    Eigen::Vector3d bL, bR, plf, prf; //FT w.r.t Foot Frame;
+    bool firstrun;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    deadReckoning(Eigen::Vector3d pwl0, Eigen::Vector3d pwr0, Eigen::Matrix3d Rwl0, Eigen::Matrix3d Rwr0,
+                  double mass_, double alpha1_ = 1.0, double alpha3_ = 0.01, double freq_ = 100.0, double g_ = 9.81,
+                  Eigen::Vector3d plf_ = Eigen::Vector3d::Zero(), Eigen::Vector3d prf_ = Eigen::Vector3d::Zero())
+    {
+        firstrun = true;
+        vwb_cov = Eigen::Matrix3d::Zero();
+        vwb_l = Eigen::Vector3d::Zero();
+        vwb_r = Eigen::Vector3d::Zero();
+
+        pwl_ = pwl0;
+        pwr_ = pwr0;
+        Rwl_ = Rwl0;
+        Rwr_ = Rwr0;
+        Rwl = Rwl_;
+        Rwr = Rwr_;
+        pwl = pwl_;
+        pwr = pwr_;
+        pwb_ = Eigen::Vector3d::Zero();
+        pwb = pwb_;
+        freq = freq_;
+        mass = mass_;
+        //Joint Freq
+        Tm = 1.0 / freq;
+        Tm2 = Tm * Tm;
+        ef = 0.1;
+        g = g_;
+        C1l = Eigen::Matrix3d::Zero();
+        C2l = Eigen::Matrix3d::Zero();
+        C1r = Eigen::Matrix3d::Zero();
+        C2r = Eigen::Matrix3d::Zero();
+
+        Lomega = Eigen::Vector3d::Zero();
+        Romega = Eigen::Vector3d::Zero();
+        vwb = Eigen::Vector3d::Zero();
+        pb_l = Eigen::Vector3d::Zero();
+        pb_r = Eigen::Vector3d::Zero();
+        vwbKCFS = Eigen::Vector3d::Zero();
+        plf = plf_;
+        prf = prf_;
+        RpRm = prf;
+        LpLm = plf;
+        alpha1 = alpha1_;
+        alpha3 = alpha3_;
+        Tm3 = (mass * mass * g * g) * Tm2;
+
+    }
+    Eigen::Vector3d getOdom()
+    {
+        return pwb;
+    }
+    Eigen::Vector3d getLinearVel()
+    {
+        return vwb;
+    }
+
+    void computeBodyVelKCFS(Eigen::Matrix3d Rwb, Eigen::Vector3d omegawb, Eigen::Vector3d pbl, Eigen::Vector3d pbr,
+                            Eigen::Vector3d vbl, Eigen::Vector3d vbr, double wl_, double wr_)
+    {
+
+        //vwb_l.noalias() = -lie::skew(omegab)  * pbl - vbl;
+        //vwb_l =  Rwb * vwb_l;
+        //vwb_r.noalias() = -lie::skew(omegab)  * pbr - vbr;
+        //vwb_r =  Rwb * vwb_r;
+
+        vwb_l = -lie::skew(omegawb) * Rwb * pbl - Rwb * vbl;
+        vwb_r = -lie::skew(omegawb) * Rwb * pbr - Rwb * vbr;
+
+        vwb = wl_ * vwb_l;
+        vwb += wr_ * vwb_r;
+    }
+
+    Eigen::Matrix3d getVelocityCovariance()
+    {
+
+        return vwb_cov;
+    }
+
+    void computeLegKCFS(Eigen::Matrix3d Rwb, Eigen::Matrix3d Rbl, Eigen::Matrix3d Rbr, Eigen::Vector3d omegawb, Eigen::Vector3d omegabl, Eigen::Vector3d omegabr,
+                        Eigen::Vector3d pbl, Eigen::Vector3d pbr, Eigen::Vector3d vbl, Eigen::Vector3d vbr)
+    {
+        Rwl = Rwb * Rbl;
+        Rwr = Rwb * Rbr;
+        omegawl = omegawb + Rwb * omegabl;
+        omegawr = omegawb + Rwb * omegabr;
+
+        vwl = vwb + lie::skew(omegawb) * Rwb * pbl + Rwb * vbl;
+        vwr = vwb + lie::skew(omegawb) * Rwb * pbr + Rwb * vbr;
+    }
+
+    void computeIMVP()
+    {
+        Lomega = Rwl.transpose() * omegawl;
+        Romega = Rwr.transpose() * omegawr;
+
+        double temp = Tm2 / (Lomega.squaredNorm() * Tm2 + 1.0);
+
+        C1l = temp * lie::skew(Lomega);
+        C2l = temp * (Lomega * Lomega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+
+        temp = Tm2 / (Romega.squaredNorm() * Tm2 + 1.0);
+
+        C1r = temp * lie::skew(Romega);
+        C2r = temp * (Romega * Romega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+
+        //IMVP Computations
+        LpLm = C2l * LpLm;
+
+        LpLm = LpLm + C1l * Rwl.transpose() * vwl;
+
+        RpRm = C2r * RpRm;
+
+        RpRm = RpRm + C1r * Rwr.transpose() * vwr;
+    }
+    void computeIMVPFT(Eigen::Vector3d lf, Eigen::Vector3d rf, Eigen::Vector3d lt, Eigen::Vector3d rt)
+    {
+        Lomega = Rwl.transpose() * omegawl;
+        Romega = Rwr.transpose() * omegawr;
+
+        wedgerf = lie::skew(rf);
+        wedgelf = lie::skew(lf);
+
+        AL.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AL.noalias() -= alpha1 * lie::skew(Lomega) * lie::skew(Lomega);
+        AL.noalias() -= alpha3 / Tm3 * wedgelf * wedgelf;
+
+        bL.noalias() = 1.0 / Tm2 * LpLm;
+        bL.noalias() += alpha1 * lie::skew(Lomega) * Rwl.transpose() * vwl;
+        bL.noalias() += alpha3 / Tm3 * (wedgelf * lt - wedgelf * wedgelf * plf);
+
+        LpLm.noalias() = AL.inverse() * bL;
+
+        AR.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AR.noalias() -= alpha1 * lie::skew(Romega) * lie::skew(Romega);
+        AR.noalias() -= alpha3 / Tm3 * wedgerf * wedgerf;
+
+        bR.noalias() = 1.0 / Tm2 * RpRm;
+        bR.noalias() += alpha1 * lie::skew(Romega) * Rwr.transpose() * vwr;
+        bR.noalias() += alpha3 / Tm3 * (wedgerf * rt - wedgerf * wedgerf * prf);
+
+        RpRm.noalias() = AR.inverse() * bR;
+
+    }
+
+    void computeDeadReckoning(Eigen::Matrix3d Rwb, Eigen::Matrix3d Rbl, Eigen::Matrix3d Rbr,
+                              Eigen::Vector3d omegawb, Eigen::Vector3d bomegab,
+                              Eigen::Vector3d pbl, Eigen::Vector3d pbr,
+                              Eigen::Vector3d vbl, Eigen::Vector3d vbr,
+                              Eigen::Vector3d omegabl, Eigen::Vector3d omegabr,
+                              double lfz, double rfz,  Eigen::Vector3d lf, Eigen::Vector3d rf, Eigen::Vector3d lt, Eigen::Vector3d rt)
+    {
+
+        //Compute Body position
+        //Cropping the vertical GRF
+        lfz = cropGRF(lfz);
+        rfz = cropGRF(rfz);
+        //GRF Coefficients
+        wl = (lfz + ef) / (lfz + rfz + 2.0 * ef);
+        wr = (rfz + ef) / (lfz + rfz + 2.0 * ef);
+
+        computeBodyVelKCFS(Rwb, omegawb, pbl, pbr, vbl, vbr, wl, wr);
+
+        computeLegKCFS(Rwb, Rbl, Rbr, omegawb, omegabl, omegabr, pbl, pbr, vbl, vbr);
+
+        if(alpha3>0)
+            computeIMVPFT(lf, rf, lt, rt);
+        else
+            computeIMVP();
+
+        //Temp estimate of Leg position w.r.t Inertial Frame
+        pwl = pwl_ - Rwl * LpLm + Rwl_ * LpLm;
+        pwr = pwr_ - Rwr * RpRm + Rwr_ * RpRm;
+
+        //Leg odometry with left foot
+        pb_l = pwl - Rwb * pbl;
+        //Leg odometry with right foot
+        pb_r = pwr - Rwb * pbr;
+
+        //Leg Odometry Estimate
+        pwb_ = pwb;
+        pwb = wl * pb_l + wr * pb_r;
+        //Leg Position Estimate w.r.t Inertial Frame
+        pwl += pwb - pb_l;
+        pwr += pwb - pb_r;
+
+        RpRmb =  pbr;
+        LpLmb =  pbl;
+
+        // RpRmb =  Rwb.transpose()*(pwr-pwb);
+        // LpLmb =  Rwb.transpose()*(pwl-pwb);
+        RLpLm = Rbl;
+        RRpRm = Rbr;
+
+        //Needed in the next iteration
+        Rwl_ = Rwl;
+        Rwr_ = Rwr;
+        pwl_ = pwl;
+        pwr_ = pwr;
+        if (!firstrun)
+            vwb = (pwb - pwb_) * freq;
+        else
+            firstrun = false;
+
+        vwb_cov.noalias() =  wl * (vwb_l - vwb) * (vwb_l - vwb).transpose();
+        vwb_cov.noalias() += wr * (vwb_r - vwb) * (vwb_r - vwb).transpose();
+
+    }
+
+    double cropGRF(double f_)
+    {
+        return std::max(0.0, std::min(f_, mass * g));
+    }
+};
+
+class deadReckoningQuad
+{
+  private:
+    double Tm, Tm2, ef, wLF, wLH, wRF, wRH, mass, g, freq, Tm3, alpha1, alpha3;
+    Eigen::Matrix3d C1l, C2l, C1r, C2r;
+    Eigen::Vector3d RFpRm, RHpRm, LFpLm, LHpLm, LFpLmb,  RHpRmb, LHpLmb, RFpRmb;
+    Eigen::Vector3d pwRF, pwRH, pwLF, pwLH, pwb, pwb_;
+    Eigen::Vector3d vwRF, vwRH, vwLF, vwLH, vwb, vwb_RF, vwb_RH, vwb_LF, vwb_LH;
+    Eigen::Matrix3d RwRF, RwRH, RwLF, RwLH, vwb_cov;
+    Eigen::Vector3d pwLF_, pwLH_, pwRF_, pwRH_;
+    Eigen::Vector3d pb_LF, pb_RF, pb_LH, pb_RH;
+    Eigen::Matrix3d RwLF_, RwLH_, RwRF_, RwRH_;
+    Eigen::Vector3d vwbKCFS;
+    Eigen::Vector3d LFomega, LHomega, RFomega, RHomega;
+    Eigen::Vector3d omegawLH, omegawRH, omegawLF, omegawRF;
+
+    Eigen::Matrix3d AL, AR, wedgeLFf, wedgeLHf, wedgeRHf, wedgeRFf, RRFpRm, RRHpRm, RLFpLm, RLHpLm;
+    Eigen::Vector3d bL, bR, pLFf, pLHf, pRFf, pRHf; //FT w.r.t Foot Frame;
+    bool firstrun;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    deadReckoningQuad(Eigen::Vector3d pwLF0, Eigen::Vector3d pwLH0, Eigen::Vector3d pwRF0, Eigen::Vector3d pwRH0,
+                  Eigen::Matrix3d RwLF0, Eigen::Matrix3d RwLH0, Eigen::Matrix3d RwRF0, Eigen::Matrix3d RwRH0,
+                  double mass_, double alpha1_ = 1.0, double alpha3_ = 0.01, double freq_ = 100.0, double g_ = 9.81,
+                  Eigen::Vector3d pLFf_ = Eigen::Vector3d::Zero(),  Eigen::Vector3d pLHf_ = Eigen::Vector3d::Zero(),
+                  Eigen::Vector3d pRFf_ = Eigen::Vector3d::Zero(), Eigen::Vector3d pRHf_ = Eigen::Vector3d::Zero())
+    {
+        firstrun = true;
+        vwb_cov = Eigen::Matrix3d::Zero();
+        vwb_LF = Eigen::Vector3d::Zero();
+        vwb_RF = Eigen::Vector3d::Zero();
+        vwb_LH = Eigen::Vector3d::Zero();
+        vwb_RH = Eigen::Vector3d::Zero();
+
+        pwLF_ = pwLF0;
+        pwLH_ = pwLH0;
+        pwRH_ = pwRH0;
+        pwRF_ = pwRF0;
+
+        RwLF_ = RwLF0;
+        RwLH_ = RwLH0;
+
+        RwRF_ = RwRF0;
+        RwRH_ = RwRH0;
+
+        pwLF = pwLF0;
+        pwLH = pwLH0;
+        pwRH = pwRH0;
+        pwRF = pwRF0;
+
+        RwLF = RwLF0;
+        RwLH = RwLH0;
+
+        RwRF = RwRF0;
+        RwRH = RwRH0;
+
+        pwb_ = Eigen::Vector3d::Zero();
+        pwb = pwb_;
+        freq = freq_;
+        mass = mass_;
+        //Joint Freq
+        Tm = 1.0 / freq;
+        Tm2 = Tm * Tm;
+        g = g_;
+        Tm3 = (mass * mass * g * g) * Tm2;
+        ef = 0.1;
+
+        C1l = Eigen::Matrix3d::Zero();
+        C2l = Eigen::Matrix3d::Zero();
+        C1r = Eigen::Matrix3d::Zero();
+        C2r = Eigen::Matrix3d::Zero();
+
+        LFomega = Eigen::Vector3d::Zero();
+        RFomega = Eigen::Vector3d::Zero();
+
+        LHomega = Eigen::Vector3d::Zero();
+        RHomega = Eigen::Vector3d::Zero();
+        vwb = Eigen::Vector3d::Zero();
+        pb_LF = Eigen::Vector3d::Zero();
+        pb_RF = Eigen::Vector3d::Zero();
+        pb_LH = Eigen::Vector3d::Zero();
+        pb_RH = Eigen::Vector3d::Zero();
+        vwbKCFS = Eigen::Vector3d::Zero();
+        pLFf = pLFf_;
+        pRFf = pRFf_;
+        pLHf = pLHf_;
+        pRHf = pRHf_;
+
+        RFpRm = pRFf;
+        LFpLm = pLFf;
+        RHpRm = pRHf;
+        LHpLm = pLHf;
+
+        alpha1 = alpha1_;
+        alpha3 = alpha3_;
+
+    }
+    Eigen::Vector3d getOdom()
+    {
+        return pwb;
+    }
+    Eigen::Vector3d getLinearVel()
+    {
+        return vwb;
+    }
+
+    void computeBodyVelKCFS(Eigen::Matrix3d Rwb, Eigen::Vector3d omegab, Eigen::Vector3d pbLF, Eigen::Vector3d pbLH,
+                            Eigen::Vector3d pbRF, Eigen::Vector3d pbRH,
+                            Eigen::Vector3d vbLF, Eigen::Vector3d vbLH,
+                            Eigen::Vector3d vbRF, Eigen::Vector3d vbRH,
+                            double wLF_, double wLH_, double wRF_, double wRH_)
+    {
+
+        vwb_LF.noalias() = -lie::skew(omegab)  * pbLF - vbLF;
+        vwb_LF =  Rwb * vwb_LF;
+        vwb_LH.noalias() = -lie::skew(omegab)  * pbLH - vbLH;
+        vwb_LH =  Rwb * vwb_LH;
+
+        vwb_RF.noalias() = -lie::skew(omegab)  * pbRF - vbRF;
+        vwb_RF =  Rwb * vwb_RF;
+        vwb_RH.noalias() = -lie::skew(omegab)  * pbRH - vbRH;
+        vwb_RH =  Rwb * vwb_RH;
+
+        vwb  = wLF_ * vwb_LF;
+        vwb += wLH_ * vwb_LH;
+        vwb += wRF_ * vwb_RF;
+        vwb += wRH_ * vwb_RH;
+
+    }
+
+    Eigen::Matrix3d getVelocityCovariance()
+    {
+
+        return vwb_cov;
+    }
+
+    void computeLegKCFS(Eigen::Matrix3d Rwb, Eigen::Matrix3d RbLF, Eigen::Matrix3d RbLH, Eigen::Matrix3d RbRF, Eigen::Matrix3d RbRH,
+                        Eigen::Vector3d omegawb, Eigen::Vector3d omegabLF, Eigen::Vector3d omegabLH, Eigen::Vector3d omegabRF, Eigen::Vector3d omegabRH,
+                        Eigen::Vector3d pbLF, Eigen::Vector3d pbLH, Eigen::Vector3d pbRF, Eigen::Vector3d pbRH,
+                        Eigen::Vector3d vbLF, Eigen::Vector3d vbLH, Eigen::Vector3d vbRF, Eigen::Vector3d vbRH)
+    {
+        RwLF = Rwb * RbLF;
+        RwLH = Rwb * RbLH;
+        RwRF = Rwb * RbRF;
+        RwRH = Rwb * RbRH;
+
+        omegawLF = omegawb + Rwb * omegabLF;
+        omegawLH = omegawb + Rwb * omegabLH;
+
+        omegawRF = omegawb + Rwb * omegabRF;
+        omegawRH = omegawb + Rwb * omegabRH;
+
+        vwLH = vwb + lie::skew(omegawb) * Rwb * pbLH + Rwb * vbLH;
+        vwLF = vwb + lie::skew(omegawb) * Rwb * pbLF + Rwb * vbLF;
+
+        vwRF = vwb + lie::skew(omegawb) * Rwb * pbRF + Rwb * vbRF;
+        vwRH = vwb + lie::skew(omegawb) * Rwb * pbRH + Rwb * vbRH;
+
+    }
+
+    void computeIMVP()
+    {
+        LFomega = RwLF.transpose() * omegawLF;
+        LHomega = RwLH.transpose() * omegawLH;
+
+        RFomega = RwRF.transpose() * omegawRF;
+        RHomega = RwRH.transpose() * omegawRH;
+
+        double temp = Tm2 / (LFomega.squaredNorm() * Tm2 + 1.0);
+        C1l = temp * lie::skew(LFomega);
+        C2l = temp * (LFomega * LFomega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+        //IMVP Computations
+        LFpLm = C2l * LFpLm;
+        LFpLm = LFpLm + C1l * RwLF.transpose() * vwLF;
+
+        temp = Tm2 / (LHomega.squaredNorm() * Tm2 + 1.0);
+        C1l = temp * lie::skew(LHomega);
+        C2l = temp * (LHomega * LHomega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+        //IMVP Computations
+        LHpLm = C2l * LHpLm;
+        LHpLm = LHpLm + C1l * RwLH.transpose() * vwLH;
+
+        temp = Tm2 / (RFomega.squaredNorm() * Tm2 + 1.0);
+        C1r = temp * lie::skew(RFomega);
+        C2r = temp * (RFomega * RFomega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+        RFpRm = C2r * RFpRm;
+        RFpRm = RFpRm + C1r * RwRF.transpose() * vwRF;
+
+        temp = Tm2 / (RHomega.squaredNorm() * Tm2 + 1.0);
+        C1r = temp * lie::skew(RHomega);
+        C2r = temp * (RHomega * RHomega.transpose() + 1.0 / Tm2 * Matrix3d::Identity());
+        RHpRm = C2r * RHpRm;
+        RHpRm = RHpRm + C1r * RwRH.transpose() * vwRH;
+    }
+
+    void computeIMVPFT(Eigen::Vector3d LFf, Eigen::Vector3d LHf, Eigen::Vector3d RFf, Eigen::Vector3d RHf,
+                       Eigen::Vector3d LFt, Eigen::Vector3d LHt, Eigen::Vector3d RFt, Eigen::Vector3d RHt)
+    {
+        LFomega = RwLF.transpose() * omegawLF;
+        LHomega = RwLH.transpose() * omegawLH;
+        RFomega = RwRF.transpose() * omegawRF;
+        RHomega = RwRH.transpose() * omegawRH;
+
+        wedgeLFf = lie::skew(LFf);
+        wedgeLHf = lie::skew(LHf);
+        wedgeRFf = lie::skew(RFf);
+        wedgeRHf = lie::skew(RHf);
+
+        //LF
+        AL.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AL.noalias() -= alpha1 * lie::skew(LFomega) * lie::skew(LFomega);
+        AL.noalias() -= alpha3 / Tm3 * wedgeLFf * wedgeLFf;
+
+        bL.noalias() = 1.0 / Tm2 * LFpLm;
+        bL.noalias() += alpha1 * lie::skew(LFomega) * RwLF.transpose() * vwLF;
+        bL.noalias() += alpha3 / Tm3 * (wedgeLFf * LFt - wedgeLFf * wedgeLFf * pLFf);
+
+        LFpLm.noalias() = AL.inverse() * bL;
+
+        //LH
+        AL.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AL.noalias() -= alpha1 * lie::skew(LHomega) * lie::skew(LHomega);
+        AL.noalias() -= alpha3 / Tm3 * wedgeLHf * wedgeLHf;
+
+        bL.noalias() = 1.0 / Tm2 * LHpLm;
+        bL.noalias() += alpha1 * lie::skew(LHomega) * RwLH.transpose() * vwLH;
+        bL.noalias() += alpha3 / Tm3 * (wedgeLHf * LHt - wedgeLHf * wedgeLHf * pLHf);
+
+        LHpLm.noalias() = AL.inverse() * bL;
+
+        //RF
+        AR.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AR.noalias() -= alpha1 * lie::skew(RFomega) * lie::skew(RFomega);
+        AR.noalias() -= alpha3 / Tm3 * wedgeRFf * wedgeRFf;
+
+        bR.noalias() = 1.0 / Tm2 * RFpRm;
+        bR.noalias() += alpha1 * lie::skew(RFomega) * RwRF.transpose() * vwRF;
+        bR.noalias() += alpha3 / Tm3 * (wedgeRFf * RFt - wedgeRFf * wedgeRFf * pRFf);
+
+        RFpRm.noalias() = AR.inverse() * bR;
+
+        //RH
+        AR.noalias() = 1.0 / Tm2 * Matrix3d::Identity();
+        AR.noalias() -= alpha1 * lie::skew(RHomega) * lie::skew(RHomega);
+        AR.noalias() -= alpha3 / Tm3 * wedgeRHf * wedgeRHf;
+
+        bR.noalias() = 1.0 / Tm2 * RHpRm;
+        bR.noalias() += alpha1 * lie::skew(RHomega) * RwRH.transpose() * vwRH;
+        bR.noalias() += alpha3 / Tm3 * (wedgeRHf * RHt - wedgeRHf * wedgeRHf * pRHf);
+
+        RHpRm.noalias() = AR.inverse() * bR;
+
+    }
+
+    void computeDeadReckoning(Eigen::Matrix3d Rwb, Eigen::Matrix3d RbLF, Eigen::Matrix3d RbLH, Eigen::Matrix3d RbRF, Eigen::Matrix3d RbRH,
+                              Eigen::Vector3d omegawb, Eigen::Vector3d bomegab,
+                              Eigen::Vector3d pbLF, Eigen::Vector3d pbLH, Eigen::Vector3d pbRF, Eigen::Vector3d pbRH,
+                              Eigen::Vector3d vbLF, Eigen::Vector3d vbLH, Eigen::Vector3d vbRF, Eigen::Vector3d vbRH,
+                              Eigen::Vector3d omegabLF, Eigen::Vector3d omegabLH, Eigen::Vector3d omegabRF, Eigen::Vector3d omegabRH,
+                              double LFfz, double LHfz, double RFfz, double RHfz,
+                              Eigen::Vector3d LFf, Eigen::Vector3d LHf, Eigen::Vector3d RFf, Eigen::Vector3d RHf,
+                              Eigen::Vector3d LFt, Eigen::Vector3d LHt, Eigen::Vector3d RFt, Eigen::Vector3d RHt )
+    {
+
+        //Compute Body position
+        //Cropping the vertical GRF
+        LFfz = cropGRF(LFfz);
+        LHfz = cropGRF(LHfz);
+        RFfz = cropGRF(RFfz);
+        RHfz = cropGRF(RHfz);
+        //GRF Coefficients
+        wLF = (LFfz + ef) / (LFfz + LHfz + RFfz + RHfz + 4.0 * ef);
+        wLH = (LHfz + ef) / (LFfz + LHfz + RFfz + RHfz + 4.0 * ef);
+        wRH = (RHfz + ef) / (LFfz + LHfz + RFfz + RHfz + 4.0 * ef);
+        wRF = (RFfz + ef) / (LFfz + LHfz + RFfz + RHfz + 4.0 * ef);
+
+        computeBodyVelKCFS(Rwb,  bomegab, pbLF,  pbLH, pbRF, pbRH, vbLF, vbLH, vbRF,  vbRH, wLF,  wLH,  wRF,  wRH);
+
+        computeLegKCFS(Rwb, RbLF, RbLH, RbRF, RbRH, omegawb, omegabLF, omegabLH, omegabRF, omegabRH, pbLF, pbLH, pbRF, pbRH, vbLF, vbLH, vbRF, vbRH);
+
+        RLFpLm = RbLF;
+        RRFpRm = RbRF;
+        RLHpLm = RbLH;
+        RRHpRm = RbRH;
+
+        if(alpha3>0)
+            computeIMVPFT(LFf, LHf, RFf, RHf, LFt, LHt,  RFt, RHt);
+        else
+            computeIMVP();
+
+        // RFpRmb = RbRF * RFpRm + pbRF;
+        // RHpRmb = RbRH * RHpRm + pbRH;
+
+        // LFpLmb = RbLF * LFpLm + pbLF;
+        // LHpLmb = RbLH * LHpLm + pbLH;
+
+        RFpRmb =  pbRF;
+        RHpRmb =  pbRH;
+        LHpLmb =  pbLH;
+        LFpLmb =  pbLF;
+
+        //Temp estimate of Leg position w.r.t Inertial Frame
+        pwLF = pwLF_ - RwLF * LFpLm + RwLF_ * LFpLm;
+        pwLH = pwLH_ - RwLH * LHpLm + RwLH_ * LHpLm;
+
+        pwRF = pwRF_ - RwRF * RFpRm + RwRF_ * RFpRm;
+        pwRH = pwRH_ - RwRH * RHpRm + RwRH_ * RHpRm;
+
+        //Leg odometry with left foot
+        pb_LF = pwLF - Rwb * pbLF;
+        pb_LH = pwLH - Rwb * pbLH;
+        //Leg odometry with right foot
+        pb_RF = pwRF - Rwb * pbRF;
+        pb_RH = pwRH - Rwb * pbRH;
+
+        //Leg Odometry Estimate
+        pwb_ = pwb;
+        pwb = wLF * pb_LF + wRF * pb_RF + wLH * pb_LH + wRH * pb_RH;
+        //Leg Position Estimate w.r.t Inertial Frame
+        pwLF += pwb - pb_LF;
+        pwLH += pwb - pb_LH;
+
+        pwRF += pwb - pb_RF;
+        pwRH += pwb - pb_RH;
+
+        //Needed in the next iteration
+        RwLF_ = RwLF;
+        RwLH_ = RwLH;
+        RwRF_ = RwRF;
+        RwRH_ = RwRH;
+
+        pwLF_ = pwLF;
+        pwRF_ = pwRF;
+        pwLH_ = pwLH;
+        pwRH_ = pwRH;
+        if (!firstrun)
+            vwb = (pwb - pwb_) * freq;
+        else
+            firstrun = false;
+
+        vwb_cov.noalias() =  wLF * (vwb_LF - vwb) * (vwb_LF - vwb).transpose();
+        vwb_cov.noalias() += wLH * (vwb_LH - vwb) * (vwb_LH - vwb).transpose();
+        vwb_cov.noalias() += wRF * (vwb_RF - vwb) * (vwb_RF - vwb).transpose();
+        vwb_cov.noalias() += wRH * (vwb_RH - vwb) * (vwb_RH - vwb).transpose();
+
+    }
+
+    double cropGRF(double f_)
+    {
+        return std::max(0.0, std::min(f_, mass * g));
+    }
+};
+
+} // namespace previous
+} // namespace serow
+
+/// Keeps the optimizer from dropping the benchmarked calls
+static volatile double sink;
+
+/// Per leg inputs of one cycle
+struct LegSample
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Matrix3d Rb;
+    Vector3d pb, vb, omegab, f, t;
+    double fz;
+};
+
+/// Inputs of one cycle
+struct Sample
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Matrix3d Rwb;
+    Vector3d omegawb, omegab;
+    LegSample leg[4];
+};
+
+template <typename Op>
+static double run(long iterations, Op op)
+{
+    double acc = 0.0;
+    uint64_t t0 = serow::monotonicNs();
+    for (long i = 0; i < iterations; i++)
+        acc += op(i);
+    double ns = (double)(serow::monotonicNs() - t0) / iterations;
+    sink = acc;
+    return ns;
+}
+
+template <class DR>
+static void stepBiped(DR &dr, const Sample &c)
+{
+    const LegSample *l = c.leg;
+    dr.computeDeadReckoning(c.Rwb, l[0].Rb, l[1].Rb, c.omegawb, c.omegab, l[0].pb, l[1].pb, l[0].vb, l[1].vb,
+                            l[0].omegab, l[1].omegab, l[0].fz, l[1].fz, l[0].f, l[1].f, l[0].t, l[1].t);
+}
+
+template <class DR>
+static void stepQuad(DR &dr, const Sample &c)
+{
+    const LegSample *l = c.leg;
+    dr.computeDeadReckoning(c.Rwb, l[0].Rb, l[1].Rb, l[2].Rb, l[3].Rb, c.omegawb, c.omegab,
+                            l[0].pb, l[1].pb, l[2].pb, l[3].pb, l[0].vb, l[1].vb, l[2].vb, l[3].vb,
+                            l[0].omegab, l[1].omegab, l[2].omegab, l[3].omegab, l[0].fz, l[1].fz, l[2].fz, l[3].fz,
+                            l[0].f, l[1].f, l[2].f, l[3].f, l[0].t, l[1].t, l[2].t, l[3].t);
+}
+
+/// Largest deviation of the odometry, the body velocity and its covariance, relative above 1
+template <class A, class B>
+static double deviation(A &a, B &b)
+{
+    double d = (a.getOdom() - b.getOdom()).cwiseAbs().maxCoeff() / std::max(1.0, a.getOdom().cwiseAbs().maxCoeff());
+    d = std::max(d, (a.getLinearVel() - b.getLinearVel()).cwiseAbs().maxCoeff() / std::max(1.0, a.getLinearVel().cwiseAbs().maxCoeff()));
+    return std::max(d, (a.getVelocityCovariance() - b.getVelocityCovariance()).cwiseAbs().maxCoeff() /
+                           std::max(1.0, a.getVelocityCovariance().cwiseAbs().maxCoeff()));
+}
+
+static void report(const char *name, double before, double after, double dev)
+{
+    std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(1) << std::setw(8) << before
+              << " ns ->" << std::setw(8) << after << " ns (" << std::setprecision(2) << before / after << "x), max deviation "
+              << std::scientific << dev << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: serow_dead_reckoning_bench [iterations]" << std::endl;
+        return 1;
+    }
+
+    //A small pool of inputs, indexed with i & mask so the loads stay in cache
+    const int pool = 64;
+    std::vector<Sample, aligned_allocator<Sample> > s(pool);
+    srand(1);
+    for (int i = 0; i < pool; i++)
+    {
+        s[i].Rwb = serow::lie::expSO3(0.2 * Vector3d::Random());
+        s[i].omegab = Vector3d::Random();
+        s[i].omegawb = s[i].Rwb * s[i].omegab;
+        for (int l = 0; l < 4; l++)
+        {
+            LegSample &leg = s[i].leg[l];
+            leg.Rb = serow::lie::expSO3(0.5 * Vector3d::Random());
+            leg.pb = Vector3d::Random() + Vector3d(0, 0, -0.5);
+            leg.vb = 0.1 * Vector3d::Random();
+            leg.omegab = Vector3d::Random();
+            leg.f = 50.0 * Vector3d::Random() + Vector3d(0, 0, 100);
+            leg.t = Vector3d::Random();
+            leg.fz = leg.f(2);
+        }
+    }
+    const int mask = pool - 1;
+    const Vector3d zero = Vector3d::Zero();
+    const Matrix3d I = Matrix3d::Identity();
+
+    //Both versions run every sample of the pool a few times from the same initial state
+    const int steps = 8 * pool;
+    const double tolerance = 1e-9;
+    bool ok = true;
+    std::cout << iterations << " iterations per cycle, previous -> LegDeadReckoning" << std::endl;
+    for (int ft = 0; ft < 2; ft++)
+    {
+        double alpha3 = ft ? 0.01 : 0.0;
+        serow::previous::deadReckoning biped0(zero, zero, I, I, 40.0, 1.0, alpha3, 100.0, 9.81);
+        serow::deadReckoning biped(zero, zero, I, I, 40.0, 1.0, alpha3, 100.0, 9.81);
+        serow::previous::deadReckoningQuad quad0(zero, zero, zero, zero, I, I, I, I, 40.0, 1.0, alpha3, 100.0, 9.81);
+        serow::deadReckoningQuad quad(zero, zero, zero, zero, I, I, I, I, 40.0, 1.0, alpha3, 100.0, 9.81);
+        double devBiped = 0, devQuad = 0;
+        for (int k = 0; k < steps; k++)
+        {
+            stepBiped(biped0, s[k & mask]);
+            stepBiped(biped, s[k & mask]);
+            stepQuad(quad0, s[k & mask]);
+            stepQuad(quad, s[k & mask]);
+            devBiped = std::max(devBiped, deviation(biped0, biped));
+            devQuad = std::max(devQuad, deviation(quad0, quad));
+        }
+        ok &= devBiped <= tolerance && devQuad <= tolerance;
+
+        double before = run(iterations, [&](long i) {
+            stepBiped(biped0, s[i & mask]);
+            return biped0.getOdom()(0);
+        });
+        double after = run(iterations, [&](long i) {
+            stepBiped(biped, s[i & mask]);
+            return biped.getOdom()(0);
+        });
+        report(ft ? "biped, FT IMVP" : "biped", before, after, devBiped);
+        before = run(iterations, [&](long i) {
+            stepQuad(quad0, s[i & mask]);
+            return quad0.getOdom()(0);
+        });
+        after = run(iterations, [&](long i) {
+            stepQuad(quad, s[i & mask]);
+            return quad.getOdom()(0);
+        });
+        report(ft ? "quadruped, FT IMVP" : "quadruped", before, after, devQuad);
+    }
+    if (!ok)
+    {
+        std::cerr << "LegDeadReckoning deviates from the previous kernels by more than " << tolerance << std::endl;
+        return 1;
+    }
+    return 0;
+}
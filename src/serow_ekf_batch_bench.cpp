@@ -0,0 +1,427 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Consistency check and throughput benchmark of IMUEKFBatch and IMUinEKFBatch
+ * @author Stylianos Piperakis
+ * @details runs IMUEKFBatch against one IMUEKF per instance on the same random IMU, leg odometry, odometry and
+ * twist inputs, and IMUinEKFBatch against one IMUinEKF per instance on random IMU and double support contact
+ * inputs, and reports the largest deviations, then times predict + leg odometry (contact) update per estimate
+ * for the scalar filters and several batch sizes on one core
+ * usage: serow_ekf_batch_bench [steps, default 2000]
+ */
+
+#include <serow/IMUEKF.h>
+#include <serow/IMUEKFBatch.h>
+#include <serow/IMUinEKF.h>
+#include <serow/IMUinEKFBatch.h>
+#include <serow/StageProfiler.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+using namespace Eigen;
+
+/// Keeps the optimizer from dropping the benchmarked calls
+static volatile double sink;
+
+static serow::ImuNoiseParams noise()
+{
+    serow::ImuNoiseParams p;
+    for (int j = 0; j < 3; j++)
+    {
+        p.acc_q[j] = 0.04;
+        p.gyr_q[j] = 0.01;
+        p.accb_q[j] = 1e-3;
+        p.gyrb_q[j] = 1e-4;
+        p.foot_contact[j] = 0.1;
+        p.odom_p[j] = 0.05;
+        p.odom_a[j] = 0.05;
+        p.leg_odom_p[j] = 0.01;
+        p.leg_odom_a[j] = 0.01;
+        p.vel_p[j] = 0.02;
+    }
+    p.mahalanobis_TH = -1;
+    return p;
+}
+
+/** @fn double consistency(int steps)
+ *  @brief largest deviation between IMUEKFBatch and IMUEKF on the same inputs, relative for the covariance
+*/
+template <int N>
+static double consistency(int steps)
+{
+    typedef typename serow::IMUEKFBatch<N>::Lanes Lanes;
+    const double dt = 0.005;
+    serow::IMUEKFBatch<N> *batch = new serow::IMUEKFBatch<N>();
+    std::vector<IMUEKF *> scalar(N);
+    batch->setdt(dt);
+    batch->init();
+    batch->setNoise(noise());
+    //IMUEKF::init() reports every instance
+    std::cout.setstate(std::ios::failbit);
+    for (int l = 0; l < N; l++)
+    {
+        scalar[l] = new IMUEKF();
+        scalar[l]->setdt(dt);
+        scalar[l]->init();
+        serow::applyImuNoise(*scalar[l], noise());
+        scalar[l]->mahalanobis_TH = -1;
+        Vector3d p0 = Vector3d::Random();
+        Matrix3d R0 = serow::lie::expSO3(0.3 * Vector3d::Random());
+        scalar[l]->setBodyPos(p0);
+        scalar[l]->setBodyOrientation(R0);
+        batch->setBodyPos(l, p0);
+        batch->setBodyOrientation(l, R0);
+    }
+    std::cout.clear();
+
+    Lanes omega[3], f[3], y[3], Ry[9], vy[3];
+    double dev = 0, cdev = 0;
+    for (int k = 0; k < steps; k++)
+    {
+        //IMU: slow random rotation, gravity compensated specific force plus noise
+        for (int l = 0; l < N; l++)
+        {
+            Vector3d w = 0.5 * Vector3d::Random();
+            Vector3d a = -scalar[l]->Rib.transpose() * scalar[l]->g + 0.2 * Vector3d::Random();
+            for (int j = 0; j < 3; j++)
+            {
+                omega[j](l) = w(j);
+                f[j](l) = a(j);
+            }
+            scalar[l]->predict(w, a);
+        }
+        batch->predict(omega, f);
+
+        //Pose measurements around the scalar estimate, every step with leg odometry and every 5th with odometry
+        for (int l = 0; l < N; l++)
+        {
+            Vector3d p = scalar[l]->x.segment<3>(6) + 0.01 * Vector3d::Random();
+            Matrix3d R = scalar[l]->Rib * serow::lie::expSO3(0.01 * Vector3d::Random());
+            for (int j = 0; j < 3; j++)
+                y[j](l) = p(j);
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                    Ry[r + 3 * c](l) = R(r, c);
+            if (k % 5 == 0)
+                scalar[l]->updateWithOdom(p, Quaterniond(R), false);
+            else
+                scalar[l]->updateWithLegOdom(p, Quaterniond(R));
+        }
+        if (k % 5 == 0)
+            batch->updateWithOdom(y, Ry);
+        else
+            batch->updateWithLegOdom(y, Ry);
+
+        //Twist every other step
+        if (k % 2 == 0)
+        {
+            for (int l = 0; l < N; l++)
+            {
+                Vector3d vw = scalar[l]->Rib * scalar[l]->x.segment<3>(0) + 0.01 * Vector3d::Random();
+                for (int j = 0; j < 3; j++)
+                    vy[j](l) = vw(j);
+                scalar[l]->updateWithTwist(vw);
+            }
+            batch->updateWithTwist(vy);
+        }
+    }
+
+    for (int l = 0; l < N; l++)
+    {
+        IMUEKF &s = *scalar[l];
+        dev = std::max(dev, (batch->bodyPos(l) - s.x.segment<3>(6)).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->bodyVel(l) - s.x.segment<3>(0)).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->bodyOrientation(l) - s.Rib).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->gyroBias(l) - s.x.segment<3>(9)).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->accBias(l) - s.x.segment<3>(12)).cwiseAbs().maxCoeff());
+        //P is not a public member of IMUEKF, compare the batch covariance with itself for symmetry and positivity
+        Matrix<double, 15, 15> C = batch->covariance(l);
+        cdev = std::max(cdev, (C - C.transpose()).cwiseAbs().maxCoeff() / C.cwiseAbs().maxCoeff());
+        if (C.llt().info() != Success)
+            cdev = 1;
+        delete scalar[l];
+    }
+    delete batch;
+    std::cout << "IMUEKFBatch<" << N << "> vs IMUEKF after " << steps << " steps: max state deviation " << std::scientific
+              << std::setprecision(2) << dev << ", covariance asymmetry " << cdev << std::endl;
+    return std::max(dev, cdev);
+}
+
+/** @fn double inekfConsistency(int steps)
+ *  @brief largest deviation between IMUinEKFBatch and IMUinEKF with both feet in contact, relative for the covariance
+*/
+template <int N>
+static double inekfConsistency(int steps)
+{
+    typedef typename serow::IMUinEKFBatch<N>::Lanes Lanes;
+    const double dt = 0.005;
+    serow::IMUinEKFBatch<N> *batch = new serow::IMUinEKFBatch<N>();
+    std::vector<IMUinEKF *> scalar(N);
+    batch->setdt(dt);
+    batch->init();
+    batch->setNoise(noise());
+    //IMUinEKF::init() reports every instance
+    std::cout.setstate(std::ios::failbit);
+    for (int l = 0; l < N; l++)
+    {
+        scalar[l] = new IMUinEKF();
+        scalar[l]->setdt(dt);
+        scalar[l]->init();
+        serow::applyImuNoise(*scalar[l], noise());
+        serow::applyContactNoise(*scalar[l], noise());
+        Vector3d p0 = Vector3d::Random();
+        Matrix3d R0 = serow::lie::expSO3(0.3 * Vector3d::Random());
+        Vector3d dR0 = p0 + R0 * Vector3d(0, -0.1, -0.8), dL0 = p0 + R0 * Vector3d(0, 0.1, -0.8);
+        scalar[l]->setBodyPos(p0);
+        scalar[l]->setBodyOrientation(R0);
+        scalar[l]->setRightContact(dR0);
+        scalar[l]->setLeftContact(dL0);
+        //IMUinEKF::init() leaves the acc bias variance off the diagonal, start both from the batch one
+        scalar[l]->setCovariance(batch->covariance(l));
+        batch->setBodyPos(l, p0);
+        batch->setBodyOrientation(l, R0);
+        batch->setRightContact(l, dR0);
+        batch->setLeftContact(l, dL0);
+    }
+    std::cout.clear();
+
+    Lanes omega[3], f[3], hR_R[9], hR_L[9], s_pR[3], s_pL[3], JR[9], JL[9], weightR, weightL;
+    double dev = 0, cdev = 0;
+    for (int k = 0; k < steps; k++)
+    {
+        //IMU as above, feet orientation in the base frame
+        for (int l = 0; l < N; l++)
+        {
+            Vector3d w = 0.5 * Vector3d::Random();
+            Vector3d a = -scalar[l]->Rwb.transpose() * scalar[l]->g + 0.2 * Vector3d::Random();
+            Matrix3d RR = serow::lie::expSO3(0.2 * Vector3d::Random()), RL = serow::lie::expSO3(0.2 * Vector3d::Random());
+            for (int j = 0; j < 3; j++)
+            {
+                omega[j](l) = w(j);
+                f[j](l) = a(j);
+            }
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                {
+                    hR_R[r + 3 * c](l) = RR(r, c);
+                    hR_L[r + 3 * c](l) = RL(r, c);
+                }
+            scalar[l]->predict(w, a, Vector3d::Zero(), Vector3d::Zero(), RR, RL, 1, 1);
+        }
+        batch->predict(omega, f, hR_R, hR_L);
+
+        //Foot positions in the base frame around the scalar estimate, with their kinematic covariance
+        for (int l = 0; l < N; l++)
+        {
+            const IMUinEKF &s = *scalar[l];
+            Vector3d pR = s.Rwb.transpose() * (s.dR - s.pwb) + 0.005 * Vector3d::Random();
+            Vector3d pL = s.Rwb.transpose() * (s.dL - s.pwb) + 0.005 * Vector3d::Random();
+            Matrix3d MR = Matrix3d::Random(), ML = Matrix3d::Random();
+            Matrix3d QR = 1e-5 * (MR * MR.transpose() + Matrix3d::Identity());
+            Matrix3d QL = 1e-5 * (ML * ML.transpose() + Matrix3d::Identity());
+            double wR = 0.5 + 0.5 * rand() / RAND_MAX, wL = 0.5 + 0.5 * rand() / RAND_MAX;
+            for (int j = 0; j < 3; j++)
+            {
+                s_pR[j](l) = pR(j);
+                s_pL[j](l) = pL(j);
+            }
+            for (int c = 0; c < 3; c++)
+                for (int r = 0; r < 3; r++)
+                {
+                    JR[r + 3 * c](l) = QR(r, c);
+                    JL[r + 3 * c](l) = QL(r, c);
+                }
+            weightR(l) = wR;
+            weightL(l) = wL;
+            scalar[l]->updateWithContacts(pR, pL, QR, QL, 1, 1, wR, wL);
+        }
+        batch->updateWithContacts(s_pR, s_pL, JR, JL, weightR, weightL);
+    }
+
+    for (int l = 0; l < N; l++)
+    {
+        IMUinEKF &s = *scalar[l];
+        dev = std::max(dev, (batch->bodyPos(l) - s.pwb).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->bodyVel(l) - s.vwb).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->bodyOrientation(l) - s.Rwb).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->rightContact(l) - s.dR).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->leftContact(l) - s.dL).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->gyroBias(l) - s.bgyr).cwiseAbs().maxCoeff());
+        dev = std::max(dev, (batch->accBias(l) - s.bacc).cwiseAbs().maxCoeff());
+        Matrix<double, 21, 21> C = batch->covariance(l);
+        cdev = std::max(cdev, (C - s.covariance()).cwiseAbs().maxCoeff() / s.covariance().cwiseAbs().maxCoeff());
+        delete scalar[l];
+    }
+    delete batch;
+    std::cout << "IMUinEKFBatch<" << N << "> vs IMUinEKF after " << steps << " steps: max state deviation " << std::scientific
+              << std::setprecision(2) << dev << ", covariance deviation " << cdev << std::endl;
+    return std::max(dev, cdev);
+}
+
+/** @fn void throughput(long estimates)
+ *  @brief estimates per second on one core of predict + leg odometry update with N instances per batch
+*/
+template <int N>
+static void throughput(long estimates)
+{
+    typedef typename serow::IMUEKFBatch<N>::Lanes Lanes;
+    serow::IMUEKFBatch<N> *batch = new serow::IMUEKFBatch<N>();
+    batch->setdt(0.005);
+    batch->init();
+    batch->setNoise(noise());
+    Lanes omega[3], f[3], y[3], Ry[9];
+    for (int j = 0; j < 3; j++)
+    {
+        omega[j] = 0.1 * Lanes::Random();
+        f[j] = 0.1 * Lanes::Random() + (j == 2 ? 9.80 : 0.0);
+        y[j] = 0.01 * Lanes::Random();
+    }
+    for (int i = 0; i < 9; i++)
+        Ry[i].setConstant(i % 4 == 0 ? 1.0 : 0.0);
+
+    long cycles = std::max(1L, estimates / N);
+    uint64_t t0 = serow::monotonicNs();
+    for (long k = 0; k < cycles; k++)
+    {
+        batch->predict(omega, f);
+        batch->updateWithLegOdom(y, Ry);
+    }
+    double s = (double)(serow::monotonicNs() - t0) * 1e-9;
+    sink = batch->x[6](0);
+    std::cout << std::left << std::setw(24) << ("IMUEKFBatch<" + std::to_string(N) + ">") << std::right << std::fixed
+              << std::setprecision(0) << std::setw(12) << cycles * N / s << " estimates/s" << std::endl;
+    delete batch;
+}
+
+/** @fn void inekfThroughput(long estimates)
+ *  @brief estimates per second on one core of predict + contact update with N instances per batch
+*/
+template <int N>
+static void inekfThroughput(long estimates)
+{
+    typedef typename serow::IMUinEKFBatch<N>::Lanes Lanes;
+    serow::IMUinEKFBatch<N> *batch = new serow::IMUinEKFBatch<N>();
+    batch->setdt(0.005);
+    batch->init();
+    batch->setNoise(noise());
+    Lanes omega[3], f[3], hR[9], s_pR[3], s_pL[3], J[9], weight = Lanes::Ones();
+    for (int j = 0; j < 3; j++)
+    {
+        omega[j] = 0.1 * Lanes::Random();
+        f[j] = 0.1 * Lanes::Random() + (j == 2 ? 9.80 : 0.0);
+        s_pR[j] = 0.01 * Lanes::Random();
+        s_pL[j] = 0.01 * Lanes::Random();
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        hR[i].setConstant(i % 4 == 0 ? 1.0 : 0.0);
+        J[i].setConstant(i % 4 == 0 ? 1e-5 : 0.0);
+    }
+
+    long cycles = std::max(1L, estimates / N);
+    uint64_t t0 = serow::monotonicNs();
+    for (long k = 0; k < cycles; k++)
+    {
+        batch->predict(omega, f, hR, hR);
+        batch->updateWithContacts(s_pR, s_pL, J, J, weight, weight);
+    }
+    double s = (double)(serow::monotonicNs() - t0) * 1e-9;
+    sink = batch->pwb[0](0);
+    std::cout << std::left << std::setw(24) << ("IMUinEKFBatch<" + std::to_string(N) + ">") << std::right << std::fixed
+              << std::setprecision(0) << std::setw(12) << cycles * N / s << " estimates/s" << std::endl;
+    delete batch;
+}
+
+int main(int argc, char **argv)
+{
+    int steps = argc > 1 ? atoi(argv[1]) : 2000;
+    if (steps <= 0)
+    {
+        std::cerr << "usage: serow_ekf_batch_bench [steps]" << std::endl;
+        return 1;
+    }
+    srand(1);
+    double worst = consistency<4>(steps);
+    worst = std::max(worst, consistency<13>(steps));
+    worst = std::max(worst, inekfConsistency<4>(steps));
+    worst = std::max(worst, inekfConsistency<13>(steps));
+
+    const long estimates = 2000000;
+    {
+        IMUEKF scalar;
+        scalar.setdt(0.005);
+        scalar.init();
+        serow::applyImuNoise(scalar, noise());
+        Vector3d w = 0.1 * Vector3d::Random(), a = Vector3d(0, 0, 9.80) + 0.1 * Vector3d::Random();
+        Vector3d p = 0.01 * Vector3d::Random();
+        Quaterniond q = Quaterniond::Identity();
+        uint64_t t0 = serow::monotonicNs();
+        for (long k = 0; k < estimates / 10; k++)
+        {
+            scalar.predict(w, a);
+            scalar.updateWithLegOdom(p, q);
+        }
+        double s = (double)(serow::monotonicNs() - t0) * 1e-9;
+        sink = scalar.x(6);
+        std::cout << std::left << std::setw(24) << "IMUEKF" << std::right << std::fixed << std::setprecision(0) << std::setw(12)
+                  << estimates / 10 / s << " estimates/s" << std::endl;
+    }
+    throughput<8>(estimates);
+    throughput<64>(estimates);
+    throughput<512>(estimates);
+    throughput<4096>(estimates);
+    {
+        IMUinEKF scalar;
+        std::cout.setstate(std::ios::failbit);
+        scalar.setdt(0.005);
+        scalar.init();
+        std::cout.clear();
+        serow::applyImuNoise(scalar, noise());
+        serow::applyContactNoise(scalar, noise());
+        Vector3d w = 0.1 * Vector3d::Random(), a = Vector3d(0, 0, 9.80) + 0.1 * Vector3d::Random();
+        Vector3d pR = 0.01 * Vector3d::Random(), pL = 0.01 * Vector3d::Random();
+        Matrix3d J = 1e-5 * Matrix3d::Identity(), I = Matrix3d::Identity();
+        uint64_t t0 = serow::monotonicNs();
+        for (long k = 0; k < estimates / 10; k++)
+        {
+            scalar.predict(w, a, pR, pL, I, I, 1, 1);
+            scalar.updateWithContacts(pR, pL, J, J, 1, 1, 1.0, 1.0);
+        }
+        double s = (double)(serow::monotonicNs() - t0) * 1e-9;
+        sink = scalar.pwb(0);
+        std::cout << std::left << std::setw(24) << "IMUinEKF" << std::right << std::fixed << std::setprecision(0) << std::setw(12)
+                  << estimates / 10 / s << " estimates/s" << std::endl;
+    }
+    inekfThroughput<8>(estimates);
+    inekfThroughput<64>(estimates);
+    inekfThroughput<512>(estimates);
+    return worst < 1e-6 ? 0 : 1;
+}
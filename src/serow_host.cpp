@@ -0,0 +1,221 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @brief SEROW host process
+ * @details runs several humanoid_ekf and quadruped_ekf cores in one process. The cores share the Pinocchio model
+ * of their URDF and are stepped by a fixed pool of worker threads instead of one estimator and one publisher
+ * thread per robot. Each core stays on one worker for its lifetime, the workers may be pinned to CPUs.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <ros/callback_queue.h>
+#include <serow/humanoid_ekf.h>
+#include <serow/quadruped_ekf.h>
+#include <serow/RealtimeThread.h>
+
+using std::string;
+using std::cerr;
+using std::endl;
+
+namespace serow
+{
+    /// Common interface of the hosted humanoid and quadruped cores
+    class HostedEstimator
+    {
+    public:
+        std::string name;
+        ///Subscriptions of the core, served by its worker in step()
+        ros::CallbackQueue queue;
+        virtual ~HostedEstimator() {}
+        virtual bool connect(ros::NodeHandle n, ros::NodeHandle n_p) = 0;
+        virtual void begin() = 0;
+        virtual void step() = 0;
+        virtual void end() = 0;
+        virtual double loopPeriod() = 0;
+        virtual bool running() = 0;
+    };
+
+    template <typename Estimator>
+    class HostedCore : public HostedEstimator
+    {
+    private:
+        Estimator *core;
+
+    public:
+        HostedCore() : core(new Estimator()) {}
+        ~HostedCore() { delete core; }
+        bool connect(ros::NodeHandle n, ros::NodeHandle n_p)
+        {
+            n.setCallbackQueue(&queue);
+            n_p.setCallbackQueue(&queue);
+            core->setCallbackQueue(&queue);
+            core->setHosted(true);
+            core->connect(n, n_p);
+            return core->connected();
+        }
+        void begin() { core->begin(); }
+        void step() { core->step(); }
+        void end() { core->end(); }
+        double loopPeriod() { return core->loopPeriod(); }
+        bool running() { return core->running(); }
+    };
+
+    /** @fn void serveWorker(std::vector<HostedEstimator *> cores, std::vector<int> cpus, std::string policy, int priority, int index)
+     *  @brief steps cores in earliest deadline order, each at its own loopPeriod(), until they all stop
+     *  @details as ros::Rate does, a core that falls behind is rescheduled from now instead of catching up
+    */
+    void serveWorker(std::vector<HostedEstimator *> cores, std::vector<int> cpus, std::string policy, int priority, int index)
+    {
+        typedef std::chrono::steady_clock Clock;
+        std::string affinity, scheduling;
+        setThreadAffinity(cpus, affinity);
+        setThreadScheduling(policy, priority, scheduling);
+        std::cout << "Host worker " << index << ": " << cores.size() << " estimators, " << affinity << ", " << scheduling << std::endl;
+
+        std::vector<Clock::time_point> due(cores.size(), Clock::now());
+        std::vector<Clock::duration> period(cores.size());
+        std::vector<bool> active(cores.size(), true);
+        for (unsigned int i = 0; i < cores.size(); i++)
+        {
+            cores[i]->begin();
+            period[i] = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(cores[i]->loopPeriod()));
+        }
+
+        unsigned int remaining = cores.size();
+        while (remaining > 0)
+        {
+            int next = -1;
+            for (unsigned int i = 0; i < cores.size(); i++)
+                if (active[i] && (next < 0 || due[i] < due[next]))
+                    next = i;
+            std::this_thread::sleep_until(due[next]);
+
+            HostedEstimator *core = cores[next];
+            if (!core->running())
+            {
+                core->end();
+                active[next] = false;
+                remaining--;
+                continue;
+            }
+            Clock::time_point now = Clock::now();
+            core->step();
+            due[next] += period[next];
+            if (due[next] < now)
+                due[next] = now;
+        }
+    }
+} // namespace serow
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "serow_host");
+    ros::NodeHandle n;
+    if(!ros::master::check())
+    {
+        cerr<<"Could not contact master!\nQuitting... "<<endl;
+        return -1;
+    }
+
+    ros::NodeHandle n_p("~");
+    std::vector<string> instances;
+    n_p.param<std::vector<string>>("instances", instances, std::vector<string>());
+    if (instances.empty())
+    {
+        ROS_ERROR("No estimators to host, set ~instances to a list of namespaces");
+        return -1;
+    }
+    int workers;
+    n_p.param<int>("workers", workers, std::min<int>(instances.size(), std::max(1u, std::thread::hardware_concurrency())));
+    workers = std::max(1, std::min<int>(workers, instances.size()));
+    std::vector<int> worker_cpus;
+    n_p.param<std::vector<int>>("worker_cpus", worker_cpus, std::vector<int>());
+    string worker_sched_policy;
+    int worker_priority;
+    n_p.param<string>("worker_sched_policy", worker_sched_policy, "other");
+    n_p.param<int>("worker_priority", worker_priority, 80);
+
+    //Topics of an instance resolve in its namespace, its parameters in ~<namespace>
+    std::vector<serow::HostedEstimator *> cores;
+    std::vector<std::vector<serow::HostedEstimator *> > assignment(workers);
+    for (unsigned int i = 0; i < instances.size(); i++)
+    {
+        ros::NodeHandle in(n, instances[i]);
+        ros::NodeHandle in_p(n_p, instances[i]);
+        bool isQuadruped;
+        int worker;
+        in_p.param<bool>("isQuadruped", isQuadruped, false);
+        in_p.param<int>("worker", worker, i % workers);
+        if (worker < 0 || worker >= workers)
+        {
+            ROS_WARN("%s: worker %d does not exist, using %d", instances[i].c_str(), worker, i % workers);
+            worker = i % workers;
+        }
+
+        serow::HostedEstimator *core;
+        if (!isQuadruped)
+            core = new serow::HostedCore<humanoid_ekf>();
+        else
+            core = new serow::HostedCore<quadruped_ekf>();
+        core->name = instances[i];
+        if (!core->connect(in, in_p))
+        {
+            ROS_ERROR("Could not connect to %s robot %s!", isQuadruped ? "Quadruped" : "Humanoid", instances[i].c_str());
+            delete core;
+            continue;
+        }
+        cores.push_back(core);
+        assignment[worker].push_back(core);
+    }
+
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++)
+    {
+        if (assignment[w].empty())
+            continue;
+        std::vector<int> cpus;
+        if (!worker_cpus.empty())
+            cpus.push_back(worker_cpus[w % worker_cpus.size()]);
+        pool.push_back(std::thread(serow::serveWorker, assignment[w], cpus, worker_sched_policy, worker_priority, w));
+    }
+    for (unsigned int w = 0; w < pool.size(); w++)
+        pool[w].join();
+    for (unsigned int i = 0; i < cores.size(); i++)
+        delete cores[i];
+
+    //Done here
+    ROS_INFO( "Quitting... " );
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Offline check of a generated kinematics library against Pinocchio
+ * @author Stylianos Piperakis
+ * @details compares the frame poses, frame jacobians and CoM of a library built with serow_add_kinematics() to
+ * the Pinocchio ones on random configurations within the joint limits, and times one estimator kinematics
+ * cycle with each backend. Exits non-zero when the library does not load or an error exceeds the tolerance.
+ * usage: serow_kinematics_check model.urdf library.so [configurations, default 20] [tolerance, default 1e-9]
+ */
+
+#include <serow/robotDyn.h>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+using namespace Eigen;
+
+/// One estimator kinematics cycle, the feet and the CoM as the nodes query them, in microseconds
+static double timeCycle(serow::robotDyn &rd, const std::vector<std::string> &frames, VectorXd q, const VectorXd &qdot, int cycles)
+{
+    double acc = 0.0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < cycles; t++)
+    {
+        q[t % q.size()] += 1e-9;
+        rd.updateJointConfig(q, qdot, 0.0);
+        for (unsigned int f = 0; f < frames.size(); f++)
+        {
+            acc += rd.linkPosition(frames[f])(0) + rd.linkOrientation(frames[f]).w();
+            acc += rd.linearJacobian(frames[f])(0, 0) + rd.angularJacobian(frames[f])(0, 0);
+        }
+        acc += rd.comPosition()(0);
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    if (acc != acc)
+        std::cerr << "NaN in the kinematics" << std::endl;
+    return std::chrono::duration<double, std::micro>(t1 - t0).count() / cycles;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: serow_kinematics_check model.urdf library.so [configurations] [tolerance]" << std::endl;
+        return 2;
+    }
+    const std::string urdf = argv[1], library = argv[2];
+    const int configurations = argc > 3 ? std::atoi(argv[3]) : 20;
+    const double tolerance = argc > 4 ? std::atof(argv[4]) : 1e-9;
+
+    serow::robotDyn pin(urdf, false);
+    serow::robotDyn gen(urdf, false);
+    std::string report;
+    if (!gen.loadGeneratedKinematics(library, report))
+    {
+        std::cerr << report << std::endl;
+        return 1;
+    }
+    std::cout << report << std::endl;
+
+    //The library gen loaded, for its joint and frame names
+    void *lib = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    const serow::GeneratedKinematics *gk = ((serow::GeneratedKinematicsEntry)dlsym(lib, SEROW_GENERATED_KINEMATICS_ENTRY))();
+    std::vector<std::string> joints(gk->joint_names, gk->joint_names + gk->num_joints);
+    std::vector<std::string> frames(gk->frame_names, gk->frame_names + gk->num_frames);
+    pin.mapJointNames(joints);
+    gen.mapJointNames(joints);
+
+    //Column of every generated joint in the Pinocchio jacobians, all joints have one velocity
+    const std::vector<std::string> model_joints = pin.jointNames();
+    const int nj = joints.size();
+    std::vector<int> col(nj);
+    for (int j = 0; j < nj; j++)
+        col[j] = std::find(model_joints.begin(), model_joints.end(), joints[j]) - model_joints.begin();
+    //The limits follow the configuration, they line up with the joints only without continuous joints
+    const bool limits = pin.ndof() == nj;
+    const VectorXd qmin = pin.jointMinAngularLimits(), qmax = pin.jointMaxAngularLimits();
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    VectorXd q(nj), qdot = VectorXd::Zero(nj);
+    double epos = 0, erot = 0, ejac = 0, ecom = 0;
+    for (int t = 0; t < configurations; t++)
+    {
+        for (int j = 0; j < nj; j++)
+        {
+            double lo = -M_PI, hi = M_PI;
+            if (limits && qmax[col[j]] > qmin[col[j]])
+            {
+                lo = std::max(lo, qmin[col[j]]);
+                hi = std::min(hi, qmax[col[j]]);
+            }
+            q[j] = lo + (hi - lo) * unit(rng);
+        }
+        pin.updateJointConfig(q, qdot, 0.0);
+        gen.updateJointConfig(q, qdot, 0.0);
+        for (int f = 0; f < (int)frames.size(); f++)
+        {
+            epos = std::max(epos, (pin.linkPosition(frames[f]) - gen.linkPosition(frames[f])).cwiseAbs().maxCoeff());
+            erot = std::max(erot, (pin.linkOrientation(frames[f]).toRotationMatrix() - gen.linkOrientation(frames[f]).toRotationMatrix()).cwiseAbs().maxCoeff());
+            const MatrixXd Jp = pin.linearJacobian(frames[f]), Jg = gen.linearJacobian(frames[f]);
+            const MatrixXd Ap = pin.angularJacobian(frames[f]), Ag = gen.angularJacobian(frames[f]);
+            for (int j = 0; j < nj; j++)
+            {
+                ejac = std::max(ejac, (Jp.col(col[j]) - Jg.col(j)).cwiseAbs().maxCoeff());
+                ejac = std::max(ejac, (Ap.col(col[j]) - Ag.col(j)).cwiseAbs().maxCoeff());
+            }
+        }
+        ecom = std::max(ecom, (pin.comPosition() - gen.comPosition()).cwiseAbs().maxCoeff());
+    }
+
+    const int cycles = 1000;
+    double tp = timeCycle(pin, frames, q, qdot, cycles);
+    double tg = timeCycle(gen, frames, q, qdot, cycles);
+    dlclose(lib);
+
+    const double err = std::max(std::max(epos, erot), std::max(ejac, ecom));
+    std::cout << "Max error vs Pinocchio over " << configurations << " configurations: position " << epos << " rotation " << erot
+              << " jacobian " << ejac << " CoM " << ecom << std::endl;
+    std::cout << tp << " us vs " << tg << " us per cycle (" << tp / tg << "x)" << std::endl;
+    if (!(err <= tolerance))
+    {
+        std::cerr << "FAILED, tolerance " << tolerance << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
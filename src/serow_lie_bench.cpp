@@ -0,0 +1,104 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Micro-benchmark of the Lie group kernels
+ * @author Stylianos Piperakis
+ * @details times the serow/lie.h maps at the sizes the filters use, on small and regular angles so both the
+ * Taylor and the closed form branches are covered
+ * usage: serow_lie_bench [iterations, default 1000000]
+ */
+
+#include <serow/lie.h>
+#include <serow/StageProfiler.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+
+using namespace Eigen;
+
+/// Keeps the optimizer from dropping the benchmarked calls
+static volatile double sink;
+
+template <typename Op>
+static void run(const char *name, long iterations, Op op)
+{
+    double acc = 0.0;
+    uint64_t t0 = serow::monotonicNs();
+    for (long i = 0; i < iterations; i++)
+        acc += op(i);
+    double ns = (double)(serow::monotonicNs() - t0) / iterations;
+    sink = acc;
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1) << std::setw(8) << ns
+              << " ns" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (iterations <= 0)
+    {
+        std::cerr << "usage: serow_lie_bench [iterations]" << std::endl;
+        return 1;
+    }
+
+    //A small pool of inputs, indexed with i & mask so the loads stay in cache
+    const int pool = 64;
+    std::vector<Matrix<double, 21, 1>, aligned_allocator<Matrix<double, 21, 1> > > xi(pool), small(pool);
+    std::vector<Matrix3d, aligned_allocator<Matrix3d> > R(pool);
+    std::vector<Matrix<double, 7, 7>, aligned_allocator<Matrix<double, 7, 7> > > X4(pool);
+    std::vector<Matrix<double, 9, 9>, aligned_allocator<Matrix<double, 9, 9> > > X6(pool);
+    srand(1);
+    for (int i = 0; i < pool; i++)
+    {
+        xi[i] = Matrix<double, 21, 1>::Random();
+        small[i] = xi[i];
+        small[i].head<3>() *= 1e-4;
+        R[i] = serow::lie::expSO3(xi[i].head<3>());
+        X4[i] = serow::lie::expSEK3(xi[i].head<15>());
+        X6[i] = serow::lie::expSEK3(xi[i]);
+    }
+    const int mask = pool - 1;
+
+    std::cout << iterations << " iterations per kernel" << std::endl;
+    run("expSO3", iterations, [&](long i) { return serow::lie::expSO3(xi[i & mask].head<3>())(0, 1); });
+    run("expSO3 (small angle)", iterations, [&](long i) { return serow::lie::expSO3(small[i & mask].head<3>())(0, 1); });
+    run("logSO3", iterations, [&](long i) { return serow::lie::logSO3(R[i & mask])(0); });
+    run("leftJacobianSO3", iterations, [&](long i) { return serow::lie::leftJacobianSO3(xi[i & mask].head<3>())(0, 1); });
+    run("leftJacobianInverseSO3", iterations, [&](long i) { return serow::lie::leftJacobianInverseSO3(xi[i & mask].head<3>())(0, 1); });
+    run("expSE3", iterations, [&](long i) { return serow::lie::expSEK3(xi[i & mask].head<6>())(0, 3); });
+    run("expSEK3 K=4", iterations, [&](long i) { return serow::lie::expSEK3(xi[i & mask].head<15>())(0, 3); });
+    run("expSEK3 K=6", iterations, [&](long i) { return serow::lie::expSEK3(xi[i & mask])(0, 3); });
+    run("logSEK3 K=4", iterations, [&](long i) { return serow::lie::logSEK3(X4[i & mask])(3); });
+    run("adjointSEK3 K=4", iterations, [&](long i) { return serow::lie::adjointSEK3(X4[i & mask])(3, 0); });
+    run("adjointSEK3 K=6", iterations, [&](long i) { return serow::lie::adjointSEK3(X6[i & mask])(3, 0); });
+    run("leftJacobianSEK3 K=4", iterations, [&](long i) { return serow::lie::leftJacobianSEK3(xi[i & mask].head<15>())(3, 0); });
+    run("leftJacobianSEK3 K=4 small", iterations, [&](long i) { return serow::lie::leftJacobianSEK3(small[i & mask].head<15>())(3, 0); });
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Numerical check of the Lie group kernels
+ * @author Stylianos Piperakis
+ * @details checks the serow/lie.h exp/log round-trips and the left/right Jacobians and their inverses against
+ * central differences of exp and log, for SO(3) and SE_K(3) with K = 1, 4, 6, on angles near 0, across the Taylor
+ * switch, regular and near pi. Exits non-zero when any error exceeds its tolerance.
+ * usage: serow_lie_check [samples per angle, default 10]
+ */
+
+#include <serow/lie.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace Eigen;
+
+/// Rotation angles, below, at and above the Taylor switch of the coefficients, regular and close to pi
+static const double angles[] = {0.0, 1e-8, 1e-5, 9.9e-3, 1.01e-2, 0.5, 2.0, M_PI - 1e-3, M_PI - 1e-6};
+/// Step of the central differences
+static const double h = 1e-6;
+/// Tolerances on the round-trips and on the Jacobians, relative to max(1, |reference|)
+static const double tol_log = 1e-9, tol_jac = 1e-6;
+
+static int failures = 0;
+
+static double relError(const MatrixXd &A, const MatrixXd &B)
+{
+    return (A - B).cwiseAbs().maxCoeff() / std::max(1.0, B.cwiseAbs().maxCoeff());
+}
+
+static void report(const std::string &name, double err, double tol)
+{
+    bool ok = err <= tol;
+    if (!ok)
+        failures++;
+    std::cout << std::left << std::setw(36) << name << std::right << std::scientific << std::setprecision(2) << std::setw(10) << err
+              << (ok ? "  ok" : "  FAILED") << std::endl;
+}
+
+/// Group operations of SO(3)
+struct SO3
+{
+    enum { Dim = 3 };
+    typedef Matrix<double, 3, 1> Tangent;
+    typedef Matrix3d Group;
+    static Group exp(const Tangent &xi) { return serow::lie::expSO3(xi); }
+    static Tangent log(const Group &X) { return serow::lie::logSO3(X); }
+    static Group inverse(const Group &X) { return X.transpose(); }
+    static Matrix3d Jl(const Tangent &xi) { return serow::lie::leftJacobianSO3(xi); }
+    static Matrix3d Jr(const Tangent &xi) { return serow::lie::rightJacobianSO3(xi); }
+    static Matrix3d Jlinv(const Tangent &xi) { return serow::lie::leftJacobianInverseSO3(xi); }
+    static Matrix3d Jrinv(const Tangent &xi) { return serow::lie::rightJacobianInverseSO3(xi); }
+    static const char *name() { return "SO(3)"; }
+};
+
+/// Group operations of SE_K(3)
+template <int K>
+struct SEK3
+{
+    enum { Dim = 3 + 3 * K };
+    typedef Matrix<double, Dim, 1> Tangent;
+    typedef Matrix<double, 3 + K, 3 + K> Group;
+    typedef Matrix<double, Dim, Dim> Jacobian;
+    static Group exp(const Tangent &xi) { return serow::lie::expSEK3(xi); }
+    static Tangent log(const Group &X) { return serow::lie::logSEK3(X); }
+    static Group inverse(const Group &X)
+    {
+        Group Y = Group::Identity();
+        Y.template topLeftCorner<3, 3>() = X.template topLeftCorner<3, 3>().transpose();
+        Y.template topRightCorner<3, K>() = -Y.template topLeftCorner<3, 3>() * X.template topRightCorner<3, K>();
+        return Y;
+    }
+    static Jacobian Jl(const Tangent &xi) { return serow::lie::leftJacobianSEK3(xi); }
+    static Jacobian Jr(const Tangent &xi) { return serow::lie::rightJacobianSEK3(xi); }
+    static Jacobian Jlinv(const Tangent &xi) { return serow::lie::leftJacobianInverseSEK3(xi); }
+    static Jacobian Jrinv(const Tangent &xi) { return serow::lie::rightJacobianInverseSEK3(xi); }
+    static const char *name() { return K == 1 ? "SE_1(3)" : (K == 4 ? "SE_4(3)" : "SE_6(3)"); }
+};
+
+/**
+ * @brief checks one group on every angle
+ * @details with X = exp(xi), the columns of the Jacobians are the central differences of
+ * Jl: log(exp(xi + h e) X^-1), Jr: log(X^-1 exp(xi + h e)), Jl^-1: log(exp(h e) X), Jr^-1: log(X exp(h e))
+ */
+template <typename G>
+static void check(std::mt19937 &rng, int samples)
+{
+    typedef typename G::Tangent Tangent;
+    typedef typename G::Group Group;
+    const int n = G::Dim;
+    std::normal_distribution<double> normal(0.0, 1.0);
+    for (unsigned int a = 0; a < sizeof(angles) / sizeof(angles[0]); a++)
+    {
+        double elog = 0, ejl = 0, ejr = 0, ejlinv = 0, ejrinv = 0;
+        for (int s = 0; s < samples; s++)
+        {
+            Tangent xi;
+            for (int i = 0; i < n; i++)
+                xi(i) = normal(rng);
+            Vector3d w = xi.template head<3>();
+            xi.template head<3>() = angles[a] * w.normalized();
+
+            const Group X = G::exp(xi), Xinv = G::inverse(X);
+            elog = std::max(elog, relError(G::log(X), xi));
+
+            MatrixXd Jl(n, n), Jr(n, n), Jlinv(n, n), Jrinv(n, n);
+            for (int j = 0; j < n; j++)
+            {
+                Tangent d = Tangent::Zero();
+                d(j) = h;
+                const Group Xp = G::exp(xi + d), Xm = G::exp(xi - d);
+                const Group Dp = G::exp(d), Dm = G::exp(-d);
+                Jl.col(j) = (G::log(Xp * Xinv) - G::log(Xm * Xinv)) / (2 * h);
+                Jr.col(j) = (G::log(Xinv * Xp) - G::log(Xinv * Xm)) / (2 * h);
+                Jlinv.col(j) = (G::log(Dp * X) - G::log(Dm * X)) / (2 * h);
+                Jrinv.col(j) = (G::log(X * Dp) - G::log(X * Dm)) / (2 * h);
+            }
+            ejl = std::max(ejl, relError(G::Jl(xi), Jl));
+            ejr = std::max(ejr, relError(G::Jr(xi), Jr));
+            ejlinv = std::max(ejlinv, relError(G::Jlinv(xi), Jlinv));
+            ejrinv = std::max(ejrinv, relError(G::Jrinv(xi), Jrinv));
+        }
+        std::ostringstream prefix;
+        prefix << G::name() << " theta " << std::setprecision(6) << angles[a] << " ";
+        report(prefix.str() + "log(exp)", elog, tol_log);
+        report(prefix.str() + "Jl", ejl, tol_jac);
+        report(prefix.str() + "Jr", ejr, tol_jac);
+        report(prefix.str() + "Jl^-1", ejlinv, tol_jac);
+        report(prefix.str() + "Jr^-1", ejrinv, tol_jac);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int samples = argc > 1 ? std::atoi(argv[1]) : 10;
+    std::mt19937 rng(7);
+    check<SO3>(rng, samples);
+    check<SEK3<1> >(rng, samples);
+    check<SEK3<4> >(rng, samples);
+    check<SEK3<6> >(rng, samples);
+    if (failures)
+    {
+        std::cerr << failures << " checks FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
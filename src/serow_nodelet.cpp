@@ -0,0 +1,109 @@
+/*
+ * humanoid_state_estimation - a complete state estimation scheme for humanoid robots
+ *
+ * Copyright 2017-2018 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *	 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @brief SEROW as a nodelet
+ * @details runs humanoid_ekf or quadruped_ekf inside a nodelet manager, so that the robot driver and
+ * the controller nodelets exchange messages with SEROW by shared pointer instead of serializing them
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <thread>
+#include <serow/humanoid_ekf.h>
+#include <serow/quadruped_ekf.h>
+
+namespace serow
+{
+    class SerowNodelet : public nodelet::Nodelet
+    {
+    private:
+        humanoid_ekf* hse;
+        quadruped_ekf* qse;
+        ///Subscriptions are served by the estimator thread, as ros::spinOnce() does in the standalone node
+        ros::CallbackQueue queue;
+        std::thread estimatorThread;
+
+        virtual void onInit()
+        {
+            ros::NodeHandle n(getNodeHandle());
+            ros::NodeHandle n_p(getPrivateNodeHandle());
+            n.setCallbackQueue(&queue);
+            n_p.setCallbackQueue(&queue);
+
+            bool isQuadruped;
+            n_p.param<bool>("isQuadruped", isQuadruped, false);
+            if (!isQuadruped)
+            {
+                hse = new humanoid_ekf();
+                hse->setCallbackQueue(&queue);
+                hse->setIntraProcess(true);
+                hse->connect(n, n_p);
+                if (!hse->connected())
+                {
+                    NODELET_ERROR("Could not connect to Humanoid robot!");
+                    return;
+                }
+                estimatorThread = std::thread(&humanoid_ekf::run, hse);
+            }
+            else
+            {
+                qse = new quadruped_ekf();
+                qse->setCallbackQueue(&queue);
+                qse->setIntraProcess(true);
+                qse->connect(n, n_p);
+                if (!qse->connected())
+                {
+                    NODELET_ERROR("Could not connect to Quadruped robot!");
+                    return;
+                }
+                estimatorThread = std::thread(&quadruped_ekf::run, qse);
+            }
+        }
+
+    public:
+        SerowNodelet() : hse(NULL), qse(NULL) {}
+
+        ~SerowNodelet()
+        {
+            if (hse)
+                hse->stop();
+            if (qse)
+                qse->stop();
+            if (estimatorThread.joinable())
+                estimatorThread.join();
+            delete hse;
+            delete qse;
+        }
+    };
+} // namespace serow
+
+PLUGINLIB_EXPORT_CLASS(serow::SerowNodelet, nodelet::Nodelet)
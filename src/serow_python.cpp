@@ -0,0 +1,370 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Python bindings of the SEROW estimators (module serow_py)
+ * @author Stylianos Piperakis
+ * @details the filters, the leg odometry, the contact detection and the kinematics are exposed per sample, and
+ * the batch functions take whole recordings as NumPy arrays. Batch inputs must be C-contiguous float64 arrays,
+ * they are read in place (no conversion is allowed, so a wrong dtype or layout raises instead of copying) and
+ * the loop runs in C++ with the GIL released.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <stdexcept>
+#include <serow/HumanoidReplay.h>
+#include <serow/IMUinEKF.h>
+#include <serow/CoMEKF.h>
+
+namespace py = pybind11;
+using namespace Eigen;
+
+typedef serow::HumanoidReplay::Rows Rows;
+typedef Eigen::Ref<const Rows> RowsIn;
+
+/** @fn void checkRows(const RowsIn& a, Eigen::Index rows, Eigen::Index cols, const char* name)
+ *  @brief throws ValueError unless a is rows x cols, cols < 0 accepts any number of columns
+*/
+static void checkRows(const RowsIn &a, Eigen::Index rows, Eigen::Index cols, const char *name)
+{
+    if (a.rows() != rows || (cols >= 0 && a.cols() != cols))
+        throw std::invalid_argument(std::string(name) + " must be " + std::to_string(rows) + " x " +
+                                    (cols >= 0 ? std::to_string(cols) : std::string("n")));
+}
+
+/** @fn py::array_t<double> outputRows(Eigen::Index rows, Eigen::Index cols)
+ *  @brief NumPy array filled in place by the batch functions
+*/
+static py::array_t<double> outputRows(Eigen::Index rows, Eigen::Index cols)
+{
+    return py::array_t<double>(std::vector<py::ssize_t>{(py::ssize_t)rows, (py::ssize_t)cols});
+}
+
+static Quaterniond quaternion(const Vector4d &wxyz)
+{
+    return Quaterniond(wxyz(0), wxyz(1), wxyz(2), wxyz(3));
+}
+
+static Vector4d wxyz(const Quaterniond &q)
+{
+    return Vector4d(q.w(), q.x(), q.y(), q.z());
+}
+
+/** @fn void bindImuNoise(py::class_<Filter>& c)
+ *  @brief the noise stds shared by the base filters, plus set_noise() with a serow_py.ImuNoiseParams
+*/
+template <class Filter>
+static void bindImuNoise(py::class_<Filter> &c)
+{
+    c.def_readwrite("acc_qx", &Filter::acc_qx).def_readwrite("acc_qy", &Filter::acc_qy).def_readwrite("acc_qz", &Filter::acc_qz)
+        .def_readwrite("gyr_qx", &Filter::gyr_qx).def_readwrite("gyr_qy", &Filter::gyr_qy).def_readwrite("gyr_qz", &Filter::gyr_qz)
+        .def_readwrite("accb_qx", &Filter::accb_qx).def_readwrite("accb_qy", &Filter::accb_qy).def_readwrite("accb_qz", &Filter::accb_qz)
+        .def_readwrite("gyrb_qx", &Filter::gyrb_qx).def_readwrite("gyrb_qy", &Filter::gyrb_qy).def_readwrite("gyrb_qz", &Filter::gyrb_qz)
+        .def_readwrite("odom_px", &Filter::odom_px).def_readwrite("odom_py", &Filter::odom_py).def_readwrite("odom_pz", &Filter::odom_pz)
+        .def_readwrite("odom_ax", &Filter::odom_ax).def_readwrite("odom_ay", &Filter::odom_ay).def_readwrite("odom_az", &Filter::odom_az)
+        .def_readwrite("leg_odom_px", &Filter::leg_odom_px).def_readwrite("leg_odom_py", &Filter::leg_odom_py).def_readwrite("leg_odom_pz", &Filter::leg_odom_pz)
+        .def_readwrite("leg_odom_ax", &Filter::leg_odom_ax).def_readwrite("leg_odom_ay", &Filter::leg_odom_ay).def_readwrite("leg_odom_az", &Filter::leg_odom_az)
+        .def_readwrite("vel_px", &Filter::vel_px).def_readwrite("vel_py", &Filter::vel_py).def_readwrite("vel_pz", &Filter::vel_pz)
+        .def("set_noise", [](Filter &f, const serow::ImuNoiseParams &p) { serow::applyImuNoise(f, p); })
+        .def_readwrite("dt", &Filter::dt)
+        .def_readwrite("g", &Filter::g)
+        .def_readonly("Rib", &Filter::Rib)
+        .def_readonly("bgyr", &Filter::bgyr)
+        .def_readonly("bacc", &Filter::bacc)
+        .def_property_readonly("qib", [](const Filter &f) { return wxyz(f.qib); });
+}
+
+/// property of a double[3] member as a 3-vector, for the ImuNoiseParams fields
+#define SEROW_PY_VECTOR3(Class, field)                                                                 \
+    def_property(#field, [](const Class &c) { return Vector3d(c.field[0], c.field[1], c.field[2]); }, \
+                 [](Class &c, const Vector3d &v) { c.field[0] = v(0); c.field[1] = v(1); c.field[2] = v(2); })
+
+PYBIND11_MODULE(serow_py, m)
+{
+    m.doc() = "SEROW state estimation: filters, leg odometry, contact detection, kinematics and offline replay";
+
+    py::class_<serow::ImuNoiseParams>(m, "ImuNoiseParams")
+        .def(py::init([]() { return serow::HumanoidReplayParams().noise; }))
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, acc_q)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, gyr_q)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, accb_q)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, gyrb_q)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, foot_contact)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, odom_p)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, odom_a)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, leg_odom_p)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, leg_odom_a)
+        .SEROW_PY_VECTOR3(serow::ImuNoiseParams, vel_p)
+        .def_readwrite("mahalanobis_TH", &serow::ImuNoiseParams::mahalanobis_TH);
+
+    //Base EKF
+    py::class_<IMUEKF> imuekf(m, "IMUEKF");
+    imuekf.def(py::init<>())
+        .def("init", &IMUEKF::init)
+        .def("setdt", &IMUEKF::setdt)
+        .def("setBodyPos", &IMUEKF::setBodyPos)
+        .def("setBodyOrientation", &IMUEKF::setBodyOrientation)
+        .def("setBodyVel", &IMUEKF::setBodyVel)
+        .def("setGyroBias", &IMUEKF::setGyroBias)
+        .def("setAccBias", &IMUEKF::setAccBias)
+        .def("predict", &IMUEKF::predict, py::arg("omega"), py::arg("f"))
+        .def("updateWithLegOdom", [](IMUEKF &f, const Vector3d &y, const Vector4d &q) { f.updateWithLegOdom(y, quaternion(q)); },
+             py::arg("y"), py::arg("q_wxyz"))
+        .def("updateWithOdom", [](IMUEKF &f, const Vector3d &y, const Vector4d &q, bool useOutlierDetection) {
+                 return f.updateWithOdom(y, quaternion(q), useOutlierDetection); },
+             py::arg("y"), py::arg("q_wxyz"), py::arg("useOutlierDetection") = false)
+        .def("updateWithTwist", &IMUEKF::updateWithTwist, py::arg("y"))
+        .def("updateWithTwistRotation", [](IMUEKF &f, const Vector3d &y, const Vector4d &q) { f.updateWithTwistRotation(y, quaternion(q)); },
+             py::arg("y"), py::arg("q_wxyz"))
+        .def_readonly("x", &IMUEKF::x)
+        .def_readwrite("firstrun", &IMUEKF::firstrun)
+        .def_readwrite("mahalanobis_TH", &IMUEKF::mahalanobis_TH)
+        .def("filterLegOdom", [](IMUEKF &f, const RowsIn &gyro, const RowsIn &acc, const RowsIn &pos, const RowsIn &q) {
+                 const Eigen::Index T = gyro.rows();
+                 checkRows(gyro, T, 3, "gyro");
+                 checkRows(acc, T, 3, "acc");
+                 checkRows(pos, T, 3, "pos");
+                 checkRows(q, T, 4, "q_wxyz");
+                 py::array_t<double> out = outputRows(T, 19);
+                 Eigen::Map<Rows> o(out.mutable_data(), T, 19);
+                 {
+                     py::gil_scoped_release release;
+                     for (Eigen::Index t = 0; t < T; t++)
+                     {
+                         f.predict(gyro.row(t).transpose(), acc.row(t).transpose());
+                         f.updateWithLegOdom(pos.row(t).transpose(), quaternion(q.row(t).transpose()));
+                         o.row(t).head<15>() = f.x.transpose();
+                         o.row(t).tail<4>() = wxyz(f.qib).transpose();
+                     }
+                 }
+                 return out; },
+             "predict and leg odometry update for every row, returns T x 19: the state x then the orientation w, x, y, z",
+             py::arg("gyro").noconvert(), py::arg("acc").noconvert(), py::arg("pos").noconvert(), py::arg("q_wxyz").noconvert());
+    bindImuNoise(imuekf);
+
+    //Contact aided InEKF
+    py::class_<IMUinEKF> inekf(m, "IMUinEKF");
+    inekf.def(py::init<>())
+        .def("init", &IMUinEKF::init)
+        .def("setdt", &IMUinEKF::setdt)
+        .def("setBodyPos", &IMUinEKF::setBodyPos)
+        .def("setBodyOrientation", &IMUinEKF::setBodyOrientation)
+        .def("setBodyVel", &IMUinEKF::setBodyVel)
+        .def("setGyroBias", &IMUinEKF::setGyroBias)
+        .def("setAccBias", &IMUinEKF::setAccBias)
+        .def("setLeftContact", &IMUinEKF::setLeftContact)
+        .def("setRightContact", &IMUinEKF::setRightContact)
+        .def("predict", &IMUinEKF::predict, py::arg("angular_velocity"), py::arg("linear_acceleration"), py::arg("pbr"), py::arg("pbl"),
+             py::arg("hR_R"), py::arg("hR_L"), py::arg("contactR"), py::arg("contactL"))
+        .def("updateWithContacts", &IMUinEKF::updateWithContacts, py::arg("s_pR"), py::arg("s_pL"), py::arg("JRQeJR"), py::arg("JLQeJL"),
+             py::arg("contactR"), py::arg("contactL"), py::arg("weightR"), py::arg("weightL"))
+        .def("updateWithOdom", [](IMUinEKF &f, const Vector3d &y, const Vector4d &q) { f.updateWithOdom(y, quaternion(q)); },
+             py::arg("y"), py::arg("q_wxyz"))
+        .def("updateWithTwist", &IMUinEKF::updateWithTwist, py::arg("vy"), py::arg("Rvy"))
+        .def_readonly("X", &IMUinEKF::X)
+        .def_readonly("Rwb", &IMUinEKF::Rwb)
+        .def_readonly("pwb", &IMUinEKF::pwb)
+        .def_readonly("vwb", &IMUinEKF::vwb)
+        .def_readonly("dL", &IMUinEKF::dL)
+        .def_readonly("dR", &IMUinEKF::dR)
+        .def_readwrite("firstrun", &IMUinEKF::firstrun)
+        .def_readwrite("foot_contactx", &IMUinEKF::foot_contactx)
+        .def_readwrite("foot_contacty", &IMUinEKF::foot_contacty)
+        .def_readwrite("foot_contactz", &IMUinEKF::foot_contactz);
+    bindImuNoise(inekf);
+
+    //CoM estimator
+    py::class_<CoMEKF>(m, "CoMEKF")
+        .def(py::init<>())
+        .def("init", &CoMEKF::init)
+        .def("setdt", &CoMEKF::setdt)
+        .def("setParams", &CoMEKF::setParams, py::arg("m"), py::arg("I_xx"), py::arg("I_yy"), py::arg("g"))
+        .def("setCoMPos", &CoMEKF::setCoMPos)
+        .def("setCoMExternalForce", &CoMEKF::setCoMExternalForce)
+        .def("predict", &CoMEKF::predict, py::arg("COP"), py::arg("fN"), py::arg("L"))
+        .def("update", &CoMEKF::update, py::arg("Acc"), py::arg("Pos"), py::arg("Gyro"), py::arg("Gyrodot"))
+        .def("run", [](CoMEKF &f, const RowsIn &cop, const RowsIn &fN, const RowsIn &L, const RowsIn &acc, const RowsIn &pos,
+                       const RowsIn &gyro, const RowsIn &gyrodot) {
+                 const Eigen::Index T = cop.rows();
+                 checkRows(cop, T, 3, "COP");
+                 checkRows(fN, T, 3, "fN");
+                 checkRows(L, T, 3, "L");
+                 checkRows(acc, T, 3, "Acc");
+                 checkRows(pos, T, 3, "Pos");
+                 checkRows(gyro, T, 3, "Gyro");
+                 checkRows(gyrodot, T, 3, "Gyrodot");
+                 py::array_t<double> out = outputRows(T, 9);
+                 Eigen::Map<Rows> o(out.mutable_data(), T, 9);
+                 {
+                     py::gil_scoped_release release;
+                     for (Eigen::Index t = 0; t < T; t++)
+                     {
+                         f.predict(cop.row(t).transpose(), fN.row(t).transpose(), L.row(t).transpose());
+                         f.update(acc.row(t).transpose(), pos.row(t).transpose(), gyro.row(t).transpose(), gyrodot.row(t).transpose());
+                         o.row(t) = f.x.transpose();
+                     }
+                 }
+                 return out; },
+             "predict and update for every row, returns T x 9: CoM position, velocity and external force",
+             py::arg("COP").noconvert(), py::arg("fN").noconvert(), py::arg("L").noconvert(), py::arg("Acc").noconvert(),
+             py::arg("Pos").noconvert(), py::arg("Gyro").noconvert(), py::arg("Gyrodot").noconvert())
+        .def_readonly("x", &CoMEKF::x)
+        .def_readwrite("firstrun", &CoMEKF::firstrun)
+        .def_readwrite("useEuler", &CoMEKF::useEuler)
+        .def_readwrite("com_q", &CoMEKF::com_q)
+        .def_readwrite("comd_q", &CoMEKF::comd_q)
+        .def_readwrite("fd_q", &CoMEKF::fd_q)
+        .def_readwrite("com_r", &CoMEKF::com_r)
+        .def_readwrite("comdd_r", &CoMEKF::comdd_r);
+
+    //Leg odometry
+    py::class_<serow::deadReckoning>(m, "deadReckoning")
+        .def(py::init<const Vector3d &, const Vector3d &, const Matrix3d &, const Matrix3d &, double, double, double, double, double,
+                      const Vector3d &, const Vector3d &>(),
+             py::arg("pwl0"), py::arg("pwr0"), py::arg("Rwl0"), py::arg("Rwr0"), py::arg("mass"), py::arg("alpha1") = 1.0,
+             py::arg("alpha3") = 0.01, py::arg("freq") = 100.0, py::arg("g") = 9.81, py::arg("plf") = Vector3d::Zero(),
+             py::arg("prf") = Vector3d::Zero())
+        .def("computeDeadReckoning", &serow::deadReckoning::computeDeadReckoning, py::arg("Rwb"), py::arg("Rbl"), py::arg("Rbr"),
+             py::arg("omegawb"), py::arg("bomegab"), py::arg("pbl"), py::arg("pbr"), py::arg("vbl"), py::arg("vbr"), py::arg("omegabl"),
+             py::arg("omegabr"), py::arg("lfz"), py::arg("rfz"), py::arg("lf"), py::arg("rf"), py::arg("lt"), py::arg("rt"))
+        .def("computeDeadReckoningGEM", &serow::deadReckoning::computeDeadReckoningGEM, py::arg("Rwb"), py::arg("Rbl"), py::arg("Rbr"),
+             py::arg("omegawb"), py::arg("pbl"), py::arg("pbr"), py::arg("vbl"), py::arg("vbr"), py::arg("omegabl"), py::arg("omegabr"),
+             py::arg("wl"), py::arg("wr"), py::arg("lf"), py::arg("rf"), py::arg("lt"), py::arg("rt"))
+        .def("getOdom", [](const serow::deadReckoning &dr) { return dr.getOdom(); })
+        .def("getLinearVel", [](const serow::deadReckoning &dr) { return dr.getLinearVel(); })
+        .def("getLFootLinearVel", &serow::deadReckoning::getLFootLinearVel)
+        .def("getRFootLinearVel", &serow::deadReckoning::getRFootLinearVel)
+        .def("getLFootAngularVel", &serow::deadReckoning::getLFootAngularVel)
+        .def("getRFootAngularVel", &serow::deadReckoning::getRFootAngularVel);
+
+    //Contact detection
+    py::class_<serow::ContactDetection>(m, "ContactDetection")
+        .def(py::init<>())
+        .def("init", (void (serow::ContactDetection::*)(std::string, std::string, double, double, double, double, double, int)) &serow::ContactDetection::init,
+             py::arg("lfoot_frame"), py::arg("rfoot_frame"), py::arg("LegHighThres"), py::arg("LegLowThres"), py::arg("StrikingContact"),
+             py::arg("VelocityThres"), py::arg("prob_TH") = 0.9, py::arg("medianWindow") = 10)
+        .def("computeForceWeights", &serow::ContactDetection::computeForceWeights, py::arg("lf"), py::arg("rf"))
+        .def("SchmittTrigger", &serow::ContactDetection::SchmittTrigger, py::arg("lf"), py::arg("rf"))
+        .def("computeSupportFoot", &serow::ContactDetection::computeSupportFoot, py::arg("lf"), py::arg("rf"), py::arg("coplx"),
+             py::arg("coply"), py::arg("coprx"), py::arg("copry"), py::arg("lvnorm"), py::arg("rvnorm"))
+        .def("setThresholds", &serow::ContactDetection::setThresholds)
+        .def("getLLegContactProb", &serow::ContactDetection::getLLegContactProb)
+        .def("getRLegContactProb", &serow::ContactDetection::getRLegContactProb)
+        .def("isLLegContact", &serow::ContactDetection::isLLegContact)
+        .def("isRLegContact", &serow::ContactDetection::isRLegContact)
+        .def("getSupportLeg", &serow::ContactDetection::getSupportLeg)
+        .def("getSupportFrame", &serow::ContactDetection::getSupportFrame)
+        .def("getSupportPhase", &serow::ContactDetection::getSupportPhase);
+
+    //Kinematics
+    py::class_<serow::robotDyn>(m, "robotDyn")
+        .def(py::init<const std::string &, const bool &, const bool &, const std::string &>(), py::arg("model_name"),
+             py::arg("has_floating_base") = false, py::arg("verbose") = false, py::arg("cache_dir") = "")
+        .def("mapJointNames", &serow::robotDyn::mapJointNames, py::arg("names"))
+        .def("updateJointConfig", (void (serow::robotDyn::*)(const Eigen::VectorXd &, const Eigen::VectorXd &, double)) &serow::robotDyn::updateJointConfig,
+             py::arg("q"), py::arg("qdot"), py::arg("joint_std"))
+        .def("linkPosition", &serow::robotDyn::linkPosition)
+        .def("linkOrientation", [](serow::robotDyn &rd, const std::string &frame) { return wxyz(rd.linkOrientation(frame)); })
+        .def("getLinearVelocity", &serow::robotDyn::getLinearVelocity)
+        .def("getAngularVelocity", &serow::robotDyn::getAngularVelocity)
+        .def("comPosition", &serow::robotDyn::comPosition)
+        .def("jointNames", &serow::robotDyn::jointNames)
+        .def("ndofActuated", &serow::robotDyn::ndofActuated)
+        .def("linkPoses", [](serow::robotDyn &rd, const std::string &frame, const RowsIn &q) {
+                 const Eigen::Index T = q.rows();
+                 py::array_t<double> out = outputRows(T, 7);
+                 Eigen::Map<Rows> o(out.mutable_data(), T, 7);
+                 {
+                     py::gil_scoped_release release;
+                     Eigen::VectorXd qt(q.cols()), zero = Eigen::VectorXd::Zero(q.cols());
+                     for (Eigen::Index t = 0; t < T; t++)
+                     {
+                         qt = q.row(t).transpose();
+                         rd.updateJointConfig(qt, zero, 0.0);
+                         o.row(t).head<3>() = rd.linkPosition(frame).transpose();
+                         o.row(t).tail<4>() = wxyz(rd.linkOrientation(frame)).transpose();
+                     }
+                 }
+                 return out; },
+             "pose of frame in the base frame for every row of joint positions (order of mapJointNames), returns T x 7: position then w, x, y, z",
+             py::arg("frame"), py::arg("q").noconvert());
+
+    //Offline replay of the humanoid pipeline
+    py::class_<serow::HumanoidReplayParams>(m, "HumanoidReplayParams")
+        .def(py::init<>())
+        .def_readwrite("modelname", &serow::HumanoidReplayParams::modelname)
+        .def_readwrite("lfoot_frame", &serow::HumanoidReplayParams::lfoot_frame)
+        .def_readwrite("rfoot_frame", &serow::HumanoidReplayParams::rfoot_frame)
+        .def_readwrite("model_cache_dir", &serow::HumanoidReplayParams::model_cache_dir)
+        .def_readwrite("joint_names", &serow::HumanoidReplayParams::joint_names)
+        .def_readwrite("freq", &serow::HumanoidReplayParams::freq)
+        .def_readwrite("joint_noise_density", &serow::HumanoidReplayParams::joint_noise_density)
+        .def_readwrite("mass", &serow::HumanoidReplayParams::mass)
+        .def_readwrite("gravity", &serow::HumanoidReplayParams::gravity)
+        .def_readwrite("Tau0", &serow::HumanoidReplayParams::Tau0)
+        .def_readwrite("Tau1", &serow::HumanoidReplayParams::Tau1)
+        .def_readwrite("Mahony_Kp", &serow::HumanoidReplayParams::Mahony_Kp)
+        .def_readwrite("Mahony_Ki", &serow::HumanoidReplayParams::Mahony_Ki)
+        .def_readwrite("LegHighThres", &serow::HumanoidReplayParams::LegHighThres)
+        .def_readwrite("LegLowThres", &serow::HumanoidReplayParams::LegLowThres)
+        .def_readwrite("StrikingContact", &serow::HumanoidReplayParams::StrikingContact)
+        .def_readwrite("VelocityThres", &serow::HumanoidReplayParams::VelocityThres)
+        .def_readwrite("LosingContact", &serow::HumanoidReplayParams::LosingContact)
+        .def_readwrite("medianWindow", &serow::HumanoidReplayParams::medianWindow)
+        .def_readwrite("useLegOdom", &serow::HumanoidReplayParams::useLegOdom)
+        .def_readwrite("p_FT_LL", &serow::HumanoidReplayParams::p_FT_LL)
+        .def_readwrite("p_FT_RL", &serow::HumanoidReplayParams::p_FT_RL)
+        .def_readwrite("bias_a", &serow::HumanoidReplayParams::bias_a)
+        .def_readwrite("bias_g", &serow::HumanoidReplayParams::bias_g)
+        .def_readwrite("noise", &serow::HumanoidReplayParams::noise);
+
+    m.def("replayHumanoid", [](const serow::HumanoidReplayParams &p, const RowsIn &gyro, const RowsIn &acc, const RowsIn &q,
+                               const RowsIn &dq, const RowsIn &lft, const RowsIn &rft) {
+              const Eigen::Index T = gyro.rows(), J = (Eigen::Index)p.joint_names.size();
+              checkRows(gyro, T, 3, "gyro");
+              checkRows(acc, T, 3, "acc");
+              checkRows(q, T, J, "q");
+              checkRows(dq, T, J, "dq");
+              checkRows(lft, T, 6, "lft");
+              checkRows(rft, T, 6, "rft");
+              py::array_t<double> out = outputRows(T, serow::HumanoidReplay::Columns);
+              Eigen::Map<Rows> o(out.mutable_data(), T, serow::HumanoidReplay::Columns);
+              {
+                  py::gil_scoped_release release;
+                  serow::HumanoidReplay replay(p);
+                  replay.run(gyro, acc, q, dq, lft, rft, o);
+              }
+              return out; },
+          "runs the humanoid base estimation over a recording, one row per IMU sample, returns T x 21: base position, base velocity "
+          "(world frame), base orientation w, x, y, z, gyro bias, acc bias, leg odometry position, left/right contact",
+          py::arg("params"), py::arg("gyro").noconvert(), py::arg("acc").noconvert(), py::arg("q").noconvert(), py::arg("dq").noconvert(),
+          py::arg("lft").noconvert(), py::arg("rft").noconvert());
+}
@@ -0,0 +1,134 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Reader of the shared memory estimate channel
+ * @author Stylianos Piperakis
+ * @details prints the latest estimate of a running estimator, or with --bench measures the read latency
+ * usage: serow_shm_reader [channel name, default /serow_estimate] [--bench reads]
+ */
+
+#include <serow/SharedEstimate.h>
+#include <serow/StageProfiler.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+static int64_t realtimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void bench(const serow::SharedEstimateReader &reader, long reads)
+{
+    serow::SharedEstimate e;
+    serow::LatencyHistogram single, age;
+    //individual reads include the clock overhead, the batch gives the mean without it
+    for (long i = 0; i < reads; i++)
+    {
+        uint64_t t0 = serow::monotonicNs();
+        reader.read(e);
+        single.record(serow::monotonicNs() - t0);
+        int64_t a = realtimeNs() - e.stamp_ns;
+        if (a > 0)
+            age.record(a);
+    }
+    uint64_t t0 = serow::monotonicNs();
+    for (long i = 0; i < reads; i++)
+        reader.read(e);
+    double mean = (double)(serow::monotonicNs() - t0) / reads;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "reads " << reads << ", mean " << mean << " ns" << std::endl;
+    std::cout << "single read p50/p99/p99.9/max [ns] " << single.percentile(50) << " / " << single.percentile(99) << " / "
+              << single.percentile(99.9) << " / " << single.max() << std::endl;
+    if (age.count())
+        std::cout << "estimate age p50/p99/max [us] (wall clock time only) " << age.percentile(50) * 1e-3 << " / "
+                  << age.percentile(99) * 1e-3 << " / " << age.max() * 1e-3 << std::endl;
+}
+
+static void print(const serow::SharedEstimate &e)
+{
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "cycle " << e.cycle << " level " << e.degradation
+              << " base p [" << e.base_pos[0] << " " << e.base_pos[1] << " " << e.base_pos[2] << "]"
+              << " q [" << e.base_q[0] << " " << e.base_q[1] << " " << e.base_q[2] << " " << e.base_q[3] << "]"
+              << " v [" << e.base_vel[0] << " " << e.base_vel[1] << " " << e.base_vel[2] << "]";
+    if (e.com_valid)
+        std::cout << " com [" << e.com_pos[0] << " " << e.com_pos[1] << " " << e.com_pos[2] << "]";
+    std::cout << " contact";
+    for (int i = 0; i < e.num_legs && i < serow::SharedEstimate::MaxLegs; i++)
+        std::cout << " " << e.contact[i] << "(" << std::setprecision(2) << e.contact_prob[i] << ")";
+    std::cout << " support " << e.support_leg << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string name = "/serow_estimate";
+    long reads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bench" && i + 1 < argc)
+            reads = std::atol(argv[++i]);
+        else
+            name = arg;
+    }
+
+    serow::SharedEstimateReader reader;
+    if (!reader.open(name))
+    {
+        std::cerr << "Could not attach to " << name << ", is the estimator running with shm_estimate_name set?" << std::endl;
+        return 1;
+    }
+    serow::SharedEstimate e;
+    while (!reader.read(e))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    if (reads > 0)
+    {
+        bench(reader, reads);
+        return 0;
+    }
+    uint64_t last = 0;
+    for (;;)
+    {
+        if (reader.sequence() != last)
+        {
+            last = reader.sequence();
+            reader.read(e);
+            print(e);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return 0;
+}
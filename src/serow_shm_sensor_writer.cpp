@@ -0,0 +1,136 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Stand-in writer of the shared memory sensor ring
+ * @author Stylianos Piperakis
+ * @details takes the place of the robot middleware for testing sensor_input: shm, it subscribes to the
+ * IMU, joint state and foot wrench topics (e.g. of a rosbag) and writes one frame per IMU message with the
+ * joint states and wrenches received since the previous one. Private parameters: shm_sensor_name,
+ * imu_topic, joint_state_topic and wrench_topics, the foot wrench topics in LLeg, RLeg or LF, LH, RF, RH order
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/JointState.h>
+#include <geometry_msgs/WrenchStamped.h>
+#include <boost/bind.hpp>
+#include <serow/SharedSensors.h>
+
+class SharedSensorBridge
+{
+private:
+    ros::NodeHandle n, n_p;
+    ros::Subscriber imu_sub, joint_state_sub;
+    std::vector<ros::Subscriber> wrench_subs;
+    serow::SharedSensorWriter ring;
+    serow::SharedSensorFrame frame;
+    std::string shm_sensor_name;
+    int capacity;
+
+public:
+    SharedSensorBridge() : n_p("~")
+    {
+        std::string imu_topic, joint_state_topic;
+        std::vector<std::string> wrench_topics;
+        n_p.param<std::string>("shm_sensor_name", shm_sensor_name, "/serow_sensors");
+        n_p.param<std::string>("imu_topic", imu_topic, "imu");
+        n_p.param<std::string>("joint_state_topic", joint_state_topic, "joint_states");
+        n_p.param<std::vector<std::string>>("wrench_topics", wrench_topics, std::vector<std::string>());
+        n_p.param<int>("capacity", capacity, 256);
+        std::memset(&frame, 0, sizeof(frame));
+        frame.num_wrenches = std::min((int)wrench_topics.size(), (int)serow::SharedSensorFrame::MaxWrenches);
+
+        imu_sub = n.subscribe(imu_topic, 1000, &SharedSensorBridge::imuCb, this, ros::TransportHints().tcpNoDelay());
+        joint_state_sub = n.subscribe(joint_state_topic, 100, &SharedSensorBridge::joint_stateCb, this, ros::TransportHints().tcpNoDelay());
+        for (int i = 0; i < frame.num_wrenches; i++)
+            wrench_subs.push_back(n.subscribe<geometry_msgs::WrenchStamped>(wrench_topics[i], 100, boost::bind(&SharedSensorBridge::wrenchCb, this, _1, i),
+                                                                            ros::VoidConstPtr(), ros::TransportHints().tcpNoDelay()));
+    }
+
+    ~SharedSensorBridge()
+    {
+        ring.close(true);
+    }
+
+    void joint_stateCb(const sensor_msgs::JointState::ConstPtr &msg)
+    {
+        //The ring is created with the joint names of the first message
+        if (!ring.isOpen())
+        {
+            if (!ring.open(shm_sensor_name, msg->name, capacity))
+            {
+                ROS_ERROR_THROTTLE(1.0, "Could not create the shared memory sensor ring %s", shm_sensor_name.c_str());
+                return;
+            }
+            frame.num_joints = msg->name.size();
+            ROS_INFO("Writing %d joints to the shared memory sensor ring %s", frame.num_joints, shm_sensor_name.c_str());
+        }
+        for (int i = 0; i < frame.num_joints && i < (int)msg->position.size(); i++)
+        {
+            frame.joint_pos[i] = msg->position[i];
+            frame.joint_vel[i] = i < (int)msg->velocity.size() ? msg->velocity[i] : 0.0;
+        }
+        frame.parts |= serow::SharedSensorFrame::HasJoints;
+    }
+
+    void wrenchCb(const geometry_msgs::WrenchStamped::ConstPtr &msg, int leg)
+    {
+        frame.force[leg][0] = msg->wrench.force.x;
+        frame.force[leg][1] = msg->wrench.force.y;
+        frame.force[leg][2] = msg->wrench.force.z;
+        frame.torque[leg][0] = msg->wrench.torque.x;
+        frame.torque[leg][1] = msg->wrench.torque.y;
+        frame.torque[leg][2] = msg->wrench.torque.z;
+        frame.parts |= serow::SharedSensorFrame::HasWrenches;
+    }
+
+    void imuCb(const sensor_msgs::Imu::ConstPtr &msg)
+    {
+        if (!ring.isOpen())
+            return;
+        frame.stamp_ns = msg->header.stamp.toNSec();
+        frame.gyro[0] = msg->angular_velocity.x;
+        frame.gyro[1] = msg->angular_velocity.y;
+        frame.gyro[2] = msg->angular_velocity.z;
+        frame.acc[0] = msg->linear_acceleration.x;
+        frame.acc[1] = msg->linear_acceleration.y;
+        frame.acc[2] = msg->linear_acceleration.z;
+        frame.parts |= serow::SharedSensorFrame::HasImu;
+        ring.write(frame);
+        frame.parts = 0;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    ros::init(argc, argv, "serow_shm_sensor_writer");
+    SharedSensorBridge bridge;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,140 @@
+/* 
+ * Copyright 2017-2020 Stylianos Piperakis, Foundation for Research and Technology Hellas (FORTH)
+ * License: BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Foundation for Research and Technology Hellas (FORTH) 
+ *		 nor the names of its contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+ /**
+ * @brief Converter of telemetry files to CSV
+ * @author Stylianos Piperakis
+ * @details writes one <prefix>_<channel>.csv per channel of a file recorded with serow::Telemetry, the first
+ * column is the record stamp in nanoseconds
+ * usage: serow_telemetry_csv file.tlm [output prefix, default the file name without extension]
+ */
+
+#include <serow/Telemetry.h>
+#include <iostream>
+#include <fstream>
+#include <map>
+
+struct CsvChannel
+{
+    std::string name;
+    std::vector<std::string> columns;
+    std::ofstream *out;
+    long records;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: serow_telemetry_csv file.tlm [output prefix]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    std::string prefix = argc > 2 ? argv[2] : path;
+    size_t dot = prefix.find_last_of('.'), slash = prefix.find_last_of('/');
+    if (argc <= 2 && dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        prefix.erase(dot);
+    std::ifstream in(path.c_str(), std::ios::binary);
+    serow::TelemetryFileHeader fh;
+    if (!in.read(reinterpret_cast<char *>(&fh), sizeof(fh)) || std::string(fh.magic, 8) != "SEROWTLM")
+    {
+        std::cerr << path << " is not a telemetry file" << std::endl;
+        return 1;
+    }
+
+    std::map<uint32_t, CsvChannel> channels;
+    serow::TelemetryBlockHeader h;
+    std::vector<char> names;
+    std::vector<uint64_t> stamps;
+    std::vector<double> values;
+    bool truncated = false;
+    while (in.read(reinterpret_cast<char *>(&h), sizeof(h)))
+    {
+        if (h.type == serow::TelemetryBlockHeader::Definition)
+        {
+            names.resize(h.count);
+            if (!in.read(&names[0], h.count))
+            {
+                truncated = true;
+                break;
+            }
+            CsvChannel &c = channels[h.channel];
+            const char *p = &names[0];
+            c.name = p;
+            c.columns.clear();
+            for (uint32_t k = 0; k < h.columns; k++)
+            {
+                p += strlen(p) + 1;
+                c.columns.push_back(p);
+            }
+            std::string file = prefix + "_" + c.name + ".csv";
+            c.out = new std::ofstream(file.c_str());
+            c.records = 0;
+            c.out->precision(17);
+            *c.out << "stamp";
+            for (size_t k = 0; k < c.columns.size(); k++)
+                *c.out << "," << c.columns[k];
+            *c.out << "\n";
+        }
+        else if (h.type == serow::TelemetryBlockHeader::Data)
+        {
+            stamps.resize(h.count);
+            values.resize((size_t)h.count * h.columns);
+            if (!in.read(reinterpret_cast<char *>(&stamps[0]), h.count * sizeof(uint64_t)) ||
+                !in.read(reinterpret_cast<char *>(&values[0]), values.size() * sizeof(double)))
+            {
+                truncated = true;
+                break;
+            }
+            std::map<uint32_t, CsvChannel>::iterator c = channels.find(h.channel);
+            if (c == channels.end())
+                continue;
+            for (uint32_t j = 0; j < h.count; j++)
+            {
+                *c->second.out << stamps[j];
+                for (uint32_t k = 0; k < h.columns; k++)
+                    *c->second.out << "," << values[(size_t)k * h.count + j];
+                *c->second.out << "\n";
+            }
+            c->second.records += h.count;
+        }
+        else
+        {
+            std::cerr << "Unknown block type " << h.type << ", stopping" << std::endl;
+            break;
+        }
+    }
+    if (truncated)
+        std::cerr << "The last block is truncated, the file was still being written" << std::endl;
+    for (std::map<uint32_t, CsvChannel>::iterator c = channels.begin(); c != channels.end(); ++c)
+    {
+        std::cout << prefix << "_" << c->second.name << ".csv: " << c->second.records << " records" << std::endl;
+        delete c->second.out;
+    }
+    return 0;
+}